@@ -0,0 +1,12 @@
+#pragma once
+
+#include <boost/asio/generic/stream_protocol.hpp>
+#include <string>
+
+// Socket of one client connection, as handed to request handlers. TCP and Unix domain
+// clients are both accepted into it, and it keeps the address family of its listener.
+using ClientSocket = boost::asio::generic::stream_protocol::socket;
+
+// Client address for logs: the IP for TCP peers, "unix" for Unix socket peers,
+// "unknown" once the connection is gone
+std::string peerAddress(const ClientSocket& socket);
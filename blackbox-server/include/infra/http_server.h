@@ -1,6 +1,8 @@
 #pragma once
 
+#include "infra/client_socket.h"
 #include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/local/stream_protocol.hpp>
 #include <boost/beast/http.hpp>
 
 namespace beast = boost::beast;
@@ -8,6 +10,8 @@ namespace http = beast::http;
 namespace net = boost::asio;
 using tcp = boost::asio::ip::tcp;
 
-void handleRequest(http::request<http::string_body>& req, tcp::socket& socket);
+void handleRequest(http::request<http::string_body>& req, ClientSocket& socket);
+// Serve clients of the listener forever, each connection on its own thread
 void acceptConnections(tcp::acceptor& acceptor);
+void acceptConnections(net::local::stream_protocol::acceptor& acceptor);
 
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <boost/beast/http.hpp>
+#include "infra/client_socket.h"
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace beast = boost::beast;
+namespace http = beast::http;
+
+// Path parameters captured by a match, as views into the request target
+struct RouteParams {
+    static constexpr size_t MAX_PARAMS = 4;
+    std::string_view names[MAX_PARAMS];
+    std::string_view values[MAX_PARAMS];
+    size_t count = 0;
+
+    std::string_view get(std::string_view name) const;
+};
+
+using RouteHandler = std::function<void(http::request<http::string_body>&, ClientSocket&, const RouteParams&)>;
+
+// Route table built once at startup. Patterns are split into segments when added;
+// a lookup splits the request path into string_views and compares segment by segment.
+//
+//   router.add(http::verb::get, "/jobs/{id}", handleJob);
+//   Router::Match match = router.match(req.method(), path, params);
+class Router {
+public:
+    // timed: record the request latency under "http:<pattern>" (off for streams, which stay open)
+    void add(http::verb method, const std::string& pattern, RouteHandler handler, bool timed = true);
+
+    struct Match {
+        const RouteHandler* handler = nullptr;  // nullptr: no route for this method
+        const char* stage = nullptr;            // Stage name for ScopedStageTimer
+        bool path_found = false;                // The path exists under another method (405)
+        const std::string* allow = nullptr;     // Methods of the path, for the Allow header
+    };
+
+    Match match(http::verb method, std::string_view path, RouteParams& params) const;
+
+private:
+    struct Segment {
+        std::string text;
+        bool parameter;  // "{name}": matches any non-empty segment, text holds the name
+    };
+    struct Route {
+        std::string pattern;
+        std::vector<Segment> segments;
+        std::string stage;
+        bool timed;
+        std::vector<std::pair<http::verb, RouteHandler>> handlers;
+        std::string allow;
+    };
+
+    std::vector<Route> routes;
+};
@@ -4,5 +4,6 @@
 #include <vector>
 #include <chrono>
 
+double calculatePercentile(const std::vector<double>& sorted_values, double percentile);
 AggregatedVRAMInfo collectAggregatedMetrics(unsigned int window_seconds);
 
@@ -0,0 +1,14 @@
+#pragma once
+
+#include "vram_types.h"
+#include <vector>
+
+// Map for a model whose first utilized_blocks blocks are in use (vLLM only reports a usage fraction)
+ModelBlockMap buildModelBlockMap(const std::string& model_id, int port, unsigned long long block_size,
+                                 unsigned int num_blocks, unsigned int utilized_blocks);
+
+// Utilized blocks within [first_block, first_block + count)
+unsigned int countUtilizedBlocks(const ModelBlockMap& map, unsigned int first_block, unsigned int count);
+
+// Expand at most limit blocks starting at offset into per-block records
+std::vector<MemoryBlock> expandBlocks(const ModelBlockMap& map, unsigned int offset, unsigned int limit);
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <string>
+
+// Container ID found in a /proc/<pid>/cgroup file, or "" for host processes.
+// Understands cgroup v1 (/docker/<id>), cgroup v2 and systemd scopes (docker-<id>.scope).
+std::string parseContainerIdFromCgroup(const std::string& cgroup);
+
+// Start time of a process in clock ticks since boot (0 if it has exited)
+unsigned long long readProcessStartTime(unsigned int pid);
+
+// Container ID of a running process, read from /proc/<pid>/cgroup ("" for host processes).
+// Uncached; the process table keeps the result per PID and start time.
+std::string resolveContainerId(unsigned int pid);
+
+// model_id of the blackbox-deployed container with this ID, or "" if it is not one of ours
+std::string resolveContainerModel(const std::string& container_id);
+
+// Forget container -> model mappings (after containers are renamed)
+void invalidateContainerModelCache();
+
+// Bumped whenever container -> model mappings may have changed
+unsigned long long getContainerModelGeneration();
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <boost/beast/http.hpp>
+#include "infra/client_socket.h"
+
+namespace beast = boost::beast;
+namespace http = beast::http;
+
+void handleDebugTimingsRequest(http::request<http::string_body>& req, ClientSocket& socket);
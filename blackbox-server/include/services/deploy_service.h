@@ -1,14 +1,13 @@
 #pragma once
 
 #include <boost/beast/http.hpp>
-#include <boost/asio/ip/tcp.hpp>
+#include "infra/client_socket.h"
 #include "hf_deploy.h"
 
 namespace beast = boost::beast;
 namespace http = beast::http;
-using tcp = boost::asio::ip::tcp;
 
-void handleDeployRequest(http::request<http::string_body>& req, tcp::socket& socket);
+void handleDeployRequest(http::request<http::string_body>& req, ClientSocket& socket);
 
 
 
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "vram_types.h"
+#include "services/process_table.h"
+#include "services/vllm_client.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+// Source of raw per-device telemetry. getDetailedVRAMUsage() only talks to the
+// active backend, so the simulated one drives the same collection, aggregation
+// and serialization paths as real hardware.
+class GpuTelemetryBackend {
+public:
+    virtual ~GpuTelemetryBackend() = default;
+
+    virtual std::string name() const = 0;
+    virtual bool init() = 0;
+    virtual void shutdown() = 0;
+    virtual unsigned int deviceCount() const = 0;
+
+    // Called once before the devices of a snapshot are queried
+    virtual void beginSnapshot() {}
+    // Both may be called concurrently for different devices
+    virtual GPUDeviceInfo queryDevice(unsigned int index) = 0;
+    virtual std::vector<ProcessMemory> queryProcesses(unsigned int index) = 0;
+
+    // False when PIDs do not exist on this host (no cgroup lookups or Nsight profiling)
+    virtual bool hasHostProcesses() const = 0;
+
+    // Name and model of a PID when hasHostProcesses() is false; empty fields are unknown
+    virtual ProcessMetadata describeProcess(unsigned int pid) { return ProcessMetadata{pid, 0, "", "", "", ""}; }
+    // vLLM KV cache metrics per model; the default scrapes the running deployments
+    virtual std::vector<ModelBlockData> queryModelBlockData() { return fetchPerModelBlockData(); }
+};
+
+std::unique_ptr<GpuTelemetryBackend> createNvmlBackend();
+
+// Chooses the backend from GPU_BACKEND ("nvml" or "simulated", default nvml)
+void selectGpuTelemetryBackend();
+void setGpuTelemetryBackend(std::unique_ptr<GpuTelemetryBackend> backend);
+GpuTelemetryBackend& getGpuTelemetryBackend();
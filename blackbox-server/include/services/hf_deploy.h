@@ -1,6 +1,8 @@
 #pragma once
 
+#include <initializer_list>
 #include <string>
+#include <vector>
 
 struct DeployResponse {
     bool success;
@@ -16,11 +18,18 @@ struct ModelInfo {
     std::string error;
 };
 
-DeployResponse deployHFModel(const std::string& model_id, const std::string& hf_token = "", int port = 8000, const std::string& gpu_type = "", const std::string& custom_config_path = "");
+DeployResponse deployHFModel(const std::string& model_id, const std::string& hf_token = "", int port = 8000, const std::string& gpu_type = "", const std::string& custom_config_path = "", const std::string& container_name_override = "");
 ModelInfo validateHFModel(const std::string& model_id, const std::string& hf_token);
 std::string searchHFModel(const std::string& search_term, const std::string& hf_token);
-std::string generateDockerCommand(const std::string& model_id, const std::string& hf_token, int port, const std::string& config_path, int tensor_parallel_size = 1);
+// Argv for `docker run` of the model, as executed by deployHFModel
+std::vector<std::string> generateDockerArgs(const std::string& model_id, const std::string& hf_token, int port, const std::string& config_path, int tensor_parallel_size = 1, const std::string& container_name_override = "");
+// Docker CLI argv (prefixed with sudo when needed) followed by the given arguments
+std::vector<std::string> dockerArgv(std::initializer_list<std::string> args);
+// `docker ps --filter` value matching exactly this container (a plain name= filter matches substrings)
+std::string dockerNameFilter(const std::string& container_name);
 int getGPUCount();
 double getMaxGPUUtilizationFromConfig(const std::string& config_path);
+int getTensorParallelSizeFromConfig(const std::string& config_path);
+std::vector<unsigned int> selectGPUDevices(int tensor_parallel_size);
 std::string getConfigPathForGPU(const std::string& gpu_type);
 
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <boost/beast/http.hpp>
+#include "infra/client_socket.h"
+
+namespace beast = boost::beast;
+namespace http = beast::http;
+
+void handleMetricsRequest(http::request<http::string_body>& req, ClientSocket& socket);
+
+// Track open /vram/stream connections for blackbox_stream_subscribers
+void adjustStreamSubscribers(int delta);
+
+// Track client connections and requests served on reused (keep-alive) connections
+void adjustOpenConnections(int delta);
+void recordKeepAliveRequest();
@@ -1,9 +1,12 @@
 #pragma once
 
+#include "vram_types.h"
+#include "services/sizing_engine.h"
 #include <string>
 #include <vector>
 #include <map>
 #include <deque>
+#include <array>
 
 struct DeployedModel {
     std::string model_id;
@@ -18,8 +21,27 @@ struct DeployedModel {
     unsigned int pid;
 };
 
+struct ModelUsageSample {
+    double timestamp;                          // steady_clock seconds
+    unsigned long long total_vram_bytes;       // Capacity of the GPUs the model spans
+    unsigned int gpu_count;                    // GPUs the model spans (tensor parallel workers)
+    unsigned long long allocated_vram_bytes;
+    unsigned long long used_kv_cache_bytes;
+    double kv_cache_usage_perc;                // 0.0-1.0
+    unsigned int num_gpu_blocks;
+    unsigned long long kv_block_bytes;         // Per device; 0 if vLLM did not report swap blocks
+    unsigned int num_requests_running;
+    unsigned int num_requests_waiting;
+    unsigned long long num_preemptions_total;
+};
+
 struct ModelMetrics {
+    std::string model_id;
+    int port;
     std::deque<double> vram_samples;
+    std::deque<ModelUsageSample> usage_samples;
+    std::array<double, 24> hourly_kv_peak;    // Peak KV usage per local hour of day, decayed daily
+    std::array<long long, 24> hourly_kv_day;  // Local day number each hour bucket was last written
     double peak_usage;
     double configured_max_utilization;
     std::string gpu_type;
@@ -33,9 +55,21 @@ struct ModelListResponse {
     int max_allowed;
 };
 
+struct OptimizationTarget {
+    std::string container_name;
+    std::string model_id;
+    int port;
+    std::string gpu_type;
+    double current_utilization;  // gpu-memory-utilization the model runs with now (0.0-1.0)
+    double target_utilization;   // gpu-memory-utilization to redeploy with (0.0-1.0)
+};
+
 struct OptimizationResult {
     bool optimized;
     std::vector<std::string> restarted_models;
+    std::vector<OptimizationTarget> targets;
+    std::vector<SizingRecommendation> recommendations;
+    long long projected_savings_bytes;  // Sum over targets; negative if models need to grow
     std::string message;
 };
 
@@ -46,13 +80,26 @@ bool isModelDeployed(const std::string& model_id);
 bool canDeployModel();
 int getNextAvailablePort(int preferred_port = 0);
 std::string getContainerName(const std::string& model_id);
+// "<container>-next": the replacement a rolling restart starts next to the container
+std::string getStagingContainerName(const std::string& container_name);
+bool isStagingContainerName(const std::string& name);
 bool spindownModel(const std::string& model_id_or_container);
+bool renameContainer(const std::string& from, const std::string& to);
 void updateModelVRAMUsage(const std::string& container_name, double vram_percent);
+// Sizing sample for one model of a snapshot (snapshot_total is used when its GPUs are unknown)
+ModelUsageSample makeUsageSample(const ModelVRAMInfo& model, unsigned long long snapshot_total, double timestamp);
+void recordModelUsage(const DetailedVRAMInfo& info);
+// Records every model's usage once per USAGE_SAMPLE_INTERVAL seconds (default 5)
+void startUsageSamplerThread();
 void registerModelDeployment(const std::string& model_id, const std::string& container_name, 
-                             double configured_max_gpu_utilization, const std::string& gpu_type, unsigned int pid);
+                             double configured_max_gpu_utilization, const std::string& gpu_type, unsigned int pid, int port = 0);
 void unregisterModel(const std::string& container_name);
+void renameModelRegistration(const std::string& from, const std::string& to);
+std::map<std::string, ModelMetrics> getModelMetricsSnapshot();
 std::string detectGPUType();
 OptimizationResult optimizeModelAllocations();
+bool checkModelHealth(int port);
+bool waitForModelReady(int port, int timeout_seconds);
 void checkVLLMHealth();
 void startHealthCheckThread();
 
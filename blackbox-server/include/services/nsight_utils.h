@@ -1,6 +1,20 @@
 #pragma once
 
 #include "vram_types.h"
+#include <string>
+#include <vector>
 
-NsightMetrics getNsightMetrics(unsigned int pid);
+// Runs ncu against the process and blocks until it finishes; use the profile queue
+// (profile_queue.h) rather than calling this on a request path.
+// Returns false if ncu is not installed or produced no kernel rows.
+bool collectKernelProfiles(unsigned int pid, std::vector<KernelProfile>& kernels);
 
+// Parse ncu --csv output into one entry per kernel launch. Accepts both the details
+// layout (one row per launch and metric) and the raw layout (one column per metric).
+std::vector<KernelProfile> parseNcuCsv(const std::string& csv);
+
+// Aggregate launches by kernel name, longest total duration first
+std::vector<KernelSummary> summarizeKernels(const std::vector<KernelProfile>& kernels);
+
+// Process-wide totals of a trace, as attached to /vram snapshots
+NsightMetrics aggregateNsightMetrics(const std::vector<KernelProfile>& kernels);
@@ -1,8 +1,34 @@
 #pragma once
 
 #include "vram_types.h"
+#include "services/vram_tracker.h"
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Optional snapshot sections. Totals, per-GPU and per-model figures are always
+// computed; everything else only when a consumer asks for it.
+enum SnapshotSection : unsigned int {
+    SNAPSHOT_CORE = 0,
+    SNAPSHOT_PROCESSES = 1u << 0,  // Per-process list with names
+    SNAPSHOT_BLOCKS = 1u << 1,     // Run-length encoded KV block maps
+    SNAPSHOT_NSIGHT = 1u << 2,     // Nsight Compute metrics (profiles processes; slow)
+    SNAPSHOT_THREADS = 1u << 3,    // Per-thread allocations
+};
+
+// "processes,blocks" -> section mask; unknown names are ignored
+unsigned int parseSnapshotSections(const std::string& include);
+// Adds the sections the requested ones depend on
+unsigned int resolveSnapshotSections(unsigned int sections);
 
 bool initNVML();
 void shutdownNVML();
-DetailedVRAMInfo getDetailedVRAMUsage();
-
+unsigned int getGPUDeviceCount();
+std::vector<GPUDeviceInfo> getGPUDevices();
+DetailedVRAMInfo getDetailedVRAMUsage(unsigned int sections = SNAPSHOT_CORE);
+// Collects and publishes a snapshot, returning the shared published instance (with its body cache)
+std::shared_ptr<const PublishedSnapshot> collectVRAMSnapshot(unsigned int sections = SNAPSHOT_CORE);
+// The latest published snapshot with these sections if it is at most max_age old, otherwise a
+// new collection. Concurrent callers asking for the same sections share one collection.
+std::shared_ptr<const PublishedSnapshot> getRecentVRAMSnapshot(unsigned int sections, std::chrono::milliseconds max_age);
@@ -0,0 +1,7 @@
+#pragma once
+
+// Subscribe to the kernel proc connector (fork/exec/exit events) and keep the
+// process table up to date from it. Needs CAP_NET_ADMIN; without it, or with
+// PROC_EVENTS=false, samples keep polling /proc. Returns true if events are flowing.
+bool startProcessEventListener();
+bool processEventsActive();
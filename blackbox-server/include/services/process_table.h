@@ -0,0 +1,28 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+struct ProcessMetadata {
+    unsigned int pid;
+    unsigned long long start_time;  // Clock ticks since boot; identifies the process across PID reuse
+    std::string name;               // /proc/<pid>/comm
+    std::string cmdline;            // /proc/<pid>/cmdline, arguments joined by spaces
+    std::string container_id;       // "" for host processes
+    std::string model_id;           // "" unless the container is a blackbox deployment
+};
+
+// Bring the table in line with the GPU processes of the current sample. Only PIDs
+// that are new (or reappear after being absent) touch /proc; entries are dropped
+// once their process has exited.
+void refreshProcessTable(const std::vector<unsigned int>& live_pids);
+
+// Cached metadata for a PID, reading /proc only if it is not in the table yet
+ProcessMetadata lookupProcess(unsigned int pid);
+
+// Process event hooks (see proc_events.h). While event driven, refreshes trust the
+// table instead of re-checking /proc for reused or exited PIDs.
+void setProcessTableEventDriven(bool event_driven);
+void requestProcessTableResync();
+void handleProcessExit(unsigned int pid);
+void handleProcessExec(unsigned int pid);
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "vram_types.h"
+#include <map>
+#include <string>
+#include <vector>
+
+struct ProfileJob {
+    std::string id;
+    unsigned int pid;
+    std::string status;       // "queued", "running", "completed" or "failed"
+    std::string message;
+    long long requested_at;   // Unix seconds
+    long long started_at;     // Unix seconds, 0 while queued
+    long long finished_at;    // Unix seconds, 0 until done
+    std::string model_id;     // Model the process served when profiled ("" if none)
+    NsightMetrics metrics;
+    std::vector<KernelProfile> kernels;  // One entry per traced launch
+};
+
+struct ModelProfileReport {
+    std::string model_id;
+    std::vector<unsigned int> pids;      // Processes of the model with a cached profile
+    long long collected_at;              // Oldest of those profiles
+    NsightMetrics metrics;
+    std::vector<KernelSummary> kernels;  // Launches of all processes, aggregated by kernel name
+};
+
+struct ProfileSubmission {
+    std::string status;       // "queued", "pending" (already queued or running), "cooldown" or "queue_full"
+    std::string job_id;       // New job, or the one already pending for this PID
+    long long retry_after;    // Seconds before a new run would be accepted (cooldown/queue_full)
+};
+
+// Queue an Nsight Compute run for a PID. Runs one at a time on a background worker;
+// a PID is profiled at most once per PROFILE_COOLDOWN_SECONDS.
+ProfileSubmission submitProfileJob(unsigned int pid);
+bool getProfileJob(const std::string& job_id, ProfileJob& job);
+
+// Latest job for a PID (pending or finished)
+bool getLatestProfileJob(unsigned int pid, ProfileJob& job);
+
+// Queue runs for any of these PIDs that are off cooldown, without waiting for them
+void scheduleProfiles(const std::vector<unsigned int>& pids);
+
+// Kernel report built from the cached profiles of a model's processes; false if there are none
+bool getModelProfileReport(const std::string& model_id, ModelProfileReport& report);
+
+// Cached results for these PIDs, dropping any taken from an earlier process with the same PID
+std::map<unsigned int, NsightMetrics> getCachedProfiles(const std::vector<unsigned int>& pids);
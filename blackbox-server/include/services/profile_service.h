@@ -0,0 +1,11 @@
+#pragma once
+
+#include <boost/beast/http.hpp>
+#include "infra/client_socket.h"
+
+namespace beast = boost::beast;
+namespace http = beast::http;
+
+void handleProfileRequest(http::request<http::string_body>& req, ClientSocket& socket);
+void handleProfileStatusRequest(http::request<http::string_body>& req, ClientSocket& socket);
+void handleModelProfileRequest(http::request<http::string_body>& req, ClientSocket& socket);
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "services/model_manager.h"
+#include <string>
+#include <vector>
+
+enum class RestartStrategy {
+    IN_PLACE,  // Stop the container, then redeploy it on the same port
+    ROLLING    // Start a replacement on a new port, switch over once ready, then stop the old one
+};
+
+struct RestartOutcome {
+    std::string container_name;
+    std::string model_id;
+    bool success;
+    bool rolled;          // true if the replacement was started before the old container stopped
+    int old_port;
+    int new_port;
+    double new_utilization;
+    std::string message;
+    bool skipped = false;  // Not attempted: already being restarted, or over the VRAM budget
+};
+
+struct OptimizationJob {
+    std::string id;
+    std::string status;   // "running", "completed" or "failed"
+    std::string strategy;
+    std::vector<OptimizationTarget> targets;
+    std::vector<RestartOutcome> outcomes;
+    long long started_at;   // Unix seconds
+    long long finished_at;  // Unix seconds, 0 while running
+};
+
+RestartStrategy parseRestartStrategy(const std::string& mode);
+std::string restartStrategyName(RestartStrategy strategy);
+// Targets whose container is already being restarted by another plan (an /optimize request,
+// a rolling job or the optimizer controller) are not touched; they get a failed outcome.
+std::vector<RestartOutcome> executeOptimizationPlan(const std::vector<OptimizationTarget>& targets, RestartStrategy strategy);
+std::string submitOptimizationJob(const std::vector<OptimizationTarget>& targets, RestartStrategy strategy);
+bool getOptimizationJob(const std::string& job_id, OptimizationJob& job);
+
+// Containers with a restart in flight. claimRestart() is false if another plan holds the container.
+bool claimRestart(const std::string& container_name);
+void releaseRestart(const std::string& container_name);
+bool isRestartInProgress(const std::string& container_name);
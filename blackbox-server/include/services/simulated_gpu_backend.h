@@ -0,0 +1,49 @@
+#pragma once
+
+#include "services/gpu_backend.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+struct SimulatedProcessConfig {
+    unsigned int pid;
+    std::string name;
+    std::string curve;             // "constant", "sine", "ramp" or "step"
+    unsigned long long base_bytes;
+    unsigned long long amplitude_bytes;
+    double period_seconds;
+    std::string model_id;          // Model this process serves as a vLLM worker ("" for none)
+};
+
+// A simulated vLLM deployment; its workers are the processes naming its model_id
+struct SimulatedModelConfig {
+    std::string model_id;
+    int port;
+    unsigned int num_gpu_blocks;        // Per worker
+    unsigned long long kv_block_bytes;  // Per worker
+    std::string kv_curve;               // KV cache usage over time, same curves as process memory
+    double kv_base;                     // 0.0-1.0
+    double kv_amplitude;
+    double kv_period_seconds;
+    double gpu_memory_utilization;
+};
+
+struct SimulatedDeviceConfig {
+    std::string name;
+    unsigned long long total_bytes;
+    std::vector<SimulatedProcessConfig> processes;
+};
+
+struct SimulatedGpuConfig {
+    std::vector<SimulatedDeviceConfig> devices;
+    std::vector<SimulatedModelConfig> models;
+    double latency_ms;          // Added to every device/process query
+    double jitter_ms;           // Extra deterministic latency in [0, jitter_ms)
+    double noise_fraction;      // Deterministic +/- noise on process memory, fraction of amplitude
+    unsigned long long seed;
+    double time_step_seconds;   // > 0: simulated clock advances this much per snapshot instead of following wall time
+};
+
+// Reads GPU_SIM_CONFIG (YAML) if set, otherwise builds devices from GPU_SIM_* variables
+SimulatedGpuConfig loadSimulatedGpuConfig();
+std::unique_ptr<GpuTelemetryBackend> createSimulatedBackend(const SimulatedGpuConfig& config);
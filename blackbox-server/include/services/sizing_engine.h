@@ -0,0 +1,38 @@
+#pragma once
+
+#include <string>
+
+struct ModelMetrics;
+
+struct SizingConfig {
+    double kv_percentile;      // KV usage percentile the cache must hold (SIZING_KV_PERCENTILE, default 0.99)
+    double safety_margin;      // Headroom on top of the percentile (SIZING_SAFETY_MARGIN, default 0.15)
+    double min_change;         // Smallest utilization change worth a restart (SIZING_MIN_CHANGE, default 0.05)
+    double pressure_growth;    // Growth applied when requests are preempted (SIZING_PRESSURE_GROWTH, default 0.25)
+    unsigned int min_samples;  // Samples required before sizing a model (SIZING_MIN_SAMPLES, default 10)
+    int lookahead_minutes;     // Minutes of the daily profile ahead that must still fit (SIZING_LOOKAHEAD_MINUTES, default 60)
+};
+
+struct SizingRecommendation {
+    std::string container_name;
+    std::string model_id;
+    std::string basis;    // "kv_percentile", "peak_usage" or "insufficient_data"
+    std::string action;   // "shrink", "grow" or "keep"
+    unsigned int samples;
+    double current_utilization;
+    double target_utilization;
+    double kv_usage_p50;
+    double kv_usage_p95;
+    double kv_usage_p99;
+    double kv_usage_forecast;  // Peak KV usage seen in the upcoming hours on previous days
+    double preemptions_per_minute;
+    double requests_running_p95;
+    unsigned long long kv_block_bytes;
+    unsigned int num_gpu_blocks;
+    unsigned int target_gpu_blocks;
+    long long projected_savings_bytes;  // Negative when the model needs more VRAM
+};
+
+SizingConfig loadSizingConfig();
+double forecastKVUsage(const ModelMetrics& metrics, int lookahead_minutes);
+SizingRecommendation sizeModelAllocation(const std::string& container_name, const ModelMetrics& metrics, const SizingConfig& config);
@@ -1,14 +1,13 @@
 #pragma once
 
 #include <boost/beast/http.hpp>
-#include <boost/asio/ip/tcp.hpp>
+#include "infra/client_socket.h"
 
 namespace beast = boost::beast;
 namespace http = beast::http;
-using tcp = boost::asio::ip::tcp;
 
-void handleSpindownRequest(http::request<http::string_body>& req, tcp::socket& socket);
-void handleListModelsRequest(http::request<http::string_body>& req, tcp::socket& socket);
+void handleSpindownRequest(http::request<http::string_body>& req, ClientSocket& socket);
+void handleListModelsRequest(http::request<http::string_body>& req, ClientSocket& socket);
 
 
 
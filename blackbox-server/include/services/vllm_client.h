@@ -13,6 +13,10 @@ struct ModelBlockData {
     double prefix_cache_hit_rate;
     unsigned int num_requests_running;
     unsigned int num_requests_waiting;
+    unsigned long long num_preemptions_total;
+    unsigned int num_cpu_blocks;
+    double swap_space_gib;
+    double gpu_memory_utilization;  // As reported by cache_config_info (0.0 if unknown)
     bool available;
 };
 
@@ -1,8 +1,13 @@
 #pragma once
 
+#include "vram_types.h"
+#include "utils/compression.h"
 #include <string>
 #include <map>
+#include <chrono>
 #include <deque>
+#include <memory>
+#include <mutex>
 
 struct ProcessVRAM {
     unsigned int pid;
@@ -11,11 +16,61 @@ struct ProcessVRAM {
     double usage_percent;
 };
 
-std::map<std::string, ProcessVRAM> getProcessVRAMUsage();
-double getModelVRAMUsagePercent(const std::string& container_name, unsigned int pid);
+enum SnapshotFormat : unsigned int {
+    SNAPSHOT_FORMAT_JSON = 0,
+    SNAPSHOT_FORMAT_BINARY,     // utils/binary_snapshot.h
+    SNAPSHOT_FORMAT_COUNT
+};
+
+// ?format= value: "" or "json", "bin" or "binary". False for anything else.
+bool parseSnapshotFormat(const std::string& name, SnapshotFormat& format);
+const char* snapshotContentType(SnapshotFormat format);
+
+// A snapshot as published by a collection. Immutable; consecutive collections with
+// identical content share one instance, so its serialized bodies are built once.
+struct PublishedSnapshot {
+    DetailedVRAMInfo info;
+    unsigned long long version = 0;      // Increments whenever the content published for its section mask changes (0: never published)
+    unsigned long long fingerprint = 0;  // Hash of the content; the ETag is derived from it
+    // Per format and content coding; compressed bodies are derived from the identity one
+    mutable std::once_flag body_once[SNAPSHOT_FORMAT_COUNT][CONTENT_ENCODING_COUNT];
+    mutable std::shared_ptr<const std::string> bodies[SNAPSHOT_FORMAT_COUNT][CONTENT_ENCODING_COUNT];
+};
+
+// Index a finished snapshot for lookups; called at the end of every collection.
+// Returns the published instance, which is the previous one if nothing changed.
+// A snapshot with optional sections is kept under its section mask, and only its core
+// part becomes the latest snapshot that lookups and getLatestVRAMSnapshot read.
+std::shared_ptr<const PublishedSnapshot> publishVRAMSnapshot(DetailedVRAMInfo info);
+
+// Serialized body of the snapshot, created on first use and shared by every reader.
+// For a compressed coding, nullptr if compression is unavailable or does not shrink the body.
+std::shared_ptr<const std::string> getSnapshotBody(const PublishedSnapshot& snapshot, SnapshotFormat format,
+                                                   ContentEncoding encoding = CONTENT_ENCODING_IDENTITY);
 
+// Strong ETag for the body in the given format and coding, e.g. "\"3f2a...-json\"" or "\"3f2a...-json-gzip\"";
+// snapshots with optional sections add their mask ("\"3f2a...-json-s3\"").
+// variant distinguishes bodies shaped by the request (a ?fields= projection).
+std::string getSnapshotETag(const PublishedSnapshot& snapshot, SnapshotFormat format,
+                            ContentEncoding encoding = CONTENT_ENCODING_IDENTITY, const std::string& variant = "");
 
+// Latest published snapshot and its age in seconds (nullptr if none has been taken yet).
+// Never triggers a collection.
+std::shared_ptr<const DetailedVRAMInfo> getLatestVRAMSnapshot(double& age_seconds);
 
+// How long a published snapshot may be served instead of collecting a new one
+// (SNAPSHOT_MAX_AGE_MS, default 1000)
+std::chrono::milliseconds snapshotMaxAge();
 
+// Latest snapshot published for a resolved section mask and its age in seconds
+// (nullptr if none has been taken yet). Never triggers a collection.
+std::shared_ptr<const PublishedSnapshot> getPublishedSnapshot(unsigned int sections, double& age_seconds);
 
+// Block until a snapshot newer than after_version is published for the section mask;
+// false if timeout passes first
+bool waitForSnapshotPublish(unsigned int sections, unsigned long long after_version, std::chrono::milliseconds timeout);
 
+// Per-process usage from the latest snapshot (collects one if none has been taken yet)
+std::map<std::string, ProcessVRAM> getProcessVRAMUsage();
+// O(1) lookup into the latest snapshot by PID, falling back to the container's model
+double getModelVRAMUsagePercent(const std::string& container_name, unsigned int pid);
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct AdmissionStats {
+    std::string gate;
+    unsigned int active;
+    unsigned int queued;
+    unsigned long long admitted;
+    unsigned long long waited;             // Admitted after queueing
+    unsigned long long shed_queue_full;    // Rejected at once: limit and queue both full
+    unsigned long long shed_timeout;       // Queued, but no slot freed within the queue timeout
+};
+
+// Concurrency limit for one class of expensive requests. Up to max_active requests run at
+// once, up to max_queued more wait (at most queue_timeout) for a slot, the rest are shed.
+// Gates register themselves for getAdmissionStats() and must outlive the server.
+class AdmissionGate {
+public:
+    AdmissionGate(std::string name, unsigned int max_active, unsigned int max_queued,
+                  std::chrono::milliseconds queue_timeout);
+    AdmissionGate(const AdmissionGate&) = delete;
+    AdmissionGate& operator=(const AdmissionGate&) = delete;
+
+    // True once a slot is held (release with leave()); false if the request was shed
+    bool enter();
+    void leave();
+
+    AdmissionStats stats() const;
+
+private:
+    std::string name;
+    unsigned int max_active;
+    unsigned int max_queued;
+    std::chrono::milliseconds queue_timeout;
+
+    mutable std::mutex mutex;
+    std::condition_variable slot_freed;
+    AdmissionStats counters{};  // Guarded by mutex
+};
+
+// Holds a gate slot for the lifetime of a request
+class AdmissionTicket {
+public:
+    explicit AdmissionTicket(AdmissionGate& gate) : gate(gate), admitted(gate.enter()) {}
+    ~AdmissionTicket() { if (admitted) gate.leave(); }
+    AdmissionTicket(const AdmissionTicket&) = delete;
+    AdmissionTicket& operator=(const AdmissionTicket&) = delete;
+
+    explicit operator bool() const { return admitted; }
+
+private:
+    AdmissionGate& gate;
+    bool admitted;
+};
+
+// Counters of every gate, in creation order
+std::vector<AdmissionStats> getAdmissionStats();
@@ -0,0 +1,8 @@
+#pragma once
+
+#include "vram_types.h"
+#include <string>
+
+// Append the snapshot in the binary format described in utils/binary_snapshot.h.
+// version is the published snapshot version, carried in the header.
+void writeBinarySnapshot(const DetailedVRAMInfo& info, unsigned long long version, std::string& out);
@@ -0,0 +1,291 @@
+#pragma once
+
+// Binary snapshot format (GET /vram?format=bin) and its decoder. Header-only and
+// standard library only, so collectors can copy this file without the server tree.
+//
+// All integers and doubles are little-endian, fixed width and read with memcpy, so
+// records need no alignment. Layout:
+//
+//   header     BINARY_SNAPSHOT_HEADER_BYTES
+//   directory  section_count entries of {u16 id, u16 record_bytes, u32 record_count, u32 offset}
+//   sections   record_count fixed-size records each, at offset (from the start of the buffer)
+//
+// The directory describes each section's record size, so later versions can append
+// fields to a record or add sections without breaking older decoders: unknown trailing
+// bytes and unknown section ids are skipped. The major version changes only when an
+// existing field moves. Strings live once in the STRINGS section as {u32 length, bytes}
+// and records refer to them by offset into that section.
+//
+//   BinarySnapshotReader reader;
+//   if (reader.parse(body.data(), body.size())) {
+//       for (size_t i = 0; i < reader.modelCount(); ++i) {
+//           BinaryModel model = reader.model(i);  // model.model_id views into body
+//       }
+//   }
+//
+// Nothing is allocated; decoded strings are views into the buffer, which must outlive them.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+static constexpr char BINARY_SNAPSHOT_MAGIC[4] = {'B', 'B', 'V', 'S'};
+static constexpr uint16_t BINARY_SNAPSHOT_VERSION = 1;
+static constexpr size_t BINARY_SNAPSHOT_HEADER_BYTES = 24;
+static constexpr size_t BINARY_SNAPSHOT_DIRECTORY_ENTRY_BYTES = 12;
+
+// Header fields
+//   0  char[4] magic "BBVS"
+//   4  u16     major version
+//   6  u16     header bytes
+//   8  u64     snapshot version (the SSE event id)
+//   16 u32     SnapshotSection mask the snapshot was computed with
+//   20 u16     section count
+//   22 u16     directory entry bytes
+
+enum BinarySnapshotSection : uint16_t {
+    BINARY_SECTION_TOTALS = 1,      // Exactly one record
+    BINARY_SECTION_STRINGS = 2,     // record_bytes 1; record_count is the table size in bytes
+    BINARY_SECTION_GPUS = 3,
+    BINARY_SECTION_MODELS = 4,
+    BINARY_SECTION_PROCESSES = 5,   // Only with ?include=processes
+    BINARY_SECTION_BLOCK_MAPS = 6,  // Only with ?include=blocks
+    BINARY_SECTION_BLOCK_RUNS = 7,  // Runs of every block map, referenced by index range
+    BINARY_SECTION_NSIGHT = 8,      // Only with ?include=nsight
+    BINARY_SECTION_THREADS = 9,     // Only with ?include=threads
+    BINARY_SECTION_LIMIT
+};
+
+// Record sizes in this version. A decoder accepts larger records and ignores the tail.
+static constexpr uint16_t BINARY_TOTALS_BYTES = 56;
+static constexpr uint16_t BINARY_GPU_BYTES = 40;
+static constexpr uint16_t BINARY_MODEL_BYTES = 80;
+static constexpr uint16_t BINARY_PROCESS_BYTES = 32;
+static constexpr uint16_t BINARY_BLOCK_MAP_BYTES = 32;
+static constexpr uint16_t BINARY_BLOCK_RUN_BYTES = 8;
+static constexpr uint16_t BINARY_NSIGHT_BYTES = 72;
+static constexpr uint16_t BINARY_THREAD_BYTES = 16;
+
+struct BinaryTotals {
+    uint64_t total_vram_bytes;          // 0
+    uint64_t allocated_vram_bytes;      // 8
+    uint64_t free_vram_bytes;           // 16
+    uint64_t used_kv_cache_bytes;       // 24
+    double prefix_cache_hit_rate;       // 32
+    uint32_t allocated_blocks;          // 40  (block counts are 0 without the blocks section)
+    uint32_t utilized_blocks;           // 44
+    uint32_t free_blocks;               // 48
+                                        // 52  reserved
+};
+
+struct BinaryGpu {
+    uint32_t index;                     // 0
+    uint32_t process_count;             // 4
+    uint64_t total_vram_bytes;          // 8
+    uint64_t allocated_vram_bytes;      // 16
+    uint64_t free_vram_bytes;           // 24
+    std::string_view name;              // 32  string ref
+    std::string_view uuid;              // 36  string ref
+};
+
+struct BinaryModel {
+    std::string_view model_id;          // 0   string ref
+    int32_t port;                       // 4
+    uint64_t allocated_vram_bytes;      // 8
+    uint64_t used_kv_cache_bytes;       // 16
+    uint64_t num_preemptions_total;     // 24
+    uint64_t kv_block_bytes;            // 32
+    double kv_cache_usage_perc;         // 40
+    double prefix_cache_hit_rate;       // 48
+    double gpu_memory_utilization;      // 56
+    uint32_t num_gpu_blocks;            // 64
+    uint32_t num_requests_running;      // 68
+    uint32_t num_requests_waiting;      // 72
+    uint32_t gpu_mask;                  // 76  bit i set if the model occupies GPU i (indices below 32)
+};
+
+struct BinaryProcess {
+    uint32_t pid;                       // 0
+    uint32_t gpu_index;                 // 4
+    uint64_t used_bytes;                // 8
+    uint64_t reserved_bytes;            // 16
+    std::string_view name;              // 24  string ref
+                                        // 28  reserved
+};
+
+struct BinaryBlockMap {
+    std::string_view model_id;          // 0   string ref
+    int32_t port;                       // 4
+    uint64_t block_size;                // 8
+    uint32_t num_blocks;                // 16
+    uint32_t utilized_blocks;           // 20
+    uint32_t first_run;                 // 24  index into BLOCK_RUNS
+    uint32_t run_count;                 // 28
+};
+
+struct BinaryBlockRun {
+    uint32_t first_block;               // 0
+    uint32_t count;                     // 4   u32 (count << 1) | utilized
+    bool utilized;
+};
+
+struct BinaryNsight {
+    uint32_t pid;                       // 0
+    bool available;                     // 4   u32
+    uint64_t atomic_operations;         // 8
+    uint64_t threads_per_block;         // 16
+    double occupancy;                   // 24
+    uint64_t active_blocks;             // 32
+    uint64_t memory_throughput;         // 40
+    uint64_t dram_read_bytes;           // 48
+    uint64_t dram_write_bytes;          // 56
+    int64_t collected_at;               // 64
+};
+
+struct BinaryThread {
+    int32_t thread_id;                  // 0
+    std::string_view state;             // 4   string ref
+    uint64_t allocated_bytes;           // 8
+};
+
+// Little-endian loads, independent of host byte order and alignment
+inline uint16_t loadLE16(const unsigned char* p) {
+    return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+inline uint32_t loadLE32(const unsigned char* p) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+inline uint64_t loadLE64(const unsigned char* p) {
+    return static_cast<uint64_t>(loadLE32(p)) | (static_cast<uint64_t>(loadLE32(p + 4)) << 32);
+}
+inline double loadLEDouble(const unsigned char* p) {
+    uint64_t bits = loadLE64(p);
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+class BinarySnapshotReader {
+public:
+    // Checks the header and that every known section lies inside the buffer.
+    // Accessors are only valid after this returns true.
+    bool parse(const void* data, size_t size) {
+        *this = BinarySnapshotReader();
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        if (size < BINARY_SNAPSHOT_HEADER_BYTES || std::memcmp(bytes, BINARY_SNAPSHOT_MAGIC, 4) != 0) return false;
+        if (loadLE16(bytes + 4) != BINARY_SNAPSHOT_VERSION) return false;
+        size_t header_bytes = loadLE16(bytes + 6);
+        size_t section_count = loadLE16(bytes + 20);
+        size_t entry_bytes = loadLE16(bytes + 22);
+        if (header_bytes < BINARY_SNAPSHOT_HEADER_BYTES || entry_bytes < BINARY_SNAPSHOT_DIRECTORY_ENTRY_BYTES) return false;
+        if (header_bytes + section_count * entry_bytes > size) return false;
+        snapshot_version = loadLE64(bytes + 8);
+        section_mask = loadLE32(bytes + 16);
+
+        for (size_t i = 0; i < section_count; ++i) {
+            const unsigned char* entry = bytes + header_bytes + i * entry_bytes;
+            uint16_t id = loadLE16(entry);
+            uint16_t record_bytes = loadLE16(entry + 2);
+            uint32_t record_count = loadLE32(entry + 4);
+            uint32_t offset = loadLE32(entry + 8);
+            if (id == 0 || id >= BINARY_SECTION_LIMIT) continue;  // From a newer version
+            if (record_bytes < MIN_RECORD_BYTES[id]) return false;
+            if (offset > size || static_cast<uint64_t>(record_bytes) * record_count > size - offset) return false;
+            sections[id] = Section{bytes + offset, record_bytes, record_count};
+        }
+        return sections[BINARY_SECTION_TOTALS].count == 1;
+    }
+
+    uint64_t version() const { return snapshot_version; }
+    uint32_t sectionMask() const { return section_mask; }
+    bool hasSection(BinarySnapshotSection id) const { return sections[id].data != nullptr; }
+
+    BinaryTotals totals() const {
+        const unsigned char* r = record(BINARY_SECTION_TOTALS, 0);
+        return {loadLE64(r), loadLE64(r + 8), loadLE64(r + 16), loadLE64(r + 24), loadLEDouble(r + 32),
+                loadLE32(r + 40), loadLE32(r + 44), loadLE32(r + 48)};
+    }
+
+    size_t gpuCount() const { return sections[BINARY_SECTION_GPUS].count; }
+    BinaryGpu gpu(size_t i) const {
+        const unsigned char* r = record(BINARY_SECTION_GPUS, i);
+        return {loadLE32(r), loadLE32(r + 4), loadLE64(r + 8), loadLE64(r + 16), loadLE64(r + 24),
+                string(loadLE32(r + 32)), string(loadLE32(r + 36))};
+    }
+
+    size_t modelCount() const { return sections[BINARY_SECTION_MODELS].count; }
+    BinaryModel model(size_t i) const {
+        const unsigned char* r = record(BINARY_SECTION_MODELS, i);
+        return {string(loadLE32(r)), static_cast<int32_t>(loadLE32(r + 4)), loadLE64(r + 8), loadLE64(r + 16),
+                loadLE64(r + 24), loadLE64(r + 32), loadLEDouble(r + 40), loadLEDouble(r + 48),
+                loadLEDouble(r + 56), loadLE32(r + 64), loadLE32(r + 68), loadLE32(r + 72), loadLE32(r + 76)};
+    }
+
+    size_t processCount() const { return sections[BINARY_SECTION_PROCESSES].count; }
+    BinaryProcess process(size_t i) const {
+        const unsigned char* r = record(BINARY_SECTION_PROCESSES, i);
+        return {loadLE32(r), loadLE32(r + 4), loadLE64(r + 8), loadLE64(r + 16), string(loadLE32(r + 24))};
+    }
+
+    size_t blockMapCount() const { return sections[BINARY_SECTION_BLOCK_MAPS].count; }
+    BinaryBlockMap blockMap(size_t i) const {
+        const unsigned char* r = record(BINARY_SECTION_BLOCK_MAPS, i);
+        BinaryBlockMap map{string(loadLE32(r)), static_cast<int32_t>(loadLE32(r + 4)), loadLE64(r + 8),
+                           loadLE32(r + 16), loadLE32(r + 20), loadLE32(r + 24), loadLE32(r + 28)};
+        // Clamp to the runs actually present, so blockRun(first_run + k) stays in range
+        size_t runs = sections[BINARY_SECTION_BLOCK_RUNS].count;
+        if (map.first_run > runs) map.first_run = static_cast<uint32_t>(runs);
+        if (map.run_count > runs - map.first_run) map.run_count = static_cast<uint32_t>(runs - map.first_run);
+        return map;
+    }
+    BinaryBlockRun blockRun(size_t i) const {
+        const unsigned char* r = record(BINARY_SECTION_BLOCK_RUNS, i);
+        uint32_t packed = loadLE32(r + 4);
+        return {loadLE32(r), packed >> 1, (packed & 1) != 0};
+    }
+
+    size_t nsightCount() const { return sections[BINARY_SECTION_NSIGHT].count; }
+    BinaryNsight nsight(size_t i) const {
+        const unsigned char* r = record(BINARY_SECTION_NSIGHT, i);
+        return {loadLE32(r), loadLE32(r + 4) != 0, loadLE64(r + 8), loadLE64(r + 16), loadLEDouble(r + 24),
+                loadLE64(r + 32), loadLE64(r + 40), loadLE64(r + 48), loadLE64(r + 56),
+                static_cast<int64_t>(loadLE64(r + 64))};
+    }
+
+    size_t threadCount() const { return sections[BINARY_SECTION_THREADS].count; }
+    BinaryThread thread(size_t i) const {
+        const unsigned char* r = record(BINARY_SECTION_THREADS, i);
+        return {static_cast<int32_t>(loadLE32(r)), string(loadLE32(r + 4)), loadLE64(r + 8)};
+    }
+
+    // Empty for a reference outside the table
+    std::string_view string(uint32_t ref) const {
+        const Section& table = sections[BINARY_SECTION_STRINGS];
+        if (table.count < 4 || ref > table.count - 4) return {};
+        uint32_t length = loadLE32(table.data + ref);
+        if (length > table.count - 4 - ref) return {};
+        return std::string_view(reinterpret_cast<const char*>(table.data + ref + 4), length);
+    }
+
+private:
+    struct Section {
+        const unsigned char* data = nullptr;
+        uint32_t record_bytes = 0;
+        uint32_t count = 0;
+    };
+
+    static constexpr uint16_t MIN_RECORD_BYTES[BINARY_SECTION_LIMIT] = {
+        0, BINARY_TOTALS_BYTES, 1, BINARY_GPU_BYTES, BINARY_MODEL_BYTES, BINARY_PROCESS_BYTES,
+        BINARY_BLOCK_MAP_BYTES, BINARY_BLOCK_RUN_BYTES, BINARY_NSIGHT_BYTES, BINARY_THREAD_BYTES};
+
+    // Callers index below the section's count
+    const unsigned char* record(BinarySnapshotSection id, size_t i) const {
+        return sections[id].data + i * sections[id].record_bytes;
+    }
+
+    Section sections[BINARY_SECTION_LIMIT];
+    uint64_t snapshot_version = 0;
+    uint32_t section_mask = 0;
+};
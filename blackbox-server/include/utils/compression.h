@@ -0,0 +1,40 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Codings the server can produce, in preference order after identity.
+// gzip needs zlib (ZLIB_AVAILABLE) and zstd needs libzstd (ZSTD_AVAILABLE); a coding
+// this build lacks is never negotiated.
+enum ContentEncoding : unsigned int {
+    CONTENT_ENCODING_IDENTITY = 0,
+    CONTENT_ENCODING_GZIP,
+    CONTENT_ENCODING_ZSTD,
+    CONTENT_ENCODING_COUNT
+};
+
+struct CompressionStats {
+    std::string encoding;
+    unsigned long long responses;
+    unsigned long long bytes_in;
+    unsigned long long bytes_out;
+    double seconds;
+};
+
+// Content-Encoding token ("identity", "gzip", "zstd")
+const char* contentEncodingName(ContentEncoding encoding);
+
+// Best coding the Accept-Encoding header allows for a body of this size. Bodies
+// below COMPRESSION_MIN_BYTES (default 1024) are always sent as identity.
+ContentEncoding negotiateContentEncoding(std::string_view accept_encoding, size_t body_size);
+
+// Compress input into out (replacing its contents). False if the coding is not
+// built in, fails, or would not make the body smaller.
+bool compressBody(std::string_view input, ContentEncoding encoding, std::string& out);
+
+// Negotiate and compress body in place; returns the coding applied (identity if none)
+ContentEncoding compressForClient(std::string_view accept_encoding, std::string& body);
+
+// Counters per coding, for /metrics
+std::vector<CompressionStats> getCompressionStats();
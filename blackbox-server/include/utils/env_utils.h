@@ -5,5 +5,7 @@
 
 std::map<std::string, std::string> loadEnvFile(const std::string& path = ".env");
 std::string getEnvValue(const std::string& key, const std::string& default_val = "");
+int getEnvInt(const std::string& key, int default_val);
+double getEnvDouble(const std::string& key, double default_val);
 bool hasEnvKey(const std::string& key);
 
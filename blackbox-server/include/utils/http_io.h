@@ -0,0 +1,65 @@
+#pragma once
+
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/beast/core/error.hpp>
+#include <boost/beast/http.hpp>
+#include <chrono>
+#include <string>
+
+// Time a client gets to take each response or stream event (HTTP_WRITE_TIMEOUT seconds, default 10)
+std::chrono::milliseconds httpWriteTimeout();
+
+// Run the asynchronous write that start begins on socket until it completes or timeout passes.
+// The socket must belong to a connection's own io_context (see serveConnection in
+// http_server.cpp), which is run here. A client that stops reading gets its socket closed,
+// so a stuck write never holds the connection thread for longer than timeout.
+template <typename Socket, typename Start>
+boost::beast::error_code runWriteWithDeadline(Socket& socket, std::chrono::milliseconds timeout, Start start) {
+    namespace net = boost::asio;
+    net::io_context& ioc = static_cast<net::io_context&>(net::query(socket.get_executor(), net::execution::context));
+    net::steady_timer timer(ioc);
+    boost::beast::error_code write_ec;
+    bool done = false;
+    bool timed_out = false;
+    timer.expires_after(timeout);
+    timer.async_wait([&](boost::beast::error_code ec) {
+        if (ec || done) return;
+        timed_out = true;
+        boost::beast::error_code ignored;
+        socket.cancel(ignored);
+    });
+    start([&](boost::beast::error_code ec, size_t) {
+        done = true;
+        write_ec = ec;
+        timer.cancel();
+    });
+    ioc.restart();
+    ioc.run();
+    if (timed_out) {
+        boost::beast::error_code ignored;
+        socket.close(ignored);
+        return net::error::timed_out;
+    }
+    return write_ec;
+}
+
+// Write all of data; false if the client is gone or did not take it within timeout
+template <typename Socket>
+bool writeWithDeadline(Socket& socket, const std::string& data, std::chrono::milliseconds timeout) {
+    return !runWriteWithDeadline(socket, timeout, [&](auto handler) {
+        boost::asio::async_write(socket, boost::asio::buffer(data), handler);
+    });
+}
+
+// http::write with HTTP_WRITE_TIMEOUT. Throws boost::system::system_error like http::write,
+// with net::error::timed_out when the client did not take the response in time.
+template <typename Socket, bool isRequest, typename Body, typename Fields>
+void writeHttpMessage(Socket& socket, boost::beast::http::message<isRequest, Body, Fields>& message) {
+    boost::beast::error_code ec = runWriteWithDeadline(socket, httpWriteTimeout(), [&](auto handler) {
+        boost::beast::http::async_write(socket, message, handler);
+    });
+    if (ec) {
+        throw boost::system::system_error(ec);
+    }
+}
@@ -1,8 +1,27 @@
 #pragma once
 
 #include "vram_types.h"
+#include "utils/json_writer.h"
 #include <string>
 
+// Field list of a KV block run, shared by /vram?include=blocks and /vram/blocks
+inline const auto BLOCK_RUN_FIELDS = std::make_tuple(
+    jsonField("first_block", &BlockRun::first_block),
+    jsonField("count", &BlockRun::count),
+    jsonField("utilized", &BlockRun::utilized)
+);
+
+// Append the response to out (which may already hold a prefix, e.g. "data: " for SSE).
+// A selection limits it to the compiled ?fields= paths and ?model= entries.
+void writeDetailedResponse(const DetailedVRAMInfo& info, std::string& out, const JsonSelection* selection = nullptr);
+void writeAggregatedResponse(const AggregatedVRAMInfo& info, std::string& out, const JsonSelection* selection = nullptr);
+
+// Compile ?fields= and ?model= against the /vram or /vram/aggregated layout.
+// False if a field path does not exist; error names it.
+bool compileDetailedSelection(const std::string& fields, const std::string& model_id,
+                              JsonSelection& selection, std::string& error);
+bool compileAggregatedSelection(const std::string& fields, const std::string& model_id,
+                                JsonSelection& selection, std::string& error);
+
 std::string createDetailedResponse(const DetailedVRAMInfo& info);
 std::string createAggregatedResponse(const AggregatedVRAMInfo& info);
-
@@ -0,0 +1,234 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+#include <charconv>
+#include <utility>
+
+// Appends compact JSON to a caller-owned buffer, so a reserved or reused string
+// is written without intermediate copies. Commas are inserted automatically,
+// strings are escaped and numbers go through std::to_chars (locale independent).
+class JsonWriter {
+public:
+    explicit JsonWriter(std::string& out) : out(out) {}
+
+    void beginObject() { prefix(); out += '{'; push(); }
+    void endObject() { pop(); out += '}'; }
+    void beginArray() { prefix(); out += '['; push(); }
+    void endArray() { pop(); out += ']'; }
+
+    void key(std::string_view name);
+
+    void value(std::string_view s);
+    void value(const char* s) { value(std::string_view(s)); }
+    void value(bool b) { prefix(); out += b ? "true" : "false"; }
+    void value(double d, int precision = -1);  // precision: fixed decimals, -1 for shortest round-trip
+    void null() { prefix(); out += "null"; }
+
+    template <typename T, typename = std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool>>>
+    void value(T v) {
+        prefix();
+        char buffer[24];
+        auto result = std::to_chars(buffer, buffer + sizeof(buffer), v);
+        out.append(buffer, result.ptr);
+    }
+
+private:
+    void prefix();
+    void push() { depth++; has_elements &= ~(1ULL << depth); }
+    void pop() { depth--; }
+
+    std::string& out;
+    unsigned long long has_elements = 0;  // One bit per nesting level (up to 63)
+    int depth = 0;
+    bool after_key = false;
+};
+
+// Declarative description of a response type: a tuple of jsonField()s, written in order.
+//
+//   static const auto GPU_FIELDS = std::make_tuple(
+//       jsonField("index", &GPUDeviceInfo::index),
+//       jsonField("name", &GPUDeviceInfo::name));
+//   writeJsonObject(writer, gpu, GPU_FIELDS);
+//
+// Vectors become arrays and maps become objects keyed by the map key. Struct members
+// (directly or as elements) are declared with jsonNested() and their own field list.
+template <typename T, typename M, typename Nested>
+struct JsonField {
+    const char* name;
+    M T::*member;
+    Nested nested;                // Field tuple for struct members, std::tuple<> otherwise
+    int precision;                // For doubles; -1 writes the shortest round-trip form
+    bool (*present)(const T&);    // Written only when this returns true (nullptr: always)
+};
+
+template <typename T, typename M>
+JsonField<T, M, std::tuple<>> jsonField(const char* name, M T::*member, int precision = -1,
+                                        bool (*present)(const T&) = nullptr) {
+    return {name, member, std::tuple<>(), precision, present};
+}
+
+// A struct, or a vector/map of structs, written with its own field list
+template <typename T, typename M, typename Nested>
+JsonField<T, M, Nested> jsonNested(const char* name, M T::*member, const Nested& nested,
+                                   bool (*present)(const T&) = nullptr) {
+    return {name, member, nested, -1, present};
+}
+
+// A compiled ?fields= selection over a field list, mirroring its nesting. Built once
+// per request or stream subscription; writing consults one bit per field.
+struct JsonProjection {
+    bool everything = true;               // Write every field (no selection, or the whole subtree was named)
+    unsigned long long fields = 0;        // Otherwise bit i selects the i-th entry of the field list
+    std::vector<JsonProjection> nested;   // Per entry index, the selection below a struct field
+};
+
+// What a writer is restricted to at one level: a projection node and a model filter.
+// Array elements with a model_id member are skipped unless it equals model_id.
+struct JsonScope {
+    const JsonProjection* projection = nullptr;  // nullptr: everything
+    std::string_view model_id;                   // Empty: no filter
+};
+
+// Owning form of a request's ?fields= and ?model=
+struct JsonSelection {
+    JsonProjection projection;
+    std::string model_id;
+
+    bool empty() const { return projection.everything && model_id.empty(); }
+    JsonScope scope() const { return {&projection, model_id}; }
+};
+
+template <typename T, typename Fields>
+void writeJsonObject(JsonWriter& writer, const T& object, const Fields& fields, JsonScope scope = {});
+
+template <typename V> struct IsJsonVector : std::false_type {};
+template <typename E, typename A> struct IsJsonVector<std::vector<E, A>> : std::true_type {};
+template <typename V> struct IsJsonMap : std::false_type {};
+template <typename K, typename E, typename C, typename A> struct IsJsonMap<std::map<K, E, C, A>> : std::true_type {};
+template <typename E, typename = void> struct HasModelId : std::false_type {};
+template <typename E> struct HasModelId<E, std::void_t<decltype(std::declval<const E&>().model_id)>> : std::true_type {};
+
+template <typename V, typename Nested>
+void writeJsonValue(JsonWriter& writer, const V& value, const Nested& nested, int precision, JsonScope scope = {}) {
+    if constexpr (std::is_same_v<V, std::string> || std::is_same_v<V, bool>) {
+        writer.value(value);
+    } else if constexpr (std::is_floating_point_v<V>) {
+        writer.value(static_cast<double>(value), precision);
+    } else if constexpr (std::is_arithmetic_v<V>) {
+        writer.value(value);
+    } else if constexpr (IsJsonVector<V>::value) {
+        writer.beginArray();
+        for (const auto& element : value) {
+            if constexpr (HasModelId<typename V::value_type>::value) {
+                if (!scope.model_id.empty() && element.model_id != scope.model_id) continue;
+            }
+            writeJsonValue(writer, element, nested, precision, scope);
+        }
+        writer.endArray();
+    } else if constexpr (IsJsonMap<V>::value) {
+        writer.beginObject();
+        for (const auto& [map_key, element] : value) {
+            if constexpr (std::is_same_v<std::decay_t<decltype(map_key)>, std::string>) {
+                writer.key(map_key);
+            } else {
+                char buffer[24];
+                auto result = std::to_chars(buffer, buffer + sizeof(buffer), map_key);
+                writer.key(std::string_view(buffer, result.ptr - buffer));
+            }
+            writeJsonValue(writer, element, nested, precision, scope);
+        }
+        writer.endObject();
+    } else {
+        writeJsonObject(writer, value, nested, scope);
+    }
+}
+
+template <typename Fields, typename F, size_t... I>
+void forEachJsonField(const Fields& fields, F&& f, std::index_sequence<I...>) {
+    (f(I, std::get<I>(fields)), ...);
+}
+
+template <typename Fields, typename F>
+void forEachJsonField(const Fields& fields, F&& f) {
+    forEachJsonField(fields, f, std::make_index_sequence<std::tuple_size_v<Fields>>());
+}
+
+template <typename T, typename Fields>
+void writeJsonObject(JsonWriter& writer, const T& object, const Fields& fields, JsonScope scope) {
+    static_assert(std::tuple_size_v<Fields> <= 64, "JsonProjection holds one bit per field");
+    const JsonProjection* projection = scope.projection && !scope.projection->everything ? scope.projection : nullptr;
+    writer.beginObject();
+    forEachJsonField(fields, [&](size_t index, const auto& f) {
+        if (f.present && !f.present(object)) return;
+        JsonScope inner{nullptr, scope.model_id};
+        if (projection) {
+            if (!(projection->fields & (1ULL << index))) return;
+            inner.projection = &projection->nested[index];
+        }
+        writer.key(f.name);
+        writeJsonValue(writer, object.*(f.member), f.nested, f.precision, inner);
+    });
+    writer.endObject();
+}
+
+// Add one dotted path (e.g. "models.used_kv_cache_bytes") to a projection over fields.
+// Names go through arrays and maps to their elements. False if a name does not exist.
+template <typename Fields>
+bool addJsonProjectionPath(JsonProjection& projection, const Fields& fields, std::string_view path) {
+    if (projection.everything) return true;
+    size_t dot = path.find('.');
+    std::string_view name = path.substr(0, dot);
+    std::string_view rest = dot == std::string_view::npos ? std::string_view() : path.substr(dot + 1);
+    bool found = false;
+    forEachJsonField(fields, [&](size_t index, const auto& f) {
+        if (found || name != f.name) return;
+        if (projection.nested.empty()) projection.nested.resize(std::tuple_size_v<Fields>);
+        JsonProjection& child = projection.nested[index];
+        unsigned long long bit = 1ULL << index;
+        if (rest.empty()) {
+            child = JsonProjection();
+            projection.fields |= bit;
+            found = true;
+            return;
+        }
+        using Nested = std::decay_t<decltype(f.nested)>;
+        if constexpr (std::tuple_size_v<Nested> > 0) {
+            if (!(projection.fields & bit)) {
+                child.everything = false;
+                child.fields = 0;
+            }
+            if (addJsonProjectionPath(child, f.nested, rest)) {
+                projection.fields |= bit;
+                found = true;
+            }
+        }
+    });
+    return found;
+}
+
+// "a,b.c" -> projection; an empty list selects everything. On an unknown path,
+// returns false with the path in error.
+template <typename Fields>
+bool compileJsonProjection(const Fields& fields, std::string_view paths, JsonProjection& projection, std::string& error) {
+    projection = JsonProjection();
+    if (paths.empty()) return true;
+    projection.everything = false;
+    size_t pos = 0;
+    while (pos <= paths.size()) {
+        size_t end = paths.find(',', pos);
+        if (end == std::string_view::npos) end = paths.size();
+        std::string_view path = paths.substr(pos, end - pos);
+        pos = end + 1;
+        if (path.empty()) continue;
+        if (!addJsonProjectionPath(projection, fields, path)) {
+            error = std::string(path);
+            return false;
+        }
+    }
+    return true;
+}
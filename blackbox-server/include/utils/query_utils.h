@@ -0,0 +1,29 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+// View over the query string of a request target. Lookups scan the query in place and
+// return views into it, so nothing is allocated unless a value has to be decoded.
+class QueryParams {
+public:
+    explicit QueryParams(std::string_view target);
+
+    // Value as sent (percent-encoding intact); empty if absent
+    std::string_view raw(std::string_view key) const;
+    bool has(std::string_view key) const;
+    // Percent-decoded copy of the value ("" if absent)
+    std::string get(std::string_view key) const;
+    // Decimal value; false (value untouched) if absent or not a number
+    bool getUnsigned(std::string_view key, unsigned long long& value) const;
+
+private:
+    bool find(std::string_view key, std::string_view& value) const;
+
+    std::string_view query;
+};
+
+// Extract a single query parameter value from a request target ("" if absent), percent-decoded
+std::string getQueryParam(const std::string& target, const std::string& key);
+// Decode %XX escapes and '+' in a query component
+std::string urlDecode(std::string_view value);
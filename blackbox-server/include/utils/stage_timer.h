@@ -0,0 +1,59 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+struct StageTimingStats {
+    std::string stage;
+    unsigned long long count;
+    double total_ms;
+    double min_ms;
+    double max_ms;
+    double p50_ms;
+    double p90_ms;
+    double p99_ms;
+};
+
+// Cumulative counts at fixed upper bounds, in the shape of a Prometheus histogram
+struct StageHistogramBuckets {
+    std::string stage;
+    std::vector<unsigned long long> cumulative_counts;  // One per bound, in bound order
+    unsigned long long count;
+    double sum_seconds;
+};
+
+struct StageDuration {
+    std::string stage;
+    double ms;
+};
+
+// Times the enclosing scope with steady_clock. The duration goes into the stage's
+// histogram and, on a thread with an active request trace, into that trace.
+// A null stage disables the timer.
+class ScopedStageTimer {
+public:
+    explicit ScopedStageTimer(const char* stage);
+    ~ScopedStageTimer();
+    ScopedStageTimer(const ScopedStageTimer&) = delete;
+    ScopedStageTimer& operator=(const ScopedStageTimer&) = delete;
+
+private:
+    const char* stage;
+    std::chrono::steady_clock::time_point start;
+};
+
+void recordStageTiming(const std::string& stage, std::chrono::steady_clock::duration duration);
+
+// Percentiles per stage since startup, in stage name order
+std::vector<StageTimingStats> getStageTimings();
+
+// Every stage's histogram folded onto the given bounds (seconds, ascending)
+std::vector<StageHistogramBuckets> getStageHistograms(const std::vector<double>& bounds_seconds);
+
+// Per-request trace of the stages run on the calling thread (repeated stages are summed)
+void beginRequestTiming();
+std::vector<StageDuration> endRequestTiming();
+
+// "nvml;dur=1.20, vllm_scrape;dur=31.05" for a Server-Timing header
+std::string formatServerTiming(const std::vector<StageDuration>& durations);
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+struct SubprocessOptions {
+    int timeout_seconds = 0;          // 0 waits for the process to exit on its own
+    bool merge_stderr = false;        // Otherwise stderr goes to /dev/null
+    size_t max_output_bytes = 16 * 1024 * 1024;  // Output past this is read and dropped
+};
+
+struct SubprocessResult {
+    bool started;     // False if the program could not be spawned (e.g. not on PATH)
+    bool timed_out;   // Killed at the deadline; output holds what was read until then
+    int exit_code;    // -1 unless the process exited normally
+    std::string output;
+};
+
+struct SubprocessStats {
+    std::string program;
+    unsigned long long spawns;
+    unsigned long long spawn_failures;
+    unsigned long long timeouts;
+    double spawn_seconds;   // Time spent inside posix_spawn
+    double run_seconds;     // Spawn to reap, including waiting for output
+};
+
+// Runs argv[0] (looked up on PATH) with the given arguments, no shell involved.
+// stdin is /dev/null and stdout is captured. The child gets its own process group,
+// so at the deadline the whole group is sent SIGTERM and, one second later, SIGKILL.
+SubprocessResult runSubprocess(const std::vector<std::string>& argv, const SubprocessOptions& options = {});
+
+// Same, reusing result.output's capacity across calls
+void runSubprocess(const std::vector<std::string>& argv, const SubprocessOptions& options, SubprocessResult& result);
+
+// First non-empty line of the output, with surrounding whitespace removed
+std::string firstOutputLine(const SubprocessResult& result);
+
+// Counters per program (argv[0], or the program run through sudo), in name order
+std::vector<SubprocessStats> getSubprocessStats();
@@ -15,11 +15,29 @@ struct MemoryBlock {
     int port;              // Port the model is running on
 };
 
+// A contiguous run of KV cache blocks in the same state
+struct BlockRun {
+    unsigned int first_block;
+    unsigned int count;
+    bool utilized;
+};
+
+// Compact per-model KV cache map: runs cover [0, num_blocks) in order
+struct ModelBlockMap {
+    std::string model_id;
+    int port;
+    unsigned long long block_size;
+    unsigned int num_blocks;
+    unsigned int utilized_blocks;
+    std::vector<BlockRun> runs;
+};
+
 struct ProcessMemory {
     unsigned int pid;
     std::string name;
     unsigned long long used_bytes;
     unsigned long long reserved_bytes;
+    unsigned int gpu_index;  // Device the memory lives on (a TP worker appears once per GPU)
 };
 
 struct ThreadInfo {
@@ -37,6 +55,37 @@ struct NsightMetrics {
     unsigned long long dram_read_bytes;
     unsigned long long dram_write_bytes;
     bool available;
+    long long collected_at;  // Unix seconds the profile was taken (0 if never)
+};
+
+// One kernel launch from an ncu CSV trace
+struct KernelProfile {
+    std::string kernel_name;
+    unsigned long long block_size;         // Threads per block
+    unsigned long long grid_size;          // Blocks per grid
+    double occupancy;                      // Achieved occupancy, % of peak
+    unsigned long long dram_read_bytes;
+    unsigned long long dram_write_bytes;
+    unsigned long long atomic_operations;
+    unsigned long long duration_ns;
+    double dram_throughput_pct;            // DRAM throughput, % of peak
+    double sm_throughput_pct;              // SM throughput, % of peak
+};
+
+// Launches of one kernel aggregated by name
+struct KernelSummary {
+    std::string kernel_name;
+    unsigned int launches;
+    unsigned long long block_size;         // Of the most recent launch
+    unsigned long long grid_size;
+    unsigned long long total_duration_ns;
+    unsigned long long dram_read_bytes;
+    unsigned long long dram_write_bytes;
+    unsigned long long atomic_operations;
+    double avg_occupancy;                  // Duration-weighted
+    double avg_dram_throughput_pct;        // Duration-weighted
+    double avg_sm_throughput_pct;          // Duration-weighted
+    bool memory_bound;                     // DRAM throughput dominates SM throughput
 };
 
 struct ModelVRAMInfo {
@@ -44,6 +93,26 @@ struct ModelVRAMInfo {
     int port;
     unsigned long long allocated_vram_bytes;  // VRAM allocated for this model
     unsigned long long used_kv_cache_bytes;   // Actual used KV cache bytes for this model
+    unsigned int num_gpu_blocks;              // KV cache blocks reserved by vLLM
+    double kv_cache_usage_perc;               // Fraction of KV cache blocks in use (0.0-1.0)
+    double prefix_cache_hit_rate;             // Prefix cache hit rate (0.0-100.0)
+    unsigned int num_requests_running;
+    unsigned int num_requests_waiting;
+    unsigned long long num_preemptions_total; // Cumulative preemptions reported by vLLM
+    unsigned long long kv_block_bytes;        // Measured bytes per KV block (0 if unknown)
+    double gpu_memory_utilization;            // Configured fraction reported by vLLM (0.0 if unknown)
+    std::vector<unsigned int> gpu_indices;    // Devices occupied by this model's workers
+    unsigned long long gpu_total_bytes;       // Combined capacity of those devices (0 if unmatched)
+};
+
+struct GPUDeviceInfo {
+    unsigned int index;
+    std::string name;
+    std::string uuid;
+    unsigned long long total;
+    unsigned long long used;
+    unsigned long long free;
+    unsigned int process_count;
 };
 
 struct DetailedVRAMInfo {
@@ -51,7 +120,7 @@ struct DetailedVRAMInfo {
     unsigned long long used;
     unsigned long long free;
     unsigned long long reserved;
-    std::vector<MemoryBlock> blocks;
+    std::vector<ModelBlockMap> block_maps;    // One run-length encoded map per model
     std::vector<ProcessMemory> processes;
     std::vector<ThreadInfo> threads;
     unsigned int allocated_blocks;
@@ -63,6 +132,8 @@ struct DetailedVRAMInfo {
     unsigned long long used_kv_cache_bytes;  // Total actual used KV cache bytes (sum across all models)
     double prefix_cache_hit_rate;            // Prefix cache hit rate (0.0-100.0)
     std::vector<ModelVRAMInfo> models;        // Per-model breakdown
+    std::vector<GPUDeviceInfo> gpus;          // Per-device breakdown; total/used/free above are node totals
+    unsigned int sections;                    // SnapshotSection mask that was computed
 };
 
 struct VLLMBlockData {
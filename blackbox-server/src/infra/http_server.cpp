@@ -1,104 +1,132 @@
 #include "infra/http_server.h"
+#include "infra/router.h"
 #include "services/nvml_utils.h"
 #include "services/aggregation_service.h"
 #include "utils/json_serializer.h"
+#include "utils/query_utils.h"
+#include "utils/stage_timer.h"
+#include "utils/compression.h"
+#include "utils/admission.h"
+#include "utils/http_io.h"
 #include "utils/logger.h"
+#include "utils/env_utils.h"
 #include "services/deploy_service.h"
 #include "services/spindown_service.h"
 #include "services/optimization_service.h"
-#include "services/model_manager.h"
+#include "services/block_service.h"
+#include "services/profile_service.h"
+#include "services/debug_service.h"
+#include "services/metrics_service.h"
 #include "services/vram_tracker.h"
 #include <boost/beast/core.hpp>
 #include <boost/beast/http.hpp>
 #include <boost/asio/connect.hpp>
+#include <nlohmann/json.hpp>
 #include <iostream>
 #include <chrono>
 #include <thread>
+#include <iomanip>
 #include <sstream>
 #include <string>
-#include <regex>
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <memory>
+#include <mutex>
 
-void handleStreamingRequest(tcp::socket& socket) {
+// SSE data lines are text, so binary events carry the body base64 encoded
+static void appendBase64(std::string& out, const std::string& data) {
+    static const char ALPHABET[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    out.reserve(out.size() + (data.size() + 2) / 3 * 4);
+    size_t i = 0;
+    for (; i + 2 < data.size(); i += 3) {
+        unsigned int n = (static_cast<unsigned char>(data[i]) << 16) |
+                         (static_cast<unsigned char>(data[i + 1]) << 8) |
+                         static_cast<unsigned char>(data[i + 2]);
+        out += ALPHABET[(n >> 18) & 63];
+        out += ALPHABET[(n >> 12) & 63];
+        out += ALPHABET[(n >> 6) & 63];
+        out += ALPHABET[n & 63];
+    }
+    if (i < data.size()) {
+        unsigned int n = static_cast<unsigned char>(data[i]) << 16;
+        if (i + 1 < data.size()) n |= static_cast<unsigned char>(data[i + 1]) << 8;
+        out += ALPHABET[(n >> 18) & 63];
+        out += ALPHABET[(n >> 12) & 63];
+        out += i + 1 < data.size() ? ALPHABET[(n >> 6) & 63] : '=';
+        out += '=';
+    }
+}
+
+static const std::chrono::milliseconds STREAM_INTERVAL(500);
+static const std::chrono::seconds STREAM_KEEPALIVE(15);
+
+// The event stream is the body of one response, delimited by closing the connection. Each
+// event must be taken by the client within HTTP_WRITE_TIMEOUT, otherwise the stream is dropped
+// instead of blocking on a client that stopped reading.
+void handleStreamingRequest(ClientSocket& socket, unsigned int sections, SnapshotFormat format, const JsonSelection& selection) {
     LOG_DEBUG("handleStreamingRequest: Entering function");
     try {
-        LOG_DEBUG("handleStreamingRequest: Creating response");
-        http::response<http::string_body> res;
+        http::response<http::empty_body> res;
         res.result(http::status::ok);
         res.set(http::field::content_type, "text/event-stream");
         res.set(http::field::cache_control, "no-cache");
-        res.set(http::field::connection, "keep-alive");
-        res.body() = "";
-        res.prepare_payload();
+        res.keep_alive(false);
+        std::ostringstream header;
+        header << res.base();
         
         LOG_DEBUG("handleStreamingRequest: Sending SSE headers");
-        http::write(socket, res);
-        LOG_DEBUG("handleStreamingRequest: SSE headers sent, starting stream loop");
+        if (!writeWithDeadline(socket, header.str(), httpWriteTimeout())) {
+            LOG_DEBUG("Stream client did not accept the response headers");
+            return;
+        }
+        
+        // The event buffer keeps its capacity from one iteration to the next
+        std::string event;
+        bool sent = false;
+        unsigned long long sent_version = 0;
+        auto last_write = std::chrono::steady_clock::now();
         
         int iteration = 0;
         while (true) {
             iteration++;
-            LOG_DEBUG("Stream iteration " + std::to_string(iteration) + ": Starting");
-            try {
-                LOG_DEBUG("Stream iteration " + std::to_string(iteration) + ": Getting VRAM info");
-                DetailedVRAMInfo info = getDetailedVRAMUsage();
-                LOG_DEBUG("Stream iteration " + std::to_string(iteration) + ": Got VRAM info, getting models");
-                
-                auto models = listDeployedModels();
-                for (const auto& model : models) {
-                    if (model.running && model.pid > 0) {
-                        double vram_percent = getModelVRAMUsagePercent(model.container_name, model.pid);
-                        updateModelVRAMUsage(model.container_name, vram_percent);
-                    }
-                }
-                
-                LOG_DEBUG("Stream iteration " + std::to_string(iteration) + ": Creating JSON response");
-                std::string json = createDetailedResponse(info);
-                LOG_DEBUG("Stream iteration " + std::to_string(iteration) + ": JSON created (" + std::to_string(json.length()) + " bytes)");
-                
-                std::ostringstream event;
-                event << "data: " << json << "\n\n";
-                
-                http::response<http::string_body> chunk;
-                chunk.result(http::status::ok);
-                chunk.set(http::field::content_type, "text/event-stream");
-                chunk.body() = event.str();
-                chunk.prepare_payload();
-                
-                LOG_DEBUG("Stream iteration " + std::to_string(iteration) + ": Writing SSE chunk (" + std::to_string(chunk.body().length()) + " bytes)");
-                http::write(socket, chunk);
-                LOG_DEBUG("Stream iteration " + std::to_string(iteration) + ": SSE chunk written, sleeping");
-                
-                std::this_thread::sleep_for(std::chrono::milliseconds(500));
-            } catch (const boost::system::system_error& e) {
-                auto ec = e.code();
-                LOG_DEBUG("Stream iteration " + std::to_string(iteration) + ": Caught system_error: " + std::string(e.what()) + " (code: " + std::to_string(ec.value()) + ")");
-                if (ec == boost::asio::error::broken_pipe || 
-                    ec == boost::asio::error::connection_reset ||
-                    ec == boost::asio::error::eof ||
-                    ec == boost::beast::http::error::end_of_stream ||
-                    ec == boost::asio::error::operation_aborted ||
-                    ec.category() == boost::asio::error::get_system_category()) {
-                    LOG_DEBUG("Stream connection closed by client at iteration " + std::to_string(iteration));
-                    break;
+            // At most one collection per interval is shared by every subscriber with these sections
+            std::shared_ptr<const PublishedSnapshot> snapshot = getRecentVRAMSnapshot(sections, STREAM_INTERVAL);
+            
+            if (!sent || snapshot->version != sent_version) {
+                // Subscribers share the snapshot's serialized body; the event id is its version.
+                // A ?fields=/?model= subscription writes its projection straight into the event.
+                event.assign("id: ");
+                event.append(std::to_string(snapshot->version));
+                event.append("\ndata: ");
+                if (!selection.empty()) {
+                    writeDetailedResponse(snapshot->info, event, &selection);
+                } else if (format == SNAPSHOT_FORMAT_BINARY) {
+                    appendBase64(event, *getSnapshotBody(*snapshot, format));
+                } else {
+                    event.append(*getSnapshotBody(*snapshot, format));
                 }
-                LOG_ERROR("Unexpected system error in stream iteration " + std::to_string(iteration) + ": " + std::string(e.what()));
-                break;
-            } catch (const std::exception& e) {
-                std::string err_msg = e.what();
-                LOG_DEBUG("Stream iteration " + std::to_string(iteration) + ": Caught exception: " + err_msg);
-                if (err_msg.find("end of stream") != std::string::npos ||
-                    err_msg.find("end_of_stream") != std::string::npos ||
-                    err_msg.find("Broken pipe") != std::string::npos ||
-                    err_msg.find("Connection reset") != std::string::npos) {
-                    LOG_DEBUG("Stream connection closed at iteration " + std::to_string(iteration));
+                event.append("\n\n");
+                sent = true;
+                sent_version = snapshot->version;
+            } else if (std::chrono::steady_clock::now() - last_write >= STREAM_KEEPALIVE) {
+                // A comment line, so a client that went away is noticed while nothing changes
+                event.assign(": keepalive\n\n");
+            } else {
+                event.clear();
+            }
+            
+            if (!event.empty()) {
+                LOG_DEBUG("Stream iteration " + std::to_string(iteration) + ": Writing SSE event (" + std::to_string(event.length()) + " bytes)");
+                if (!writeWithDeadline(socket, event, httpWriteTimeout())) {
+                    LOG_DEBUG("Stream closed at iteration " + std::to_string(iteration) + " (client gone or not reading)");
                     break;
                 }
-                LOG_ERROR("Error in stream iteration " + std::to_string(iteration) + ": " + err_msg);
-                break;
-            } catch (...) {
-                LOG_ERROR("Stream iteration " + std::to_string(iteration) + ": Caught unknown exception");
-                break;
+                last_write = std::chrono::steady_clock::now();
             }
+            
+            // Woken by the next version another subscriber's collection publishes
+            waitForSnapshotPublish(snapshot->info.sections, snapshot->version, STREAM_INTERVAL);
         }
         LOG_DEBUG("Stream loop ended after " + std::to_string(iteration) + " iterations");
     } catch (const std::exception& e) {
@@ -109,134 +137,227 @@ void handleStreamingRequest(tcp::socket& socket) {
 }
 
 
-void handleRequest(http::request<http::string_body>& req, tcp::socket& socket) {
-    std::string target = std::string(req.target());
-    std::string method = std::string(to_string(req.method()));
-    
-    std::string client_ip = "unknown";
+static void writeBadRequest(http::request<http::string_body>& req, ClientSocket& socket, const std::string& message) {
+    http::response<http::string_body> res;
+    res.version(req.version());
+    res.keep_alive(req.keep_alive());
+    res.result(http::status::bad_request);
+    res.set(http::field::content_type, "application/json");
+    nlohmann::json error_json;
+    error_json["success"] = false;
+    error_json["message"] = message;
+    res.body() = error_json.dump();
+    res.prepare_payload();
     try {
-        client_ip = socket.remote_endpoint().address().to_string();
-    } catch (...) {
-        // Connection may be closed, use unknown
+        writeHttpMessage(socket, res);
+    } catch (const boost::system::system_error& e) {
+        LOG_DEBUG("Client disconnected during error response");
+    }
+}
+
+// ETag component for a body shaped by ?fields=/?model=, so each selection has its own tag
+static std::string selectionTag(const std::string& fields, const std::string& model_id) {
+    unsigned long long hash = 14695981039346656037ULL;
+    for (char c : fields + '\n' + model_id) {
+        hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ULL;
+    }
+    std::ostringstream tag;
+    tag << 'p' << std::hex << std::setw(16) << std::setfill('0') << hash;
+    return tag.str();
+}
+
+// If-None-Match: "*" or a comma separated list of (possibly weak) entity tags
+static bool etagMatches(boost::beast::string_view if_none_match, const std::string& etag) {
+    size_t pos = 0;
+    while (pos < if_none_match.size()) {
+        size_t end = if_none_match.find(',', pos);
+        if (end == boost::beast::string_view::npos) end = if_none_match.size();
+        boost::beast::string_view candidate = if_none_match.substr(pos, end - pos);
+        while (!candidate.empty() && candidate.front() == ' ') candidate.remove_prefix(1);
+        while (!candidate.empty() && candidate.back() == ' ') candidate.remove_suffix(1);
+        if (candidate.starts_with("W/")) candidate.remove_prefix(2);
+        if (candidate == "*" || candidate == etag) return true;
+        pos = end + 1;
+    }
+    return false;
+}
+
+// GET /vram and /vram/stream: the snapshot in the requested format, sections and projection
+static void handleSnapshotRequest(http::request<http::string_body>& req, ClientSocket& socket, bool stream) {
+    QueryParams query(std::string_view(req.target().data(), req.target().size()));
+    // Optional sections are only computed when asked for, e.g. ?include=processes,blocks
+    unsigned int sections = parseSnapshotSections(query.get("include"));
+    SnapshotFormat format = SNAPSHOT_FORMAT_JSON;
+    if (!parseSnapshotFormat(query.get("format"), format)) {
+        writeBadRequest(req, socket, "Unknown format (expected json or bin)");
+        return;
+    }
+    // ?fields= and ?model= are compiled once here and reused for every event of a stream
+    std::string fields = query.get("fields");
+    std::string model_id = query.get("model");
+    JsonSelection selection;
+    std::string unknown_field;
+    if (!compileDetailedSelection(fields, model_id, selection, unknown_field)) {
+        writeBadRequest(req, socket, "Unknown field: " + unknown_field);
+        return;
+    }
+    if (!selection.empty() && format != SNAPSHOT_FORMAT_JSON) {
+        writeBadRequest(req, socket, "fields and model apply to format=json only");
+        return;
+    }
+    if (stream) {
+        LOG_DEBUG("Starting streaming request");
+        adjustStreamSubscribers(1);
+        handleStreamingRequest(socket, sections, format, selection);
+        adjustStreamSubscribers(-1);
+        LOG_DEBUG("Streaming request ended");
+        return;
     }
     
-    LOG_INFO("[" + method + "] " + target + " from " + client_ip);
-    
-    if (req.method() == http::verb::get) {
-        if (target == "/vram" || target == "/vram/stream") {
-            if (target == "/vram/stream") {
-                LOG_DEBUG("Starting streaming request from " + client_ip);
-                handleStreamingRequest(socket);
-                LOG_DEBUG("Streaming request ended from " + client_ip);
-                return;
-            }
-            
-            LOG_DEBUG("Fetching VRAM info");
-            DetailedVRAMInfo info = getDetailedVRAMUsage();
-            std::string json = createDetailedResponse(info);
-            
-            http::response<http::string_body> res;
-            res.version(req.version());
-            res.keep_alive(req.keep_alive());
-            res.result(http::status::ok);
-            res.set(http::field::content_type, "application/json");
-            res.body() = json;
-            res.prepare_payload();
-            
-            try {
-                http::write(socket, res);
-                LOG_DEBUG("VRAM response sent (" + std::to_string(json.length()) + " bytes)");
-            } catch (const boost::system::system_error& e) {
-                auto ec = e.code();
-                if (ec == boost::asio::error::broken_pipe || 
-                    ec == boost::asio::error::connection_reset ||
-                    ec == boost::asio::error::eof) {
-                    LOG_DEBUG("Client disconnected during VRAM response");
-                    return;
-                }
-                throw;
-            }
-            return;
-        } else if (target.find("/vram/aggregated") == 0) {
-            unsigned int window_seconds = 5;
-            std::regex window_regex(R"(window=(\d+))");
-            std::smatch match;
-            std::string query = std::string(req.target());
-            size_t query_pos = query.find('?');
-            if (query_pos != std::string::npos) {
-                std::string query_str = query.substr(query_pos + 1);
-                if (std::regex_search(query_str, match, window_regex)) {
-                    try {
-                        window_seconds = std::stoi(match[1].str());
-                        if (window_seconds < 1) window_seconds = 1;
-                        if (window_seconds > 60) window_seconds = 60;
-                    } catch (...) {
-                        window_seconds = 5;
-                    }
-                }
-            }
-            
-            LOG_DEBUG("Collecting aggregated metrics for " + std::to_string(window_seconds) + " seconds");
-            AggregatedVRAMInfo info = collectAggregatedMetrics(window_seconds);
-            std::string json = createAggregatedResponse(info);
-            
-            http::response<http::string_body> res;
-            res.version(req.version());
-            res.keep_alive(req.keep_alive());
-            res.result(http::status::ok);
-            res.set(http::field::content_type, "application/json");
-            res.body() = json;
-            res.prepare_payload();
-            
-            try {
-                http::write(socket, res);
-                LOG_DEBUG("Aggregated VRAM response sent (" + std::to_string(json.length()) + " bytes)");
-            } catch (const boost::system::system_error& e) {
-                auto ec = e.code();
-                if (ec == boost::asio::error::broken_pipe || 
-                    ec == boost::asio::error::connection_reset ||
-                    ec == boost::asio::error::eof) {
-                    LOG_DEBUG("Client disconnected during aggregated VRAM response");
-                    return;
-                }
-                throw;
+    LOG_DEBUG("Fetching VRAM info");
+    beginRequestTiming();
+    // A snapshot published within SNAPSHOT_MAX_AGE_MS is served as it is, so a matching
+    // If-None-Match is answered without collecting
+    std::shared_ptr<const PublishedSnapshot> snapshot = getRecentVRAMSnapshot(sections, snapshotMaxAge());
+    // Unchanged content: headers only, nothing is serialized. The client may hold
+    // any coding of the body; all of them are current.
+    boost::beast::string_view if_none_match = req[http::field::if_none_match];
+    std::string variant = selection.empty() ? std::string() : selectionTag(fields, model_id);
+    std::string etag;
+    bool not_modified = false;
+    for (unsigned int e = 0; e < CONTENT_ENCODING_COUNT && !not_modified && !if_none_match.empty(); ++e) {
+        etag = getSnapshotETag(*snapshot, format, static_cast<ContentEncoding>(e), variant);
+        not_modified = etagMatches(if_none_match, etag);
+    }
+    std::shared_ptr<const std::string> body;
+    ContentEncoding encoding = CONTENT_ENCODING_IDENTITY;
+    if (!not_modified && !selection.empty()) {
+        // Projections are request specific: written and compressed per request
+        auto projected = std::make_shared<std::string>();
+        writeDetailedResponse(snapshot->info, *projected, &selection);
+        boost::beast::string_view accept_encoding = req[http::field::accept_encoding];
+        encoding = compressForClient(std::string_view(accept_encoding.data(), accept_encoding.size()), *projected);
+        body = std::move(projected);
+        etag = getSnapshotETag(*snapshot, format, encoding, variant);
+    } else if (!not_modified) {
+        body = getSnapshotBody(*snapshot, format);
+        // Compressed bodies are cached with the snapshot like the identity one
+        boost::beast::string_view accept_encoding = req[http::field::accept_encoding];
+        encoding = negotiateContentEncoding(std::string_view(accept_encoding.data(), accept_encoding.size()), body->size());
+        if (encoding != CONTENT_ENCODING_IDENTITY) {
+            std::shared_ptr<const std::string> encoded = getSnapshotBody(*snapshot, format, encoding);
+            if (encoded) {
+                body = std::move(encoded);
+            } else {
+                encoding = CONTENT_ENCODING_IDENTITY;
             }
-            return;
-        } else if (target == "/models") {
-            LOG_DEBUG("Listing deployed models");
-            handleListModelsRequest(req, socket);
-            return;
         }
-    } else if (req.method() == http::verb::post) {
-        if (target == "/deploy") {
-            LOG_INFO("Deploy request received from " + client_ip);
-            LOG_DEBUG("Request body: " + req.body().substr(0, 200) + (req.body().length() > 200 ? "..." : ""));
-            handleDeployRequest(req, socket);
-            return;
-        } else if (target == "/spindown") {
-            LOG_INFO("Spindown request received from " + client_ip);
-            LOG_DEBUG("Request body: " + req.body());
-            handleSpindownRequest(req, socket);
-            return;
-        } else if (target == "/optimize") {
-            LOG_INFO("Optimize request received from " + client_ip);
-            handleOptimizeRequest(req, socket);
+        etag = getSnapshotETag(*snapshot, format, encoding);
+    }
+    std::string server_timing = formatServerTiming(endRequestTiming());
+    
+    // The cached body is written in place rather than copied into the response
+    http::response<http::span_body<const char>> res;
+    res.version(req.version());
+    res.keep_alive(req.keep_alive());
+    res.result(not_modified ? http::status::not_modified : http::status::ok);
+    res.set(http::field::content_type, snapshotContentType(format));
+    res.set(http::field::etag, etag);
+    res.set(http::field::cache_control, "no-cache");
+    res.set(http::field::vary, "Accept-Encoding");
+    if (encoding != CONTENT_ENCODING_IDENTITY) {
+        res.set(http::field::content_encoding, contentEncodingName(encoding));
+    }
+    if (!server_timing.empty()) {
+        // Absent when the snapshot was served without collecting
+        res.set("Server-Timing", server_timing);
+    }
+    if (body) {
+        res.body() = boost::beast::span<const char>(body->data(), body->size());
+        res.prepare_payload();
+    }
+    
+    try {
+        writeHttpMessage(socket, res);
+        LOG_DEBUG(not_modified ? "VRAM response not modified (" + etag + ")"
+                               : "VRAM response sent (" + std::to_string(body->size()) + " bytes)");
+    } catch (const boost::system::system_error& e) {
+        auto ec = e.code();
+        if (ec == boost::asio::error::broken_pipe || 
+            ec == boost::asio::error::connection_reset ||
+            ec == boost::asio::error::eof) {
+            LOG_DEBUG("Client disconnected during VRAM response");
             return;
         }
+        throw;
+    }
+}
+
+// GET /vram/aggregated?window=<seconds>: statistics over snapshots sampled for the window (1-60s)
+static void handleAggregatedRequest(http::request<http::string_body>& req, ClientSocket& socket) {
+    QueryParams query(std::string_view(req.target().data(), req.target().size()));
+    JsonSelection selection;
+    std::string unknown_field;
+    if (!compileAggregatedSelection(query.get("fields"), query.get("model"), selection, unknown_field)) {
+        writeBadRequest(req, socket, "Unknown field: " + unknown_field);
+        return;
     }
     
-    LOG_WARN("404 Not Found: " + method + " " + target + " from " + client_ip);
+    unsigned long long window = 5;
+    query.getUnsigned("window", window);
+    unsigned int window_seconds = static_cast<unsigned int>(std::clamp(window, 1ULL, 60ULL));
+    
+    LOG_DEBUG("Collecting aggregated metrics for " + std::to_string(window_seconds) + " seconds");
+    AggregatedVRAMInfo info = collectAggregatedMetrics(window_seconds);
     
     http::response<http::string_body> res;
+    writeAggregatedResponse(info, res.body(), &selection);
     res.version(req.version());
     res.keep_alive(req.keep_alive());
-    res.result(http::status::not_found);
+    res.result(http::status::ok);
+    res.set(http::field::content_type, "application/json");
+    boost::beast::string_view accept_encoding = req[http::field::accept_encoding];
+    ContentEncoding encoding = compressForClient(std::string_view(accept_encoding.data(), accept_encoding.size()), res.body());
+    if (encoding != CONTENT_ENCODING_IDENTITY) {
+        res.set(http::field::content_encoding, contentEncodingName(encoding));
+    }
+    res.set(http::field::vary, "Accept-Encoding");
+    res.prepare_payload();
+    
+    try {
+        writeHttpMessage(socket, res);
+        LOG_DEBUG("Aggregated VRAM response sent (" + std::to_string(res.body().length()) + " bytes)");
+    } catch (const boost::system::system_error& e) {
+        auto ec = e.code();
+        if (ec == boost::asio::error::broken_pipe || 
+            ec == boost::asio::error::connection_reset ||
+            ec == boost::asio::error::eof) {
+            LOG_DEBUG("Client disconnected during aggregated VRAM response");
+            return;
+        }
+        throw;
+    }
+}
+
+// 404, 405 (with Allow) and 503 (with Retry-After): the reason phrase as a text/plain body
+static void writeStatusResponse(http::request<http::string_body>& req, ClientSocket& socket,
+                                http::status status, const std::string* allow = nullptr, int retry_after = 0) {
+    http::response<http::string_body> res;
+    res.version(req.version());
+    res.keep_alive(req.keep_alive());
+    res.result(status);
     res.set(http::field::content_type, "text/plain");
-    res.body() = "Not Found";
+    if (allow) {
+        res.set(http::field::allow, *allow);
+    }
+    if (retry_after > 0) {
+        res.set(http::field::retry_after, std::to_string(retry_after));
+    }
+    res.body() = std::string(http::obsolete_reason(status));
     res.prepare_payload();
     
     try {
-        http::write(socket, res);
+        writeHttpMessage(socket, res);
     } catch (const boost::system::system_error& e) {
         auto ec = e.code();
         if (ec == boost::asio::error::broken_pipe || 
@@ -248,40 +369,324 @@ void handleRequest(http::request<http::string_body>& req, tcp::socket& socket) {
     }
 }
 
-void acceptConnections(tcp::acceptor& acceptor) {
+static std::vector<std::unique_ptr<AdmissionGate>> admission_gates;
+
+// Gate for one class of expensive requests: <env_prefix>_LIMIT running at once and
+// <env_prefix>_QUEUE more waiting up to ADMISSION_QUEUE_TIMEOUT_MS for a slot
+static AdmissionGate& makeAdmissionGate(const std::string& name, const std::string& env_prefix,
+                                        int default_limit, int default_queue) {
+    int limit = std::max(1, getEnvInt(env_prefix + "_LIMIT", default_limit));
+    int queue = std::max(0, getEnvInt(env_prefix + "_QUEUE", default_queue));
+    int timeout_ms = std::max(0, getEnvInt("ADMISSION_QUEUE_TIMEOUT_MS", 2000));
+    admission_gates.push_back(std::make_unique<AdmissionGate>(name, limit, queue, std::chrono::milliseconds(timeout_ms)));
+    return *admission_gates.back();
+}
+
+// Runs handler only while holding a slot of gate; a shed request gets 503 with Retry-After
+static RouteHandler admitted(AdmissionGate& gate, RouteHandler handler) {
+    return [&gate, handler = std::move(handler)](auto& req, auto& socket, const RouteParams& params) {
+        AdmissionTicket ticket(gate);
+        if (!ticket) {
+            static const int retry_after = std::max(1, getEnvInt("ADMISSION_RETRY_AFTER", 1));
+            LOG_WARN("503 Service Unavailable: " + std::string(req.target()) + " shed by admission control");
+            writeStatusResponse(req, socket, http::status::service_unavailable, nullptr, retry_after);
+            return;
+        }
+        handler(req, socket, params);
+    };
+}
+
+// Every endpoint, registered once. A route's latency is recorded as "http:<pattern>".
+// Literal paths go before parameterized ones that could also match them.
+//
+// Cheap reads (/vram, /models, /jobs, /metrics, ...) have no gate and never queue. Expensive
+// routes are gated, so together they hold at most the sum of their limits and queues of the
+// HTTP_MAX_CONNECTIONS connection threads and the rest stay free for reads.
+static Router buildRouter() {
+    Router router;
+    AdmissionGate& stream_gate = makeAdmissionGate("stream", "ADMISSION_STREAM", 16, 0);
+    AdmissionGate& aggregated_gate = makeAdmissionGate("aggregated", "ADMISSION_AGGREGATED", 4, 4);
+    AdmissionGate& profile_gate = makeAdmissionGate("profile", "ADMISSION_PROFILE", 2, 2);
+    AdmissionGate& deploy_gate = makeAdmissionGate("deploy", "ADMISSION_DEPLOY", 2, 2);
+    // Separate from deploy, so freeing VRAM is never shed behind a burst of deploys
+    AdmissionGate& spindown_gate = makeAdmissionGate("spindown", "ADMISSION_SPINDOWN", 2, 2);
+    AdmissionGate& optimize_gate = makeAdmissionGate("optimize", "ADMISSION_OPTIMIZE", 1, 1);
+    router.add(http::verb::get, "/vram", [](auto& req, auto& socket, const RouteParams&) {
+        handleSnapshotRequest(req, socket, false);
+    });
+    router.add(http::verb::get, "/vram/stream", admitted(stream_gate, [](auto& req, auto& socket, const RouteParams&) {
+        handleSnapshotRequest(req, socket, true);
+    }), false);
+    router.add(http::verb::get, "/vram/blocks", [](auto& req, auto& socket, const RouteParams&) {
+        handleVRAMBlocksRequest(req, socket);
+    });
+    router.add(http::verb::get, "/vram/aggregated", admitted(aggregated_gate, [](auto& req, auto& socket, const RouteParams&) {
+        handleAggregatedRequest(req, socket);
+    }));
+    router.add(http::verb::get, "/models", [](auto& req, auto& socket, const RouteParams&) {
+        LOG_DEBUG("Listing deployed models");
+        handleListModelsRequest(req, socket);
+    });
+    router.add(http::verb::get, "/jobs/{id}", [](auto& req, auto& socket, const RouteParams&) {
+        handleJobStatusRequest(req, socket);
+    });
+    router.add(http::verb::get, "/profile", admitted(profile_gate, [](auto& req, auto& socket, const RouteParams&) {
+        handleModelProfileRequest(req, socket);
+    }));
+    router.add(http::verb::get, "/profile/{pid}", [](auto& req, auto& socket, const RouteParams&) {
+        handleProfileStatusRequest(req, socket);
+    });
+    router.add(http::verb::post, "/profile/{pid}", admitted(profile_gate, [](auto& req, auto& socket, const RouteParams&) {
+        handleProfileRequest(req, socket);
+    }));
+    router.add(http::verb::get, "/debug/timings", [](auto& req, auto& socket, const RouteParams&) {
+        handleDebugTimingsRequest(req, socket);
+    });
+    router.add(http::verb::get, "/metrics", [](auto& req, auto& socket, const RouteParams&) {
+        handleMetricsRequest(req, socket);
+    });
+    router.add(http::verb::post, "/deploy", admitted(deploy_gate, [](auto& req, auto& socket, const RouteParams&) {
+        LOG_INFO("Deploy request received");
+        LOG_DEBUG("Request body: " + req.body().substr(0, 200) + (req.body().length() > 200 ? "..." : ""));
+        handleDeployRequest(req, socket);
+    }));
+    router.add(http::verb::post, "/spindown", admitted(spindown_gate, [](auto& req, auto& socket, const RouteParams&) {
+        LOG_INFO("Spindown request received");
+        LOG_DEBUG("Request body: " + req.body());
+        handleSpindownRequest(req, socket);
+    }));
+    router.add(http::verb::post, "/optimize", admitted(optimize_gate, [](auto& req, auto& socket, const RouteParams&) {
+        LOG_INFO("Optimize request received");
+        handleOptimizeRequest(req, socket);
+    }));
+    return router;
+}
+
+static const Router& apiRouter() {
+    static const Router router = buildRouter();
+    return router;
+}
+
+void handleRequest(http::request<http::string_body>& req, ClientSocket& socket) {
+    std::string_view target(req.target().data(), req.target().size());
+    std::string_view path = target.substr(0, target.find('?'));
+    RouteParams params;
+    Router::Match route = apiRouter().match(req.method(), path, params);
+    ScopedStageTimer request_timer(route.handler ? route.stage : "http:other");
+    
+    std::string client_ip = peerAddress(socket);
+    
+    std::string method = std::string(to_string(req.method()));
+    LOG_INFO("[" + method + "] " + std::string(target) + " from " + client_ip);
+    
+    if (route.handler) {
+        (*route.handler)(req, socket, params);
+        return;
+    }
+    
+    if (route.path_found) {
+        LOG_WARN("405 Method Not Allowed: " + method + " " + std::string(target) + " from " + client_ip);
+        writeStatusResponse(req, socket, http::status::method_not_allowed, route.allow);
+        return;
+    }
+    LOG_WARN("404 Not Found: " + method + " " + std::string(target) + " from " + client_ip);
+    writeStatusResponse(req, socket, http::status::not_found);
+}
+
+static std::chrono::milliseconds keepAliveTimeout() {
+    static const std::chrono::milliseconds timeout(std::max(1, getEnvInt("HTTP_KEEPALIVE_TIMEOUT", 5)) * 1000);
+    return timeout;
+}
+
+static std::chrono::milliseconds readTimeout() {
+    static const std::chrono::milliseconds timeout(std::max(1, getEnvInt("HTTP_READ_TIMEOUT", 10)) * 1000);
+    return timeout;
+}
+
+static unsigned int maxRequestsPerConnection() {
+    static const unsigned int max_requests = static_cast<unsigned int>(std::max(1, getEnvInt("HTTP_MAX_KEEPALIVE_REQUESTS", 1000)));
+    return max_requests;
+}
+
+static unsigned int maxOpenConnections() {
+    static const unsigned int max_connections = static_cast<unsigned int>(std::max(1, getEnvInt("HTTP_MAX_CONNECTIONS", 64)));
+    return max_connections;
+}
+
+static std::mutex open_connections_mutex;
+static std::condition_variable open_connections_cv;
+static unsigned int open_connections = 0;  // Guarded by open_connections_mutex
+
+static void releaseConnectionSlot() {
+    std::lock_guard<std::mutex> lock(open_connections_mutex);
+    open_connections--;
+    open_connections_cv.notify_one();
+}
+
+std::string peerAddress(const ClientSocket& socket) {
+    beast::error_code ec;
+    net::generic::stream_protocol::endpoint endpoint = socket.remote_endpoint(ec);
+    if (ec) return "unknown";
+    int family = endpoint.protocol().family();
+    if (family == AF_UNIX) return "unix";
+    if (family != AF_INET && family != AF_INET6) return "unknown";
+    tcp::endpoint ip_endpoint;
+    std::memcpy(ip_endpoint.data(), endpoint.data(), std::min<size_t>(endpoint.size(), ip_endpoint.capacity()));
+    return ip_endpoint.address().to_string();
+}
+
+// beast::tcp_stream over a socket of any stream family, so Unix clients are served by the same code
+using ClientStream = beast::basic_stream<net::generic::stream_protocol, net::any_io_executor, beast::unlimited_rate_policy>;
+
+// A client socket with an io_context of its own. Reads are asynchronous with a stream
+// expiry, driven by running the context on the connection's thread; handlers write to
+// stream.socket() through writeHttpMessage (utils/http_io.h), which runs it the same way.
+struct ClientConnection {
+    net::io_context ioc{1};
+    ClientStream stream{ioc};
+};
+
+// Run the connection's pending operation (started by start) to completion
+template <typename Start>
+static beast::error_code runUntilDone(ClientConnection& connection, std::chrono::milliseconds timeout, Start start) {
+    beast::error_code result;
+    connection.stream.expires_after(timeout);
+    start([&result](beast::error_code ec, size_t) { result = ec; });
+    connection.ioc.restart();
+    connection.ioc.run();
+    return result;
+}
+
+// Wait up to HTTP_KEEPALIVE_TIMEOUT for the client to send anything, then give the whole
+// request HTTP_READ_TIMEOUT to arrive within HTTP_MAX_HEADER_BYTES/HTTP_MAX_BODY_BYTES.
+static beast::error_code readRequest(ClientConnection& connection, beast::flat_buffer& buffer,
+                                     http::request_parser<http::string_body>& parser) {
+    static const unsigned int header_limit = static_cast<unsigned int>(std::max(1024, getEnvInt("HTTP_MAX_HEADER_BYTES", 8 * 1024)));
+    static const unsigned int body_limit = static_cast<unsigned int>(std::max(0, getEnvInt("HTTP_MAX_BODY_BYTES", 1024 * 1024)));
+    parser.header_limit(header_limit);
+    parser.body_limit(body_limit);
+
+    if (buffer.size() == 0) {
+        beast::error_code ec = runUntilDone(connection, keepAliveTimeout(), [&](auto handler) {
+            connection.stream.async_read_some(buffer.prepare(4096), [&buffer, handler](beast::error_code ec, size_t n) {
+                buffer.commit(n);
+                handler(ec, n);
+            });
+        });
+        if (ec) return ec;
+    }
+    return runUntilDone(connection, readTimeout(), [&](auto handler) {
+        http::async_read(connection.stream, buffer, parser, handler);
+    });
+}
+
+// Serve requests from one client until it asks to close, stays idle for HTTP_KEEPALIVE_TIMEOUT
+// seconds or reaches HTTP_MAX_KEEPALIVE_REQUESTS. Pipelined requests are parsed from the bytes
+// left in the buffer by the previous read and answered in order.
+static void serveConnection(std::unique_ptr<ClientConnection> connection) {
+    adjustOpenConnections(1);
+    ClientSocket& socket = connection->stream.socket();
+    beast::flat_buffer buffer;
+    unsigned int served = 0;
+    try {
+        while (true) {
+            http::request_parser<http::string_body> parser;
+            beast::error_code ec = readRequest(*connection, buffer, parser);
+            if (ec == beast::error::timeout) {
+                LOG_DEBUG("Closing connection after " + std::to_string(served) + " requests: " +
+                          (parser.got_some() ? "request not received within HTTP_READ_TIMEOUT" : "idle"));
+                break;
+            }
+            if (ec == http::error::header_limit || ec == http::error::body_limit) {
+                http::request<http::string_body> rejected;
+                rejected.keep_alive(false);
+                http::status status = ec == http::error::header_limit
+                    ? http::status::request_header_fields_too_large : http::status::payload_too_large;
+                LOG_WARN(std::to_string(static_cast<unsigned>(status)) + " " + std::string(http::obsolete_reason(status)) +
+                         ": request rejected before reading it completely");
+                writeStatusResponse(rejected, socket, status);
+                break;
+            }
+            if (ec) break;
+
+            http::request<http::string_body> req = parser.release();
+            if (served++ > 0) recordKeepAliveRequest();
+
+            // Handlers echo req.keep_alive(), so the last allowed request is answered with Connection: close
+            bool keep_alive = req.keep_alive() && served < maxRequestsPerConnection();
+            req.keep_alive(keep_alive);
+            handleRequest(req, socket);
+            if (!keep_alive) break;
+        }
+        beast::error_code ec;
+        socket.shutdown(net::socket_base::shutdown_send, ec);
+    } catch (const boost::system::system_error& e) {
+        auto ec = e.code();
+        if (!(ec == boost::asio::error::broken_pipe || 
+              ec == boost::asio::error::connection_reset ||
+              ec == boost::asio::error::eof ||
+              ec == boost::beast::http::error::end_of_stream ||
+              ec == boost::asio::error::operation_aborted ||
+              ec.category() == boost::asio::error::get_system_category())) {
+            std::cerr << "Unexpected connection error: " << e.what() << std::endl;
+        }
+    } catch (const std::exception& e) {
+        std::string err_msg = e.what();
+        if (err_msg.find("end of stream") == std::string::npos &&
+            err_msg.find("end_of_stream") == std::string::npos &&
+            err_msg.find("Broken pipe") == std::string::npos &&
+            err_msg.find("Connection reset") == std::string::npos &&
+            err_msg.find("Connection refused") == std::string::npos) {
+            std::cerr << "Error handling request: " << e.what() << std::endl;
+        }
+    } catch (...) {
+        // Connection is dropped below
+    }
+    adjustOpenConnections(-1);
+    connection.reset();
+    releaseConnectionSlot();
+}
+
+// Accept clients one at a time with accept_into, which moves the accepted socket into connection.stream
+template <typename AcceptInto>
+static void runAcceptLoop(AcceptInto accept_into) {
+    // Build the route table before the first connection
+    apiRouter();
     while (true) {
+        // Past HTTP_MAX_CONNECTIONS new clients wait in the listen backlog. The slot is taken
+        // before accepting, so the TCP and Unix socket loops together never exceed the limit.
+        {
+            std::unique_lock<std::mutex> lock(open_connections_mutex);
+            open_connections_cv.wait(lock, [] { return open_connections < maxOpenConnections(); });
+            open_connections++;
+        }
         try {
-            tcp::socket socket(acceptor.get_executor());
-            acceptor.accept(socket);
-            
-            beast::flat_buffer buffer;
-            http::request<http::string_body> req;
-            http::read(socket, buffer, req);
-            handleRequest(req, socket);
+            auto connection = std::make_unique<ClientConnection>();
+            accept_into(*connection);
+            // One thread per connection, so an idle keep-alive client or a stream never blocks the others
+            std::thread(serveConnection, std::move(connection)).detach();
         } catch (const boost::system::system_error& e) {
-            auto ec = e.code();
-            if (ec == boost::asio::error::broken_pipe || 
-                ec == boost::asio::error::connection_reset ||
-                ec == boost::asio::error::eof ||
-                ec == boost::beast::http::error::end_of_stream ||
-                ec == boost::asio::error::operation_aborted ||
-                ec.category() == boost::asio::error::get_system_category()) {
-                continue;
-            }
-            std::cerr << "Unexpected connection error: " << e.what() << std::endl;
+            LOG_WARN("Accept failed: " + std::string(e.what()));
+            releaseConnectionSlot();
         } catch (const std::exception& e) {
-            std::string err_msg = e.what();
-            if (err_msg.find("end of stream") != std::string::npos ||
-                err_msg.find("end_of_stream") != std::string::npos ||
-                err_msg.find("Broken pipe") != std::string::npos ||
-                err_msg.find("Connection reset") != std::string::npos ||
-                err_msg.find("Connection refused") != std::string::npos) {
-                continue;
-            }
-            std::cerr << "Error handling request: " << e.what() << std::endl;
-        } catch (...) {
-            continue;
+            LOG_WARN("Failed to start connection thread: " + std::string(e.what()));
+            releaseConnectionSlot();
         }
     }
 }
 
+void acceptConnections(tcp::acceptor& acceptor) {
+    runAcceptLoop([&acceptor](ClientConnection& connection) {
+        tcp::socket peer(connection.ioc);
+        acceptor.accept(peer);
+        connection.stream.socket() = std::move(peer);
+    });
+}
+
+void acceptConnections(net::local::stream_protocol::acceptor& acceptor) {
+    runAcceptLoop([&acceptor](ClientConnection& connection) {
+        net::local::stream_protocol::socket peer(connection.ioc);
+        acceptor.accept(peer);
+        connection.stream.socket() = std::move(peer);
+    });
+}
@@ -1,9 +1,59 @@
 #include "infra/http_server.h"
 #include "services/nvml_utils.h"
+#include "services/gpu_backend.h"
+#include "services/proc_events.h"
 #include "services/model_manager.h"
+#include "services/optimizer_controller.h"
 #include "utils/logger.h"
+#include "utils/env_utils.h"
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstdlib>
 #include <iostream>
+#include <memory>
 #include <stdexcept>
+#include <thread>
+
+// Optional listener for clients on the same host (UNIX_SOCKET_PATH). Access is controlled by
+// the socket file's permissions (UNIX_SOCKET_MODE, octal, default 660). A stale socket file
+// left by a previous run is replaced; any other file at the path is left alone, and a socket
+// another server still answers on stops startup.
+static std::unique_ptr<net::local::stream_protocol::acceptor> openUnixListener(net::io_context& ioc) {
+    std::string path = getEnvValue("UNIX_SOCKET_PATH");
+    if (path.empty()) return nullptr;
+
+    struct stat existing;
+    if (lstat(path.c_str(), &existing) == 0) {
+        if (!S_ISSOCK(existing.st_mode)) {
+            LOG_ERROR("UNIX_SOCKET_PATH " + path + " exists and is not a socket, Unix listener disabled");
+            return nullptr;
+        }
+        net::local::stream_protocol::socket probe(ioc);
+        boost::system::error_code ec;
+        probe.connect(net::local::stream_protocol::endpoint(path), ec);
+        if (!ec) {
+            throw std::runtime_error("UNIX_SOCKET_PATH " + path + " is in use by a running server");
+        }
+        if (ec != net::error::connection_refused) {
+            LOG_ERROR("Cannot tell whether " + path + " is in use (" + ec.message() + "), Unix listener disabled");
+            return nullptr;
+        }
+        LOG_INFO("Removing stale socket " + path);
+        unlink(path.c_str());
+    }
+
+    try {
+        auto acceptor = std::make_unique<net::local::stream_protocol::acceptor>(ioc, net::local::stream_protocol::endpoint(path));
+        mode_t mode = static_cast<mode_t>(std::strtol(getEnvValue("UNIX_SOCKET_MODE", "660").c_str(), nullptr, 8));
+        if (chmod(path.c_str(), mode) != 0) {
+            LOG_WARN("Failed to set permissions of " + path);
+        }
+        return acceptor;
+    } catch (const boost::system::system_error& e) {
+        LOG_ERROR("Failed to listen on " + path + ": " + std::string(e.what()));
+        return nullptr;
+    }
+}
 
 int main(int argc, char* argv[]) {
     try {
@@ -25,9 +75,25 @@ int main(int argc, char* argv[]) {
             case LogLevel::ERROR: level_str = "ERROR"; break;
         }
         LOG_INFO("Starting Blackbox Server on port " + std::to_string(port) + " (log level: " + level_str + ")");
-        initNVML();
-        LOG_INFO("NVML initialized successfully");
+        selectGpuTelemetryBackend();
+        if (initNVML()) {
+            LOG_INFO("GPU telemetry initialized (" + getGpuTelemetryBackend().name() + ")");
+        } else {
+            LOG_WARN("GPU telemetry unavailable, VRAM metrics will be zero");
+        }
+        startProcessEventListener();
         startHealthCheckThread();
+        startUsageSamplerThread();
+        startOptimizerController();
+        auto unix_ioc = std::make_unique<net::io_context>();
+        auto unix_acceptor = openUnixListener(*unix_ioc);
+        if (unix_acceptor) {
+            LOG_INFO("Also listening on " + getEnvValue("UNIX_SOCKET_PATH"));
+            // The listener thread owns its acceptor and context, so both live as long as it does
+            std::thread([unix_ioc = std::move(unix_ioc), unix_acceptor = std::move(unix_acceptor)]() {
+                acceptConnections(*unix_acceptor);
+            }).detach();
+        }
         LOG_INFO("Server ready to accept connections");
         acceptConnections(acceptor);
     } catch (std::exception& e) {
@@ -0,0 +1,89 @@
+#include "infra/router.h"
+
+// Deeper paths than any route are rejected without being split further
+static constexpr size_t MAX_SEGMENTS = 8;
+
+std::string_view RouteParams::get(std::string_view name) const {
+    for (size_t i = 0; i < count; ++i) {
+        if (names[i] == name) return values[i];
+    }
+    return {};
+}
+
+// "/jobs/{id}" -> ["jobs", "{id}"]; "/" -> []
+static size_t splitPath(std::string_view path, std::string_view* segments, size_t max_segments) {
+    size_t count = 0;
+    size_t pos = path.empty() || path[0] != '/' ? 0 : 1;
+    if (pos >= path.size()) return 0;
+    while (pos <= path.size()) {
+        size_t end = path.find('/', pos);
+        if (end == std::string_view::npos) end = path.size();
+        if (count == max_segments) return max_segments + 1;
+        segments[count++] = path.substr(pos, end - pos);
+        pos = end + 1;
+    }
+    return count;
+}
+
+void Router::add(http::verb method, const std::string& pattern, RouteHandler handler, bool timed) {
+    Route* route = nullptr;
+    for (auto& existing : routes) {
+        if (existing.pattern == pattern) route = &existing;
+    }
+    if (!route) {
+        routes.emplace_back();
+        route = &routes.back();
+        route->pattern = pattern;
+        route->stage = "http:" + pattern;
+        route->timed = timed;
+        std::string_view segments[MAX_SEGMENTS];
+        size_t count = splitPath(pattern, segments, MAX_SEGMENTS);
+        for (size_t i = 0; i < count && i < MAX_SEGMENTS; ++i) {
+            std::string_view segment = segments[i];
+            bool parameter = segment.size() > 2 && segment.front() == '{' && segment.back() == '}';
+            route->segments.push_back({std::string(parameter ? segment.substr(1, segment.size() - 2) : segment), parameter});
+        }
+    }
+    route->handlers.emplace_back(method, std::move(handler));
+    if (!route->allow.empty()) route->allow += ", ";
+    route->allow += std::string(http::to_string(method));
+}
+
+Router::Match Router::match(http::verb method, std::string_view path, RouteParams& params) const {
+    Match result;
+    std::string_view segments[MAX_SEGMENTS];
+    size_t count = splitPath(path, segments, MAX_SEGMENTS);
+    if (count > MAX_SEGMENTS) return result;
+
+    for (const auto& route : routes) {
+        if (route.segments.size() != count) continue;
+        RouteParams captured;
+        bool matched = true;
+        for (size_t i = 0; i < count && matched; ++i) {
+            const Segment& segment = route.segments[i];
+            if (!segment.parameter) {
+                matched = segments[i] == segment.text;
+            } else if (segments[i].empty() || captured.count == RouteParams::MAX_PARAMS) {
+                matched = false;
+            } else {
+                captured.names[captured.count] = segment.text;
+                captured.values[captured.count] = segments[i];
+                captured.count++;
+            }
+        }
+        if (!matched) continue;
+
+        // Literal routes are added before parameterized ones that could also match
+        result.path_found = true;
+        result.allow = &route.allow;
+        result.stage = route.timed ? route.stage.c_str() : nullptr;
+        for (const auto& [route_method, handler] : route.handlers) {
+            if (route_method == method) {
+                result.handler = &handler;
+                params = captured;
+                return result;
+            }
+        }
+    }
+    return result;
+}
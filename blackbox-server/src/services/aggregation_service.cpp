@@ -8,7 +8,7 @@
 #include <thread>
 #include <chrono>
 
-static double calculatePercentile(const std::vector<double>& sorted_values, double percentile) {
+double calculatePercentile(const std::vector<double>& sorted_values, double percentile) {
     if (sorted_values.empty()) return 0.0;
     if (sorted_values.size() == 1) return sorted_values[0];
     
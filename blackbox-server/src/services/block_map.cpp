@@ -0,0 +1,58 @@
+#include "services/block_map.h"
+#include <algorithm>
+
+ModelBlockMap buildModelBlockMap(const std::string& model_id, int port, unsigned long long block_size,
+                                 unsigned int num_blocks, unsigned int utilized_blocks) {
+    ModelBlockMap map{model_id, port, block_size, num_blocks, std::min(utilized_blocks, num_blocks), {}};
+    if (map.utilized_blocks > 0) {
+        map.runs.push_back(BlockRun{0, map.utilized_blocks, true});
+    }
+    if (num_blocks > map.utilized_blocks) {
+        map.runs.push_back(BlockRun{map.utilized_blocks, num_blocks - map.utilized_blocks, false});
+    }
+    return map;
+}
+
+// First run that ends after block
+static std::vector<BlockRun>::const_iterator findRun(const ModelBlockMap& map, unsigned int block) {
+    return std::upper_bound(map.runs.begin(), map.runs.end(), block, [](unsigned int b, const BlockRun& run) {
+        return b < run.first_block + run.count;
+    });
+}
+
+unsigned int countUtilizedBlocks(const ModelBlockMap& map, unsigned int first_block, unsigned int count) {
+    unsigned long long end = std::min<unsigned long long>(static_cast<unsigned long long>(first_block) + count, map.num_blocks);
+    unsigned int utilized = 0;
+    for (auto run = findRun(map, first_block); run != map.runs.end() && run->first_block < end; ++run) {
+        if (!run->utilized) continue;
+        unsigned long long from = std::max(first_block, run->first_block);
+        unsigned long long to = std::min<unsigned long long>(run->first_block + run->count, end);
+        utilized += static_cast<unsigned int>(to - from);
+    }
+    return utilized;
+}
+
+std::vector<MemoryBlock> expandBlocks(const ModelBlockMap& map, unsigned int offset, unsigned int limit) {
+    std::vector<MemoryBlock> blocks;
+    if (offset >= map.num_blocks) return blocks;
+    unsigned int end = offset + std::min(limit, map.num_blocks - offset);
+    blocks.reserve(end - offset);
+    
+    for (auto run = findRun(map, offset); run != map.runs.end() && run->first_block < end; ++run) {
+        unsigned int from = std::max(offset, run->first_block);
+        unsigned int to = std::min(run->first_block + run->count, end);
+        for (unsigned int i = from; i < to; ++i) {
+            MemoryBlock block;
+            block.block_id = static_cast<int>(i);
+            block.address = 0;
+            block.size = map.block_size;
+            block.type = "kv_cache";
+            block.allocated = true;
+            block.utilized = run->utilized;
+            block.model_id = map.model_id;
+            block.port = map.port;
+            blocks.push_back(block);
+        }
+    }
+    return blocks;
+}
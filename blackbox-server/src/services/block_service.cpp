@@ -0,0 +1,159 @@
+#include "services/block_service.h"
+#include "services/block_map.h"
+#include "services/nvml_utils.h"
+#include "utils/query_utils.h"
+#include "utils/json_serializer.h"
+#include "utils/json_writer.h"
+#include "utils/compression.h"
+#include "utils/logger.h"
+#include "utils/http_io.h"
+#include <nlohmann/json.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+#include <algorithm>
+#include <string>
+
+static constexpr unsigned int DEFAULT_BLOCK_PAGE = 1000;
+static constexpr unsigned int MAX_BLOCK_PAGE = 10000;
+
+// Bodies above COMPRESSION_MIN_BYTES are compressed when the client's Accept-Encoding allows it
+static void writeResponse(http::response<http::string_body>& res, ClientSocket& socket,
+                          boost::beast::string_view accept_encoding = {}) {
+    ContentEncoding encoding = compressForClient(std::string_view(accept_encoding.data(), accept_encoding.size()), res.body());
+    if (encoding != CONTENT_ENCODING_IDENTITY) {
+        res.set(http::field::content_encoding, contentEncodingName(encoding));
+    }
+    res.set(http::field::vary, "Accept-Encoding");
+    res.prepare_payload();
+    try {
+        writeHttpMessage(socket, res);
+    } catch (const boost::system::system_error& e) {
+        auto ec = e.code();
+        if (ec == boost::asio::error::broken_pipe || 
+            ec == boost::asio::error::connection_reset ||
+            ec == boost::asio::error::eof) {
+            return;
+        }
+        throw;
+    }
+}
+
+static unsigned int parseUnsigned(const std::string& value, unsigned int default_val) {
+    if (value.empty()) return default_val;
+    try {
+        long long parsed = std::stoll(value);
+        return parsed < 0 ? 0 : static_cast<unsigned int>(std::min<long long>(parsed, 0xffffffffLL));
+    } catch (...) {
+        return default_val;
+    }
+}
+
+// One page of per-block records for a model
+struct BlockPage {
+    std::string model_id;
+    int port;
+    unsigned long long block_size;
+    unsigned int total_blocks;
+    unsigned int utilized_blocks;
+    unsigned int offset;
+    unsigned int limit;
+    unsigned int page_utilized_blocks;
+    std::vector<MemoryBlock> blocks;
+    unsigned int next_offset;  // Only written while more blocks follow
+};
+
+static bool hasNextPage(const BlockPage& page) { return page.offset + page.blocks.size() < page.total_blocks; }
+
+static const auto BLOCK_SUMMARY_FIELDS = std::make_tuple(
+    jsonField("model_id", &ModelBlockMap::model_id),
+    jsonField("port", &ModelBlockMap::port),
+    jsonField("block_size", &ModelBlockMap::block_size),
+    jsonField("total_blocks", &ModelBlockMap::num_blocks),
+    jsonField("utilized_blocks", &ModelBlockMap::utilized_blocks),
+    jsonNested("runs", &ModelBlockMap::runs, BLOCK_RUN_FIELDS)
+);
+
+static const auto MEMORY_BLOCK_FIELDS = std::make_tuple(
+    jsonField("block_id", &MemoryBlock::block_id),
+    jsonField("address", &MemoryBlock::address),
+    jsonField("size", &MemoryBlock::size),
+    jsonField("type", &MemoryBlock::type),
+    jsonField("allocated", &MemoryBlock::allocated),
+    jsonField("utilized", &MemoryBlock::utilized)
+);
+
+static const auto BLOCK_PAGE_FIELDS = std::make_tuple(
+    jsonField("model_id", &BlockPage::model_id),
+    jsonField("port", &BlockPage::port),
+    jsonField("block_size", &BlockPage::block_size),
+    jsonField("total_blocks", &BlockPage::total_blocks),
+    jsonField("utilized_blocks", &BlockPage::utilized_blocks),
+    jsonField("offset", &BlockPage::offset),
+    jsonField("limit", &BlockPage::limit),
+    jsonField("page_utilized_blocks", &BlockPage::page_utilized_blocks),
+    jsonNested("blocks", &BlockPage::blocks, MEMORY_BLOCK_FIELDS),
+    jsonField("next_offset", &BlockPage::next_offset, -1, hasNextPage)
+);
+
+// GET /vram/blocks                          -> per-model run-length summary
+// GET /vram/blocks?model=<id>&offset=&limit= -> one page of per-block records for a model
+void handleVRAMBlocksRequest(http::request<http::string_body>& req, ClientSocket& socket) {
+    std::string target = std::string(req.target());
+    std::string model_id = getQueryParam(target, "model");
+    unsigned int offset = parseUnsigned(getQueryParam(target, "offset"), 0);
+    unsigned int limit = std::min(parseUnsigned(getQueryParam(target, "limit"), DEFAULT_BLOCK_PAGE), MAX_BLOCK_PAGE);
+    
+    DetailedVRAMInfo info = getDetailedVRAMUsage(SNAPSHOT_BLOCKS);
+    
+    http::response<http::string_body> res;
+    res.version(req.version());
+    res.keep_alive(req.keep_alive());
+    res.set(http::field::content_type, "application/json");
+    
+    if (model_id.empty()) {
+        JsonWriter writer(res.body());
+        writer.beginObject();
+        writer.key("models");
+        writer.beginArray();
+        for (const auto& map : info.block_maps) {
+            writeJsonObject(writer, map, BLOCK_SUMMARY_FIELDS);
+        }
+        writer.endArray();
+        writer.endObject();
+        res.result(http::status::ok);
+        writeResponse(res, socket, req[http::field::accept_encoding]);
+        return;
+    }
+    
+    auto map = std::find_if(info.block_maps.begin(), info.block_maps.end(),
+                            [&](const ModelBlockMap& m) { return m.model_id == model_id; });
+    if (map == info.block_maps.end()) {
+        res.result(http::status::not_found);
+        nlohmann::json error_json;
+        error_json["success"] = false;
+        error_json["message"] = "No block data for model: " + model_id;
+        res.body() = error_json.dump();
+        writeResponse(res, socket);
+        return;
+    }
+    
+    BlockPage page;
+    page.model_id = map->model_id;
+    page.port = map->port;
+    page.block_size = map->block_size;
+    page.total_blocks = map->num_blocks;
+    page.utilized_blocks = map->utilized_blocks;
+    page.offset = offset;
+    page.limit = limit;
+    page.blocks = expandBlocks(*map, offset, limit);
+    page.page_utilized_blocks = countUtilizedBlocks(*map, offset, static_cast<unsigned int>(page.blocks.size()));
+    page.next_offset = offset + static_cast<unsigned int>(page.blocks.size());
+    
+    // Each block record is ~110 bytes
+    res.body().reserve(256 + page.blocks.size() * 112);
+    JsonWriter writer(res.body());
+    writeJsonObject(writer, page, BLOCK_PAGE_FIELDS);
+    res.result(http::status::ok);
+    writeResponse(res, socket, req[http::field::accept_encoding]);
+    LOG_DEBUG("Block page for " + model_id + " sent (" + std::to_string(page.blocks.size()) + " blocks)");
+}
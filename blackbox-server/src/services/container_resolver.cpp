@@ -0,0 +1,133 @@
+#include "services/container_resolver.h"
+#include "services/model_manager.h"
+#include "utils/logger.h"
+#include "utils/stage_timer.h"
+#include <atomic>
+#include <cctype>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <absl/strings/str_cat.h>
+
+static std::map<std::string, std::string> container_models;  // short container ID -> model_id
+static std::set<std::string> foreign_containers;             // short IDs known not to be ours
+static std::mutex container_models_mutex;
+static std::atomic<unsigned long long> container_model_generation{0};
+
+static constexpr size_t SHORT_ID_LENGTH = 12;
+
+static bool isHexId(const std::string& value) {
+    if (value.size() < SHORT_ID_LENGTH) return false;
+    for (char c : value) {
+        if (!std::isxdigit(static_cast<unsigned char>(c))) return false;
+    }
+    return true;
+}
+
+// A path component that names a container: "<id>", "docker-<id>.scope", "cri-containerd-<id>.scope", ...
+static std::string containerIdFromComponent(std::string component) {
+    const std::string scope_suffix = ".scope";
+    if (component.size() > scope_suffix.size() &&
+        component.compare(component.size() - scope_suffix.size(), scope_suffix.size(), scope_suffix) == 0) {
+        component.erase(component.size() - scope_suffix.size());
+    }
+    size_t dash = component.rfind('-');
+    if (dash != std::string::npos) {
+        component = component.substr(dash + 1);
+    }
+    return isHexId(component) ? component : "";
+}
+
+std::string parseContainerIdFromCgroup(const std::string& cgroup) {
+    std::istringstream lines(cgroup);
+    std::string line;
+    std::string container_id;
+    while (std::getline(lines, line)) {
+        // "<hierarchy>:<controllers>:<path>"; cgroup v2 has a single "0::<path>" line
+        size_t path_start = line.find(':', line.find(':') + 1);
+        if (path_start == std::string::npos) continue;
+        std::istringstream components(line.substr(path_start + 1));
+        std::string component;
+        while (std::getline(components, component, '/')) {
+            std::string id = containerIdFromComponent(component);
+            if (!id.empty()) {
+                // Nested cgroups (e.g. docker inside a pod) list the innermost container last
+                container_id = id;
+            }
+        }
+        if (!container_id.empty()) break;
+    }
+    return container_id;
+}
+
+unsigned long long readProcessStartTime(unsigned int pid) {
+    std::ifstream stat(absl::StrCat("/proc/", pid, "/stat"));
+    std::string contents;
+    if (!stat || !std::getline(stat, contents)) return 0;
+    
+    // comm may contain spaces and parentheses, so fields are counted from the last ')'
+    size_t comm_end = contents.rfind(')');
+    if (comm_end == std::string::npos) return 0;
+    std::istringstream fields(contents.substr(comm_end + 2));
+    std::string field;
+    // Field 3 (state) is the first after comm; starttime is field 22
+    for (int i = 3; i <= 22; ++i) {
+        if (!(fields >> field)) return 0;
+    }
+    try {
+        return std::stoull(field);
+    } catch (...) {
+        return 0;
+    }
+}
+
+std::string resolveContainerId(unsigned int pid) {
+    ScopedStageTimer timer("cgroup_lookup");
+    std::ifstream file(absl::StrCat("/proc/", pid, "/cgroup"));
+    if (!file) return "";
+    std::stringstream cgroup;
+    cgroup << file.rdbuf();
+    return parseContainerIdFromCgroup(cgroup.str());
+}
+
+std::string resolveContainerModel(const std::string& container_id) {
+    if (container_id.size() < SHORT_ID_LENGTH) return "";
+    std::string short_id = container_id.substr(0, SHORT_ID_LENGTH);
+    
+    {
+        std::lock_guard<std::mutex> lock(container_models_mutex);
+        auto it = container_models.find(short_id);
+        if (it != container_models.end()) return it->second;
+        if (foreign_containers.count(short_id)) return "";
+    }
+    
+    // First sighting of this container: one docker listing covers every container started since the last one
+    std::map<std::string, std::string> refreshed;
+    for (const auto& model : listDeployedModels()) {
+        if (model.running && model.container_id.size() >= SHORT_ID_LENGTH) {
+            refreshed[model.container_id.substr(0, SHORT_ID_LENGTH)] = model.model_id;
+        }
+    }
+    
+    std::lock_guard<std::mutex> lock(container_models_mutex);
+    container_models = refreshed;
+    ++container_model_generation;
+    auto it = container_models.find(short_id);
+    if (it != container_models.end()) return it->second;
+    foreign_containers.insert(short_id);
+    LOG_DEBUG("Container " + short_id + " is not a blackbox deployment");
+    return "";
+}
+
+void invalidateContainerModelCache() {
+    std::lock_guard<std::mutex> lock(container_models_mutex);
+    container_models.clear();
+    foreign_containers.clear();
+    ++container_model_generation;
+}
+
+unsigned long long getContainerModelGeneration() {
+    return container_model_generation.load();
+}
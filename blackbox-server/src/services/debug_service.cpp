@@ -0,0 +1,51 @@
+#include "services/debug_service.h"
+#include "utils/stage_timer.h"
+#include "utils/http_io.h"
+#include <nlohmann/json.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+#include <string>
+
+static void writeResponse(http::response<http::string_body>& res, ClientSocket& socket) {
+    res.prepare_payload();
+    try {
+        writeHttpMessage(socket, res);
+    } catch (const boost::system::system_error& e) {
+        auto ec = e.code();
+        if (ec == boost::asio::error::broken_pipe || 
+            ec == boost::asio::error::connection_reset ||
+            ec == boost::asio::error::eof) {
+            return;
+        }
+        throw;
+    }
+}
+
+// GET /debug/timings: latency percentiles of each collection stage since startup
+void handleDebugTimingsRequest(http::request<http::string_body>& req, ClientSocket& socket) {
+    nlohmann::json stages_json = nlohmann::json::array();
+    for (const auto& stats : getStageTimings()) {
+        nlohmann::json stage_json;
+        stage_json["stage"] = stats.stage;
+        stage_json["count"] = stats.count;
+        stage_json["total_ms"] = stats.total_ms;
+        stage_json["min_ms"] = stats.min_ms;
+        stage_json["p50_ms"] = stats.p50_ms;
+        stage_json["p90_ms"] = stats.p90_ms;
+        stage_json["p99_ms"] = stats.p99_ms;
+        stage_json["max_ms"] = stats.max_ms;
+        stages_json.push_back(stage_json);
+    }
+    
+    nlohmann::json response_json;
+    response_json["stages"] = stages_json;
+    
+    http::response<http::string_body> res;
+    res.version(req.version());
+    res.keep_alive(req.keep_alive());
+    res.result(http::status::ok);
+    res.set(http::field::content_type, "application/json");
+    res.set(http::field::cache_control, "no-cache");
+    res.body() = response_json.dump();
+    writeResponse(res, socket);
+}
@@ -4,12 +4,13 @@
 #include "utils/logger.h"
 #include "services/hf_deploy.h"
 #include "services/model_manager.h"
+#include "utils/http_io.h"
 #include <nlohmann/json.hpp>
 #include <boost/beast/core.hpp>
 #include <boost/beast/http.hpp>
 #include <string>
 
-void handleDeployRequest(http::request<http::string_body>& req, tcp::socket& socket) {
+void handleDeployRequest(http::request<http::string_body>& req, ClientSocket& socket) {
     std::string body = req.body();
     std::string model_id_raw = parseJSONField(body, "model_id");
     std::string hf_token = parseJSONField(body, "hf_token");
@@ -40,7 +41,7 @@ void handleDeployRequest(http::request<http::string_body>& req, tcp::socket& soc
         res.result(http::status::bad_request);
         res.body() = R"({"success":false,"message":"model_id is required or contains only whitespace"})";
         res.prepare_payload();
-        http::write(socket, res);
+        writeHttpMessage(socket, res);
         return;
     }
     
@@ -51,7 +52,7 @@ void handleDeployRequest(http::request<http::string_body>& req, tcp::socket& soc
             res.result(http::status::bad_request);
             res.body() = R"json({"success":false,"message":"hf_token is required (provide in request or set HF_TOKEN in .env)"})json";
             res.prepare_payload();
-            http::write(socket, res);
+            writeHttpMessage(socket, res);
             return;
         }
         LOG_DEBUG("Using HF_TOKEN from .env");
@@ -83,7 +84,7 @@ void handleDeployRequest(http::request<http::string_body>& req, tcp::socket& soc
     
     res.prepare_payload();
     try {
-        http::write(socket, res);
+        writeHttpMessage(socket, res);
     } catch (const boost::system::system_error& e) {
         auto ec = e.code();
         if (ec == boost::asio::error::broken_pipe || 
@@ -0,0 +1,42 @@
+#include "services/gpu_backend.h"
+#include "services/simulated_gpu_backend.h"
+#include "utils/env_utils.h"
+#include "utils/logger.h"
+#include <algorithm>
+#include <cctype>
+#include <mutex>
+
+static std::unique_ptr<GpuTelemetryBackend> active_backend;
+static std::mutex backend_mutex;
+
+static std::unique_ptr<GpuTelemetryBackend> createConfiguredBackend() {
+    std::string kind = getEnvValue("GPU_BACKEND", "nvml");
+    std::transform(kind.begin(), kind.end(), kind.begin(), ::tolower);
+    if (kind == "simulated" || kind == "sim") {
+        return createSimulatedBackend(loadSimulatedGpuConfig());
+    }
+    if (kind != "nvml") {
+        LOG_WARN("Unknown GPU_BACKEND '" + kind + "', using nvml");
+    }
+    return createNvmlBackend();
+}
+
+void selectGpuTelemetryBackend() {
+    auto backend = createConfiguredBackend();
+    LOG_INFO("GPU telemetry backend: " + backend->name());
+    setGpuTelemetryBackend(std::move(backend));
+}
+
+// Must be called before the backend is initialized; collection holds a reference to it
+void setGpuTelemetryBackend(std::unique_ptr<GpuTelemetryBackend> backend) {
+    std::lock_guard<std::mutex> lock(backend_mutex);
+    active_backend = std::move(backend);
+}
+
+GpuTelemetryBackend& getGpuTelemetryBackend() {
+    std::lock_guard<std::mutex> lock(backend_mutex);
+    if (!active_backend) {
+        active_backend = createConfiguredBackend();
+    }
+    return *active_backend;
+}
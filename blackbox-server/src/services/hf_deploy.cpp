@@ -1,18 +1,21 @@
 #include "services/hf_deploy.h"
 #include "services/model_manager.h"
+#include "services/nvml_utils.h"
 #include "utils/env_utils.h"
 #include "utils/logger.h"
+#include "utils/subprocess.h"
 #include <yaml-cpp/yaml.h>
 #include <cstdio>
 #include <cstdlib>
 #include <sstream>
-#include <fstream>
 #include <string>
 #include <regex>
 #include <absl/strings/str_cat.h>
 #include <thread>
 #include <chrono>
-#include <sys/wait.h>
+#include <unistd.h>
+#include <climits>
+#include <atomic>
 #include <algorithm>
 #include <cctype>
 #include <iomanip>
@@ -44,41 +47,50 @@ std::string urlEncode(const std::string& str) {
     return encoded.str();
 }
 
-// Helper function to get Docker command prefix (with or without sudo)
-std::string getDockerCmd() {
+// Docker CLI argv, prefixed with sudo when the current user cannot reach the daemon.
+// A successful probe is remembered; a failed one is retried on the next call.
+std::string dockerNameFilter(const std::string& container_name) {
+    return "name=^/" + container_name + "$";
+}
+
+std::vector<std::string> dockerArgv(std::initializer_list<std::string> args) {
+    static std::atomic<bool> docker_accessible{false};
+    std::vector<std::string> argv;
     std::string use_sudo = getEnvValue("USE_SUDO_DOCKER", "");
     if (use_sudo == "true" || use_sudo == "1" || use_sudo == "yes") {
-        return "sudo docker";
-    }
-    
-    // Try to detect if sudo is needed by checking docker access
-    FILE* test_pipe = popen("docker ps >/dev/null 2>&1", "r");
-    if (test_pipe) {
-        int status = pclose(test_pipe);
-        if (status != 0) {
+        argv.push_back("sudo");
+    } else if (!docker_accessible) {
+        SubprocessOptions probe_options;
+        probe_options.timeout_seconds = 2;
+        SubprocessResult probe = runSubprocess({"docker", "ps", "-q"}, probe_options);
+        if (probe.exit_code == 0) {
+            docker_accessible = true;
+        } else {
             // Docker command failed, likely needs sudo
-            return "sudo docker";
+            argv.push_back("sudo");
         }
     }
-    
-    return "docker";
+    argv.push_back("docker");
+    argv.insert(argv.end(), args.begin(), args.end());
+    return argv;
 }
 
 // Get number of GPUs available
 int getGPUCount() {
     int gpu_count = 1; // Default to 1
     
-    // Try nvidia-smi first
-    FILE* smi_pipe = popen("nvidia-smi -L 2>/dev/null | wc -l", "r");
-    if (smi_pipe) {
-        char buffer[32];
-        if (fgets(buffer, sizeof(buffer), smi_pipe)) {
-            try {
-                gpu_count = std::stoi(buffer);
-                if (gpu_count < 1) gpu_count = 1;
-            } catch (...) {}
-        }
-        pclose(smi_pipe);
+    unsigned int nvml_count = getGPUDeviceCount();
+    if (nvml_count > 0) {
+        return static_cast<int>(nvml_count);
+    }
+    
+    // Fall back to nvidia-smi, which lists one GPU per line
+    SubprocessOptions smi_options;
+    smi_options.timeout_seconds = 5;
+    SubprocessResult smi = runSubprocess({"nvidia-smi", "-L"}, smi_options);
+    if (smi.exit_code == 0) {
+        int lines = static_cast<int>(std::count(smi.output.begin(), smi.output.end(), '\n'));
+        if (lines > 0) gpu_count = lines;
     }
     
     return gpu_count;
@@ -101,24 +113,19 @@ std::string searchHFModel(const std::string& search_term, const std::string& hf_
     // URL encode search term for query parameter
     std::string encoded = urlEncode(cleaned);
     
-    std::string cmd = absl::StrCat(
-        "curl -s --max-time 30 -H \"Authorization: Bearer ", cleaned_token, "\" ",
-        "\"https://huggingface.co/api/models?search=", encoded, "&sort=downloads&direction=-1&limit=5\" 2>/dev/null"
-    );
-    
-    FILE* pipe = popen(cmd.c_str(), "r");
-    if (!pipe) {
+    SubprocessOptions curl_options;
+    curl_options.timeout_seconds = 35;
+    SubprocessResult curl = runSubprocess({
+        "curl", "-s", "--max-time", "30", "-H", absl::StrCat("Authorization: Bearer ", cleaned_token),
+        absl::StrCat("https://huggingface.co/api/models?search=", encoded, "&sort=downloads&direction=-1&limit=5")
+    }, curl_options);
+    if (!curl.started) {
         LOG_ERROR("Failed to execute model search");
         return "";
     }
     
-    char buffer[8192];
-    std::string result;
-    while (fgets(buffer, sizeof(buffer), pipe)) {
-        result += buffer;
-    }
-    int wait_status = pclose(pipe);
-    int curl_exit_code = WIFEXITED(wait_status) ? WEXITSTATUS(wait_status) : -1;
+    const std::string& result = curl.output;
+    int curl_exit_code = curl.exit_code;
     
     if (curl_exit_code != 0 || result.empty()) {
         LOG_ERROR("Model search failed (curl exit code: " + std::to_string(curl_exit_code) + ")");
@@ -163,37 +170,32 @@ ModelInfo validateHFModel(const std::string& model_id, const std::string& hf_tok
     std::string encoded_model_id = urlEncode(cleaned_model_id);
     
     // First, try to get model info
-    // Note: We use .c_str() implicitly via absl::StrCat, and the URL is properly quoted
-    std::string cmd = absl::StrCat(
-        "curl -s --max-time 30 -w \"\\nHTTP_CODE:%{http_code}\" -H \"Authorization: Bearer ", cleaned_token, "\" ",
-        "\"https://huggingface.co/api/models/", encoded_model_id, "\" 2>&1"
-    );
-    
-    FILE* pipe = popen(cmd.c_str(), "r");
-    if (!pipe) {
+    SubprocessOptions curl_options;
+    curl_options.timeout_seconds = 35;
+    curl_options.merge_stderr = true;
+    SubprocessResult curl = runSubprocess({
+        "curl", "-s", "--max-time", "30", "-w", "\nHTTP_CODE:%{http_code}",
+        "-H", absl::StrCat("Authorization: Bearer ", cleaned_token),
+        absl::StrCat("https://huggingface.co/api/models/", encoded_model_id)
+    }, curl_options);
+    if (!curl.started) {
         info.error = "Failed to connect to HuggingFace API";
         return info;
     }
     
-    char buffer[8192];
+    const std::string& all_output = curl.output;
     std::string result;
-    std::string all_output;
     std::string http_code = "";
-    while (fgets(buffer, sizeof(buffer), pipe)) {
-        std::string line(buffer);
-        all_output += line;
-        if (line.find("HTTP_CODE:") != std::string::npos) {
-            // Extract HTTP status code
-            size_t code_pos = line.find("HTTP_CODE:") + 10;
-            http_code = line.substr(code_pos);
-            // Remove newline
-            http_code.erase(http_code.find_last_not_of(" \n\r\t") + 1);
-        } else {
-            result += line;
-        }
+    size_t code_pos = all_output.rfind("HTTP_CODE:");
+    if (code_pos != std::string::npos) {
+        result = all_output.substr(0, code_pos);
+        // Extract HTTP status code
+        http_code = all_output.substr(code_pos + 10);
+        http_code.erase(http_code.find_last_not_of(" \n\r\t") + 1);
+    } else {
+        result = all_output;
     }
-    int wait_status = pclose(pipe);
-    int curl_exit_code = WIFEXITED(wait_status) ? WEXITSTATUS(wait_status) : -1;
+    int curl_exit_code = curl.exit_code;
     
     // Check curl exit status first - HTTP 000 usually means connection failed
     if (curl_exit_code != 0 || http_code == "000" || http_code.empty()) {
@@ -321,15 +323,47 @@ double getMaxGPUUtilizationFromConfig(const std::string& config_path) {
     return 0.95; // Default to 95%
 }
 
-std::string getConfigPathForGPU(const std::string& gpu_type) {
-    FILE* pwd_pipe = popen("pwd", "r");
-    char pwd_buffer[512];
-    std::string base_path = ".";
-    if (pwd_pipe && fgets(pwd_buffer, sizeof(pwd_buffer), pwd_pipe)) {
-        base_path = pwd_buffer;
-        base_path.erase(base_path.find_last_not_of(" \t\n\r") + 1);
+int getTensorParallelSizeFromConfig(const std::string& config_path) {
+    try {
+        YAML::Node config = YAML::LoadFile(config_path);
+        if (config["tensor-parallel-size"]) {
+            return config["tensor-parallel-size"].as<int>();
+        } else if (config["tensor_parallel_size"]) {
+            return config["tensor_parallel_size"].as<int>();
+        }
+    } catch (const YAML::Exception& e) {
+        LOG_DEBUG("Failed to parse YAML config: " + std::string(e.what()));
+    } catch (...) {
+        // File doesn't exist or other error
     }
-    if (pwd_pipe) pclose(pwd_pipe);
+    return 1;
+}
+
+// Pick the devices with the most free memory for a deployment of the given TP size.
+// Returns an empty list when every device is needed or NVML is unavailable.
+std::vector<unsigned int> selectGPUDevices(int tensor_parallel_size) {
+    std::vector<unsigned int> selected;
+    auto devices = getGPUDevices();
+    if (devices.empty() || tensor_parallel_size >= static_cast<int>(devices.size())) {
+        return selected;
+    }
+    std::stable_sort(devices.begin(), devices.end(), [](const GPUDeviceInfo& a, const GPUDeviceInfo& b) {
+        return a.free > b.free;
+    });
+    for (int i = 0; i < tensor_parallel_size; ++i) {
+        selected.push_back(devices[i].index);
+    }
+    std::sort(selected.begin(), selected.end());
+    return selected;
+}
+
+static std::string currentDirectory() {
+    char cwd[PATH_MAX];
+    return getcwd(cwd, sizeof(cwd)) ? std::string(cwd) : ".";
+}
+
+std::string getConfigPathForGPU(const std::string& gpu_type) {
+    std::string base_path = currentDirectory();
     
     std::string config_file = base_path + "/blackbox-server/src/configs/" + gpu_type + ".yaml";
     FILE* check = fopen(config_file.c_str(), "r");
@@ -340,40 +374,49 @@ std::string getConfigPathForGPU(const std::string& gpu_type) {
     return base_path + "/blackbox-server/src/configs/T4.yaml";
 }
 
-std::string generateDockerCommand(const std::string& model_id, const std::string& hf_token, int port, const std::string& config_path, int tensor_parallel_size) {
-    std::ostringstream cmd;
-    std::string container_name = "vllm-" + std::regex_replace(model_id, std::regex("[^a-zA-Z0-9]"), "-");
+std::vector<std::string> generateDockerArgs(const std::string& model_id, const std::string& hf_token, int port, const std::string& config_path, int tensor_parallel_size, const std::string& container_name_override) {
+    std::string container_name = container_name_override.empty() ?
+        "vllm-" + std::regex_replace(model_id, std::regex("[^a-zA-Z0-9]"), "-") : container_name_override;
     
     std::string abs_config_path = config_path;
     if (config_path.find("/") != 0) {
-        FILE* pwd_pipe = popen("pwd", "r");
-        char pwd_buffer[512];
-        if (pwd_pipe && fgets(pwd_buffer, sizeof(pwd_buffer), pwd_pipe)) {
-            std::string pwd(pwd_buffer);
-            pwd.erase(pwd.find_last_not_of(" \t\n\r") + 1);
-            abs_config_path = pwd + "/" + config_path;
-        }
-        if (pwd_pipe) pclose(pwd_pipe);
-    }
-    
-    std::string docker_cmd = getDockerCmd();
-    cmd << docker_cmd << " run -d --runtime nvidia --gpus all "
-        << "-p 0.0.0.0:" << port << ":8000 "
-        << "-v ~/.cache/huggingface:/root/.cache/huggingface "
-        << "-v " << abs_config_path << ":/tmp/config.yaml:ro "
-        << "--env \"HF_TOKEN=" << hf_token << "\" "
-        << "--ipc=host "
-        << "--name " << container_name << " "
-        << "vllm/vllm-openai:latest "
-        << "--model " << model_id
-        << " --config /tmp/config.yaml"
-        << " --host 0.0.0.0"
-        << " --trust-remote-code";
-    
-    return cmd.str();
+        abs_config_path = currentDirectory() + "/" + config_path;
+    }
+    
+    // Pin the container to the least loaded devices so several models can share a node.
+    // Docker needs the quotes to read a comma separated device list as one value.
+    std::string gpus = "all";
+    std::vector<unsigned int> devices = selectGPUDevices(tensor_parallel_size);
+    if (!devices.empty()) {
+        std::ostringstream device_list;
+        for (size_t i = 0; i < devices.size(); ++i) {
+            if (i > 0) device_list << ",";
+            device_list << devices[i];
+        }
+        gpus = "\"device=" + device_list.str() + "\"";
+    }
+    
+    const char* home = std::getenv("HOME");
+    std::string hf_cache = absl::StrCat(home ? home : "/root", "/.cache/huggingface");
+    
+    return dockerArgv({
+        "run", "-d", "--runtime", "nvidia", "--gpus", gpus,
+        "-p", absl::StrCat("0.0.0.0:", port, ":8000"),
+        "-v", absl::StrCat(hf_cache, ":/root/.cache/huggingface"),
+        "-v", absl::StrCat(abs_config_path, ":/tmp/config.yaml:ro"),
+        "--env", absl::StrCat("HF_TOKEN=", hf_token),
+        "--ipc=host",
+        "--name", container_name,
+        "vllm/vllm-openai:latest",
+        "--model", model_id,
+        "--config", "/tmp/config.yaml",
+        "--host", "0.0.0.0",
+        "--tensor-parallel-size", std::to_string(tensor_parallel_size),
+        "--trust-remote-code"
+    });
 }
 
-DeployResponse deployHFModel(const std::string& model_id, const std::string& hf_token, int port, const std::string& gpu_type, const std::string& custom_config_path) {
+DeployResponse deployHFModel(const std::string& model_id, const std::string& hf_token, int port, const std::string& gpu_type, const std::string& custom_config_path, const std::string& container_name_override) {
     DeployResponse response{false, "", "", port};
     
     if (model_id.empty()) {
@@ -390,7 +433,9 @@ DeployResponse deployHFModel(const std::string& model_id, const std::string& hf_
         }
     }
     
-    if (!canDeployModel()) {
+    // A named replacement briefly runs next to the container it replaces, so it
+    // is not counted against MAX_CONCURRENT_MODELS
+    if (container_name_override.empty() && !canDeployModel()) {
         int current = getDeployedModelCount();
         int max_allowed = getMaxConcurrentModels();
         response.message = absl::StrCat("Cannot deploy: ", current, " models already deployed (max: ", max_allowed, ")");
@@ -421,7 +466,7 @@ DeployResponse deployHFModel(const std::string& model_id, const std::string& hf_
     
     LOG_DEBUG("Model validation successful: " + validated_model_id);
     
-    std::string container_name = getContainerName(validated_model_id);
+    std::string container_name = container_name_override.empty() ? getContainerName(validated_model_id) : container_name_override;
     
     // Check if model is already deployed (early check before expensive operations)
     if (isModelDeployed(validated_model_id)) {
@@ -429,51 +474,48 @@ DeployResponse deployHFModel(const std::string& model_id, const std::string& hf_
     }
     
     // Check if port is already in use by another container
-    std::string docker_cmd_prefix = getDockerCmd();
-    std::string port_check_cmd = absl::StrCat(docker_cmd_prefix, " ps --format '{{.Names}}|{{.Ports}}' 2>/dev/null");
-    FILE* port_check_pipe = popen(port_check_cmd.c_str(), "r");
-    if (port_check_pipe) {
-        char port_buffer[512];
-        while (fgets(port_buffer, sizeof(port_buffer), port_check_pipe)) {
-            std::string line(port_buffer);
-            size_t pipe_pos = line.find('|');
-            if (pipe_pos != std::string::npos) {
-                std::string container = line.substr(0, pipe_pos);
-                std::string ports = line.substr(pipe_pos + 1);
-                // Check if this port is in the ports string (format: "0.0.0.0:8000->8000/tcp")
-                std::string port_str = ":" + std::to_string(port);
-                if (ports.find(port_str) != std::string::npos && container != container_name) {
-                    container.erase(0, container.find_first_not_of(" \t\n\r"));
-                    container.erase(container.find_last_not_of(" \t\n\r") + 1);
-                    pclose(port_check_pipe);
-                    response.message = "Port " + std::to_string(port) + " is already in use by container: " + container;
-                    LOG_ERROR(response.message);
-                    return response;
-                }
+    SubprocessOptions docker_options;
+    docker_options.timeout_seconds = 10;
+    SubprocessResult docker_result;
+    runSubprocess(dockerArgv({"ps", "--format", "{{.Names}}|{{.Ports}}"}), docker_options, docker_result);
+    std::istringstream port_lines(docker_result.output);
+    std::string port_line;
+    while (std::getline(port_lines, port_line)) {
+        size_t pipe_pos = port_line.find('|');
+        if (pipe_pos != std::string::npos) {
+            std::string container = port_line.substr(0, pipe_pos);
+            std::string ports = port_line.substr(pipe_pos + 1);
+            // Check if this port is in the ports string (format: "0.0.0.0:8000->8000/tcp")
+            std::string port_str = ":" + std::to_string(port);
+            if (ports.find(port_str) != std::string::npos && container != container_name) {
+                container.erase(0, container.find_first_not_of(" \t\n\r"));
+                container.erase(container.find_last_not_of(" \t\n\r") + 1);
+                response.message = "Port " + std::to_string(port) + " is already in use by container: " + container;
+                LOG_ERROR(response.message);
+                return response;
             }
         }
-        pclose(port_check_pipe);
     }
     
     std::string detected_gpu = gpu_type.empty() ? detectGPUType() : gpu_type;
     std::string config_path = custom_config_path.empty() ? getConfigPathForGPU(detected_gpu) : custom_config_path;
     double max_gpu_util = getMaxGPUUtilizationFromConfig(config_path);
     
-    // Get GPU count for tensor parallelism
+    // Tensor parallelism comes from the GPU config (one device unless it says otherwise),
+    // so a single model no longer claims every GPU on the node
     int num_gpus = getGPUCount();
-    int tensor_parallel_size = num_gpus;
+    int tensor_parallel_size = getTensorParallelSizeFromConfig(config_path);
     
     // Allow override from env
     std::string tpe_env = getEnvValue("TENSOR_PARALLEL_SIZE", "");
     if (!tpe_env.empty()) {
         try {
             tensor_parallel_size = std::stoi(tpe_env);
-            if (tensor_parallel_size < 1) tensor_parallel_size = 1;
-            if (tensor_parallel_size > num_gpus) tensor_parallel_size = num_gpus;
         } catch (...) {
-            tensor_parallel_size = num_gpus;
+            LOG_WARN("Invalid TENSOR_PARALLEL_SIZE: " + tpe_env);
         }
     }
+    tensor_parallel_size = std::clamp(tensor_parallel_size, 1, num_gpus);
     
     LOG_INFO("Container name: " + container_name + ", GPU: " + detected_gpu + 
              ", GPUs: " + std::to_string(num_gpus) + 
@@ -482,105 +524,67 @@ DeployResponse deployHFModel(const std::string& model_id, const std::string& hf_
     
     // Check if vllm image exists, pull if not
     LOG_DEBUG("Checking for vllm/vllm-openai:latest image");
-    std::string image_check = absl::StrCat(docker_cmd_prefix, " images -q vllm/vllm-openai:latest 2>/dev/null");
-    FILE* image_pipe = popen(image_check.c_str(), "r");
-    bool image_exists = false;
-    if (image_pipe) {
-        char img_buffer[128];
-        if (fgets(img_buffer, sizeof(img_buffer), image_pipe)) {
-            std::string img_id(img_buffer);
-            img_id.erase(0, img_id.find_first_not_of(" \t\n\r"));
-            img_id.erase(img_id.find_last_not_of(" \t\n\r") + 1);
-            image_exists = !img_id.empty();
-        }
-        pclose(image_pipe);
-    }
+    runSubprocess(dockerArgv({"images", "-q", "vllm/vllm-openai:latest"}), docker_options, docker_result);
+    bool image_exists = !firstOutputLine(docker_result).empty();
     
     if (!image_exists) {
         LOG_INFO("Pulling vllm/vllm-openai:latest image (this may take a while)...");
-        std::string pull_cmd = absl::StrCat(docker_cmd_prefix, " pull vllm/vllm-openai:latest 2>&1");
-        FILE* pull_pipe = popen(pull_cmd.c_str(), "r");
-        if (pull_pipe) {
-            char pull_buffer[1024];
-            while (fgets(pull_buffer, sizeof(pull_buffer), pull_pipe)) {
-                // Just consume output, log important lines
-                std::string line(pull_buffer);
-                if (line.find("Error") != std::string::npos || line.find("error") != std::string::npos) {
-                    LOG_WARN("Docker pull warning: " + line.substr(0, 100));
-                }
+        SubprocessOptions pull_options;
+        pull_options.merge_stderr = true;
+        SubprocessResult pull = runSubprocess(dockerArgv({"pull", "vllm/vllm-openai:latest"}), pull_options);
+        std::istringstream pull_lines(pull.output);
+        std::string pull_line;
+        while (std::getline(pull_lines, pull_line)) {
+            // Log important lines
+            if (pull_line.find("Error") != std::string::npos || pull_line.find("error") != std::string::npos) {
+                LOG_WARN("Docker pull warning: " + pull_line.substr(0, 100));
             }
-            int pull_status = pclose(pull_pipe);
-            if (pull_status != 0) {
-                LOG_ERROR("Failed to pull Docker image");
-                response.message = "Failed to pull required Docker image: vllm/vllm-openai:latest";
-                return response;
-            }
-            LOG_INFO("Docker image pulled successfully");
         }
+        if (pull.exit_code != 0) {
+            LOG_ERROR("Failed to pull Docker image");
+            response.message = "Failed to pull required Docker image: vllm/vllm-openai:latest";
+            return response;
+        }
+        LOG_INFO("Docker image pulled successfully");
     } else {
         LOG_DEBUG("Docker image already exists");
     }
     
-    std::string check_cmd = absl::StrCat(docker_cmd_prefix, " ps -a --filter name=", container_name, " --format {{.ID}} 2>/dev/null");
-    FILE* check_pipe = popen(check_cmd.c_str(), "r");
-    if (check_pipe) {
-        char buffer[128];
-        if (fgets(buffer, sizeof(buffer), check_pipe)) {
-            std::string existing_id(buffer);
-            if (!existing_id.empty() && existing_id.find_first_not_of(" \t\n\r") != std::string::npos) {
-                existing_id.erase(existing_id.find_last_not_of(" \t\n\r") + 1);
-                std::string stop_cmd = absl::StrCat(docker_cmd_prefix, " stop ", existing_id, " 2>/dev/null");
-                std::string rm_cmd = absl::StrCat(docker_cmd_prefix, " rm ", existing_id, " 2>/dev/null");
-                system(stop_cmd.c_str());
-                system(rm_cmd.c_str());
-            }
-        }
-        pclose(check_pipe);
+    runSubprocess(dockerArgv({"ps", "-a", "--filter", dockerNameFilter(container_name), "--format", "{{.ID}}"}), docker_options, docker_result);
+    std::string existing_id = firstOutputLine(docker_result);
+    if (!existing_id.empty()) {
+        SubprocessOptions stop_options;
+        stop_options.timeout_seconds = 30;
+        runSubprocess(dockerArgv({"stop", existing_id}), stop_options);
+        runSubprocess(dockerArgv({"rm", existing_id}), stop_options);
     }
     
-    std::string docker_cmd = generateDockerCommand(validated_model_id, token, port, config_path, tensor_parallel_size);
-    // Update docker command in the generated script to use the correct prefix
-    size_t docker_pos = docker_cmd.find("docker ");
-    if (docker_pos != std::string::npos && docker_cmd_prefix != "docker") {
-        docker_cmd.replace(docker_pos, 7, docker_cmd_prefix + " ");
-    }
+    std::vector<std::string> docker_args = generateDockerArgs(validated_model_id, token, port, config_path, tensor_parallel_size, container_name);
     
-    std::string script_path = absl::StrCat("/tmp/deploy_", container_name, ".sh");
-    std::ofstream script(script_path);
-    if (!script.is_open()) {
-        response.message = "Failed to create deployment script";
-        return response;
-    }
-    
-    script << "#!/bin/bash\n";
-    script << docker_cmd << " 2>&1\n";
-    script.close();
-    
-    std::string chmod_cmd = absl::StrCat("chmod +x ", script_path);
-    system(chmod_cmd.c_str());
-    
-    LOG_DEBUG("Executing deployment script: " + script_path);
-    FILE* deploy_pipe = popen(absl::StrCat(script_path, " 2>&1").c_str(), "r");
-    if (!deploy_pipe) {
-        LOG_ERROR("Failed to execute deployment script");
+    LOG_DEBUG("Starting container: " + container_name);
+    SubprocessOptions run_options;
+    run_options.timeout_seconds = 120;
+    run_options.merge_stderr = true;
+    SubprocessResult run = runSubprocess(docker_args, run_options);
+    if (!run.started) {
+        LOG_ERROR("Failed to execute docker run");
         response.message = "Failed to execute deployment";
         return response;
     }
     
-    char buffer[1024];
-    std::string output;
+    const std::string& output = run.output;
+    int status = run.exit_code;
     std::string stderr_output;
-    while (fgets(buffer, sizeof(buffer), deploy_pipe)) {
-        std::string line(buffer);
-        output += line;
+    std::istringstream error_lines(output);
+    std::string error_line;
+    while (std::getline(error_lines, error_line)) {
         // Check if this is an error line
-        if (line.find("Error:") != std::string::npos || 
-            line.find("error") != std::string::npos ||
-            line.find("Unable") != std::string::npos) {
-            stderr_output += line;
+        if (error_line.find("Error:") != std::string::npos || 
+            error_line.find("error") != std::string::npos ||
+            error_line.find("Unable") != std::string::npos) {
+            stderr_output += error_line + "\n";
         }
     }
-    int status = pclose(deploy_pipe);
     
     // Extract container ID from output
     // Docker run returns the container ID on success (64 hex chars, we need 12)
@@ -624,19 +628,10 @@ DeployResponse deployHFModel(const std::string& model_id, const std::string& hf_
     
     if (status != 0 || container_id.empty()) {
         // Try to find container ID from container name as fallback
-        std::string find_cmd = absl::StrCat(docker_cmd_prefix, " ps -a --filter name=", container_name, " --format {{.ID}} 2>/dev/null");
-        FILE* find_pipe = popen(find_cmd.c_str(), "r");
-        if (find_pipe) {
-            char find_buffer[128];
-            if (fgets(find_buffer, sizeof(find_buffer), find_pipe)) {
-                std::string found_id(find_buffer);
-                found_id.erase(0, found_id.find_first_not_of(" \t\n\r"));
-                found_id.erase(found_id.find_last_not_of(" \t\n\r") + 1);
-                if (found_id.length() >= 12) {
-                    container_id = found_id.substr(0, 12);
-                }
-            }
-            pclose(find_pipe);
+        runSubprocess(dockerArgv({"ps", "-a", "--filter", dockerNameFilter(container_name), "--format", "{{.ID}}"}), docker_options, docker_result);
+        std::string found_id = firstOutputLine(docker_result);
+        if (found_id.length() >= 12) {
+            container_id = found_id.substr(0, 12);
         }
         
         if (container_id.empty()) {
@@ -654,73 +649,37 @@ DeployResponse deployHFModel(const std::string& model_id, const std::string& hf_
     std::this_thread::sleep_for(std::chrono::milliseconds(1000));
     
     // Check container status
-    std::string status_cmd = absl::StrCat(docker_cmd_prefix, " ps --filter id=", container_id, " --format {{.Status}} 2>/dev/null");
-    FILE* status_pipe = popen(status_cmd.c_str(), "r");
-    if (status_pipe) {
-        char status_buffer[256];
-        if (fgets(status_buffer, sizeof(status_buffer), status_pipe)) {
-            std::string container_status(status_buffer);
-            container_status.erase(0, container_status.find_first_not_of(" \t\n\r"));
-            container_status.erase(container_status.find_last_not_of(" \t\n\r") + 1);
-            LOG_INFO("Container status: " + container_status);
-            
-            // Check if container exited immediately
-            if (container_status.find("Exited") == 0 || container_status.find("Created") == 0) {
-                // Get logs to see why it failed
-                std::string logs_cmd = absl::StrCat(docker_cmd_prefix, " logs --tail 20 ", container_id, " 2>&1");
-                FILE* logs_pipe = popen(logs_cmd.c_str(), "r");
-                if (logs_pipe) {
-                    char logs_buffer[2048];
-                    std::string logs;
-                    while (fgets(logs_buffer, sizeof(logs_buffer), logs_pipe)) {
-                        logs += logs_buffer;
-                    }
-                    pclose(logs_pipe);
-                    if (!logs.empty()) {
-                        LOG_WARN("Container logs (last 20 lines):\n" + logs.substr(0, 1000));
-                    }
-                }
+    runSubprocess(dockerArgv({"ps", "--filter", "id=" + container_id, "--format", "{{.Status}}"}), docker_options, docker_result);
+    std::string container_status = firstOutputLine(docker_result);
+    if (!container_status.empty()) {
+        LOG_INFO("Container status: " + container_status);
+        
+        // Check if container exited immediately
+        if (container_status.find("Exited") == 0 || container_status.find("Created") == 0) {
+            // Get logs to see why it failed
+            SubprocessOptions logs_options = docker_options;
+            logs_options.merge_stderr = true;
+            SubprocessResult logs = runSubprocess(dockerArgv({"logs", "--tail", "20", container_id}), logs_options);
+            if (!logs.output.empty()) {
+                LOG_WARN("Container logs (last 20 lines):\n" + logs.output.substr(0, 1000));
             }
         }
-        pclose(status_pipe);
     }
+    
+    // The PID can still be 0 right after start; retry once after a short delay
     unsigned int pid = 0;
-    std::string pid_cmd = absl::StrCat(docker_cmd_prefix, " inspect --format '{{.State.Pid}}' ", container_id, " 2>/dev/null");
-    FILE* pid_pipe = popen(pid_cmd.c_str(), "r");
-    if (pid_pipe) {
-        char pid_buffer[32];
-        if (fgets(pid_buffer, sizeof(pid_buffer), pid_pipe)) {
-            try {
-                std::string pid_str(pid_buffer);
-                pid_str.erase(0, pid_str.find_first_not_of(" \t\n\r"));
-                pid_str.erase(pid_str.find_last_not_of(" \t\n\r") + 1);
-                if (!pid_str.empty() && pid_str != "0") {
-                    pid = std::stoi(pid_str);
-                }
-            } catch (...) {
-                LOG_DEBUG("Could not parse PID, will retry later");
-            }
+    for (int attempt = 0; attempt < 2 && pid == 0; ++attempt) {
+        if (attempt > 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1000));
         }
-        pclose(pid_pipe);
-    }
-    
-    // If PID is 0, try again after a short delay
-    if (pid == 0) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(1000));
-        pid_pipe = popen(pid_cmd.c_str(), "r");
-        if (pid_pipe) {
-            char pid_buffer[32];
-            if (fgets(pid_buffer, sizeof(pid_buffer), pid_pipe)) {
-                try {
-                    std::string pid_str(pid_buffer);
-                    pid_str.erase(0, pid_str.find_first_not_of(" \t\n\r"));
-                    pid_str.erase(pid_str.find_last_not_of(" \t\n\r") + 1);
-                    if (!pid_str.empty() && pid_str != "0") {
-                        pid = std::stoi(pid_str);
-                    }
-                } catch (...) {}
+        runSubprocess(dockerArgv({"inspect", "--format", "{{.State.Pid}}", container_id}), docker_options, docker_result);
+        std::string pid_str = firstOutputLine(docker_result);
+        try {
+            if (!pid_str.empty() && pid_str != "0") {
+                pid = std::stoi(pid_str);
             }
-            pclose(pid_pipe);
+        } catch (...) {
+            LOG_DEBUG("Could not parse PID, will retry later");
         }
     }
     
@@ -732,23 +691,16 @@ DeployResponse deployHFModel(const std::string& model_id, const std::string& hf_
     bool is_running = false;
     std::string final_status;
     for (int check = 0; check < 3; check++) {
-        std::string final_status_cmd = absl::StrCat(docker_cmd_prefix, " ps --filter id=", container_id, " --format {{.Status}} 2>/dev/null");
-        FILE* final_status_pipe = popen(final_status_cmd.c_str(), "r");
-        if (final_status_pipe) {
-            char final_status_buffer[256];
-            if (fgets(final_status_buffer, sizeof(final_status_buffer), final_status_pipe)) {
-                final_status = final_status_buffer;
-                final_status.erase(0, final_status.find_first_not_of(" \t\n\r"));
-                final_status.erase(final_status.find_last_not_of(" \t\n\r") + 1);
-                is_running = (final_status.find("Up") == 0);
-                if (is_running) {
-                    LOG_INFO("Container is running. Status: " + final_status);
-                    break;
-                } else {
-                    LOG_DEBUG("Container check " + std::to_string(check + 1) + "/3: Status: " + final_status);
-                }
+        runSubprocess(dockerArgv({"ps", "--filter", "id=" + container_id, "--format", "{{.Status}}"}), docker_options, docker_result);
+        if (!docker_result.output.empty()) {
+            final_status = firstOutputLine(docker_result);
+            is_running = (final_status.find("Up") == 0);
+            if (is_running) {
+                LOG_INFO("Container is running. Status: " + final_status);
+                break;
+            } else {
+                LOG_DEBUG("Container check " + std::to_string(check + 1) + "/3: Status: " + final_status);
             }
-            pclose(final_status_pipe);
         }
         if (!is_running && check < 2) {
             std::this_thread::sleep_for(std::chrono::milliseconds(3000));
@@ -761,42 +713,29 @@ DeployResponse deployHFModel(const std::string& model_id, const std::string& hf_
         // Get detailed error information
         if (final_status.find("Exited") == 0) {
             // Get exit code
-            std::string inspect_cmd = absl::StrCat(docker_cmd_prefix, " inspect --format '{{.State.ExitCode}}' ", container_id, " 2>/dev/null");
-            FILE* exit_pipe = popen(inspect_cmd.c_str(), "r");
-            if (exit_pipe) {
-                char exit_buffer[32];
-                if (fgets(exit_buffer, sizeof(exit_buffer), exit_pipe)) {
-                    std::string exit_code(exit_buffer);
-                    exit_code.erase(0, exit_code.find_first_not_of(" \t\n\r"));
-                    exit_code.erase(exit_code.find_last_not_of(" \t\n\r") + 1);
-                    LOG_ERROR("Container exited with code: " + exit_code);
-                }
-                pclose(exit_pipe);
+            runSubprocess(dockerArgv({"inspect", "--format", "{{.State.ExitCode}}", container_id}), docker_options, docker_result);
+            std::string exit_code = firstOutputLine(docker_result);
+            if (!exit_code.empty()) {
+                LOG_ERROR("Container exited with code: " + exit_code);
             }
             
             // Get full logs to see what went wrong
-            std::string logs_cmd = absl::StrCat(docker_cmd_prefix, " logs --tail 50 ", container_id, " 2>&1");
-            FILE* logs_pipe = popen(logs_cmd.c_str(), "r");
-            if (logs_pipe) {
-                char logs_buffer[4096];
-                std::string logs;
-                while (fgets(logs_buffer, sizeof(logs_buffer), logs_pipe)) {
-                    logs += logs_buffer;
-                }
-                pclose(logs_pipe);
-                if (!logs.empty()) {
-                    LOG_ERROR("Container logs:\n" + logs.substr(0, 2000));
-                    // Try to extract the actual error message
-                    size_t error_pos = logs.find("Error");
-                    size_t exception_pos = logs.find("Exception");
-                    size_t failed_pos = logs.find("Failed");
-                    if (error_pos != std::string::npos || exception_pos != std::string::npos || failed_pos != std::string::npos) {
-                        size_t start = std::min({error_pos != std::string::npos ? error_pos : logs.length(),
-                                                 exception_pos != std::string::npos ? exception_pos : logs.length(),
-                                                 failed_pos != std::string::npos ? failed_pos : logs.length()});
-                        std::string error_snippet = logs.substr(start, 500);
-                        LOG_ERROR("Error snippet: " + error_snippet);
-                    }
+            SubprocessOptions logs_options = docker_options;
+            logs_options.merge_stderr = true;
+            SubprocessResult logs_result = runSubprocess(dockerArgv({"logs", "--tail", "50", container_id}), logs_options);
+            const std::string& logs = logs_result.output;
+            if (!logs.empty()) {
+                LOG_ERROR("Container logs:\n" + logs.substr(0, 2000));
+                // Try to extract the actual error message
+                size_t error_pos = logs.find("Error");
+                size_t exception_pos = logs.find("Exception");
+                size_t failed_pos = logs.find("Failed");
+                if (error_pos != std::string::npos || exception_pos != std::string::npos || failed_pos != std::string::npos) {
+                    size_t start = std::min({error_pos != std::string::npos ? error_pos : logs.length(),
+                                             exception_pos != std::string::npos ? exception_pos : logs.length(),
+                                             failed_pos != std::string::npos ? failed_pos : logs.length()});
+                    std::string error_snippet = logs.substr(start, 500);
+                    LOG_ERROR("Error snippet: " + error_snippet);
                 }
             }
         } else if (final_status.find("Created") == 0) {
@@ -812,26 +751,18 @@ DeployResponse deployHFModel(const std::string& model_id, const std::string& hf_
     bool is_healthy = false;
     if (is_running) {
         LOG_DEBUG("Performing quick health check on vLLM API...");
-        std::string health_cmd = absl::StrCat("timeout 2 curl -s -f -m 2 http://localhost:", port, "/health 2>/dev/null || echo 'FAILED'");
-        FILE* health_pipe = popen(health_cmd.c_str(), "r");
-        if (health_pipe) {
-            char health_buffer[128];
-            if (fgets(health_buffer, sizeof(health_buffer), health_pipe)) {
-                std::string health_response(health_buffer);
-                health_response.erase(0, health_response.find_first_not_of(" \t\n\r"));
-                health_response.erase(health_response.find_last_not_of(" \t\n\r") + 1);
-                if (health_response != "FAILED" && !health_response.empty()) {
-                    is_healthy = true;
-                    LOG_INFO("vLLM API health check passed immediately");
-                } else {
-                    LOG_DEBUG("vLLM API not ready yet (this is normal for large models)");
-                }
-            }
-            pclose(health_pipe);
+        SubprocessOptions health_options;
+        health_options.timeout_seconds = 2;
+        SubprocessResult health = runSubprocess({"curl", "-s", "-f", "-m", "2", absl::StrCat("http://localhost:", port, "/health")}, health_options);
+        if (health.exit_code == 0) {
+            is_healthy = true;
+            LOG_INFO("vLLM API health check passed immediately");
+        } else {
+            LOG_DEBUG("vLLM API not ready yet (this is normal for large models)");
         }
     }
     
-    registerModelDeployment(validated_model_id, container_name, max_gpu_util, detected_gpu, pid);
+    registerModelDeployment(validated_model_id, container_name, max_gpu_util, detected_gpu, pid, port);
     
     response.container_id = container_id;
     if (is_running && is_healthy) {
@@ -0,0 +1,299 @@
+#include "services/metrics_service.h"
+#include "services/vram_tracker.h"
+#include "utils/stage_timer.h"
+#include "utils/subprocess.h"
+#include "utils/compression.h"
+#include "utils/admission.h"
+#include "utils/http_io.h"
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+#include <atomic>
+#include <cmath>
+#include <dirent.h>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <absl/strings/str_cat.h>
+
+static std::atomic<int> stream_subscribers{0};
+static std::atomic<int> open_connections{0};
+static std::atomic<unsigned long long> connections_total{0};
+static std::atomic<unsigned long long> keepalive_requests_total{0};
+static std::atomic<size_t> last_metrics_size{16 * 1024};
+
+static const std::vector<double> LATENCY_BOUNDS_SECONDS = {
+    0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1.0, 2.5, 5.0, 10.0
+};
+
+// Stages recorded for HTTP requests are named "http:<route>" (see http_server.cpp)
+static const std::string REQUEST_STAGE_PREFIX = "http:";
+
+// Bodies above COMPRESSION_MIN_BYTES are compressed when the client's Accept-Encoding allows it
+static void writeResponse(http::response<http::string_body>& res, ClientSocket& socket,
+                          boost::beast::string_view accept_encoding = {}) {
+    ContentEncoding encoding = compressForClient(std::string_view(accept_encoding.data(), accept_encoding.size()), res.body());
+    if (encoding != CONTENT_ENCODING_IDENTITY) {
+        res.set(http::field::content_encoding, contentEncodingName(encoding));
+    }
+    res.set(http::field::vary, "Accept-Encoding");
+    res.prepare_payload();
+    try {
+        writeHttpMessage(socket, res);
+    } catch (const boost::system::system_error& e) {
+        auto ec = e.code();
+        if (ec == boost::asio::error::broken_pipe ||
+            ec == boost::asio::error::connection_reset ||
+            ec == boost::asio::error::eof) {
+            return;
+        }
+        throw;
+    }
+}
+
+void adjustStreamSubscribers(int delta) {
+    stream_subscribers += delta;
+}
+
+void adjustOpenConnections(int delta) {
+    if (delta > 0) connections_total += delta;
+    open_connections += delta;
+}
+
+void recordKeepAliveRequest() {
+    keepalive_requests_total++;
+}
+
+// Children of every thread of this process, i.e. docker/curl/ncu commands still running
+static unsigned int countRunningSubprocesses() {
+    unsigned int count = 0;
+    DIR* tasks = opendir("/proc/self/task");
+    if (!tasks) return 0;
+    while (struct dirent* entry = readdir(tasks)) {
+        if (entry->d_name[0] == '.') continue;
+        std::ifstream children(absl::StrCat("/proc/self/task/", entry->d_name, "/children"));
+        std::string pid;
+        while (children >> pid) count++;
+    }
+    closedir(tasks);
+    return count;
+}
+
+static std::string escapeLabel(const std::string& value) {
+    std::string escaped;
+    escaped.reserve(value.size());
+    for (char c : value) {
+        if (c == '\\' || c == '"') {
+            escaped += '\\';
+            escaped += c;
+        } else if (c == '\n') {
+            escaped += "\\n";
+        } else {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+// Byte counts stay exact; everything else keeps 12 significant digits
+static std::string formatValue(double value) {
+    if (value == std::floor(value) && std::fabs(value) < 9007199254740992.0) {
+        return std::to_string(static_cast<long long>(value));
+    }
+    std::ostringstream oss;
+    oss << std::setprecision(12) << value;
+    return oss.str();
+}
+
+static void appendHeader(std::string& out, const char* name, const char* type, const char* help) {
+    absl::StrAppend(&out, "# HELP ", name, " ", help, "\n# TYPE ", name, " ", type, "\n");
+}
+
+static void appendSample(std::string& out, const char* name, const std::string& labels, double value) {
+    absl::StrAppend(&out, name, labels.empty() ? "" : "{", labels, labels.empty() ? "" : "}", " ", formatValue(value), "\n");
+}
+
+static void appendHistogram(std::string& out, const char* name, const std::string& label_name,
+                            const std::string& label_value, const StageHistogramBuckets& histogram) {
+    std::string label = absl::StrCat(label_name, "=\"", escapeLabel(label_value), "\"");
+    for (size_t i = 0; i < LATENCY_BOUNDS_SECONDS.size(); ++i) {
+        absl::StrAppend(&out, name, "_bucket{", label, ",le=\"", formatValue(LATENCY_BOUNDS_SECONDS[i]), "\"} ",
+                        histogram.cumulative_counts[i], "\n");
+    }
+    absl::StrAppend(&out, name, "_bucket{", label, ",le=\"+Inf\"} ", histogram.count, "\n");
+    absl::StrAppend(&out, name, "_sum{", label, "} ", formatValue(histogram.sum_seconds), "\n");
+    absl::StrAppend(&out, name, "_count{", label, "} ", histogram.count, "\n");
+}
+
+static void appendSnapshotMetrics(std::string& out, const DetailedVRAMInfo& info) {
+    appendHeader(out, "blackbox_gpu_memory_total_bytes", "gauge", "Total memory of each GPU");
+    for (const auto& gpu : info.gpus) {
+        std::string labels = absl::StrCat("gpu=\"", gpu.index, "\",uuid=\"", escapeLabel(gpu.uuid),
+                                          "\",name=\"", escapeLabel(gpu.name), "\"");
+        appendSample(out, "blackbox_gpu_memory_total_bytes", labels, static_cast<double>(gpu.total));
+    }
+    appendHeader(out, "blackbox_gpu_memory_used_bytes", "gauge", "Allocated memory of each GPU");
+    for (const auto& gpu : info.gpus) {
+        appendSample(out, "blackbox_gpu_memory_used_bytes", absl::StrCat("gpu=\"", gpu.index, "\""), static_cast<double>(gpu.used));
+    }
+    appendHeader(out, "blackbox_gpu_memory_free_bytes", "gauge", "Free memory of each GPU");
+    for (const auto& gpu : info.gpus) {
+        appendSample(out, "blackbox_gpu_memory_free_bytes", absl::StrCat("gpu=\"", gpu.index, "\""), static_cast<double>(gpu.free));
+    }
+    appendHeader(out, "blackbox_gpu_processes", "gauge", "Compute processes on each GPU");
+    for (const auto& gpu : info.gpus) {
+        appendSample(out, "blackbox_gpu_processes", absl::StrCat("gpu=\"", gpu.index, "\""), gpu.process_count);
+    }
+
+    std::vector<std::string> model_labels;
+    for (const auto& model : info.models) {
+        model_labels.push_back(absl::StrCat("model=\"", escapeLabel(model.model_id), "\",port=\"", model.port, "\""));
+    }
+    auto append_model_metric = [&](const char* name, const char* type, const char* help, auto value_of) {
+        appendHeader(out, name, type, help);
+        for (size_t i = 0; i < info.models.size(); ++i) {
+            appendSample(out, name, model_labels[i], static_cast<double>(value_of(info.models[i])));
+        }
+    };
+    append_model_metric("blackbox_model_vram_allocated_bytes", "gauge", "VRAM held by the model's processes",
+                        [](const ModelVRAMInfo& m) { return m.allocated_vram_bytes; });
+    append_model_metric("blackbox_model_kv_cache_used_bytes", "gauge", "KV cache bytes in use",
+                        [](const ModelVRAMInfo& m) { return m.used_kv_cache_bytes; });
+    append_model_metric("blackbox_model_kv_cache_usage_ratio", "gauge", "Fraction of KV cache blocks in use",
+                        [](const ModelVRAMInfo& m) { return m.kv_cache_usage_perc; });
+    append_model_metric("blackbox_model_kv_cache_blocks", "gauge", "KV cache blocks reserved by vLLM",
+                        [](const ModelVRAMInfo& m) { return m.num_gpu_blocks; });
+    append_model_metric("blackbox_model_prefix_cache_hit_rate", "gauge", "Prefix cache hit rate (0-100)",
+                        [](const ModelVRAMInfo& m) { return m.prefix_cache_hit_rate; });
+    append_model_metric("blackbox_model_requests_running", "gauge", "Requests being processed",
+                        [](const ModelVRAMInfo& m) { return m.num_requests_running; });
+    append_model_metric("blackbox_model_requests_waiting", "gauge", "Requests queued",
+                        [](const ModelVRAMInfo& m) { return m.num_requests_waiting; });
+    append_model_metric("blackbox_model_preemptions_total", "counter", "Preemptions reported by vLLM",
+                        [](const ModelVRAMInfo& m) { return m.num_preemptions_total; });
+    append_model_metric("blackbox_model_gpu_memory_utilization", "gauge", "Configured gpu_memory_utilization",
+                        [](const ModelVRAMInfo& m) { return m.gpu_memory_utilization; });
+
+    appendHeader(out, "blackbox_kv_cache_used_bytes", "gauge", "KV cache bytes in use across all models");
+    appendSample(out, "blackbox_kv_cache_used_bytes", "", static_cast<double>(info.used_kv_cache_bytes));
+    appendHeader(out, "blackbox_prefix_cache_hit_rate", "gauge", "Average prefix cache hit rate across models (0-100)");
+    appendSample(out, "blackbox_prefix_cache_hit_rate", "", info.prefix_cache_hit_rate);
+}
+
+static void appendSubprocessMetrics(std::string& out, const std::vector<SubprocessStats>& stats) {
+    auto append_program_metric = [&](const char* name, const char* help, auto value_of) {
+        appendHeader(out, name, "counter", help);
+        for (const auto& entry : stats) {
+            appendSample(out, name, absl::StrCat("program=\"", escapeLabel(entry.program), "\""),
+                         static_cast<double>(value_of(entry)));
+        }
+    };
+    append_program_metric("blackbox_subprocess_spawns_total", "Commands run through the subprocess runner",
+                          [](const SubprocessStats& s) { return s.spawns; });
+    append_program_metric("blackbox_subprocess_spawn_failures_total", "Commands that could not be started",
+                          [](const SubprocessStats& s) { return s.spawn_failures; });
+    append_program_metric("blackbox_subprocess_timeouts_total", "Commands killed at their deadline",
+                          [](const SubprocessStats& s) { return s.timeouts; });
+    append_program_metric("blackbox_subprocess_spawn_seconds_total", "Time spent in posix_spawn",
+                          [](const SubprocessStats& s) { return s.spawn_seconds; });
+    append_program_metric("blackbox_subprocess_run_seconds_total", "Time from spawn until the command was reaped",
+                          [](const SubprocessStats& s) { return s.run_seconds; });
+}
+
+static void appendAdmissionMetrics(std::string& out, const std::vector<AdmissionStats>& stats) {
+    auto append_gate_metric = [&](const char* name, const char* type, const char* help, auto value_of) {
+        appendHeader(out, name, type, help);
+        for (const auto& entry : stats) {
+            appendSample(out, name, absl::StrCat("gate=\"", entry.gate, "\""), static_cast<double>(value_of(entry)));
+        }
+    };
+    append_gate_metric("blackbox_admission_active", "gauge", "Requests holding a slot of the admission gate",
+                       [](const AdmissionStats& s) { return s.active; });
+    append_gate_metric("blackbox_admission_queued", "gauge", "Requests waiting for a slot",
+                       [](const AdmissionStats& s) { return s.queued; });
+    append_gate_metric("blackbox_admission_admitted_total", "counter", "Requests admitted",
+                       [](const AdmissionStats& s) { return s.admitted; });
+    append_gate_metric("blackbox_admission_queued_total", "counter", "Requests admitted after waiting in the queue",
+                       [](const AdmissionStats& s) { return s.waited; });
+    appendHeader(out, "blackbox_admission_shed_total", "counter", "Requests rejected with 503");
+    for (const auto& entry : stats) {
+        appendSample(out, "blackbox_admission_shed_total", absl::StrCat("gate=\"", entry.gate, "\",reason=\"queue_full\""),
+                     static_cast<double>(entry.shed_queue_full));
+        appendSample(out, "blackbox_admission_shed_total", absl::StrCat("gate=\"", entry.gate, "\",reason=\"timeout\""),
+                     static_cast<double>(entry.shed_timeout));
+    }
+}
+
+static void appendCompressionMetrics(std::string& out, const std::vector<CompressionStats>& stats) {
+    auto append_encoding_metric = [&](const char* name, const char* help, auto value_of) {
+        appendHeader(out, name, "counter", help);
+        for (const auto& entry : stats) {
+            appendSample(out, name, absl::StrCat("encoding=\"", entry.encoding, "\""),
+                         static_cast<double>(value_of(entry)));
+        }
+    };
+    append_encoding_metric("blackbox_compression_bodies_total", "Response bodies compressed (cached snapshot bodies count once)",
+                           [](const CompressionStats& s) { return s.responses; });
+    append_encoding_metric("blackbox_compression_input_bytes_total", "Bytes before compression",
+                           [](const CompressionStats& s) { return s.bytes_in; });
+    append_encoding_metric("blackbox_compression_output_bytes_total", "Bytes after compression",
+                           [](const CompressionStats& s) { return s.bytes_out; });
+    append_encoding_metric("blackbox_compression_seconds_total", "Time spent compressing",
+                           [](const CompressionStats& s) { return s.seconds; });
+}
+
+// GET /metrics: Prometheus text exposition of the cached snapshot and the server's own health.
+// Renders from what is already collected; a scrape never runs NVML, docker or curl.
+void handleMetricsRequest(http::request<http::string_body>& req, ClientSocket& socket) {
+    std::string out;
+    out.reserve(last_metrics_size.load() + last_metrics_size.load() / 4);
+
+    double snapshot_age = 0.0;
+    std::shared_ptr<const DetailedVRAMInfo> snapshot = getLatestVRAMSnapshot(snapshot_age);
+    appendHeader(out, "blackbox_snapshot_available", "gauge", "1 if a VRAM snapshot has been collected");
+    appendSample(out, "blackbox_snapshot_available", "", snapshot ? 1 : 0);
+    if (snapshot) {
+        appendHeader(out, "blackbox_snapshot_age_seconds", "gauge", "Seconds since the cached VRAM snapshot was collected");
+        appendSample(out, "blackbox_snapshot_age_seconds", "", snapshot_age);
+        appendSnapshotMetrics(out, *snapshot);
+    }
+
+    appendHeader(out, "blackbox_stream_subscribers", "gauge", "Open /vram/stream connections");
+    appendSample(out, "blackbox_stream_subscribers", "", stream_subscribers.load());
+    appendHeader(out, "blackbox_http_connections_open", "gauge", "Client connections currently open");
+    appendSample(out, "blackbox_http_connections_open", "", open_connections.load());
+    appendHeader(out, "blackbox_http_connections_total", "counter", "Client connections accepted");
+    appendSample(out, "blackbox_http_connections_total", "", connections_total.load());
+    appendHeader(out, "blackbox_http_keepalive_requests_total", "counter", "Requests served on a reused connection");
+    appendSample(out, "blackbox_http_keepalive_requests_total", "", keepalive_requests_total.load());
+    appendHeader(out, "blackbox_subprocesses_running", "gauge", "Child processes (docker, curl, ncu) currently running");
+    appendSample(out, "blackbox_subprocesses_running", "", countRunningSubprocesses());
+    appendSubprocessMetrics(out, getSubprocessStats());
+    appendCompressionMetrics(out, getCompressionStats());
+    appendAdmissionMetrics(out, getAdmissionStats());
+
+    std::vector<StageHistogramBuckets> histograms = getStageHistograms(LATENCY_BOUNDS_SECONDS);
+    appendHeader(out, "blackbox_http_request_duration_seconds", "histogram", "Request latency per endpoint");
+    for (const auto& histogram : histograms) {
+        if (histogram.stage.compare(0, REQUEST_STAGE_PREFIX.size(), REQUEST_STAGE_PREFIX) != 0) continue;
+        appendHistogram(out, "blackbox_http_request_duration_seconds", "route",
+                        histogram.stage.substr(REQUEST_STAGE_PREFIX.size()), histogram);
+    }
+    appendHeader(out, "blackbox_stage_duration_seconds", "histogram",
+                 "Collection stage latency (NVML, docker, vLLM scrape, serialization; see /debug/timings)");
+    for (const auto& histogram : histograms) {
+        if (histogram.stage.compare(0, REQUEST_STAGE_PREFIX.size(), REQUEST_STAGE_PREFIX) == 0) continue;
+        appendHistogram(out, "blackbox_stage_duration_seconds", "stage", histogram.stage, histogram);
+    }
+
+    last_metrics_size = out.size();
+
+    http::response<http::string_body> res;
+    res.version(req.version());
+    res.keep_alive(req.keep_alive());
+    res.result(http::status::ok);
+    res.set(http::field::content_type, "text/plain; version=0.0.4; charset=utf-8");
+    res.body() = std::move(out);
+    writeResponse(res, socket, req[http::field::accept_encoding]);
+}
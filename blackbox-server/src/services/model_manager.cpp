@@ -1,8 +1,12 @@
 #include "services/model_manager.h"
+#include "services/container_resolver.h"
 #include "services/vram_tracker.h"
+#include "services/nvml_utils.h"
 #include "services/hf_deploy.h"
 #include "utils/env_utils.h"
 #include "utils/logger.h"
+#include "utils/stage_timer.h"
+#include "utils/subprocess.h"
 #include <cstdio>
 #include <cstdlib>
 #include <sstream>
@@ -15,31 +19,21 @@
 #include <numeric>
 #include <thread>
 #include <chrono>
+#include <mutex>
+#include <ctime>
 #include <absl/strings/str_cat.h>
 
-// Helper function to get Docker command prefix (with or without sudo)
-static std::string getDockerCmd() {
-    std::string use_sudo = getEnvValue("USE_SUDO_DOCKER", "");
-    if (use_sudo == "true" || use_sudo == "1" || use_sudo == "yes") {
-        return "sudo docker";
-    }
-    
-    // Try to detect if sudo is needed by checking docker access (with timeout)
-    FILE* test_pipe = popen("timeout 2 docker ps >/dev/null 2>&1", "r");
-    if (test_pipe) {
-        int status = pclose(test_pipe);
-        if (status != 0) {
-            // Docker command failed, likely needs sudo
-            return "sudo docker";
-        }
-    }
-    
-    return "docker";
-}
-
 static std::map<std::string, ModelMetrics> model_metrics;
+static std::mutex model_metrics_mutex;  // Guards model_metrics (HTTP, health check and optimizer threads)
+// Hour-of-day KV profiles outlive a container so a restarted model keeps its daily pattern
+static std::map<std::string, std::pair<std::array<double, 24>, std::array<long long, 24>>> retained_kv_profiles;
 static const int MAX_SAMPLES = 100;
 
+// Seconds of usage history kept per model for sizing
+static double getUsageHistorySeconds() {
+    return std::max(60, getEnvInt("USAGE_HISTORY_SECONDS", 1800));
+}
+
 int getMaxConcurrentModels() {
     std::string max_str = getEnvValue("MAX_CONCURRENT_MODELS", "3");
     try {
@@ -54,18 +48,36 @@ std::string getContainerName(const std::string& model_id) {
     return "vllm-" + std::regex_replace(model_id, std::regex("[^a-zA-Z0-9]"), "-");
 }
 
+static const std::string STAGING_SUFFIX = "-next";
+
+std::string getStagingContainerName(const std::string& container_name) {
+    return container_name + STAGING_SUFFIX;
+}
+
+bool isStagingContainerName(const std::string& name) {
+    return name.size() > STAGING_SUFFIX.size() &&
+           name.compare(name.size() - STAGING_SUFFIX.size(), STAGING_SUFFIX.size(), STAGING_SUFFIX) == 0;
+}
+
 std::vector<DeployedModel> listDeployedModels() {
+    ScopedStageTimer timer("docker_list");
     std::vector<DeployedModel> models;
     
-    std::string docker_cmd = getDockerCmd();
     // Only query running containers - explicitly filter for running status
-    std::string docker_list_cmd = absl::StrCat("timeout 5 ", docker_cmd, " ps --filter name=vllm- --filter status=running --format '{{.ID}}|{{.Names}}|{{.Status}}|{{.Ports}}' 2>/dev/null");
-    FILE* pipe = popen(docker_list_cmd.c_str(), "r");
-    if (!pipe) return models;
-    
-    char line[512];
-    while (fgets(line, sizeof(line), pipe)) {
-        std::string line_str(line);
+    SubprocessOptions docker_options;
+    docker_options.timeout_seconds = 5;
+    SubprocessResult docker_ps = runSubprocess(dockerArgv({
+        "ps", "--filter", "name=vllm-", "--filter", "status=running",
+        "--format", "{{.ID}}|{{.Names}}|{{.Status}}|{{.Ports}}"
+    }), docker_options);
+    if (!docker_ps.started) return models;
+    
+    SubprocessOptions inspect_options;
+    inspect_options.timeout_seconds = 2;
+    SubprocessResult inspect;
+    std::istringstream lines(docker_ps.output);
+    std::string line_str;
+    while (std::getline(lines, line_str)) {
         if (line_str.empty()) continue;
         
         std::istringstream iss(line_str);
@@ -85,6 +97,8 @@ std::vector<DeployedModel> listDeployedModels() {
         name.erase(name.find_last_not_of(" \t\n\r") + 1);
         status.erase(0, status.find_first_not_of(" \t\n\r"));
         status.erase(status.find_last_not_of(" \t\n\r") + 1);
+        // A rolling restart's replacement is not a deployment of its own until it takes over the name
+        if (isStagingContainerName(name)) continue;
         
         std::string model_id = name.substr(5);
         
@@ -116,19 +130,8 @@ std::vector<DeployedModel> listDeployedModels() {
         }
         
         // Verify the container is actually running with docker inspect
-        std::string inspect_cmd = absl::StrCat("timeout 2 ", docker_cmd, " inspect --format '{{.State.Running}}' ", container_id, " 2>/dev/null");
-        FILE* inspect_pipe = popen(inspect_cmd.c_str(), "r");
-        bool is_actually_running = false;
-        if (inspect_pipe) {
-            char inspect_buffer[16];
-            if (fgets(inspect_buffer, sizeof(inspect_buffer), inspect_pipe)) {
-                std::string running_state(inspect_buffer);
-                running_state.erase(0, running_state.find_first_not_of(" \t\n\r"));
-                running_state.erase(running_state.find_last_not_of(" \t\n\r") + 1);
-                is_actually_running = (running_state == "true");
-            }
-            pclose(inspect_pipe);
-        }
+        runSubprocess(dockerArgv({"inspect", "--format", "{{.State.Running}}", container_id}), inspect_options, inspect);
+        bool is_actually_running = firstOutputLine(inspect) == "true";
         
         // Only add if actually running
         if (!is_actually_running) {
@@ -136,7 +139,7 @@ std::vector<DeployedModel> listDeployedModels() {
             continue;
         }
         
-        DeployedModel model;
+        DeployedModel model{};
         model.model_id = model_id;
         model.container_id = container_id;
         model.container_name = name;
@@ -145,7 +148,6 @@ std::vector<DeployedModel> listDeployedModels() {
         
         models.push_back(model);
     }
-    pclose(pipe);
     
     return models;
 }
@@ -153,22 +155,12 @@ std::vector<DeployedModel> listDeployedModels() {
 bool isModelDeployed(const std::string& model_id) {
     std::string container_name = getContainerName(model_id);
     
-    std::string docker_cmd = getDockerCmd();
-    std::string cmd = absl::StrCat(docker_cmd, " ps -a --filter name=", container_name, " --format {{.ID}}");
-    
-    FILE* pipe = popen(cmd.c_str(), "r");
-    if (!pipe) return false;
-    
-    char buffer[128];
-    bool exists = false;
-    if (fgets(buffer, sizeof(buffer), pipe)) {
-        std::string id(buffer);
-        id.erase(id.find_last_not_of(" \t\n\r") + 1);
-        exists = !id.empty() && id.length() >= 12;
-    }
-    pclose(pipe);
-    
-    return exists;
+    SubprocessOptions docker_options;
+    docker_options.timeout_seconds = 5;
+    SubprocessResult docker_ps = runSubprocess(dockerArgv({
+        "ps", "-a", "--filter", dockerNameFilter(container_name), "--format", "{{.ID}}"
+    }), docker_options);
+    return firstOutputLine(docker_ps).length() >= 12;
 }
 
 int getDeployedModelCount() {
@@ -225,28 +217,31 @@ bool spindownModel(const std::string& model_id_or_container) {
     
     unregisterModel(container_name);
     
-    std::string docker_cmd = getDockerCmd();
-    
-    std::string stop_cmd = absl::StrCat(docker_cmd, " stop ", container_name, " 2>/dev/null");
-    std::string rm_cmd = absl::StrCat(docker_cmd, " rm ", container_name, " 2>/dev/null");
-    
-    int stop_result = system(stop_cmd.c_str());
-    int rm_result = system(rm_cmd.c_str());
+    SubprocessOptions docker_options;
+    docker_options.timeout_seconds = 30;
+    int stop_result = runSubprocess(dockerArgv({"stop", container_name}), docker_options).exit_code;
+    int rm_result = runSubprocess(dockerArgv({"rm", container_name}), docker_options).exit_code;
     
     return (stop_result == 0 || rm_result == 0);
 }
 
-std::string detectGPUType() {
-    FILE* pipe = popen("nvidia-smi --query-gpu=name --format=csv,noheader 2>/dev/null | head -1", "r");
-    if (!pipe) return "T4";
-    
-    char buffer[256];
-    std::string gpu_name;
-    if (fgets(buffer, sizeof(buffer), pipe)) {
-        gpu_name = buffer;
-        gpu_name.erase(gpu_name.find_last_not_of(" \t\n\r") + 1);
+bool renameContainer(const std::string& from, const std::string& to) {
+    SubprocessOptions docker_options;
+    docker_options.timeout_seconds = 10;
+    bool renamed = runSubprocess(dockerArgv({"rename", from, to}), docker_options).exit_code == 0;
+    if (renamed) {
+        // Model IDs are derived from container names
+        invalidateContainerModelCache();
     }
-    pclose(pipe);
+    return renamed;
+}
+
+std::string detectGPUType() {
+    SubprocessOptions smi_options;
+    smi_options.timeout_seconds = 5;
+    SubprocessResult smi = runSubprocess({"nvidia-smi", "--query-gpu=name", "--format=csv,noheader"}, smi_options);
+    if (!smi.started) return "T4";
+    std::string gpu_name = firstOutputLine(smi);
     
     if (gpu_name.find("A100") != std::string::npos) return "A100";
     if (gpu_name.find("H100") != std::string::npos) return "H100";
@@ -257,17 +252,53 @@ std::string detectGPUType() {
 }
 
 void registerModelDeployment(const std::string& model_id, const std::string& container_name,
-                            double configured_max_gpu_utilization, const std::string& gpu_type, unsigned int pid) {
-    ModelMetrics metrics;
+                            double configured_max_gpu_utilization, const std::string& gpu_type, unsigned int pid, int port) {
+    ModelMetrics metrics{};
+    metrics.model_id = model_id;
+    metrics.port = port;
     metrics.configured_max_utilization = configured_max_gpu_utilization;
     metrics.gpu_type = gpu_type;
     metrics.pid = pid;
     metrics.peak_usage = 0.0;
+    std::lock_guard<std::mutex> lock(model_metrics_mutex);
+    // A rolling replacement registers while the old container is still live
+    auto live = std::find_if(model_metrics.begin(), model_metrics.end(), [&](const auto& entry) {
+        return entry.second.model_id == model_id;
+    });
+    auto retained = retained_kv_profiles.find(model_id);
+    if (live != model_metrics.end()) {
+        metrics.hourly_kv_peak = live->second.hourly_kv_peak;
+        metrics.hourly_kv_day = live->second.hourly_kv_day;
+    } else if (retained != retained_kv_profiles.end()) {
+        metrics.hourly_kv_peak = retained->second.first;
+        metrics.hourly_kv_day = retained->second.second;
+    }
     model_metrics[container_name] = metrics;
 }
 
 void unregisterModel(const std::string& container_name) {
-    model_metrics.erase(container_name);
+    std::lock_guard<std::mutex> lock(model_metrics_mutex);
+    auto it = model_metrics.find(container_name);
+    if (it == model_metrics.end()) return;
+    if (!it->second.model_id.empty()) {
+        retained_kv_profiles[it->second.model_id] = {it->second.hourly_kv_peak, it->second.hourly_kv_day};
+    }
+    model_metrics.erase(it);
+}
+
+// Move a registration to a new container name (used when a staged replacement takes over)
+void renameModelRegistration(const std::string& from, const std::string& to) {
+    std::lock_guard<std::mutex> lock(model_metrics_mutex);
+    auto it = model_metrics.find(from);
+    if (it == model_metrics.end()) return;
+    ModelMetrics metrics = std::move(it->second);
+    model_metrics.erase(it);
+    model_metrics[to] = std::move(metrics);
+}
+
+std::map<std::string, ModelMetrics> getModelMetricsSnapshot() {
+    std::lock_guard<std::mutex> lock(model_metrics_mutex);
+    return model_metrics;
 }
 
 // Clean up model_metrics for containers that no longer exist or aren't running
@@ -279,6 +310,7 @@ static void cleanupStaleModelMetrics() {
     }
     
     // Remove metrics for containers that are no longer running
+    std::lock_guard<std::mutex> lock(model_metrics_mutex);
     auto it = model_metrics.begin();
     while (it != model_metrics.end()) {
         if (running_container_names.find(it->first) == running_container_names.end()) {
@@ -294,9 +326,11 @@ void updateModelVRAMUsage(const std::string& container_name, double vram_percent
     // Clean up stale metrics before updating
     cleanupStaleModelMetrics();
     
-    if (model_metrics.find(container_name) == model_metrics.end()) return;
+    std::lock_guard<std::mutex> lock(model_metrics_mutex);
+    auto found = model_metrics.find(container_name);
+    if (found == model_metrics.end()) return;
     
-    auto& metrics = model_metrics[container_name];
+    auto& metrics = found->second;
     metrics.vram_samples.push_back(vram_percent);
     if (metrics.vram_samples.size() > MAX_SAMPLES) {
         metrics.vram_samples.pop_front();
@@ -307,38 +341,176 @@ void updateModelVRAMUsage(const std::string& container_name, double vram_percent
     }
 }
 
+ModelUsageSample makeUsageSample(const ModelVRAMInfo& model, unsigned long long snapshot_total, double timestamp) {
+    ModelUsageSample sample;
+    sample.timestamp = timestamp;
+    // Utilization fractions are per device, so measure against the GPUs this model occupies
+    sample.total_vram_bytes = model.gpu_total_bytes > 0 ? model.gpu_total_bytes : snapshot_total;
+    sample.gpu_count = static_cast<unsigned int>(std::max<size_t>(1, model.gpu_indices.size()));
+    sample.allocated_vram_bytes = model.allocated_vram_bytes;
+    sample.used_kv_cache_bytes = model.used_kv_cache_bytes;
+    sample.kv_cache_usage_perc = model.kv_cache_usage_perc;
+    sample.num_gpu_blocks = model.num_gpu_blocks;
+    sample.kv_block_bytes = model.kv_block_bytes;
+    sample.num_requests_running = model.num_requests_running;
+    sample.num_requests_waiting = model.num_requests_waiting;
+    sample.num_preemptions_total = model.num_preemptions_total;
+    return sample;
+}
+
+// Append one sizing sample per registered model from a collected snapshot, dropping
+// samples older than USAGE_HISTORY_SECONDS. Called by the usage sampler thread only.
+void recordModelUsage(const DetailedVRAMInfo& info) {
+    cleanupStaleModelMetrics();
+    
+    double now = std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    std::time_t wall_now = std::time(nullptr);
+    std::tm local_tm{};
+    localtime_r(&wall_now, &local_tm);
+    long long local_day = static_cast<long long>(wall_now + local_tm.tm_gmtoff) / 86400;
+    
+    double history_seconds = getUsageHistorySeconds();
+    
+    std::lock_guard<std::mutex> lock(model_metrics_mutex);
+    for (const auto& model : info.models) {
+        // Container names are "vllm-<model_id>"; fall back to the port for renamed containers
+        auto found = model_metrics.find("vllm-" + model.model_id);
+        if (found == model_metrics.end()) {
+            found = std::find_if(model_metrics.begin(), model_metrics.end(), [&](const auto& entry) {
+                return entry.second.port > 0 && entry.second.port == model.port;
+            });
+        }
+        if (found == model_metrics.end()) continue;
+        
+        auto& metrics = found->second;
+        ModelUsageSample sample = makeUsageSample(model, info.total, now);
+        unsigned long long model_total = sample.total_vram_bytes;
+        metrics.usage_samples.push_back(sample);
+        while (now - metrics.usage_samples.front().timestamp > history_seconds) {
+            metrics.usage_samples.pop_front();
+        }
+        
+        // Fold this sample into the hour-of-day profile; a bucket from an earlier day decays first
+        int hour = local_tm.tm_hour;
+        if (metrics.hourly_kv_day[hour] != local_day) {
+            metrics.hourly_kv_peak[hour] *= 0.8;
+            metrics.hourly_kv_day[hour] = local_day;
+        }
+        metrics.hourly_kv_peak[hour] = std::max(metrics.hourly_kv_peak[hour], model.kv_cache_usage_perc);
+        
+        // vLLM knows the utilization it actually started with
+        if (model.gpu_memory_utilization > 0.0) {
+            metrics.configured_max_utilization = model.gpu_memory_utilization;
+        }
+        
+        double vram_percent = model_total > 0 ? 100.0 * model.allocated_vram_bytes / model_total : 0.0;
+        metrics.vram_samples.push_back(vram_percent);
+        // Covers the same window as usage_samples, which it is recorded alongside
+        while (metrics.vram_samples.size() > metrics.usage_samples.size()) {
+            metrics.vram_samples.pop_front();
+        }
+        if (vram_percent > metrics.peak_usage) {
+            metrics.peak_usage = vram_percent;
+        }
+    }
+}
+
+void startUsageSamplerThread() {
+    int interval_seconds = std::max(1, getEnvInt("USAGE_SAMPLE_INTERVAL", 5));
+    std::thread([interval_seconds]() {
+        while (true) {
+            try {
+                recordModelUsage(getDetailedVRAMUsage());
+            } catch (const std::exception& e) {
+                LOG_ERROR("Usage sampling error: " + std::string(e.what()));
+            }
+            std::this_thread::sleep_for(std::chrono::seconds(interval_seconds));
+        }
+    }).detach();
+    LOG_INFO("Started model usage sampler (every " + std::to_string(interval_seconds) + " seconds)");
+}
+
 
 OptimizationResult optimizeModelAllocations() {
-    OptimizationResult result{false, {}, ""};
-    std::vector<std::string> to_restart;
+    OptimizationResult result{false, {}, {}, {}, 0, ""};
     
     // Clean up stale metrics first
     cleanupStaleModelMetrics();
     
+    auto running_models = listDeployedModels();
+    auto metrics_snapshot = getModelMetricsSnapshot();
+    SizingConfig sizing_config = loadSizingConfig();
+    
     // Now iterate only over running models
-    for (const auto& [container_name, metrics] : model_metrics) {
-        if (metrics.vram_samples.size() < 10) continue;
+    for (const auto& [container_name, metrics] : metrics_snapshot) {
+        SizingRecommendation rec = sizeModelAllocation(container_name, metrics, sizing_config);
+        result.recommendations.push_back(rec);
+        
+        LOG_DEBUG("Sizing " + container_name + ": basis=" + rec.basis + ", action=" + rec.action +
+                  ", samples=" + std::to_string(rec.samples) +
+                  ", kv_p99=" + std::to_string(rec.kv_usage_p99) +
+                  ", kv_forecast=" + std::to_string(rec.kv_usage_forecast) +
+                  ", preemptions/min=" + std::to_string(rec.preemptions_per_minute) +
+                  ", block_bytes=" + std::to_string(rec.kv_block_bytes) +
+                  ", utilization " + std::to_string(rec.current_utilization) + " -> " + std::to_string(rec.target_utilization));
+        
+        if (rec.action == "keep") continue;
         
-        double avg = std::accumulate(metrics.vram_samples.begin(), metrics.vram_samples.end(), 0.0) / metrics.vram_samples.size();
-        double threshold = metrics.configured_max_utilization * 100.0 * 0.7;
+        OptimizationTarget target;
+        target.container_name = container_name;
+        target.model_id = metrics.model_id;
+        target.port = metrics.port;
+        target.gpu_type = metrics.gpu_type;
+        target.current_utilization = rec.current_utilization;
+        target.target_utilization = rec.target_utilization;
         
-        if (avg < threshold && metrics.peak_usage > 0) {
-            to_restart.push_back(container_name);
+        // Prefer the live container view for port/model if registration is incomplete
+        for (const auto& m : running_models) {
+            if (m.container_name == container_name) {
+                if (target.port <= 0) target.port = m.port;
+                if (target.model_id.empty()) target.model_id = m.model_id;
+                break;
+            }
         }
+        
+        result.targets.push_back(target);
+        result.restarted_models.push_back(container_name);
+        result.projected_savings_bytes += rec.projected_savings_bytes;
     }
     
-    if (to_restart.empty()) {
+    if (result.targets.empty()) {
         result.message = "No models need optimization";
         return result;
     }
     
     result.optimized = true;
-    result.restarted_models = to_restart;
-    result.message = absl::StrCat("Optimizing ", to_restart.size(), " model(s)");
+    result.message = absl::StrCat("Optimizing ", result.targets.size(), " model(s)");
     
     return result;
 }
 
+bool checkModelHealth(int port) {
+    SubprocessOptions health_options;
+    health_options.timeout_seconds = 2;
+    SubprocessResult health = runSubprocess({
+        "curl", "-s", "-o", "/dev/null", "-w", "%{http_code}", "-m", "1",
+        absl::StrCat("http://localhost:", port, "/health")
+    }, health_options);
+    return firstOutputLine(health) == "200";
+}
+
+// Poll /health until the model answers or the deadline passes
+bool waitForModelReady(int port, int timeout_seconds) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(timeout_seconds);
+    while (std::chrono::steady_clock::now() < deadline) {
+        if (checkModelHealth(port)) {
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::seconds(2));
+    }
+    return false;
+}
+
 void checkVLLMHealth() {
     // Clean up stale metrics first
     cleanupStaleModelMetrics();
@@ -348,37 +520,33 @@ void checkVLLMHealth() {
         return;
     }
     
+    SubprocessOptions health_options;
+    health_options.timeout_seconds = 2;
+    health_options.merge_stderr = true;
+    SubprocessResult health;
     for (const auto& model : models) {
         
         // Check /health endpoint
-        std::string health_cmd = absl::StrCat(
-            "timeout 2 curl -s -w '\\nHTTP_CODE:%{http_code}' -m 1 http://localhost:", model.port, "/health 2>&1"
-        );
+        runSubprocess({
+            "curl", "-s", "-w", "\nHTTP_CODE:%{http_code}", "-m", "1",
+            absl::StrCat("http://localhost:", model.port, "/health")
+        }, health_options, health);
+        if (!health.started) {
+            LOG_WARN("Failed to execute health check for " + model.model_id);
+            continue;
+        }
         
-        FILE* health_pipe = popen(health_cmd.c_str(), "r");
-        if (health_pipe) {
-            char buffer[512];
-            std::string output;
-            std::string http_code;
-            while (fgets(buffer, sizeof(buffer), health_pipe)) {
-                std::string line(buffer);
-                if (line.find("HTTP_CODE:") != std::string::npos) {
-                    size_t pos = line.find("HTTP_CODE:") + 10;
-                    http_code = line.substr(pos);
-                    http_code.erase(http_code.find_last_not_of(" \t\n\r") + 1);
-                } else {
-                    output += line;
-                }
-            }
-            pclose(health_pipe);
-            
-            if (http_code == "200") {
-                LOG_DEBUG("vLLM health check OK: " + model.model_id + " on port " + std::to_string(model.port));
-            } else {
-                LOG_WARN("vLLM health check failed: " + model.model_id + " on port " + std::to_string(model.port) + " (HTTP " + http_code + ")");
-            }
+        std::string http_code;
+        size_t code_pos = health.output.rfind("HTTP_CODE:");
+        if (code_pos != std::string::npos) {
+            http_code = health.output.substr(code_pos + 10);
+            http_code.erase(http_code.find_last_not_of(" \t\n\r") + 1);
+        }
+        
+        if (http_code == "200") {
+            LOG_DEBUG("vLLM health check OK: " + model.model_id + " on port " + std::to_string(model.port));
         } else {
-            LOG_WARN("Failed to execute health check for " + model.model_id);
+            LOG_WARN("vLLM health check failed: " + model.model_id + " on port " + std::to_string(model.port) + " (HTTP " + http_code + ")");
         }
     }
 }
@@ -1,89 +1,268 @@
 #include "services/nsight_utils.h"
-#include <cstdio>
+#include "utils/env_utils.h"
+#include "utils/subprocess.h"
+#include <algorithm>
+#include <map>
 #include <string>
 #include <absl/strings/str_cat.h>
 
-NsightMetrics getNsightMetrics(unsigned int pid) {
-    NsightMetrics metrics{};
-    metrics.atomic_operations = 0;
-    metrics.threads_per_block = 0;
-    metrics.occupancy = 0.0;
-    metrics.active_blocks = 0;
-    metrics.memory_throughput = 0;
-    metrics.dram_read_bytes = 0;
-    metrics.dram_write_bytes = 0;
-    metrics.available = false;
-    
-    FILE* ncu_check = popen("which ncu > /dev/null 2>&1", "r");
-    if (!ncu_check) {
-        return metrics;
+static const char* METRIC_ATOMICS = "sm__sass_thread_inst_executed_op_atom_pred_on.sum";
+static const char* METRIC_OCCUPANCY = "sm__warps_active.avg.pct_of_peak_sustained_active";
+static const char* METRIC_DRAM_READ = "dram__bytes_read.sum";
+static const char* METRIC_DRAM_WRITE = "dram__bytes_write.sum";
+static const char* METRIC_DURATION = "gpu__time_duration.sum";
+static const char* METRIC_DRAM_THROUGHPUT = "dram__throughput.avg.pct_of_peak_sustained_elapsed";
+static const char* METRIC_SM_THROUGHPUT = "sm__throughput.avg.pct_of_peak_sustained_elapsed";
+static const char* METRIC_BLOCK_SIZE = "launch__block_size";
+static const char* METRIC_GRID_SIZE = "launch__grid_size";
+
+static const size_t MAX_NCU_OUTPUT_BYTES = 64 * 1024 * 1024;
+
+// Split one CSV line, honouring quoted fields ("a,b") and doubled quotes
+static std::vector<std::string> splitCsvLine(const std::string& line) {
+    std::vector<std::string> fields;
+    std::string field;
+    bool quoted = false;
+    for (size_t i = 0; i < line.size(); ++i) {
+        char c = line[i];
+        if (quoted) {
+            if (c == '"' && i + 1 < line.size() && line[i + 1] == '"') {
+                field += '"';
+                ++i;
+            } else if (c == '"') {
+                quoted = false;
+            } else {
+                field += c;
+            }
+        } else if (c == '"') {
+            quoted = true;
+        } else if (c == ',') {
+            fields.push_back(field);
+            field.clear();
+        } else if (c != '\r' && c != '\n') {
+            field += c;
+        }
     }
-    int ncu_available = pclose(ncu_check);
-    if (ncu_available != 0) {
-        return metrics;
+    fields.push_back(field);
+    return fields;
+}
+
+// ncu prints numbers with thousands separators ("1,048,576") unless told otherwise
+static double parseNcuNumber(const std::string& value) {
+    std::string digits;
+    for (char c : value) {
+        if (c != ',' && c != ' ') digits += c;
     }
-    
-    std::string cmd = absl::StrCat(
-        "timeout 2 ncu --target-processes ", pid,
-        " --metrics sm__sass_thread_inst_executed_op_atom_pred_on.sum,sm__thread_inst_executed.sum,sm__warps_active.avg.pct_of_peak_sustained_active,dram__bytes_read.sum,dram__bytes_write.sum",
-        " --print-gpu-trace --csv 2>/dev/null | tail -30"
-    );
-    
-    FILE* ncu_output = popen(cmd.c_str(), "r");
-    if (!ncu_output) {
-        return metrics;
+    if (digits.empty()) return 0.0;
+    try {
+        return std::stod(digits);
+    } catch (...) {
+        return 0.0;
     }
-    
-    char line[1024];
-    while (fgets(line, sizeof(line), ncu_output)) {
-        std::string line_str(line);
-        if (line_str.find("sm__sass_thread_inst_executed_op_atom") != std::string::npos) {
-            size_t last_space = line_str.find_last_of(" \t,");
-            if (last_space != std::string::npos) {
-                try {
-                    metrics.atomic_operations = std::stoull(line_str.substr(last_space + 1));
-                } catch (...) {}
-            }
+}
+
+// "(256, 1, 1)" -> 256; a plain number is returned as is
+static unsigned long long parseLaunchDims(const std::string& value) {
+    if (value.find('(') == std::string::npos) {
+        return static_cast<unsigned long long>(parseNcuNumber(value));
+    }
+    unsigned long long product = 1;
+    std::string dim;
+    for (char c : value) {
+        if (c >= '0' && c <= '9') {
+            dim += c;
+        } else if (!dim.empty()) {
+            product *= std::stoull(dim);
+            dim.clear();
         }
-        if (line_str.find("launch__threads_per_block") != std::string::npos) {
-            size_t last_space = line_str.find_last_of(" \t,");
-            if (last_space != std::string::npos) {
-                try {
-                    metrics.threads_per_block = std::stoull(line_str.substr(last_space + 1));
-                } catch (...) {}
+    }
+    if (!dim.empty()) product *= std::stoull(dim);
+    return product;
+}
+
+static void applyMetric(KernelProfile& kernel, const std::string& name, const std::string& value) {
+    if (name == METRIC_ATOMICS) {
+        kernel.atomic_operations = static_cast<unsigned long long>(parseNcuNumber(value));
+    } else if (name == METRIC_OCCUPANCY) {
+        kernel.occupancy = parseNcuNumber(value);
+    } else if (name == METRIC_DRAM_READ) {
+        kernel.dram_read_bytes = static_cast<unsigned long long>(parseNcuNumber(value));
+    } else if (name == METRIC_DRAM_WRITE) {
+        kernel.dram_write_bytes = static_cast<unsigned long long>(parseNcuNumber(value));
+    } else if (name == METRIC_DURATION) {
+        kernel.duration_ns = static_cast<unsigned long long>(parseNcuNumber(value));
+    } else if (name == METRIC_DRAM_THROUGHPUT) {
+        kernel.dram_throughput_pct = parseNcuNumber(value);
+    } else if (name == METRIC_SM_THROUGHPUT) {
+        kernel.sm_throughput_pct = parseNcuNumber(value);
+    } else if (name == METRIC_BLOCK_SIZE) {
+        kernel.block_size = parseLaunchDims(value);
+    } else if (name == METRIC_GRID_SIZE) {
+        kernel.grid_size = parseLaunchDims(value);
+    }
+}
+
+std::vector<KernelProfile> parseNcuCsv(const std::string& csv) {
+    std::vector<KernelProfile> kernels;
+    std::map<std::string, size_t> kernel_by_id;  // Details layout: launch ID -> index into kernels
+    std::map<std::string, size_t> columns;
+    bool details_layout = false;
+
+    size_t pos = 0;
+    while (pos < csv.size()) {
+        size_t end = csv.find('\n', pos);
+        if (end == std::string::npos) end = csv.size();
+        std::string line = csv.substr(pos, end - pos);
+        pos = end + 1;
+        if (line.empty() || line[0] != '"') continue;  // ==PROF== log lines and application output
+
+        std::vector<std::string> fields = splitCsvLine(line);
+        if (!fields.empty() && fields[0] == "ID") {
+            columns.clear();
+            for (size_t i = 0; i < fields.size(); ++i) {
+                columns[fields[i]] = i;
             }
+            details_layout = columns.count("Metric Name") && columns.count("Metric Value");
+            continue;
         }
-        if (line_str.find("sm__warps_active") != std::string::npos) {
-            size_t last_space = line_str.find_last_of(" \t,");
-            if (last_space != std::string::npos) {
-                try {
-                    metrics.occupancy = std::stod(line_str.substr(last_space + 1));
-                } catch (...) {}
+        if (columns.empty() || !columns.count("Kernel Name")) continue;
+
+        auto field = [&](const std::string& column) -> std::string {
+            auto it = columns.find(column);
+            return it != columns.end() && it->second < fields.size() ? fields[it->second] : "";
+        };
+
+        // The raw layout has a units row under the header
+        std::string id = field("ID");
+        if (id.empty() || id.find_first_not_of("0123456789") != std::string::npos) continue;
+
+        KernelProfile* kernel = nullptr;
+        if (details_layout) {
+            auto existing = kernel_by_id.find(id);
+            if (existing != kernel_by_id.end()) {
+                kernel = &kernels[existing->second];
             }
         }
-        if (line_str.find("dram__bytes_read") != std::string::npos) {
-            size_t last_space = line_str.find_last_of(" \t,");
-            if (last_space != std::string::npos) {
-                try {
-                    metrics.dram_read_bytes = std::stoull(line_str.substr(last_space + 1));
-                } catch (...) {}
-            }
+        if (!kernel) {
+            kernels.push_back(KernelProfile{});
+            kernel = &kernels.back();
+            kernel->kernel_name = field("Kernel Name");
+            kernel->block_size = parseLaunchDims(field("Block Size"));
+            kernel->grid_size = parseLaunchDims(field("Grid Size"));
+            if (details_layout) kernel_by_id[id] = kernels.size() - 1;
         }
-        if (line_str.find("dram__bytes_write") != std::string::npos) {
-            size_t last_space = line_str.find_last_of(" \t,");
-            if (last_space != std::string::npos) {
-                try {
-                    metrics.dram_write_bytes = std::stoull(line_str.substr(last_space + 1));
-                } catch (...) {}
+
+        if (details_layout) {
+            applyMetric(*kernel, field("Metric Name"), field("Metric Value"));
+        } else {
+            for (const auto& [name, index] : columns) {
+                if (index < fields.size()) applyMetric(*kernel, name, fields[index]);
             }
         }
     }
-    pclose(ncu_output);
-    
-    if (metrics.atomic_operations > 0 || metrics.threads_per_block > 0) {
-        metrics.available = true;
+    return kernels;
+}
+
+std::vector<KernelSummary> summarizeKernels(const std::vector<KernelProfile>& kernels) {
+    struct Accumulator {
+        KernelSummary summary;
+        double occupancy_weighted = 0.0, dram_weighted = 0.0, sm_weighted = 0.0;
+        double occupancy_sum = 0.0, dram_sum = 0.0, sm_sum = 0.0;
+    };
+    std::map<std::string, Accumulator> by_name;
+
+    for (const auto& kernel : kernels) {
+        Accumulator& acc = by_name[kernel.kernel_name];
+        KernelSummary& summary = acc.summary;
+        summary.kernel_name = kernel.kernel_name;
+        summary.launches++;
+        summary.block_size = kernel.block_size;
+        summary.grid_size = kernel.grid_size;
+        summary.total_duration_ns += kernel.duration_ns;
+        summary.dram_read_bytes += kernel.dram_read_bytes;
+        summary.dram_write_bytes += kernel.dram_write_bytes;
+        summary.atomic_operations += kernel.atomic_operations;
+        acc.occupancy_weighted += kernel.occupancy * kernel.duration_ns;
+        acc.dram_weighted += kernel.dram_throughput_pct * kernel.duration_ns;
+        acc.sm_weighted += kernel.sm_throughput_pct * kernel.duration_ns;
+        acc.occupancy_sum += kernel.occupancy;
+        acc.dram_sum += kernel.dram_throughput_pct;
+        acc.sm_sum += kernel.sm_throughput_pct;
+    }
+
+    std::vector<KernelSummary> summaries;
+    for (auto& [name, acc] : by_name) {
+        KernelSummary& summary = acc.summary;
+        // Without durations every launch counts the same
+        if (summary.total_duration_ns > 0) {
+            double duration = static_cast<double>(summary.total_duration_ns);
+            summary.avg_occupancy = acc.occupancy_weighted / duration;
+            summary.avg_dram_throughput_pct = acc.dram_weighted / duration;
+            summary.avg_sm_throughput_pct = acc.sm_weighted / duration;
+        } else {
+            summary.avg_occupancy = acc.occupancy_sum / summary.launches;
+            summary.avg_dram_throughput_pct = acc.dram_sum / summary.launches;
+            summary.avg_sm_throughput_pct = acc.sm_sum / summary.launches;
+        }
+        summary.memory_bound = summary.avg_dram_throughput_pct > summary.avg_sm_throughput_pct;
+        summaries.push_back(summary);
     }
-    
+
+    std::sort(summaries.begin(), summaries.end(), [](const KernelSummary& a, const KernelSummary& b) {
+        if (a.total_duration_ns != b.total_duration_ns) return a.total_duration_ns > b.total_duration_ns;
+        return a.launches > b.launches;
+    });
+    return summaries;
+}
+
+NsightMetrics aggregateNsightMetrics(const std::vector<KernelProfile>& kernels) {
+    NsightMetrics metrics{};
+    if (kernels.empty()) {
+        return metrics;
+    }
+
+    unsigned long long total_duration_ns = 0;
+    double occupancy_weighted = 0.0;
+    double occupancy_sum = 0.0;
+    for (const auto& kernel : kernels) {
+        metrics.atomic_operations += kernel.atomic_operations;
+        metrics.dram_read_bytes += kernel.dram_read_bytes;
+        metrics.dram_write_bytes += kernel.dram_write_bytes;
+        total_duration_ns += kernel.duration_ns;
+        occupancy_weighted += kernel.occupancy * kernel.duration_ns;
+        occupancy_sum += kernel.occupancy;
+    }
+
+    std::vector<KernelSummary> summaries = summarizeKernels(kernels);
+    metrics.threads_per_block = summaries.front().block_size;  // Of the kernel that ran longest
+    if (total_duration_ns > 0) {
+        metrics.occupancy = occupancy_weighted / total_duration_ns;
+        // Bytes per second across the traced kernels
+        metrics.memory_throughput = static_cast<unsigned long long>(
+            (metrics.dram_read_bytes + metrics.dram_write_bytes) * 1e9 / total_duration_ns);
+    } else {
+        metrics.occupancy = occupancy_sum / kernels.size();
+    }
+    metrics.available = true;
     return metrics;
 }
 
+bool collectKernelProfiles(unsigned int pid, std::vector<KernelProfile>& kernels) {
+    SubprocessOptions options;
+    options.timeout_seconds = getEnvInt("NSIGHT_TIMEOUT_SECONDS", 2);
+    options.max_output_bytes = MAX_NCU_OUTPUT_BYTES;
+    SubprocessResult ncu = runSubprocess({
+        "ncu", "--target-processes", std::to_string(pid),
+        "--metrics", absl::StrCat(METRIC_ATOMICS, ",", METRIC_OCCUPANCY, ",", METRIC_DRAM_READ, ",", METRIC_DRAM_WRITE,
+                                  ",", METRIC_DURATION, ",", METRIC_DRAM_THROUGHPUT, ",", METRIC_SM_THROUGHPUT,
+                                  ",", METRIC_BLOCK_SIZE, ",", METRIC_GRID_SIZE),
+        "--print-gpu-trace", "--csv", "--print-units", "base"
+    }, options);
+    // Not installed; a run cut off at the deadline still parses whatever rows it printed
+    if (!ncu.started) {
+        return false;
+    }
+
+    kernels = parseNcuCsv(ncu.output);
+    return !kernels.empty();
+}
@@ -0,0 +1,156 @@
+#include "services/gpu_backend.h"
+#include <iostream>
+#include <string>
+#include <vector>
+#ifdef NVML_AVAILABLE
+#include <nvml.h>
+#endif
+
+class NvmlBackend : public GpuTelemetryBackend {
+public:
+    std::string name() const override { return "nvml"; }
+
+    bool init() override {
+#ifdef NVML_AVAILABLE
+        nvmlReturn_t result = nvmlInit();
+        if (result != NVML_SUCCESS) {
+            std::cerr << "[NVML] Initialization failed (error code: " << result << ")" << std::endl;
+            if (result == NVML_ERROR_DRIVER_NOT_LOADED) {
+                std::cerr << "[NVML] Driver not loaded. Try: sudo modprobe nvidia" << std::endl;
+            } else if (result == NVML_ERROR_LIBRARY_NOT_FOUND) {
+                std::cerr << "[NVML] Library not found. Install: sudo apt install -y nvidia-utils-535" << std::endl;
+            } else if (result == NVML_ERROR_NO_PERMISSION) {
+                std::cerr << "[NVML] Permission denied. Try running as root or add user to video group" << std::endl;
+            } else {
+                std::cerr << "[NVML] Check: 1) NVIDIA drivers installed? 2) GPU present? 3) nvidia-smi works?" << std::endl;
+                std::cerr << "[NVML] If 'Driver/library version mismatch': Reboot or reinstall drivers" << std::endl;
+            }
+            return false;
+        }
+        
+        unsigned int deviceCount = 0;
+        result = nvmlDeviceGetCount(&deviceCount);
+        if (result != NVML_SUCCESS) {
+            std::cerr << "[NVML] Failed to get device count (error code: " << result << ")" << std::endl;
+            nvmlShutdown();
+            return false;
+        }
+        
+        if (deviceCount == 0) {
+            std::cerr << "[NVML] No GPU devices found" << std::endl;
+            nvmlShutdown();
+            return false;
+        }
+        
+        std::cout << "[NVML] Found " << deviceCount << " GPU device(s)" << std::endl;
+        
+        devices.clear();
+        for (unsigned int i = 0; i < deviceCount; ++i) {
+            nvmlDevice_t device = nullptr;
+            result = nvmlDeviceGetHandleByIndex(i, &device);
+            if (result != NVML_SUCCESS) {
+                std::cerr << "[NVML] Failed to get handle for device " << i << " (error code: " << result << ")" << std::endl;
+                devices.clear();
+                nvmlShutdown();
+                return false;
+            }
+            devices.push_back(device);
+        }
+        
+        std::cout << "[NVML] Initialized successfully" << std::endl;
+        return true;
+#else
+        std::cerr << "[NVML] NVML not available (compiled without NVML support)" << std::endl;
+        std::cerr << "[NVML] Install: sudo apt install -y libnvidia-ml-dev, or set GPU_BACKEND=simulated" << std::endl;
+        return false;
+#endif
+    }
+
+    void shutdown() override {
+#ifdef NVML_AVAILABLE
+        nvmlShutdown();
+        devices.clear();
+#endif
+    }
+
+    unsigned int deviceCount() const override {
+#ifdef NVML_AVAILABLE
+        return static_cast<unsigned int>(devices.size());
+#else
+        return 0;
+#endif
+    }
+
+    GPUDeviceInfo queryDevice(unsigned int index) override {
+        GPUDeviceInfo info{index, "", "", 0, 0, 0, 0};
+#ifdef NVML_AVAILABLE
+        nvmlDevice_t device = devices[index];
+        
+        char name[NVML_DEVICE_NAME_BUFFER_SIZE] = {0};
+        if (nvmlDeviceGetName(device, name, sizeof(name)) == NVML_SUCCESS) {
+            info.name = name;
+        }
+        char uuid[NVML_DEVICE_UUID_BUFFER_SIZE] = {0};
+        if (nvmlDeviceGetUUID(device, uuid, sizeof(uuid)) == NVML_SUCCESS) {
+            info.uuid = uuid;
+        }
+        
+        nvmlMemory_t memory;
+        if (nvmlDeviceGetMemoryInfo(device, &memory) == NVML_SUCCESS) {
+            info.total = memory.total;
+            info.used = memory.used;
+            info.free = memory.free;
+        }
+        
+        // A zero-sized query only reports how many processes are running
+        unsigned int processCount = 0;
+        nvmlReturn_t result = nvmlDeviceGetComputeRunningProcesses(device, &processCount, nullptr);
+        if (result == NVML_SUCCESS || result == NVML_ERROR_INSUFFICIENT_SIZE) {
+            info.process_count = processCount;
+        }
+#endif
+        return info;
+    }
+
+    std::vector<ProcessMemory> queryProcesses(unsigned int index) override {
+        std::vector<ProcessMemory> result;
+#ifdef NVML_AVAILABLE
+        // Size the list from a zero-sized query; if processes start in between, NVML reports
+        // the new count and the query is repeated with room for it
+        unsigned int processCount = 0;
+        nvmlReturn_t status = nvmlDeviceGetComputeRunningProcesses(devices[index], &processCount, nullptr);
+        std::vector<nvmlProcessInfo_t> processes;
+        for (int attempt = 0; attempt < 3 && status == NVML_ERROR_INSUFFICIENT_SIZE; ++attempt) {
+            processCount += 4;
+            processes.resize(processCount);
+            status = nvmlDeviceGetComputeRunningProcesses(devices[index], &processCount, processes.data());
+        }
+        if (status == NVML_SUCCESS) {
+            for (unsigned int i = 0; i < processCount; ++i) {
+                ProcessMemory pm;
+                pm.pid = processes[i].pid;
+                // Filled in from the process table, which caches /proc lookups
+                pm.name = "";
+                pm.used_bytes = processes[i].usedGpuMemory;
+                pm.reserved_bytes = processes[i].usedGpuMemory;
+                pm.gpu_index = index;
+                result.push_back(pm);
+            }
+        }
+#else
+        (void)index;
+#endif
+        return result;
+    }
+
+    bool hasHostProcesses() const override { return true; }
+
+private:
+#ifdef NVML_AVAILABLE
+    std::vector<nvmlDevice_t> devices;
+#endif
+};
+
+std::unique_ptr<GpuTelemetryBackend> createNvmlBackend() {
+    return std::make_unique<NvmlBackend>();
+}
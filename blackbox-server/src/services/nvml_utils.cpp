@@ -1,8 +1,13 @@
 #include "services/nvml_utils.h"
+#include "services/gpu_backend.h"
+#include "services/process_table.h"
+#include "services/block_map.h"
+#include "services/vram_tracker.h"
 #include "services/vllm_client.h"
-#include "services/nsight_utils.h"
+#include "services/profile_queue.h"
 #include "services/model_manager.h"
 #include "utils/logger.h"
+#include "utils/stage_timer.h"
 #include <iostream>
 #include <cstdio>
 #include <cstdlib>
@@ -10,199 +15,264 @@
 #include <algorithm>
 #include <map>
 #include <sstream>
+#include <set>
+#include <mutex>
+#include <future>
 #include <absl/strings/str_cat.h>
-#ifdef NVML_AVAILABLE
-#include <nvml.h>
-#endif
 
-#ifdef NVML_AVAILABLE
-static nvmlDevice_t g_device = nullptr;
-#else
-static void* g_device = nullptr;
-#endif
 static bool g_nvml_initialized = false;
+static std::mutex g_nvml_mutex;
+
+// Collections in progress, by resolved section mask; callers arriving meanwhile wait for the result
+static std::map<unsigned int, std::shared_future<std::shared_ptr<const PublishedSnapshot>>> g_collections_in_flight;
+static std::mutex g_collections_mutex;
 
 bool initNVML() {
+    std::lock_guard<std::mutex> lock(g_nvml_mutex);
     if (g_nvml_initialized) return true;
-#ifdef NVML_AVAILABLE
-    nvmlReturn_t result = nvmlInit();
-    if (result != NVML_SUCCESS) {
-        std::cerr << "[NVML] Initialization failed (error code: " << result << ")" << std::endl;
-        if (result == NVML_ERROR_DRIVER_NOT_LOADED) {
-            std::cerr << "[NVML] Driver not loaded. Try: sudo modprobe nvidia" << std::endl;
-        } else if (result == NVML_ERROR_LIBRARY_NOT_FOUND) {
-            std::cerr << "[NVML] Library not found. Install: sudo apt install -y nvidia-utils-535" << std::endl;
-        } else if (result == NVML_ERROR_NO_PERMISSION) {
-            std::cerr << "[NVML] Permission denied. Try running as root or add user to video group" << std::endl;
-        } else {
-            std::cerr << "[NVML] Check: 1) NVIDIA drivers installed? 2) GPU present? 3) nvidia-smi works?" << std::endl;
-            std::cerr << "[NVML] If 'Driver/library version mismatch': Reboot or reinstall drivers" << std::endl;
-        }
-        return false;
-    }
-    
-    unsigned int deviceCount = 0;
-    result = nvmlDeviceGetCount(&deviceCount);
-    if (result != NVML_SUCCESS) {
-        std::cerr << "[NVML] Failed to get device count (error code: " << result << ")" << std::endl;
-        nvmlShutdown();
-        return false;
-    }
-    
-    if (deviceCount == 0) {
-        std::cerr << "[NVML] No GPU devices found" << std::endl;
-        nvmlShutdown();
-        return false;
-    }
-    
-    std::cout << "[NVML] Found " << deviceCount << " GPU device(s)" << std::endl;
-    
-    result = nvmlDeviceGetHandleByIndex(0, &g_device);
-    if (result != NVML_SUCCESS) {
-        std::cerr << "[NVML] Failed to get device handle (error code: " << result << ")" << std::endl;
-        nvmlShutdown();
-        return false;
-    }
-    
-    g_nvml_initialized = true;
-    std::cout << "[NVML] Initialized successfully" << std::endl;
-    return true;
-#else
-    std::cerr << "[NVML] NVML not available (compiled without NVML support)" << std::endl;
-    std::cerr << "[NVML] Install: sudo apt install -y libnvidia-ml-dev" << std::endl;
-    return false;
-#endif
+    g_nvml_initialized = getGpuTelemetryBackend().init();
+    return g_nvml_initialized;
 }
 
 void shutdownNVML() {
+    std::lock_guard<std::mutex> lock(g_nvml_mutex);
     if (g_nvml_initialized) {
-#ifdef NVML_AVAILABLE
-        nvmlShutdown();
-#endif
+        getGpuTelemetryBackend().shutdown();
         g_nvml_initialized = false;
-        g_device = nullptr;
     }
 }
 
-DetailedVRAMInfo getDetailedVRAMUsage() {
-    DetailedVRAMInfo detailed = {0, 0, 0, 0, {}, {}, {}, 0, 0, 0, 0ULL, 0.0, {}, 0ULL, 0.0, {}};
+unsigned int getGPUDeviceCount() {
+    if (!initNVML()) return 0;
+    return getGpuTelemetryBackend().deviceCount();
+}
+
+struct DeviceSnapshot {
+    GPUDeviceInfo info;
+    std::vector<ProcessMemory> processes;
+};
+
+static DeviceSnapshot collectDeviceSnapshot(GpuTelemetryBackend* backend, unsigned int index, bool include_processes) {
+    ScopedStageTimer timer("nvml_device");
+    DeviceSnapshot snapshot;
+    snapshot.info = backend->queryDevice(index);
+    if (include_processes) {
+        snapshot.processes = backend->queryProcesses(index);
+    }
+    return snapshot;
+}
+
+// Query every device; each device gets its own task on multi-GPU nodes
+static std::vector<DeviceSnapshot> collectAllDevices(bool include_processes) {
+    GpuTelemetryBackend& backend = getGpuTelemetryBackend();
+    unsigned int device_count = backend.deviceCount();
+    std::vector<DeviceSnapshot> snapshots;
+    backend.beginSnapshot();
+    if (device_count == 1) {
+        snapshots.push_back(collectDeviceSnapshot(&backend, 0, include_processes));
+        return snapshots;
+    }
+    std::vector<std::future<DeviceSnapshot>> pending;
+    for (unsigned int i = 0; i < device_count; ++i) {
+        pending.push_back(std::async(std::launch::async, collectDeviceSnapshot, &backend, i, include_processes));
+    }
+    for (auto& task : pending) {
+        snapshots.push_back(task.get());
+    }
+    return snapshots;
+}
+
+std::vector<GPUDeviceInfo> getGPUDevices() {
+    std::vector<GPUDeviceInfo> devices;
     if (!initNVML()) {
-        return detailed;
+        return devices;
     }
-#ifdef NVML_AVAILABLE
-    nvmlMemory_t memory;
-    if (nvmlDeviceGetMemoryInfo(g_device, &memory) == NVML_SUCCESS) {
-        detailed.total = memory.total;
-        detailed.used = memory.used;
-        detailed.free = memory.free;
-        detailed.reserved = memory.used;
+    for (auto& snapshot : collectAllDevices(false)) {
+        devices.push_back(snapshot.info);
     }
+    return devices;
+}
 
-    unsigned int processCount = 64;
-    nvmlProcessInfo_t processes[64];
-    unsigned long long total_atomic_allocations = 0;
+struct SectionInfo {
+    SnapshotSection section;
+    const char* name;
+    unsigned int depends_on;
+};
+
+static const SectionInfo SNAPSHOT_SECTIONS[] = {
+    {SNAPSHOT_PROCESSES, "processes", SNAPSHOT_CORE},
+    {SNAPSHOT_BLOCKS, "blocks", SNAPSHOT_CORE},
+    {SNAPSHOT_NSIGHT, "nsight", SNAPSHOT_PROCESSES},    // Picks vLLM processes by name
+    {SNAPSHOT_THREADS, "threads", SNAPSHOT_PROCESSES},
+};
+
+unsigned int parseSnapshotSections(const std::string& include) {
+    unsigned int sections = SNAPSHOT_CORE;
+    std::istringstream names(include);
+    std::string name;
+    while (std::getline(names, name, ',')) {
+        for (const auto& info : SNAPSHOT_SECTIONS) {
+            if (name == info.name || name == "all") sections |= info.section;
+        }
+    }
+    return sections;
+}
+
+unsigned int resolveSnapshotSections(unsigned int sections) {
+    unsigned int resolved = sections;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (const auto& info : SNAPSHOT_SECTIONS) {
+            if ((resolved & info.section) && (resolved | info.depends_on) != resolved) {
+                resolved |= info.depends_on;
+                changed = true;
+            }
+        }
+    }
+    return resolved;
+}
+
+DetailedVRAMInfo getDetailedVRAMUsage(unsigned int sections) {
+    return collectVRAMSnapshot(sections)->info;
+}
+
+std::shared_ptr<const PublishedSnapshot> getRecentVRAMSnapshot(unsigned int sections, std::chrono::milliseconds max_age) {
+    sections = resolveSnapshotSections(sections);
+    double age_seconds = 0.0;
+    std::shared_ptr<const PublishedSnapshot> latest = getPublishedSnapshot(sections, age_seconds);
+    if (latest && age_seconds * 1000.0 <= max_age.count()) {
+        return latest;
+    }
     
-    if (nvmlDeviceGetComputeRunningProcesses(g_device, &processCount, processes) == NVML_SUCCESS) {
-        for (unsigned int i = 0; i < processCount; ++i) {
-            ProcessMemory pm;
-            pm.pid = processes[i].pid;
-            pm.used_bytes = processes[i].usedGpuMemory;
-            pm.reserved_bytes = processes[i].usedGpuMemory;
-            
-            total_atomic_allocations += processes[i].usedGpuMemory;
-            
-            char name[256] = {0};
-            FILE* fp = fopen(absl::StrCat("/proc/", pm.pid, "/comm").c_str(), "r");
-            if (fp) {
-                if (fgets(name, sizeof(name), fp)) {
-                    pm.name = name;
-                    if (!pm.name.empty() && pm.name.back() == '\n') {
-                        pm.name.pop_back();
-                    }
-                } else {
-                    pm.name = "unknown";
-                }
-                fclose(fp);
-            } else {
-                pm.name = "unknown";
+    std::shared_future<std::shared_ptr<const PublishedSnapshot>> pending;
+    std::promise<std::shared_ptr<const PublishedSnapshot>> collected;
+    {
+        std::lock_guard<std::mutex> lock(g_collections_mutex);
+        auto running = g_collections_in_flight.find(sections);
+        if (running != g_collections_in_flight.end()) {
+            pending = running->second;
+        } else {
+            g_collections_in_flight[sections] = collected.get_future().share();
+        }
+    }
+    if (pending.valid()) {
+        return pending.get();
+    }
+    
+    auto finish = [&]() {
+        std::lock_guard<std::mutex> lock(g_collections_mutex);
+        g_collections_in_flight.erase(sections);
+    };
+    try {
+        std::shared_ptr<const PublishedSnapshot> snapshot = collectVRAMSnapshot(sections);
+        collected.set_value(snapshot);
+        finish();
+        return snapshot;
+    } catch (...) {
+        collected.set_exception(std::current_exception());
+        finish();
+        throw;
+    }
+}
+
+std::shared_ptr<const PublishedSnapshot> collectVRAMSnapshot(unsigned int sections) {
+    ScopedStageTimer snapshot_timer("snapshot");
+    DetailedVRAMInfo detailed{};
+    if (!initNVML()) {
+        // Not published, so /metrics keeps reporting that no snapshot exists
+        auto empty = std::make_shared<PublishedSnapshot>();
+        empty->info = detailed;
+        return empty;
+    }
+    sections = resolveSnapshotSections(sections);
+    detailed.sections = sections;
+    unsigned long long total_atomic_allocations = 0;
+    std::map<unsigned int, unsigned long long> device_totals;
+    {
+        ScopedStageTimer timer("nvml");
+        for (auto& snapshot : collectAllDevices(true)) {
+            detailed.total += snapshot.info.total;
+            detailed.used += snapshot.info.used;
+            detailed.free += snapshot.info.free;
+            device_totals[snapshot.info.index] = snapshot.info.total;
+            for (const auto& pm : snapshot.processes) {
+                total_atomic_allocations += pm.used_bytes;
+                detailed.processes.push_back(pm);
             }
-            detailed.processes.push_back(pm);
-            
-            // Only try to get nsight metrics for vLLM/python processes to avoid hanging
-            // Skip nsight metrics collection if it might be slow
+            detailed.gpus.push_back(snapshot.info);
+        }
+    }
+    detailed.reserved = detailed.used;
+
+    // Names, containers and models come from the process table; only PIDs new to
+    // the GPU since the last sample are read from /proc. The process list itself is
+    // part of every snapshot because per-model VRAM is attributed from it.
+    GpuTelemetryBackend& backend = getGpuTelemetryBackend();
+    bool host_processes = backend.hasHostProcesses();
+    std::vector<std::string> process_models(detailed.processes.size());
+    if (host_processes) {
+        ScopedStageTimer timer("process_table");
+        std::vector<unsigned int> live_pids;
+        for (const auto& pm : detailed.processes) {
+            live_pids.push_back(pm.pid);
+        }
+        refreshProcessTable(live_pids);
+        for (size_t i = 0; i < detailed.processes.size(); ++i) {
+            ProcessMetadata metadata = lookupProcess(detailed.processes[i].pid);
+            detailed.processes[i].name = metadata.name;
+            process_models[i] = metadata.model_id;
+        }
+    } else {
+        // PIDs that only exist in the backend (simulated) are described by it
+        for (size_t i = 0; i < detailed.processes.size(); ++i) {
+            ProcessMetadata metadata = backend.describeProcess(detailed.processes[i].pid);
+            if (!metadata.name.empty()) detailed.processes[i].name = metadata.name;
+            process_models[i] = metadata.model_id;
+        }
+    }
+
+    // Only profile vLLM/python processes, and only the first few; TP workers are listed once per device.
+    // ncu runs on the profile queue, so the snapshot only carries results cached from earlier runs
+    if ((sections & SNAPSHOT_NSIGHT) && host_processes) {
+        ScopedStageTimer timer("nsight");
+        std::vector<unsigned int> nsight_pids;
+        for (const auto& pm : detailed.processes) {
+            if (nsight_pids.size() >= 3) break;
             if (pm.name.find("python") != std::string::npos || 
                 pm.name.find("vllm") != std::string::npos ||
                 pm.name.find("VLLM") != std::string::npos) {
-                // Only collect for first few processes to avoid hanging
-                if (detailed.processes.size() <= 3) {
-                    NsightMetrics nsight = getNsightMetrics(pm.pid);
-                    if (nsight.available) {
-                        detailed.nsight_metrics[pm.pid] = nsight;
-                    }
+                if (std::find(nsight_pids.begin(), nsight_pids.end(), pm.pid) == nsight_pids.end()) {
+                    nsight_pids.push_back(pm.pid);
                 }
             }
         }
+        scheduleProfiles(nsight_pids);
+        detailed.nsight_metrics = getCachedProfiles(nsight_pids);
     }
 
     // Fetch per-model block data
-    std::vector<ModelBlockData> models_data = fetchPerModelBlockData();
+    std::vector<ModelBlockData> models_data = backend.queryModelBlockData();
     
     unsigned int total_allocated_blocks = 0;
     unsigned int total_utilized_blocks = 0;
     
-    // Get deployed models to match processes to containers (only running ones)
-    auto all_deployed_models = listDeployedModels();
-    std::vector<DeployedModel> deployed_models;
-    for (const auto& model : all_deployed_models) {
-        if (model.running) {
-            deployed_models.push_back(model);
-        }
+    std::set<std::string> reporting_models;
+    for (const auto& model_data : models_data) {
+        reporting_models.insert(model_data.model_id);
     }
     
     // Create a map of model_id -> process memory for block size calculation
-    // Match processes to models by checking which container they belong to
+    // Match processes to models by the container their cgroup belongs to
     std::map<std::string, unsigned long long> model_memory;
-    for (const auto& pm : detailed.processes) {
-        if (pm.name.find("python") != std::string::npos || 
-            pm.name.find("vllm") != std::string::npos ||
-            pm.name.find("VLLM") != std::string::npos) {
-            // Check process's cgroup to find container
-            std::ostringstream cgroup_cmd;
-            cgroup_cmd << "cat /proc/" << pm.pid << "/cgroup 2>/dev/null | grep docker";
-            FILE* cgroup_pipe = popen(cgroup_cmd.str().c_str(), "r");
-            if (cgroup_pipe) {
-                char cgroup_line[512];
-                if (fgets(cgroup_line, sizeof(cgroup_line), cgroup_pipe)) {
-                    std::string cgroup(cgroup_line);
-                    // Extract container ID from cgroup path
-                    size_t docker_pos = cgroup.find("/docker/");
-                    if (docker_pos != std::string::npos) {
-                        size_t container_start = docker_pos + 8;
-                        size_t container_end = cgroup.find("/", container_start);
-                        if (container_end == std::string::npos) {
-                            container_end = cgroup.find("\n", container_start);
-                        }
-                        if (container_end != std::string::npos) {
-                            std::string container_id = cgroup.substr(container_start, container_end - container_start);
-                            // Find which model this container belongs to
-                            for (const auto& deployed : deployed_models) {
-                                if (deployed.container_id.find(container_id) == 0 || container_id.find(deployed.container_id) == 0) {
-                                    // Match found - use the model_id from models_data that matches
-                                    for (const auto& model_data : models_data) {
-                                        if (model_data.model_id == deployed.model_id) {
-                                            // Sum up memory for all processes in this model
-                                            model_memory[model_data.model_id] += pm.used_bytes;
-                                            break;
-                                        }
-                                    }
-                                    break;
-                                }
-                            }
-                        }
-                    }
-                }
-                pclose(cgroup_pipe);
-            }
+    std::map<std::string, std::set<unsigned int>> model_gpus;
+    for (size_t i = 0; i < detailed.processes.size(); ++i) {
+        const auto& pm = detailed.processes[i];
+        const std::string& model_id = process_models[i];
+        if (!model_id.empty() && reporting_models.count(model_id)) {
+            // Sum up memory for all processes in this model
+            model_memory[model_id] += pm.used_bytes;
+            model_gpus[model_id].insert(pm.gpu_index);
         }
     }
     
@@ -215,6 +285,25 @@ DetailedVRAMInfo getDetailedVRAMUsage() {
         model_info.port = model_data.port;
         model_info.allocated_vram_bytes = 0;
         model_info.used_kv_cache_bytes = 0;
+        model_info.num_gpu_blocks = model_data.num_gpu_blocks;
+        model_info.kv_cache_usage_perc = model_data.kv_cache_usage_perc;
+        model_info.prefix_cache_hit_rate = model_data.prefix_cache_hit_rate;
+        model_info.num_requests_running = model_data.num_requests_running;
+        model_info.num_requests_waiting = model_data.num_requests_waiting;
+        model_info.num_preemptions_total = model_data.num_preemptions_total;
+        model_info.gpu_memory_utilization = model_data.gpu_memory_utilization;
+        // vLLM sizes CPU swap with the same block layout, so swap bytes / CPU blocks is the KV block size
+        model_info.kv_block_bytes = (model_data.num_cpu_blocks > 0 && model_data.swap_space_gib > 0.0) ?
+            static_cast<unsigned long long>(model_data.swap_space_gib * 1024.0 * 1024.0 * 1024.0 / model_data.num_cpu_blocks) : 0;
+        // vLLM applies gpu_memory_utilization per device, so sizing works against the GPUs this model spans
+        model_info.gpu_total_bytes = 0;
+        auto model_gpu_it = model_gpus.find(model_data.model_id);
+        if (model_gpu_it != model_gpus.end()) {
+            for (unsigned int gpu_index : model_gpu_it->second) {
+                model_info.gpu_indices.push_back(gpu_index);
+                model_info.gpu_total_bytes += device_totals[gpu_index];
+            }
+        }
         
         LOG_DEBUG("Processing model " + model_data.model_id + ": available=" + (model_data.available ? "true" : "false") + 
                  ", num_gpu_blocks=" + std::to_string(model_data.num_gpu_blocks) +
@@ -267,18 +356,10 @@ DetailedVRAMInfo getDetailedVRAMUsage() {
             LOG_DEBUG("Model " + model_data.model_id + ": final allocated_vram_bytes=" + std::to_string(model_info.allocated_vram_bytes) +
                      ", used_kv_cache_bytes=" + std::to_string(model_info.used_kv_cache_bytes));
             
-            // Create blocks for this model
-            for (unsigned int i = 0; i < model_data.num_gpu_blocks; ++i) {
-                MemoryBlock block;
-                block.block_id = i;
-                block.address = 0;
-                block.size = calculated_block_size;
-                block.type = "kv_cache";
-                block.allocated = true;
-                block.utilized = (i < model_utilized);
-                block.model_id = model_data.model_id;
-                block.port = model_data.port;
-                detailed.blocks.push_back(block);
+            // Block state as contiguous runs; per-block records are only built on request (/vram/blocks)
+            if (sections & SNAPSHOT_BLOCKS) {
+                detailed.block_maps.push_back(buildModelBlockMap(model_data.model_id, model_data.port, calculated_block_size,
+                                                                 model_data.num_gpu_blocks, model_utilized));
             }
             
             total_allocated_blocks += model_data.num_gpu_blocks;
@@ -347,7 +428,7 @@ DetailedVRAMInfo getDetailedVRAMUsage() {
             }
         }
     }
-#endif
-    return detailed;
+    
+    return publishVRAMSnapshot(std::move(detailed));
 }
 
@@ -1,20 +1,74 @@
 #include "services/optimization_service.h"
 #include "services/model_manager.h"
-#include "services/hf_deploy.h"
-#include "services/vram_tracker.h"
+#include "services/rolling_restart.h"
 #include "utils/env_utils.h"
+#include "utils/query_utils.h"
 #include "utils/logger.h"
-#include <yaml-cpp/yaml.h>
+#include "utils/http_io.h"
 #include <nlohmann/json.hpp>
 #include <boost/beast/core.hpp>
 #include <boost/beast/http.hpp>
-#include <sstream>
 #include <string>
 #include <vector>
-#include <fstream>
-#include <algorithm>
 
-void handleOptimizeRequest(http::request<http::string_body>& req, tcp::socket& socket) {
+static void writeResponse(http::response<http::string_body>& res, ClientSocket& socket) {
+    res.prepare_payload();
+    try {
+        writeHttpMessage(socket, res);
+    } catch (const boost::system::system_error& e) {
+        auto ec = e.code();
+        if (ec == boost::asio::error::broken_pipe || 
+            ec == boost::asio::error::connection_reset ||
+            ec == boost::asio::error::eof) {
+            return;
+        }
+        throw;
+    }
+}
+
+static nlohmann::json outcomeToJson(const RestartOutcome& outcome) {
+    nlohmann::json outcome_json;
+    outcome_json["container_name"] = outcome.container_name;
+    outcome_json["model_id"] = outcome.model_id;
+    outcome_json["success"] = outcome.success;
+    outcome_json["rolled"] = outcome.rolled;
+    outcome_json["old_port"] = outcome.old_port;
+    outcome_json["new_port"] = outcome.new_port;
+    outcome_json["gpu_memory_utilization"] = outcome.new_utilization;
+    outcome_json["message"] = outcome.message;
+    outcome_json["skipped"] = outcome.skipped;
+    return outcome_json;
+}
+
+static nlohmann::json recommendationToJson(const SizingRecommendation& rec) {
+    nlohmann::json rec_json;
+    rec_json["container_name"] = rec.container_name;
+    rec_json["model_id"] = rec.model_id;
+    rec_json["basis"] = rec.basis;
+    rec_json["action"] = rec.action;
+    rec_json["samples"] = rec.samples;
+    rec_json["current_utilization"] = rec.current_utilization;
+    rec_json["target_utilization"] = rec.target_utilization;
+    rec_json["kv_usage_p50"] = rec.kv_usage_p50;
+    rec_json["kv_usage_p95"] = rec.kv_usage_p95;
+    rec_json["kv_usage_p99"] = rec.kv_usage_p99;
+    rec_json["kv_usage_forecast"] = rec.kv_usage_forecast;
+    rec_json["preemptions_per_minute"] = rec.preemptions_per_minute;
+    rec_json["requests_running_p95"] = rec.requests_running_p95;
+    rec_json["kv_block_bytes"] = rec.kv_block_bytes;
+    rec_json["num_gpu_blocks"] = rec.num_gpu_blocks;
+    rec_json["target_gpu_blocks"] = rec.target_gpu_blocks;
+    rec_json["projected_savings_bytes"] = rec.projected_savings_bytes;
+    return rec_json;
+}
+
+void handleOptimizeRequest(http::request<http::string_body>& req, ClientSocket& socket) {
+    std::string target = std::string(req.target());
+    std::string dry_run = getQueryParam(target, "dry_run");
+    std::string mode = getQueryParam(target, "mode");
+    if (mode.empty()) mode = getEnvValue("OPTIMIZE_MODE", "in_place");
+    RestartStrategy strategy = parseRestartStrategy(mode);
+    
     OptimizationResult opt_result = optimizeModelAllocations();
     
     http::response<http::string_body> res;
@@ -22,91 +76,118 @@ void handleOptimizeRequest(http::request<http::string_body>& req, tcp::socket& s
     res.keep_alive(req.keep_alive());
     res.set(http::field::content_type, "application/json");
     
+    if (dry_run == "true" || dry_run == "1") {
+        nlohmann::json dry_run_json;
+        dry_run_json["success"] = true;
+        dry_run_json["dry_run"] = true;
+        dry_run_json["optimized"] = false;
+        dry_run_json["message"] = opt_result.optimized ?
+            "Would restart " + std::to_string(opt_result.targets.size()) + " model(s)" : opt_result.message;
+        dry_run_json["projected_savings_bytes"] = opt_result.projected_savings_bytes;
+        dry_run_json["restarted_models"] = opt_result.restarted_models;
+        nlohmann::json recs_json = nlohmann::json::array();
+        for (const auto& rec : opt_result.recommendations) {
+            recs_json.push_back(recommendationToJson(rec));
+        }
+        dry_run_json["recommendations"] = recs_json;
+        res.result(http::status::ok);
+        res.body() = dry_run_json.dump();
+        writeResponse(res, socket);
+        return;
+    }
+    
     if (!opt_result.optimized) {
         res.result(http::status::ok);
         res.body() = R"({"success":true,"optimized":false,"message":")" + opt_result.message + R"("})";
-        res.prepare_payload();
-        http::write(socket, res);
+        writeResponse(res, socket);
         return;
     }
     
+    nlohmann::json response_json;
+    response_json["success"] = true;
+    response_json["optimized"] = true;
+    response_json["mode"] = restartStrategyName(strategy);
+    response_json["projected_savings_bytes"] = opt_result.projected_savings_bytes;
+    
+    if (strategy == RestartStrategy::ROLLING) {
+        // Rolling restarts take as long as a cold start; run them in the background
+        std::string job_id = submitOptimizationJob(opt_result.targets, strategy);
+        response_json["message"] = "Rolling restart of " + std::to_string(opt_result.targets.size()) + " model(s) started";
+        response_json["job_id"] = job_id;
+        response_json["restarted_models"] = opt_result.restarted_models;
+        res.result(http::status::accepted);
+        res.set(http::field::location, "/jobs/" + job_id);
+        res.body() = response_json.dump();
+        writeResponse(res, socket);
+        return;
+    }
+    
+    std::vector<RestartOutcome> outcomes = executeOptimizationPlan(opt_result.targets, strategy);
     std::vector<std::string> restarted;
-    for (const auto& container_name : opt_result.restarted_models) {
-        auto models = listDeployedModels();
-        std::string model_id;
-        std::string gpu_type;
-        double peak_usage = 0.0;
-        
-        for (const auto& m : models) {
-            if (m.container_name == container_name) {
-                model_id = m.model_id;
-                gpu_type = m.gpu_type;
-                peak_usage = m.peak_vram_usage_percent / 100.0;
-                break;
-            }
-        }
-        
-        if (model_id.empty()) continue;
-        
-        spindownModel(container_name);
-        
-        std::string hf_token = getEnvValue("HF_TOKEN");
-        if (gpu_type.empty()) gpu_type = detectGPUType();
-        std::string config_path = getConfigPathForGPU(gpu_type);
-        
-        if (peak_usage < 0.1) peak_usage = 0.1;
-        if (peak_usage > 0.95) peak_usage = 0.95;
-        
-        std::string temp_config = "/tmp/optimized_" + container_name + ".yaml";
-        try {
-            // Load existing config
-            YAML::Node config = YAML::LoadFile(config_path);
-            
-            // Update gpu-memory-utilization
-            config["gpu-memory-utilization"] = peak_usage;
-            
-            // Write updated config with proper YAML formatting
-            std::ofstream dst(temp_config);
-            YAML::Emitter emitter;
-            emitter << config;
-            dst << emitter.c_str();
-            dst.close();
-        } catch (const YAML::Exception& e) {
-            LOG_ERROR("Failed to parse or update YAML config: " + std::string(e.what()));
-            // Fallback: copy original file
-            std::ifstream src(config_path);
-            std::ofstream dst(temp_config);
-            dst << src.rdbuf();
-            src.close();
-            dst.close();
-        }
-        
-        DeployResponse deploy_res = deployHFModel(model_id, hf_token, 8000, gpu_type, temp_config);
-        if (deploy_res.success) {
-            restarted.push_back(container_name);
+    nlohmann::json outcomes_json = nlohmann::json::array();
+    for (const auto& outcome : outcomes) {
+        if (outcome.success) {
+            restarted.push_back(outcome.container_name);
         }
+        outcomes_json.push_back(outcomeToJson(outcome));
     }
     
-    nlohmann::json response_json;
-    response_json["success"] = true;
-    response_json["optimized"] = true;
     response_json["message"] = "Optimized " + std::to_string(restarted.size()) + " model(s)";
     response_json["restarted_models"] = restarted;
+    response_json["outcomes"] = outcomes_json;
     
     res.result(http::status::ok);
     res.body() = response_json.dump();
-    res.prepare_payload();
+    writeResponse(res, socket);
+}
+
+void handleJobStatusRequest(http::request<http::string_body>& req, ClientSocket& socket) {
+    std::string target = std::string(req.target());
+    std::string job_id = target.substr(std::string("/jobs/").length());
+    job_id = job_id.substr(0, job_id.find('?'));
     
-    try {
-        http::write(socket, res);
-    } catch (const boost::system::system_error& e) {
-        auto ec = e.code();
-        if (ec == boost::asio::error::broken_pipe || 
-            ec == boost::asio::error::connection_reset ||
-            ec == boost::asio::error::eof) {
-            return;
-        }
-        throw;
+    http::response<http::string_body> res;
+    res.version(req.version());
+    res.keep_alive(req.keep_alive());
+    res.set(http::field::content_type, "application/json");
+    
+    OptimizationJob job;
+    if (!getOptimizationJob(job_id, job)) {
+        res.result(http::status::not_found);
+        nlohmann::json error_json;
+        error_json["success"] = false;
+        error_json["message"] = "Unknown job: " + job_id;
+        res.body() = error_json.dump();
+        writeResponse(res, socket);
+        return;
     }
+    
+    nlohmann::json job_json;
+    job_json["job_id"] = job.id;
+    job_json["status"] = job.status;
+    job_json["mode"] = job.strategy;
+    job_json["started_at"] = job.started_at;
+    job_json["finished_at"] = job.finished_at;
+    
+    nlohmann::json targets_json = nlohmann::json::array();
+    for (const auto& t : job.targets) {
+        nlohmann::json target_json;
+        target_json["container_name"] = t.container_name;
+        target_json["model_id"] = t.model_id;
+        target_json["port"] = t.port;
+        target_json["current_utilization"] = t.current_utilization;
+        target_json["target_utilization"] = t.target_utilization;
+        targets_json.push_back(target_json);
+    }
+    job_json["targets"] = targets_json;
+    
+    nlohmann::json outcomes_json = nlohmann::json::array();
+    for (const auto& outcome : job.outcomes) {
+        outcomes_json.push_back(outcomeToJson(outcome));
+    }
+    job_json["outcomes"] = outcomes_json;
+    
+    res.result(http::status::ok);
+    res.body() = job_json.dump();
+    writeResponse(res, socket);
 }
-
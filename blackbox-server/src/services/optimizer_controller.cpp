@@ -0,0 +1,175 @@
+#include "services/optimizer_controller.h"
+#include "services/model_manager.h"
+#include "services/rolling_restart.h"
+#include "utils/env_utils.h"
+#include "utils/logger.h"
+#include <absl/strings/str_cat.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <deque>
+#include <map>
+#include <set>
+#include <thread>
+
+using ControllerClock = std::chrono::steady_clock;
+
+struct ControllerConfig {
+    int interval_seconds;       // OPTIMIZER_INTERVAL, default 30
+    int shrink_dwell_seconds;   // OPTIMIZER_DWELL_SECONDS, default 600
+    int grow_dwell_seconds;     // OPTIMIZER_GROW_DWELL_SECONDS, default 60
+    int max_restarts_per_hour;  // OPTIMIZER_MAX_RESTARTS_PER_HOUR, default 2
+    RestartStrategy strategy;   // OPTIMIZER_MODE, default rolling
+};
+
+struct PendingRecommendation {
+    std::string action;
+    double target_utilization;
+    ControllerClock::time_point since;
+};
+
+static std::map<std::string, PendingRecommendation> pending_recommendations;
+static std::deque<ControllerClock::time_point> restart_history;
+
+static ControllerConfig loadControllerConfig() {
+    ControllerConfig config;
+    config.interval_seconds = std::max(5, getEnvInt("OPTIMIZER_INTERVAL", 30));
+    config.shrink_dwell_seconds = std::max(0, getEnvInt("OPTIMIZER_DWELL_SECONDS", 600));
+    config.grow_dwell_seconds = std::max(0, getEnvInt("OPTIMIZER_GROW_DWELL_SECONDS", 60));
+    config.max_restarts_per_hour = std::max(0, getEnvInt("OPTIMIZER_MAX_RESTARTS_PER_HOUR", 2));
+    config.strategy = parseRestartStrategy(getEnvValue("OPTIMIZER_MODE", "rolling"));
+    return config;
+}
+
+static std::string describeInputs(const SizingRecommendation& rec) {
+    return absl::StrCat("basis=", rec.basis,
+                        " samples=", rec.samples,
+                        " kv_p50=", rec.kv_usage_p50,
+                        " kv_p99=", rec.kv_usage_p99,
+                        " kv_forecast=", rec.kv_usage_forecast,
+                        " preemptions/min=", rec.preemptions_per_minute,
+                        " running_p95=", rec.requests_running_p95,
+                        " utilization=", rec.current_utilization, "->", rec.target_utilization,
+                        " savings_bytes=", rec.projected_savings_bytes);
+}
+
+static void runControllerTick(const ControllerConfig& config, double min_change) {
+    OptimizationResult result = optimizeModelAllocations();
+
+    auto now = ControllerClock::now();
+    while (!restart_history.empty() && now - restart_history.front() > std::chrono::hours(1)) {
+        restart_history.pop_front();
+    }
+
+    std::map<std::string, SizingRecommendation> ready;
+    std::set<std::string> seen;
+    for (const auto& rec : result.recommendations) {
+        seen.insert(rec.container_name);
+        std::string inputs = describeInputs(rec);
+
+        if (rec.action == "keep") {
+            if (pending_recommendations.erase(rec.container_name)) {
+                LOG_INFO("Optimizer: " + rec.container_name + " recommendation withdrawn (" + inputs + ")");
+            } else {
+                LOG_DEBUG("Optimizer: keep " + rec.container_name + " (" + inputs + ")");
+            }
+            continue;
+        }
+
+        auto pending = pending_recommendations.find(rec.container_name);
+        if (pending == pending_recommendations.end() || pending->second.action != rec.action ||
+            std::fabs(pending->second.target_utilization - rec.target_utilization) >= min_change) {
+            pending_recommendations[rec.container_name] = PendingRecommendation{rec.action, rec.target_utilization, now};
+            LOG_INFO("Optimizer: " + rec.action + " recommended for " + rec.container_name + ", starting dwell (" + inputs + ")");
+            continue;
+        }
+        pending->second.target_utilization = rec.target_utilization;
+
+        // Growing protects against preemption, so it is allowed to act sooner than shrinking
+        int dwell = rec.action == "grow" ? config.grow_dwell_seconds : config.shrink_dwell_seconds;
+        auto held = std::chrono::duration_cast<std::chrono::seconds>(now - pending->second.since).count();
+        if (held < dwell) {
+            LOG_INFO(absl::StrCat("Optimizer: hold ", rec.action, " of ", rec.container_name, " (held ", held, "s of ", dwell, "s, ", inputs, ")"));
+            continue;
+        }
+        ready[rec.container_name] = rec;
+    }
+
+    for (auto it = pending_recommendations.begin(); it != pending_recommendations.end();) {
+        it = seen.count(it->first) ? std::next(it) : pending_recommendations.erase(it);
+    }
+
+    if (ready.empty()) return;
+
+    std::vector<OptimizationTarget> targets;
+    for (const auto& target : result.targets) {
+        if (!ready.count(target.container_name)) continue;
+        // A restart started by /optimize or a rolling job is still running; retry on a later tick
+        if (isRestartInProgress(target.container_name)) {
+            LOG_INFO("Optimizer: " + target.container_name + " is being restarted by another optimization, deferring");
+            continue;
+        }
+        targets.push_back(target);
+    }
+    if (targets.empty()) return;
+
+    // Grow first, then the largest reclaim, when the hourly restart cap cuts the list short
+    std::sort(targets.begin(), targets.end(), [&](const OptimizationTarget& a, const OptimizationTarget& b) {
+        const auto& ra = ready[a.container_name];
+        const auto& rb = ready[b.container_name];
+        if ((ra.action == "grow") != (rb.action == "grow")) return ra.action == "grow";
+        return std::llabs(ra.projected_savings_bytes) > std::llabs(rb.projected_savings_bytes);
+    });
+
+    int remaining = config.max_restarts_per_hour - static_cast<int>(restart_history.size());
+    if (remaining <= 0) {
+        LOG_INFO(absl::StrCat("Optimizer: ", targets.size(), " restart(s) due but the cap of ",
+                              config.max_restarts_per_hour, " per hour is reached"));
+        return;
+    }
+    if (static_cast<int>(targets.size()) > remaining) {
+        for (size_t i = remaining; i < targets.size(); ++i) {
+            LOG_INFO("Optimizer: deferring " + targets[i].container_name + " (hourly restart cap)");
+        }
+        targets.resize(remaining);
+    }
+
+    for (const auto& target : targets) {
+        LOG_INFO("Optimizer: acting on " + target.container_name + " (" + describeInputs(ready[target.container_name]) + ")");
+    }
+
+    std::vector<RestartOutcome> outcomes = executeOptimizationPlan(targets, config.strategy);
+    for (const auto& outcome : outcomes) {
+        if (outcome.skipped) {
+            LOG_INFO("Optimizer: " + outcome.container_name + " was claimed by another optimization, deferring");
+            continue;
+        }
+        restart_history.push_back(ControllerClock::now());
+        pending_recommendations.erase(outcome.container_name);
+        LOG_INFO("Optimizer: " + outcome.container_name + (outcome.success ? " restarted: " : " restart failed: ") + outcome.message);
+    }
+}
+
+void startOptimizerController() {
+    std::string enabled = getEnvValue("OPTIMIZER_CONTROLLER", "false");
+    if (enabled != "true" && enabled != "1" && enabled != "yes") {
+        return;
+    }
+
+    ControllerConfig config = loadControllerConfig();
+    double min_change = loadSizingConfig().min_change;
+    std::thread([config, min_change]() {
+        while (true) {
+            std::this_thread::sleep_for(std::chrono::seconds(config.interval_seconds));
+            try {
+                runControllerTick(config, min_change);
+            } catch (const std::exception& e) {
+                LOG_ERROR("Optimizer controller error: " + std::string(e.what()));
+            }
+        }
+    }).detach();
+    LOG_INFO(absl::StrCat("Started optimizer controller (every ", config.interval_seconds, "s, dwell ",
+                          config.shrink_dwell_seconds, "s/", config.grow_dwell_seconds, "s shrink/grow, max ",
+                          config.max_restarts_per_hour, " restarts/hour, ", restartStrategyName(config.strategy), ")"));
+}
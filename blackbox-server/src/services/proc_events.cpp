@@ -0,0 +1,164 @@
+#include "services/proc_events.h"
+#include "services/process_table.h"
+#include "utils/env_utils.h"
+#include "utils/logger.h"
+#include <linux/cn_proc.h>
+#include <linux/connector.h>
+#include <linux/netlink.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <thread>
+
+static std::atomic<bool> events_active{false};
+
+static constexpr size_t RECEIVE_BUFFER_SIZE = 16384;
+
+static int openProcConnector() {
+    int sock = socket(PF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_CONNECTOR);
+    if (sock < 0) {
+        LOG_DEBUG("Proc connector socket failed: " + std::string(strerror(errno)));
+        return -1;
+    }
+    
+    sockaddr_nl address{};
+    address.nl_family = AF_NETLINK;
+    address.nl_groups = CN_IDX_PROC;
+    address.nl_pid = 0;  // Let the kernel pick a port ID
+    if (bind(sock, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+        LOG_DEBUG("Proc connector bind failed: " + std::string(strerror(errno)));
+        close(sock);
+        return -1;
+    }
+    
+    alignas(nlmsghdr) char request[NLMSG_SPACE(sizeof(cn_msg) + sizeof(proc_cn_mcast_op))] = {};
+    nlmsghdr* header = reinterpret_cast<nlmsghdr*>(request);
+    header->nlmsg_len = NLMSG_LENGTH(sizeof(cn_msg) + sizeof(proc_cn_mcast_op));
+    header->nlmsg_type = NLMSG_DONE;
+    cn_msg* message = reinterpret_cast<cn_msg*>(NLMSG_DATA(header));
+    message->id.idx = CN_IDX_PROC;
+    message->id.val = CN_VAL_PROC;
+    message->len = sizeof(proc_cn_mcast_op);
+    proc_cn_mcast_op op = PROC_CN_MCAST_LISTEN;
+    memcpy(message->data, &op, sizeof(op));
+    if (send(sock, request, header->nlmsg_len, 0) < 0) {
+        LOG_DEBUG("Proc connector subscribe failed: " + std::string(strerror(errno)));
+        close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+// Dispatch every event in one datagram; returns true if it contained an exit of watch_pid
+static bool dispatchEvents(const char* buffer, ssize_t length, pid_t watch_pid) {
+    bool saw_watched_exit = false;
+    for (const nlmsghdr* header = reinterpret_cast<const nlmsghdr*>(buffer);
+         NLMSG_OK(header, static_cast<unsigned int>(length));
+         header = NLMSG_NEXT(header, length)) {
+        if (header->nlmsg_type == NLMSG_ERROR || header->nlmsg_type == NLMSG_NOOP) continue;
+        const cn_msg* message = reinterpret_cast<const cn_msg*>(NLMSG_DATA(header));
+        if (message->id.idx != CN_IDX_PROC || message->id.val != CN_VAL_PROC) continue;
+        const proc_event* event = reinterpret_cast<const proc_event*>(message->data);
+        
+        switch (event->what) {
+            case proc_event::PROC_EVENT_EXIT:
+                // Thread exits are reported too; only the thread group leader ends the process
+                if (event->event_data.exit.process_pid == event->event_data.exit.process_tgid) {
+                    handleProcessExit(static_cast<unsigned int>(event->event_data.exit.process_tgid));
+                    if (event->event_data.exit.process_tgid == watch_pid) saw_watched_exit = true;
+                }
+                break;
+            case proc_event::PROC_EVENT_EXEC:
+                handleProcessExec(static_cast<unsigned int>(event->event_data.exec.process_tgid));
+                break;
+            default:
+                // Forked children show up in NVML output before they matter
+                break;
+        }
+    }
+    return saw_watched_exit;
+}
+
+// The subscription succeeds without CAP_NET_ADMIN on some kernels but delivers
+// nothing, so confirm that the exit of a short-lived child actually arrives
+static bool verifyEventsFlow(int sock) {
+    timeval timeout{1, 0};
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    
+    pid_t child = fork();
+    if (child < 0) return false;
+    if (child == 0) {
+        _exit(0);
+    }
+    waitpid(child, nullptr, 0);
+    
+    alignas(nlmsghdr) char buffer[RECEIVE_BUFFER_SIZE];
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+    bool verified = false;
+    while (!verified && std::chrono::steady_clock::now() < deadline) {
+        ssize_t length = recv(sock, buffer, sizeof(buffer), 0);
+        if (length <= 0) {
+            if (length < 0 && errno == EINTR) continue;
+            break;
+        }
+        verified = dispatchEvents(buffer, length, child);
+    }
+    
+    timeval no_timeout{0, 0};
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &no_timeout, sizeof(no_timeout));
+    return verified;
+}
+
+static void receiveEvents(int sock) {
+    alignas(nlmsghdr) char buffer[RECEIVE_BUFFER_SIZE];
+    while (true) {
+        ssize_t length = recv(sock, buffer, sizeof(buffer), 0);
+        if (length < 0) {
+            if (errno == EINTR) continue;
+            if (errno == ENOBUFS) {
+                // The kernel dropped events; the next sample re-checks /proc once
+                LOG_WARN("Proc connector overflowed, resyncing process table");
+                requestProcessTableResync();
+                continue;
+            }
+            LOG_ERROR("Proc connector receive failed: " + std::string(strerror(errno)) + ", falling back to polling");
+            break;
+        }
+        if (length == 0) continue;
+        dispatchEvents(buffer, length, 0);
+    }
+    events_active = false;
+    setProcessTableEventDriven(false);
+    close(sock);
+}
+
+bool startProcessEventListener() {
+    std::string mode = getEnvValue("PROC_EVENTS", "auto");
+    if (mode == "false" || mode == "off" || mode == "0") {
+        LOG_INFO("Process events disabled, polling /proc for process changes");
+        return false;
+    }
+    
+    int sock = openProcConnector();
+    if (sock < 0 || !verifyEventsFlow(sock)) {
+        if (sock >= 0) close(sock);
+        LOG_INFO("Proc connector unavailable (needs CAP_NET_ADMIN), polling /proc for process changes");
+        return false;
+    }
+    
+    events_active = true;
+    setProcessTableEventDriven(true);
+    std::thread(receiveEvents, sock).detach();
+    LOG_INFO("Tracking process exec/exit events via the proc connector");
+    return true;
+}
+
+bool processEventsActive() {
+    return events_active;
+}
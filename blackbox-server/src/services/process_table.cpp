@@ -0,0 +1,153 @@
+#include "services/process_table.h"
+#include "services/container_resolver.h"
+#include <atomic>
+#include <fstream>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <unordered_map>
+#include <absl/strings/str_cat.h>
+
+struct ProcessEntry {
+    ProcessMetadata metadata;
+    unsigned long long model_generation;  // Container -> model mapping the model_id was resolved with
+    bool live;                            // Listed by the GPU backend in the latest sample
+};
+
+static std::unordered_map<unsigned int, ProcessEntry> process_table;
+static std::mutex process_table_mutex;
+static std::atomic<bool> event_driven{false};
+static std::atomic<bool> resync_requested{false};
+
+static std::string readProcFile(unsigned int pid, const char* file) {
+    std::ifstream in(absl::StrCat("/proc/", pid, "/", file));
+    std::stringstream contents;
+    contents << in.rdbuf();
+    return contents.str();
+}
+
+static ProcessMetadata readProcessMetadata(unsigned int pid, unsigned long long start_time) {
+    ProcessMetadata metadata{pid, start_time, "unknown", "", "", ""};
+    
+    std::string comm = readProcFile(pid, "comm");
+    if (!comm.empty() && comm.back() == '\n') comm.pop_back();
+    if (!comm.empty()) metadata.name = comm;
+    
+    // Arguments are NUL-separated
+    metadata.cmdline = readProcFile(pid, "cmdline");
+    while (!metadata.cmdline.empty() && metadata.cmdline.back() == '\0') metadata.cmdline.pop_back();
+    for (char& c : metadata.cmdline) {
+        if (c == '\0') c = ' ';
+    }
+    
+    metadata.container_id = resolveContainerId(pid);
+    return metadata;
+}
+
+// Caller holds process_table_mutex
+static ProcessEntry& loadEntry(unsigned int pid, unsigned long long start_time) {
+    ProcessEntry& entry = process_table[pid];
+    entry.metadata = readProcessMetadata(pid, start_time);
+    entry.model_generation = ~0ULL;
+    return entry;
+}
+
+void refreshProcessTable(const std::vector<unsigned int>& live_pids) {
+    std::set<unsigned int> live(live_pids.begin(), live_pids.end());
+    // Exit events remove entries as they happen, so unless events were lost an
+    // entry in the table is always the process currently holding that PID
+    bool trust_table = event_driven && !resync_requested.exchange(false);
+    std::lock_guard<std::mutex> lock(process_table_mutex);
+    
+    for (unsigned int pid : live) {
+        auto it = process_table.find(pid);
+        if (it != process_table.end() && (it->second.live || trust_table)) {
+            // Still on the GPU since the last sample: same process
+            it->second.live = true;
+            continue;
+        }
+        // New, or back after an absence during which the PID may have been reused
+        unsigned long long start_time = readProcessStartTime(pid);
+        if (start_time == 0) {
+            // Exited (or not visible from this PID namespace) before we got to it
+            if (it != process_table.end()) process_table.erase(it);
+            continue;
+        }
+        if (it == process_table.end() || it->second.metadata.start_time != start_time) {
+            loadEntry(pid, start_time).live = true;
+        } else {
+            it->second.live = true;
+        }
+    }
+    
+    for (auto it = process_table.begin(); it != process_table.end();) {
+        if (live.count(it->first)) {
+            ++it;
+            continue;
+        }
+        // Off the GPU: keep the entry while the process exists, drop it once it has exited
+        it->second.live = false;
+        if (!trust_table && readProcessStartTime(it->first) != it->second.metadata.start_time) {
+            it = process_table.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+ProcessMetadata lookupProcess(unsigned int pid) {
+    unsigned long long generation = getContainerModelGeneration();
+    ProcessMetadata metadata;
+    unsigned long long resolved_generation;
+    {
+        std::lock_guard<std::mutex> lock(process_table_mutex);
+        auto it = process_table.find(pid);
+        ProcessEntry* entry = it != process_table.end() ? &it->second : nullptr;
+        if (!entry) {
+            unsigned long long start_time = readProcessStartTime(pid);
+            if (start_time == 0) {
+                return ProcessMetadata{pid, 0, "unknown", "", "", ""};
+            }
+            entry = &loadEntry(pid, start_time);
+            entry->live = false;
+        }
+        if (entry->model_generation == generation) {
+            return entry->metadata;
+        }
+        metadata = entry->metadata;
+        resolved_generation = entry->model_generation;
+    }
+    
+    // Resolving may list and inspect containers; other lookups and refreshes go on meanwhile
+    metadata.model_id = metadata.container_id.empty() ? "" : resolveContainerModel(metadata.container_id);
+    
+    // Stored only if the PID still belongs to the same process and no other lookup resolved it first
+    std::lock_guard<std::mutex> lock(process_table_mutex);
+    auto it = process_table.find(pid);
+    if (it != process_table.end() && it->second.metadata.start_time == metadata.start_time &&
+        it->second.model_generation == resolved_generation) {
+        it->second.metadata.model_id = metadata.model_id;
+        it->second.model_generation = generation;
+    }
+    return metadata;
+}
+
+void setProcessTableEventDriven(bool enabled) {
+    event_driven = enabled;
+    resync_requested = true;
+}
+
+void requestProcessTableResync() {
+    resync_requested = true;
+}
+
+void handleProcessExit(unsigned int pid) {
+    std::lock_guard<std::mutex> lock(process_table_mutex);
+    process_table.erase(pid);
+}
+
+void handleProcessExec(unsigned int pid) {
+    // Name and cmdline change on exec; reload on next sight
+    std::lock_guard<std::mutex> lock(process_table_mutex);
+    process_table.erase(pid);
+}
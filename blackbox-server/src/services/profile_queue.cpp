@@ -0,0 +1,270 @@
+#include "services/profile_queue.h"
+#include "services/nsight_utils.h"
+#include "services/container_resolver.h"
+#include "services/process_table.h"
+#include "utils/env_utils.h"
+#include "utils/logger.h"
+#include <absl/strings/str_cat.h>
+#include <algorithm>
+#include <condition_variable>
+#include <ctime>
+#include <deque>
+#include <iterator>
+#include <mutex>
+#include <thread>
+
+struct CachedProfile {
+    NsightMetrics metrics;
+    std::vector<KernelProfile> kernels;
+    std::string model_id;
+    unsigned long long start_time;  // Process the metrics belong to (see readProcessStartTime)
+};
+
+static std::map<std::string, ProfileJob> profile_jobs;
+static std::deque<std::string> pending_jobs;
+static std::map<unsigned int, std::string> latest_job_by_pid;
+static std::map<unsigned int, long long> last_requested;  // pid -> Unix seconds, for the cooldown
+static std::map<unsigned int, CachedProfile> cached_profiles;
+static std::mutex profile_mutex;
+static std::condition_variable profile_cv;
+static bool worker_started = false;
+static unsigned long long profile_counter = 0;
+static const size_t MAX_TRACKED_PROFILE_JOBS = 64;
+static const size_t MAX_CACHED_PROFILES = 64;
+
+static long long unixNow() {
+    return static_cast<long long>(std::time(nullptr));
+}
+
+// ncu replays the target's kernels, slowing it down; running one profile at a time bounds that cost
+static void runProfileWorker() {
+    while (true) {
+        std::string job_id;
+        unsigned int pid = 0;
+        {
+            std::unique_lock<std::mutex> lock(profile_mutex);
+            profile_cv.wait(lock, [] { return !pending_jobs.empty(); });
+            job_id = pending_jobs.front();
+            pending_jobs.pop_front();
+            auto it = profile_jobs.find(job_id);
+            if (it == profile_jobs.end()) continue;
+            it->second.status = "running";
+            it->second.started_at = unixNow();
+            pid = it->second.pid;
+        }
+
+        unsigned long long start_time = readProcessStartTime(pid);
+        NsightMetrics metrics{};
+        std::vector<KernelProfile> kernels;
+        std::string model_id;
+        std::string message;
+        if (start_time == 0) {
+            message = "Process has exited";
+        } else {
+            model_id = lookupProcess(pid).model_id;
+            try {
+                if (collectKernelProfiles(pid, kernels)) {
+                    metrics = aggregateNsightMetrics(kernels);
+                }
+            } catch (const std::exception& e) {
+                LOG_ERROR("Profile of PID " + std::to_string(pid) + " failed: " + std::string(e.what()));
+            }
+            message = metrics.available ?
+                absl::StrCat("Profiled ", kernels.size(), " kernel launch(es)") :
+                "No metrics collected (ncu unavailable or no kernel activity)";
+        }
+        metrics.collected_at = unixNow();
+
+        std::lock_guard<std::mutex> lock(profile_mutex);
+        if (metrics.available) {
+            cached_profiles[pid] = CachedProfile{metrics, kernels, model_id, start_time};
+        }
+        auto it = profile_jobs.find(job_id);
+        if (it == profile_jobs.end()) continue;
+        it->second.status = metrics.available ? "completed" : "failed";
+        it->second.message = message;
+        it->second.model_id = model_id;
+        it->second.metrics = metrics;
+        it->second.kernels = std::move(kernels);
+        it->second.finished_at = metrics.collected_at;
+        LOG_INFO("Profile job " + job_id + " for PID " + std::to_string(pid) + " " + it->second.status);
+    }
+}
+
+// Forget finished jobs and results of processes that have exited once the tables fill up
+static void pruneProfileState() {
+    while (profile_jobs.size() >= MAX_TRACKED_PROFILE_JOBS) {
+        auto oldest = profile_jobs.end();
+        for (auto it = profile_jobs.begin(); it != profile_jobs.end(); ++it) {
+            if (it->second.finished_at != 0 &&
+                (oldest == profile_jobs.end() || it->second.requested_at < oldest->second.requested_at)) {
+                oldest = it;
+            }
+        }
+        if (oldest == profile_jobs.end()) break;
+        auto latest = latest_job_by_pid.find(oldest->second.pid);
+        if (latest != latest_job_by_pid.end() && latest->second == oldest->first) {
+            latest_job_by_pid.erase(latest);
+        }
+        profile_jobs.erase(oldest);
+    }
+
+    if (cached_profiles.size() >= MAX_CACHED_PROFILES) {
+        for (auto it = cached_profiles.begin(); it != cached_profiles.end();) {
+            if (readProcessStartTime(it->first) != it->second.start_time) {
+                last_requested.erase(it->first);
+                it = cached_profiles.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    if (last_requested.size() >= MAX_CACHED_PROFILES) {
+        for (auto it = last_requested.begin(); it != last_requested.end();) {
+            it = readProcessStartTime(it->first) == 0 ? last_requested.erase(it) : std::next(it);
+        }
+    }
+}
+
+// Caller holds profile_mutex
+static ProfileSubmission submitProfileJobLocked(unsigned int pid) {
+    ProfileSubmission submission{"", "", 0};
+    long long now = unixNow();
+
+    auto latest = latest_job_by_pid.find(pid);
+    if (latest != latest_job_by_pid.end()) {
+        auto job = profile_jobs.find(latest->second);
+        if (job != profile_jobs.end() && job->second.finished_at == 0) {
+            submission.status = "pending";
+            submission.job_id = job->first;
+            return submission;
+        }
+    }
+
+    long long cooldown = getEnvInt("PROFILE_COOLDOWN_SECONDS", 300);
+    auto last = last_requested.find(pid);
+    if (last != last_requested.end() && now - last->second < cooldown) {
+        submission.status = "cooldown";
+        submission.job_id = latest != latest_job_by_pid.end() ? latest->second : "";
+        submission.retry_after = cooldown - (now - last->second);
+        return submission;
+    }
+
+    size_t max_queued = static_cast<size_t>(std::max(1, getEnvInt("PROFILE_QUEUE_MAX", 8)));
+    if (pending_jobs.size() >= max_queued) {
+        submission.status = "queue_full";
+        submission.retry_after = static_cast<long long>(pending_jobs.size()) * getEnvInt("NSIGHT_TIMEOUT_SECONDS", 2);
+        return submission;
+    }
+
+    pruneProfileState();
+
+    ProfileJob job{};
+    job.id = absl::StrCat("prof-", now, "-", ++profile_counter);
+    job.pid = pid;
+    job.status = "queued";
+    job.requested_at = now;
+    profile_jobs[job.id] = job;
+    latest_job_by_pid[pid] = job.id;
+    last_requested[pid] = now;
+    pending_jobs.push_back(job.id);
+
+    if (!worker_started) {
+        worker_started = true;
+        std::thread(runProfileWorker).detach();
+    }
+    profile_cv.notify_one();
+
+    submission.status = "queued";
+    submission.job_id = job.id;
+    return submission;
+}
+
+ProfileSubmission submitProfileJob(unsigned int pid) {
+    std::lock_guard<std::mutex> lock(profile_mutex);
+    ProfileSubmission submission = submitProfileJobLocked(pid);
+    LOG_DEBUG("Profile request for PID " + std::to_string(pid) + ": " + submission.status);
+    return submission;
+}
+
+bool getProfileJob(const std::string& job_id, ProfileJob& job) {
+    std::lock_guard<std::mutex> lock(profile_mutex);
+    auto it = profile_jobs.find(job_id);
+    if (it == profile_jobs.end()) return false;
+    job = it->second;
+    return true;
+}
+
+bool getLatestProfileJob(unsigned int pid, ProfileJob& job) {
+    std::lock_guard<std::mutex> lock(profile_mutex);
+    auto latest = latest_job_by_pid.find(pid);
+    if (latest == latest_job_by_pid.end()) return false;
+    auto it = profile_jobs.find(latest->second);
+    if (it == profile_jobs.end()) return false;
+    job = it->second;
+    return true;
+}
+
+void scheduleProfiles(const std::vector<unsigned int>& pids) {
+    std::lock_guard<std::mutex> lock(profile_mutex);
+    for (unsigned int pid : pids) {
+        submitProfileJobLocked(pid);
+    }
+}
+
+bool getModelProfileReport(const std::string& model_id, ModelProfileReport& report) {
+    std::vector<KernelProfile> kernels;
+    report = ModelProfileReport{model_id, {}, 0, {}, {}};
+    {
+        std::lock_guard<std::mutex> lock(profile_mutex);
+        for (const auto& [pid, cached] : cached_profiles) {
+            if (cached.model_id != model_id || readProcessStartTime(pid) != cached.start_time) continue;
+            report.pids.push_back(pid);
+            if (report.collected_at == 0 || cached.metrics.collected_at < report.collected_at) {
+                report.collected_at = cached.metrics.collected_at;
+            }
+            kernels.insert(kernels.end(), cached.kernels.begin(), cached.kernels.end());
+        }
+    }
+    if (report.pids.empty()) return false;
+    report.metrics = aggregateNsightMetrics(kernels);
+    report.metrics.collected_at = report.collected_at;
+    report.kernels = summarizeKernels(kernels);
+    return true;
+}
+
+std::map<unsigned int, NsightMetrics> getCachedProfiles(const std::vector<unsigned int>& pids) {
+    // Copy the entries out; lookupProcess may read /proc and takes the process table lock
+    std::map<unsigned int, std::pair<unsigned long long, NsightMetrics>> candidates;
+    {
+        std::lock_guard<std::mutex> lock(profile_mutex);
+        for (unsigned int pid : pids) {
+            auto it = cached_profiles.find(pid);
+            if (it != cached_profiles.end()) {
+                candidates[pid] = {it->second.start_time, it->second.metrics};
+            }
+        }
+    }
+
+    std::map<unsigned int, NsightMetrics> result;
+    std::vector<std::pair<unsigned int, unsigned long long>> reused;
+    for (const auto& [pid, candidate] : candidates) {
+        if (lookupProcess(pid).start_time != candidate.first) {
+            reused.emplace_back(pid, candidate.first);
+            continue;
+        }
+        result[pid] = candidate.second;
+    }
+
+    if (!reused.empty()) {
+        std::lock_guard<std::mutex> lock(profile_mutex);
+        for (const auto& [pid, start_time] : reused) {
+            // Only drop the entry that was checked, not one profiled since
+            auto it = cached_profiles.find(pid);
+            if (it != cached_profiles.end() && it->second.start_time == start_time) {
+                cached_profiles.erase(it);  // PID was reused
+            }
+        }
+    }
+    return result;
+}
@@ -0,0 +1,255 @@
+#include "services/profile_service.h"
+#include "services/profile_queue.h"
+#include "services/container_resolver.h"
+#include "services/nsight_utils.h"
+#include "services/nvml_utils.h"
+#include "services/vram_tracker.h"
+#include "utils/query_utils.h"
+#include "utils/logger.h"
+#include "utils/http_io.h"
+#include <nlohmann/json.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+#include <algorithm>
+#include <memory>
+#include <string>
+
+// Oldest published snapshot trusted for the GPU process check before collecting a new one
+static constexpr double PROCESS_CHECK_MAX_AGE_SECONDS = 5.0;
+
+static void writeResponse(http::response<http::string_body>& res, ClientSocket& socket) {
+    res.prepare_payload();
+    try {
+        writeHttpMessage(socket, res);
+    } catch (const boost::system::system_error& e) {
+        auto ec = e.code();
+        if (ec == boost::asio::error::broken_pipe || 
+            ec == boost::asio::error::connection_reset ||
+            ec == boost::asio::error::eof) {
+            return;
+        }
+        throw;
+    }
+}
+
+// PID from /profile/<pid>; false if the segment is not a number
+static bool parseProfilePid(const std::string& target, unsigned int& pid) {
+    std::string segment = target.substr(std::string("/profile/").length());
+    segment = segment.substr(0, segment.find('?'));
+    if (segment.empty() || segment.size() > 10 || segment.find_first_not_of("0123456789") != std::string::npos) {
+        return false;
+    }
+    unsigned long long parsed = std::stoull(segment);
+    if (parsed == 0 || parsed > 0xffffffffULL) return false;
+    pid = static_cast<unsigned int>(parsed);
+    return true;
+}
+
+// Whether the PID is a compute process in the current snapshot, so ncu is never pointed at
+// an arbitrary host process
+static bool isGpuComputeProcess(unsigned int pid) {
+    double age_seconds = 0.0;
+    std::shared_ptr<const DetailedVRAMInfo> info = getLatestVRAMSnapshot(age_seconds);
+    if (!info || age_seconds > PROCESS_CHECK_MAX_AGE_SECONDS) {
+        std::shared_ptr<const PublishedSnapshot> snapshot = collectVRAMSnapshot();
+        info = std::shared_ptr<const DetailedVRAMInfo>(snapshot, &snapshot->info);
+    }
+    return std::any_of(info->processes.begin(), info->processes.end(), [pid](const ProcessMemory& pm) {
+        return pm.pid == pid;
+    });
+}
+
+static nlohmann::json metricsToJson(const NsightMetrics& metrics) {
+    return {
+        {"atomic_operations", metrics.atomic_operations},
+        {"threads_per_block", metrics.threads_per_block},
+        {"occupancy", metrics.occupancy},
+        {"active_blocks", metrics.active_blocks},
+        {"memory_throughput", metrics.memory_throughput},
+        {"dram_read_bytes", metrics.dram_read_bytes},
+        {"dram_write_bytes", metrics.dram_write_bytes},
+        {"available", metrics.available},
+        {"collected_at", metrics.collected_at}
+    };
+}
+
+static nlohmann::json kernelSummariesToJson(const std::vector<KernelSummary>& summaries) {
+    nlohmann::json kernels_json = nlohmann::json::array();
+    for (const auto& summary : summaries) {
+        nlohmann::json kernel_json;
+        kernel_json["kernel_name"] = summary.kernel_name;
+        kernel_json["launches"] = summary.launches;
+        kernel_json["block_size"] = summary.block_size;
+        kernel_json["grid_size"] = summary.grid_size;
+        kernel_json["total_duration_ns"] = summary.total_duration_ns;
+        kernel_json["dram_read_bytes"] = summary.dram_read_bytes;
+        kernel_json["dram_write_bytes"] = summary.dram_write_bytes;
+        kernel_json["atomic_operations"] = summary.atomic_operations;
+        kernel_json["occupancy"] = summary.avg_occupancy;
+        kernel_json["dram_throughput_pct"] = summary.avg_dram_throughput_pct;
+        kernel_json["sm_throughput_pct"] = summary.avg_sm_throughput_pct;
+        kernel_json["memory_bound"] = summary.memory_bound;
+        kernels_json.push_back(kernel_json);
+    }
+    return kernels_json;
+}
+
+static nlohmann::json kernelLaunchesToJson(const std::vector<KernelProfile>& kernels) {
+    nlohmann::json launches_json = nlohmann::json::array();
+    for (const auto& kernel : kernels) {
+        nlohmann::json launch_json;
+        launch_json["kernel_name"] = kernel.kernel_name;
+        launch_json["block_size"] = kernel.block_size;
+        launch_json["grid_size"] = kernel.grid_size;
+        launch_json["duration_ns"] = kernel.duration_ns;
+        launch_json["occupancy"] = kernel.occupancy;
+        launch_json["dram_read_bytes"] = kernel.dram_read_bytes;
+        launch_json["dram_write_bytes"] = kernel.dram_write_bytes;
+        launch_json["atomic_operations"] = kernel.atomic_operations;
+        launch_json["dram_throughput_pct"] = kernel.dram_throughput_pct;
+        launch_json["sm_throughput_pct"] = kernel.sm_throughput_pct;
+        launches_json.push_back(launch_json);
+    }
+    return launches_json;
+}
+
+static nlohmann::json profileJobToJson(const ProfileJob& job, bool include_launches) {
+    nlohmann::json job_json;
+    job_json["job_id"] = job.id;
+    job_json["pid"] = job.pid;
+    job_json["status"] = job.status;
+    job_json["message"] = job.message;
+    job_json["requested_at"] = job.requested_at;
+    job_json["started_at"] = job.started_at;
+    job_json["finished_at"] = job.finished_at;
+    if (job.finished_at != 0) {
+        job_json["model_id"] = job.model_id;
+        job_json["metrics"] = metricsToJson(job.metrics);
+        job_json["kernels"] = kernelSummariesToJson(summarizeKernels(job.kernels));
+        if (include_launches) {
+            job_json["launches"] = kernelLaunchesToJson(job.kernels);
+        }
+    }
+    return job_json;
+}
+
+static void writeError(http::response<http::string_body>& res, ClientSocket& socket,
+                       http::status status, const std::string& message) {
+    nlohmann::json error_json;
+    error_json["success"] = false;
+    error_json["message"] = message;
+    res.result(status);
+    res.body() = error_json.dump();
+    writeResponse(res, socket);
+}
+
+// POST /profile/<pid>: queue an Nsight Compute run; the result is read back with GET /profile/<pid>
+void handleProfileRequest(http::request<http::string_body>& req, ClientSocket& socket) {
+    std::string target = std::string(req.target());
+    
+    http::response<http::string_body> res;
+    res.version(req.version());
+    res.keep_alive(req.keep_alive());
+    res.set(http::field::content_type, "application/json");
+    
+    unsigned int pid = 0;
+    if (!parseProfilePid(target, pid)) {
+        writeError(res, socket, http::status::bad_request, "Expected /profile/<pid>");
+        return;
+    }
+    if (readProcessStartTime(pid) == 0) {
+        writeError(res, socket, http::status::not_found, "No running process with PID " + std::to_string(pid));
+        return;
+    }
+    if (!isGpuComputeProcess(pid)) {
+        writeError(res, socket, http::status::conflict, "PID " + std::to_string(pid) + " is not a GPU compute process");
+        return;
+    }
+    
+    ProfileSubmission submission = submitProfileJob(pid);
+    std::string location = "/profile/" + std::to_string(pid);
+    
+    nlohmann::json response_json;
+    response_json["pid"] = pid;
+    response_json["status"] = submission.status;
+    response_json["job_id"] = submission.job_id;
+    
+    if (submission.status == "queued" || submission.status == "pending") {
+        response_json["success"] = true;
+        response_json["message"] = submission.status == "queued" ? "Profile queued" : "A profile of this process is already pending";
+        res.result(http::status::accepted);
+        res.set(http::field::location, location);
+    } else {
+        bool cooldown = submission.status == "cooldown";
+        response_json["success"] = false;
+        response_json["message"] = cooldown ? "Process was profiled recently" : "Profile queue is full";
+        response_json["retry_after"] = submission.retry_after;
+        res.result(cooldown ? http::status::too_many_requests : http::status::service_unavailable);
+        res.set(http::field::retry_after, std::to_string(submission.retry_after));
+        if (cooldown) res.set(http::field::location, location);
+    }
+    
+    LOG_INFO("Profile request for PID " + std::to_string(pid) + ": " + submission.status);
+    res.body() = response_json.dump();
+    writeResponse(res, socket);
+}
+
+// GET /profile/<pid>: latest profile job for the process, with its metrics once finished
+void handleProfileStatusRequest(http::request<http::string_body>& req, ClientSocket& socket) {
+    std::string target = std::string(req.target());
+    
+    http::response<http::string_body> res;
+    res.version(req.version());
+    res.keep_alive(req.keep_alive());
+    res.set(http::field::content_type, "application/json");
+    
+    unsigned int pid = 0;
+    if (!parseProfilePid(target, pid)) {
+        writeError(res, socket, http::status::bad_request, "Expected /profile/<pid>");
+        return;
+    }
+    
+    ProfileJob job;
+    if (!getLatestProfileJob(pid, job)) {
+        writeError(res, socket, http::status::not_found, "No profile requested for PID " + std::to_string(pid));
+        return;
+    }
+    
+    std::string launches = getQueryParam(target, "launches");
+    res.result(http::status::ok);
+    res.body() = profileJobToJson(job, launches == "true" || launches == "1").dump();
+    writeResponse(res, socket);
+}
+
+// GET /profile?model=<id>: kernel report over the cached profiles of a model's processes
+void handleModelProfileRequest(http::request<http::string_body>& req, ClientSocket& socket) {
+    std::string target = std::string(req.target());
+    std::string model_id = getQueryParam(target, "model");
+    
+    http::response<http::string_body> res;
+    res.version(req.version());
+    res.keep_alive(req.keep_alive());
+    res.set(http::field::content_type, "application/json");
+    
+    if (model_id.empty()) {
+        writeError(res, socket, http::status::bad_request, "Missing model parameter");
+        return;
+    }
+    
+    ModelProfileReport report;
+    if (!getModelProfileReport(model_id, report)) {
+        writeError(res, socket, http::status::not_found, "No profiles collected for model " + model_id);
+        return;
+    }
+    
+    nlohmann::json report_json;
+    report_json["model_id"] = report.model_id;
+    report_json["pids"] = report.pids;
+    report_json["collected_at"] = report.collected_at;
+    report_json["metrics"] = metricsToJson(report.metrics);
+    report_json["kernels"] = kernelSummariesToJson(report.kernels);
+    
+    res.result(http::status::ok);
+    res.body() = report_json.dump();
+    writeResponse(res, socket);
+}
@@ -0,0 +1,373 @@
+#include "services/rolling_restart.h"
+#include "services/model_manager.h"
+#include "services/hf_deploy.h"
+#include "services/nvml_utils.h"
+#include "utils/env_utils.h"
+#include "utils/logger.h"
+#include <yaml-cpp/yaml.h>
+#include <absl/strings/str_cat.h>
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <deque>
+#include <fstream>
+#include <future>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
+
+static std::map<std::string, OptimizationJob> optimization_jobs;
+static std::mutex jobs_mutex;
+static unsigned long long job_counter = 0;
+static const size_t MAX_TRACKED_JOBS = 32;
+
+// Ports handed to replacements that are not visible in `docker ps` yet
+static std::set<int> reserved_ports;
+static std::mutex ports_mutex;
+
+// Containers being restarted by any plan, so two plans never stop, redeploy or
+// stage "<container>-next" for the same container at the same time
+static std::set<std::string> restarting_containers;
+static std::mutex restarting_mutex;
+
+RestartStrategy parseRestartStrategy(const std::string& mode) {
+    if (mode == "rolling") return RestartStrategy::ROLLING;
+    return RestartStrategy::IN_PLACE;
+}
+
+std::string restartStrategyName(RestartStrategy strategy) {
+    return strategy == RestartStrategy::ROLLING ? "rolling" : "in_place";
+}
+
+// Write a copy of the GPU config with gpu-memory-utilization replaced
+static std::string writeOptimizedConfig(const std::string& container_name, const std::string& gpu_type, double utilization) {
+    std::string config_path = getConfigPathForGPU(gpu_type);
+    std::string temp_config = "/tmp/optimized_" + container_name + ".yaml";
+    try {
+        YAML::Node config = YAML::LoadFile(config_path);
+        config["gpu-memory-utilization"] = utilization;
+
+        std::ofstream dst(temp_config);
+        YAML::Emitter emitter;
+        emitter << config;
+        dst << emitter.c_str();
+        dst.close();
+    } catch (const YAML::Exception& e) {
+        LOG_ERROR("Failed to parse or update YAML config: " + std::string(e.what()));
+        // Fallback: copy original file
+        std::ifstream src(config_path);
+        std::ofstream dst(temp_config);
+        dst << src.rdbuf();
+        src.close();
+        dst.close();
+    }
+    return temp_config;
+}
+
+bool claimRestart(const std::string& container_name) {
+    std::lock_guard<std::mutex> lock(restarting_mutex);
+    return restarting_containers.insert(container_name).second;
+}
+
+void releaseRestart(const std::string& container_name) {
+    std::lock_guard<std::mutex> lock(restarting_mutex);
+    restarting_containers.erase(container_name);
+}
+
+bool isRestartInProgress(const std::string& container_name) {
+    std::lock_guard<std::mutex> lock(restarting_mutex);
+    return restarting_containers.count(container_name) > 0;
+}
+
+static int reserveReplacementPort() {
+    std::lock_guard<std::mutex> lock(ports_mutex);
+    int port = getNextAvailablePort(0);
+    while (reserved_ports.count(port)) {
+        port = getNextAvailablePort(port + 1);
+    }
+    reserved_ports.insert(port);
+    return port;
+}
+
+static void releaseReplacementPort(int port) {
+    std::lock_guard<std::mutex> lock(ports_mutex);
+    reserved_ports.erase(port);
+}
+
+static RestartOutcome restartInPlace(const OptimizationTarget& target) {
+    RestartOutcome outcome{target.container_name, target.model_id, false, false,
+                           target.port, target.port, target.target_utilization, ""};
+
+    std::string gpu_type = target.gpu_type.empty() ? detectGPUType() : target.gpu_type;
+    std::string config_path = writeOptimizedConfig(target.container_name, gpu_type, target.target_utilization);
+
+    LOG_INFO("In-place restart of " + target.container_name + " with gpu-memory-utilization " + std::to_string(target.target_utilization));
+    spindownModel(target.container_name);
+
+    int port = target.port > 0 ? target.port : getNextAvailablePort(0);
+    DeployResponse deploy_res = deployHFModel(target.model_id, getEnvValue("HF_TOKEN"), port, gpu_type, config_path);
+    outcome.new_port = deploy_res.port;
+    outcome.success = deploy_res.success;
+    outcome.message = deploy_res.message;
+    return outcome;
+}
+
+static RestartOutcome restartRolling(const OptimizationTarget& target) {
+    RestartOutcome outcome{target.container_name, target.model_id, false, true,
+                           target.port, 0, target.target_utilization, ""};
+
+    std::string gpu_type = target.gpu_type.empty() ? detectGPUType() : target.gpu_type;
+    std::string staging_name = getStagingContainerName(target.container_name);
+    std::string config_path = writeOptimizedConfig(staging_name, gpu_type, target.target_utilization);
+    int new_port = reserveReplacementPort();
+    outcome.new_port = new_port;
+
+    LOG_INFO("Rolling restart of " + target.container_name + ": starting replacement " + staging_name +
+             " on port " + std::to_string(new_port) + " with gpu-memory-utilization " + std::to_string(target.target_utilization));
+
+    DeployResponse deploy_res = deployHFModel(target.model_id, getEnvValue("HF_TOKEN"), new_port, gpu_type, config_path, staging_name);
+    if (!deploy_res.success) {
+        spindownModel(staging_name);
+        releaseReplacementPort(new_port);
+        outcome.message = "Replacement failed to start, old container kept: " + deploy_res.message;
+        LOG_ERROR("Rolling restart of " + target.container_name + " aborted: " + deploy_res.message);
+        return outcome;
+    }
+
+    int ready_timeout = getEnvInt("OPTIMIZE_READY_TIMEOUT", 900);
+    if (!waitForModelReady(new_port, ready_timeout)) {
+        spindownModel(staging_name);
+        releaseReplacementPort(new_port);
+        outcome.message = absl::StrCat("Replacement not ready within ", ready_timeout, "s, old container kept");
+        LOG_ERROR("Rolling restart of " + target.container_name + " aborted: " + outcome.message);
+        return outcome;
+    }
+
+    // The replacement is serving: stop the old container, then let the
+    // replacement take over its name so the registry points at the new port
+    LOG_INFO("Switching " + target.model_id + " from port " + std::to_string(target.port) + " to " + std::to_string(new_port));
+    spindownModel(target.container_name);
+    if (renameContainer(staging_name, target.container_name)) {
+        renameModelRegistration(staging_name, target.container_name);
+    } else {
+        LOG_WARN("Could not rename " + staging_name + " to " + target.container_name + ", keeping staging name");
+        outcome.container_name = staging_name;
+    }
+    releaseReplacementPort(new_port);
+
+    outcome.success = true;
+    outcome.message = absl::StrCat("Now serving on port ", new_port);
+    return outcome;
+}
+
+struct PlannedRestart {
+    OptimizationTarget target;
+    RestartStrategy strategy;
+    unsigned long long old_bytes;
+    unsigned long long new_bytes;
+    unsigned long long reserve_bytes;  // Extra VRAM held while the restart is in flight
+};
+
+static void planReservation(PlannedRestart& plan) {
+    if (plan.strategy == RestartStrategy::ROLLING) {
+        plan.reserve_bytes = plan.new_bytes;
+    } else {
+        plan.reserve_bytes = plan.new_bytes > plan.old_bytes ? plan.new_bytes - plan.old_bytes : 0;
+    }
+}
+
+std::vector<RestartOutcome> executeOptimizationPlan(const std::vector<OptimizationTarget>& targets, RestartStrategy strategy) {
+    std::vector<RestartOutcome> outcomes;
+    if (targets.empty()) return outcomes;
+
+    DetailedVRAMInfo vram = getDetailedVRAMUsage();
+    unsigned long long total = vram.total;
+    unsigned long long budget = static_cast<unsigned long long>(total * std::clamp(getEnvDouble("OPTIMIZE_VRAM_BUDGET", 0.95), 0.1, 1.0));
+    size_t max_parallel = static_cast<size_t>(std::max(1, getEnvInt("OPTIMIZE_MAX_PARALLEL", 2)));
+
+    // Committed VRAM: what the running models are allowed to grow to, or what is
+    // actually in use if that is higher (e.g. containers we did not deploy)
+    // Utilization is a per-device fraction, so each model is scaled by the GPUs it spans
+    auto metrics_snapshot = getModelMetricsSnapshot();
+    auto model_capacity = [&](const std::string& container_name) {
+        auto it = metrics_snapshot.find(container_name);
+        if (it != metrics_snapshot.end() && !it->second.usage_samples.empty() &&
+            it->second.usage_samples.back().total_vram_bytes > 0) {
+            return it->second.usage_samples.back().total_vram_bytes;
+        }
+        return total;
+    };
+    unsigned long long committed = 0;
+    for (const auto& [name, metrics] : metrics_snapshot) {
+        committed += static_cast<unsigned long long>(metrics.configured_max_utilization * model_capacity(name));
+    }
+    committed = std::max(committed, vram.used);
+
+    if (total == 0) {
+        LOG_WARN("Total VRAM unknown, optimizing without a VRAM budget (max " + std::to_string(max_parallel) + " in parallel)");
+    }
+
+    std::deque<PlannedRestart> pending;
+    for (const auto& target : targets) {
+        if (!claimRestart(target.container_name)) {
+            LOG_WARN("Skipping " + target.container_name + ": a restart of it is already in progress");
+            outcomes.push_back(RestartOutcome{target.container_name, target.model_id, false, false, target.port, target.port,
+                                              target.target_utilization, "Restart already in progress", true});
+            continue;
+        }
+        unsigned long long capacity = model_capacity(target.container_name);
+        PlannedRestart plan{target, strategy,
+                            static_cast<unsigned long long>(target.current_utilization * capacity),
+                            static_cast<unsigned long long>(target.target_utilization * capacity), 0};
+        planReservation(plan);
+        pending.push_back(plan);
+    }
+
+    struct InFlight {
+        PlannedRestart plan;
+        std::future<RestartOutcome> result;
+    };
+    std::vector<InFlight> in_flight;
+    unsigned long long reserved = 0;
+
+    while (!pending.empty() || !in_flight.empty()) {
+        // Launch everything that fits next to what is already running
+        for (auto it = pending.begin(); it != pending.end() && in_flight.size() < max_parallel;) {
+            bool fits = total == 0 || committed + reserved + it->reserve_bytes <= budget;
+            if (!fits && in_flight.empty() && it->strategy == RestartStrategy::ROLLING) {
+                // Old and new copies never fit together: fall back to an outage
+                LOG_WARN("Rolling restart of " + it->target.container_name + " exceeds the VRAM budget, restarting in place");
+                it->strategy = RestartStrategy::IN_PLACE;
+                planReservation(*it);
+                fits = committed + it->reserve_bytes <= budget;
+            }
+            if (!fits && !in_flight.empty()) {
+                ++it;
+                continue;
+            }
+            if (!fits) {
+                // Does not fit even with nothing else restarting: launching it could push other models out
+                LOG_WARN("Skipping " + it->target.container_name + ": needs " + std::to_string(it->reserve_bytes) +
+                         " bytes with " + std::to_string(committed) + " of " + std::to_string(budget) + " committed");
+                outcomes.push_back(RestartOutcome{it->target.container_name, it->target.model_id, false, false, it->target.port,
+                                                  it->target.port, it->target.target_utilization, "Exceeds VRAM budget", true});
+                releaseRestart(it->target.container_name);
+                it = pending.erase(it);
+                continue;
+            }
+
+            PlannedRestart plan = *it;
+            it = pending.erase(it);
+            reserved += plan.reserve_bytes;
+            LOG_INFO("Launching " + restartStrategyName(plan.strategy) + " restart of " + plan.target.container_name +
+                     " (reserved " + std::to_string(plan.reserve_bytes) + " bytes, committed " + std::to_string(committed) +
+                     " of " + std::to_string(budget) + ")");
+            std::future<RestartOutcome> result = std::async(std::launch::async, [plan]() {
+                // The claim is released when this restart finishes, even if it throws
+                struct ClaimRelease {
+                    const std::string& container_name;
+                    ~ClaimRelease() { releaseRestart(container_name); }
+                } release{plan.target.container_name};
+                return plan.strategy == RestartStrategy::ROLLING ? restartRolling(plan.target) : restartInPlace(plan.target);
+            });
+            in_flight.push_back(InFlight{plan, std::move(result)});
+        }
+
+        // Reap finished restarts and release their reservations
+        bool reaped = false;
+        for (auto it = in_flight.begin(); it != in_flight.end();) {
+            if (it->result.wait_for(std::chrono::milliseconds(0)) != std::future_status::ready) {
+                ++it;
+                continue;
+            }
+            const PlannedRestart& plan = it->plan;
+            RestartOutcome outcome;
+            try {
+                outcome = it->result.get();
+            } catch (const std::exception& e) {
+                // Keep going so the claims of the remaining targets are released
+                outcome = RestartOutcome{plan.target.container_name, plan.target.model_id, false, false, plan.target.port,
+                                         plan.target.port, plan.target.target_utilization, e.what()};
+            }
+            reserved -= plan.reserve_bytes;
+            if (outcome.success) {
+                committed = committed - std::min(committed, plan.old_bytes) + plan.new_bytes;
+            } else if (plan.strategy == RestartStrategy::IN_PLACE) {
+                // The old container is gone even though the redeploy failed
+                committed -= std::min(committed, plan.old_bytes);
+            }
+            outcomes.push_back(outcome);
+            it = in_flight.erase(it);
+            reaped = true;
+        }
+
+        if (!reaped && !in_flight.empty()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        }
+    }
+
+    return outcomes;
+}
+
+std::string submitOptimizationJob(const std::vector<OptimizationTarget>& targets, RestartStrategy strategy) {
+    OptimizationJob job;
+    job.status = "running";
+    job.strategy = restartStrategyName(strategy);
+    job.targets = targets;
+    job.started_at = static_cast<long long>(std::time(nullptr));
+    job.finished_at = 0;
+
+    {
+        std::lock_guard<std::mutex> lock(jobs_mutex);
+        job.id = absl::StrCat("opt-", job.started_at, "-", ++job_counter);
+
+        // Forget the oldest finished jobs once the table is full
+        while (optimization_jobs.size() >= MAX_TRACKED_JOBS) {
+            auto oldest = optimization_jobs.end();
+            for (auto it = optimization_jobs.begin(); it != optimization_jobs.end(); ++it) {
+                if (it->second.finished_at != 0 &&
+                    (oldest == optimization_jobs.end() || it->second.started_at < oldest->second.started_at)) {
+                    oldest = it;
+                }
+            }
+            if (oldest == optimization_jobs.end()) break;
+            optimization_jobs.erase(oldest);
+        }
+        optimization_jobs[job.id] = job;
+    }
+
+    std::string job_id = job.id;
+    std::thread([job_id, targets, strategy]() {
+        std::vector<RestartOutcome> outcomes;
+        try {
+            outcomes = executeOptimizationPlan(targets, strategy);
+        } catch (const std::exception& e) {
+            LOG_ERROR("Optimization job " + job_id + " failed: " + std::string(e.what()));
+        }
+
+        bool all_ok = !outcomes.empty();
+        for (const auto& outcome : outcomes) {
+            all_ok = all_ok && outcome.success;
+        }
+
+        std::lock_guard<std::mutex> lock(jobs_mutex);
+        auto it = optimization_jobs.find(job_id);
+        if (it == optimization_jobs.end()) return;
+        it->second.outcomes = outcomes;
+        it->second.status = all_ok ? "completed" : "failed";
+        it->second.finished_at = static_cast<long long>(std::time(nullptr));
+        LOG_INFO("Optimization job " + job_id + " " + it->second.status);
+    }).detach();
+
+    LOG_INFO("Submitted optimization job " + job_id + " (" + std::to_string(targets.size()) + " model(s), " + job.strategy + ")");
+    return job_id;
+}
+
+bool getOptimizationJob(const std::string& job_id, OptimizationJob& job) {
+    std::lock_guard<std::mutex> lock(jobs_mutex);
+    auto it = optimization_jobs.find(job_id);
+    if (it == optimization_jobs.end()) return false;
+    job = it->second;
+    return true;
+}
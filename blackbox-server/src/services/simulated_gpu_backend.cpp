@@ -0,0 +1,293 @@
+#include "services/simulated_gpu_backend.h"
+#include "utils/env_utils.h"
+#include "utils/logger.h"
+#include <yaml-cpp/yaml.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <absl/strings/str_cat.h>
+
+static constexpr unsigned long long GIB = 1024ULL * 1024ULL * 1024ULL;
+static constexpr unsigned long long DRIVER_OVERHEAD_BYTES = 512ULL * 1024ULL * 1024ULL;
+static constexpr unsigned long long DEFAULT_KV_BLOCK_BYTES = 2ULL * 1024ULL * 1024ULL;
+static constexpr unsigned int SIM_CPU_BLOCKS = 1024;
+
+// splitmix64: cheap, stateless and identical on every platform
+static unsigned long long mixHash(unsigned long long x) {
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+// Deterministic value in [0, 1) for a (seed, snapshot, device, pid) tuple
+static double unitNoise(unsigned long long seed, unsigned long long snapshot, unsigned int device, unsigned int pid) {
+    unsigned long long h = mixHash(seed ^ mixHash(snapshot ^ mixHash((static_cast<unsigned long long>(device) << 32) | pid)));
+    return static_cast<double>(h >> 11) / static_cast<double>(1ULL << 53);
+}
+
+static double curveValue(const std::string& curve, double t, double period) {
+    if (period <= 0.0 || curve == "constant") return 0.0;
+    double phase = std::fmod(t, period) / period;
+    if (curve == "ramp") return phase;
+    if (curve == "step") return phase < 0.5 ? 0.0 : 1.0;
+    // sine, mapped to [0, 1]
+    return 0.5 - 0.5 * std::cos(2.0 * M_PI * phase);
+}
+
+class SimulatedBackend : public GpuTelemetryBackend {
+public:
+    explicit SimulatedBackend(const SimulatedGpuConfig& config) : config(config) {
+        for (const auto& device : this->config.devices) {
+            for (const auto& process : device.processes) {
+                processes_by_pid.emplace(process.pid, &process);
+            }
+        }
+    }
+
+    std::string name() const override { return "simulated"; }
+
+    bool init() override {
+        start_time = std::chrono::steady_clock::now();
+        snapshot_index = 0;
+        simulated_time = 0.0;
+        LOG_INFO(absl::StrCat("Simulated GPU backend: ", config.devices.size(), " device(s), latency ",
+                              config.latency_ms, "ms (+", config.jitter_ms, "ms jitter), seed ", config.seed));
+        return !config.devices.empty();
+    }
+
+    void shutdown() override {}
+
+    unsigned int deviceCount() const override {
+        return static_cast<unsigned int>(config.devices.size());
+    }
+
+    void beginSnapshot() override {
+        std::lock_guard<std::mutex> lock(clock_mutex);
+        ++snapshot_index;
+        if (config.time_step_seconds > 0.0) {
+            simulated_time = config.time_step_seconds * snapshot_index;
+        } else {
+            simulated_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+        }
+    }
+
+    GPUDeviceInfo queryDevice(unsigned int index) override {
+        double t;
+        unsigned long long snapshot;
+        readClock(t, snapshot);
+        injectLatency(snapshot, index, 0);
+
+        const auto& device = config.devices[index];
+        GPUDeviceInfo info{index, device.name, absl::StrCat("GPU-sim-", config.seed, "-", index),
+                           device.total_bytes, 0, 0, static_cast<unsigned int>(device.processes.size())};
+        unsigned long long used = DRIVER_OVERHEAD_BYTES;
+        for (const auto& process : device.processes) {
+            used += processBytes(process, index, t, snapshot);
+        }
+        info.used = std::min(used, device.total_bytes);
+        info.free = device.total_bytes - info.used;
+        return info;
+    }
+
+    std::vector<ProcessMemory> queryProcesses(unsigned int index) override {
+        double t;
+        unsigned long long snapshot;
+        readClock(t, snapshot);
+        injectLatency(snapshot, index, 1);
+
+        std::vector<ProcessMemory> result;
+        for (const auto& process : config.devices[index].processes) {
+            unsigned long long bytes = processBytes(process, index, t, snapshot);
+            result.push_back(ProcessMemory{process.pid, process.name, bytes, bytes, index});
+        }
+        return result;
+    }
+
+    bool hasHostProcesses() const override { return false; }
+
+    ProcessMetadata describeProcess(unsigned int pid) override {
+        auto found = processes_by_pid.find(pid);
+        if (found == processes_by_pid.end()) {
+            return ProcessMetadata{pid, 0, "", "", "", ""};
+        }
+        const SimulatedProcessConfig& process = *found->second;
+        // One simulated container per model
+        std::string container_id = process.model_id.empty() ? "" : "sim-" + process.model_id;
+        return ProcessMetadata{pid, 0, process.name, process.name, container_id, process.model_id};
+    }
+
+    std::vector<ModelBlockData> queryModelBlockData() override {
+        double t;
+        unsigned long long snapshot;
+        readClock(t, snapshot);
+
+        std::vector<ModelBlockData> result;
+        for (const auto& model : config.models) {
+            double usage = model.kv_base + model.kv_amplitude * curveValue(model.kv_curve, t, model.kv_period_seconds);
+            if (config.noise_fraction > 0.0) {
+                double noise = unitNoise(config.seed, snapshot, 0, static_cast<unsigned int>(model.port)) * 2.0 - 1.0;
+                usage += noise * config.noise_fraction * model.kv_amplitude;
+            }
+            usage = std::clamp(usage, 0.0, 1.0);
+
+            ModelBlockData data{};
+            data.model_id = model.model_id;
+            data.port = model.port;
+            data.num_gpu_blocks = model.num_gpu_blocks;
+            data.block_size = model.kv_block_bytes;
+            data.kv_cache_usage_perc = usage;
+            // Running requests follow the cache in use; a nearly full cache queues them
+            data.num_requests_running = static_cast<unsigned int>(std::lround(usage * 32.0));
+            data.num_requests_waiting = usage > 0.95 ? 4 : 0;
+            // Swap uses the same block layout, which is how the block size is measured from real vLLM
+            data.num_cpu_blocks = SIM_CPU_BLOCKS;
+            data.swap_space_gib = static_cast<double>(model.kv_block_bytes) * SIM_CPU_BLOCKS / GIB;
+            data.gpu_memory_utilization = model.gpu_memory_utilization;
+            data.available = true;
+            result.push_back(data);
+        }
+        return result;
+    }
+
+private:
+    void readClock(double& t, unsigned long long& snapshot) {
+        std::lock_guard<std::mutex> lock(clock_mutex);
+        t = simulated_time;
+        snapshot = snapshot_index;
+    }
+
+    void injectLatency(unsigned long long snapshot, unsigned int device, unsigned int call) {
+        double delay_ms = config.latency_ms;
+        if (config.jitter_ms > 0.0) {
+            delay_ms += config.jitter_ms * unitNoise(config.seed + call, snapshot, device, 0);
+        }
+        if (delay_ms > 0.0) {
+            std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(delay_ms));
+        }
+    }
+
+    unsigned long long processBytes(const SimulatedProcessConfig& process, unsigned int device, double t, unsigned long long snapshot) const {
+        double bytes = process.base_bytes + process.amplitude_bytes * curveValue(process.curve, t, process.period_seconds);
+        if (config.noise_fraction > 0.0) {
+            double noise = unitNoise(config.seed, snapshot, device, process.pid) * 2.0 - 1.0;
+            bytes += noise * config.noise_fraction * process.amplitude_bytes;
+        }
+        return static_cast<unsigned long long>(std::max(0.0, bytes));
+    }
+
+    SimulatedGpuConfig config;
+    std::unordered_map<unsigned int, const SimulatedProcessConfig*> processes_by_pid;  // Into config, which never changes
+    std::mutex clock_mutex;
+    std::chrono::steady_clock::time_point start_time;
+    unsigned long long snapshot_index = 0;
+    double simulated_time = 0.0;
+};
+
+static unsigned long long gibToBytes(double gib) {
+    return static_cast<unsigned long long>(std::max(0.0, gib) * GIB);
+}
+
+static SimulatedGpuConfig defaultSimulatedConfig() {
+    SimulatedGpuConfig config;
+    config.latency_ms = getEnvDouble("GPU_SIM_LATENCY_MS", 0.0);
+    config.jitter_ms = getEnvDouble("GPU_SIM_JITTER_MS", 0.0);
+    config.noise_fraction = getEnvDouble("GPU_SIM_NOISE", 0.0);
+    config.seed = static_cast<unsigned long long>(getEnvInt("GPU_SIM_SEED", 1));
+    config.time_step_seconds = getEnvDouble("GPU_SIM_TIME_STEP", 0.0);
+
+    int device_count = std::max(1, getEnvInt("GPU_SIM_DEVICES", 2));
+    int processes_per_device = std::max(0, getEnvInt("GPU_SIM_PROCESSES_PER_DEVICE", 1));
+    double memory_gib = getEnvDouble("GPU_SIM_MEMORY_GB", 80.0);
+    for (int d = 0; d < device_count; ++d) {
+        SimulatedDeviceConfig device{"Simulated GPU", gibToBytes(memory_gib), {}};
+        for (int p = 0; p < processes_per_device; ++p) {
+            // Each process oscillates between 60% and 70% of its share of the device, out of phase
+            double share = memory_gib / processes_per_device;
+            device.processes.push_back(SimulatedProcessConfig{
+                static_cast<unsigned int>(100000 + d * 100 + p), "python3", "sine",
+                gibToBytes(share * 0.6), gibToBytes(share * 0.1), 300.0 + 60.0 * (d + p),
+                absl::StrCat("simulated/model-", p)});
+        }
+        config.devices.push_back(device);
+    }
+    // Process p of every device is a tensor parallel worker of model p, with half its share as KV cache
+    for (int p = 0; p < processes_per_device; ++p) {
+        double share = memory_gib / processes_per_device;
+        config.models.push_back(SimulatedModelConfig{
+            absl::StrCat("simulated/model-", p), 8000 + p,
+            static_cast<unsigned int>(gibToBytes(share * 0.5) / DEFAULT_KV_BLOCK_BYTES), DEFAULT_KV_BLOCK_BYTES,
+            "sine", 0.2, 0.3, 600.0 + 60.0 * p, 0.7 / processes_per_device});
+    }
+    return config;
+}
+
+SimulatedGpuConfig loadSimulatedGpuConfig() {
+    SimulatedGpuConfig config = defaultSimulatedConfig();
+    std::string path = getEnvValue("GPU_SIM_CONFIG", "");
+    if (path.empty()) {
+        return config;
+    }
+
+    try {
+        YAML::Node root = YAML::LoadFile(path);
+        if (root["latency_ms"]) config.latency_ms = root["latency_ms"].as<double>();
+        if (root["jitter_ms"]) config.jitter_ms = root["jitter_ms"].as<double>();
+        if (root["noise_fraction"]) config.noise_fraction = root["noise_fraction"].as<double>();
+        if (root["seed"]) config.seed = root["seed"].as<unsigned long long>();
+        if (root["time_step_seconds"]) config.time_step_seconds = root["time_step_seconds"].as<double>();
+
+        if (root["devices"]) {
+            config.devices.clear();
+            config.models.clear();
+            unsigned int next_pid = 100000;
+            for (const auto& node : root["devices"]) {
+                SimulatedDeviceConfig device{node["name"].as<std::string>("Simulated GPU"),
+                                             gibToBytes(node["memory_gb"].as<double>(80.0)), {}};
+                for (const auto& proc : node["processes"]) {
+                    SimulatedProcessConfig process;
+                    process.pid = proc["pid"].as<unsigned int>(next_pid);
+                    process.name = proc["name"].as<std::string>("python3");
+                    process.curve = proc["curve"].as<std::string>("constant");
+                    process.base_bytes = gibToBytes(proc["base_gb"].as<double>(0.0));
+                    process.amplitude_bytes = gibToBytes(proc["amplitude_gb"].as<double>(0.0));
+                    process.period_seconds = proc["period_seconds"].as<double>(300.0);
+                    process.model_id = proc["model"].as<std::string>("");
+                    next_pid = process.pid + 1;
+                    device.processes.push_back(process);
+                }
+                config.devices.push_back(device);
+            }
+        }
+        if (root["models"]) {
+            config.models.clear();
+            int next_port = 8000;
+            for (const auto& node : root["models"]) {
+                SimulatedModelConfig model;
+                model.model_id = node["model_id"].as<std::string>();
+                model.port = node["port"].as<int>(next_port);
+                model.num_gpu_blocks = node["num_gpu_blocks"].as<unsigned int>(1000);
+                model.kv_block_bytes = static_cast<unsigned long long>(node["kv_block_mb"].as<double>(2.0) * 1024.0 * 1024.0);
+                model.kv_curve = node["kv_curve"].as<std::string>("constant");
+                model.kv_base = node["kv_base"].as<double>(0.3);
+                model.kv_amplitude = node["kv_amplitude"].as<double>(0.0);
+                model.kv_period_seconds = node["kv_period_seconds"].as<double>(300.0);
+                model.gpu_memory_utilization = node["gpu_memory_utilization"].as<double>(0.9);
+                next_port = model.port + 1;
+                config.models.push_back(model);
+            }
+        }
+        LOG_INFO("Loaded simulated GPU config from " + path);
+    } catch (const YAML::Exception& e) {
+        LOG_ERROR("Failed to parse GPU_SIM_CONFIG " + path + ": " + std::string(e.what()) + ", using defaults");
+        return defaultSimulatedConfig();
+    }
+    return config;
+}
+
+std::unique_ptr<GpuTelemetryBackend> createSimulatedBackend(const SimulatedGpuConfig& config) {
+    return std::make_unique<SimulatedBackend>(config);
+}
@@ -0,0 +1,140 @@
+#include "services/sizing_engine.h"
+#include "services/model_manager.h"
+#include "services/aggregation_service.h"
+#include "utils/env_utils.h"
+#include <algorithm>
+#include <cmath>
+#include <ctime>
+#include <vector>
+
+SizingConfig loadSizingConfig() {
+    SizingConfig config;
+    config.kv_percentile = std::clamp(getEnvDouble("SIZING_KV_PERCENTILE", 0.99), 0.5, 1.0);
+    config.safety_margin = std::clamp(getEnvDouble("SIZING_SAFETY_MARGIN", 0.15), 0.0, 2.0);
+    config.min_change = std::clamp(getEnvDouble("SIZING_MIN_CHANGE", 0.05), 0.0, 1.0);
+    config.pressure_growth = std::clamp(getEnvDouble("SIZING_PRESSURE_GROWTH", 0.25), 0.0, 2.0);
+    config.min_samples = static_cast<unsigned int>(std::max(1, getEnvInt("SIZING_MIN_SAMPLES", 10)));
+    config.lookahead_minutes = std::clamp(getEnvInt("SIZING_LOOKAHEAD_MINUTES", 60), 0, 24 * 60);
+    return config;
+}
+
+// Highest KV usage recorded for the hours between now and now + lookahead on earlier days,
+// so the cache is restored before a recurring peak rather than after it
+double forecastKVUsage(const ModelMetrics& metrics, int lookahead_minutes) {
+    if (lookahead_minutes <= 0) return 0.0;
+    std::time_t now = std::time(nullptr);
+    std::tm local_tm{};
+    localtime_r(&now, &local_tm);
+
+    double forecast = 0.0;
+    int hours = (local_tm.tm_min + lookahead_minutes) / 60;
+    for (int offset = 0; offset <= std::min(hours, 23); ++offset) {
+        forecast = std::max(forecast, metrics.hourly_kv_peak[(local_tm.tm_hour + offset) % 24]);
+    }
+    return forecast;
+}
+
+static std::vector<double> sortedValues(std::vector<double> values) {
+    std::sort(values.begin(), values.end());
+    return values;
+}
+
+SizingRecommendation sizeModelAllocation(const std::string& container_name, const ModelMetrics& metrics, const SizingConfig& config) {
+    SizingRecommendation rec{};
+    rec.container_name = container_name;
+    rec.model_id = metrics.model_id;
+    rec.basis = "insufficient_data";
+    rec.action = "keep";
+    rec.samples = static_cast<unsigned int>(metrics.usage_samples.size());
+    rec.current_utilization = metrics.configured_max_utilization;
+    rec.target_utilization = metrics.configured_max_utilization;
+
+    if (metrics.usage_samples.size() < config.min_samples) {
+        return rec;
+    }
+
+    const ModelUsageSample& first = metrics.usage_samples.front();
+    const ModelUsageSample& latest = metrics.usage_samples.back();
+
+    std::vector<double> kv_usage;
+    std::vector<double> running;
+    std::vector<double> waiting;
+    std::vector<double> block_bytes;
+    for (const auto& sample : metrics.usage_samples) {
+        kv_usage.push_back(sample.kv_cache_usage_perc);
+        running.push_back(static_cast<double>(sample.num_requests_running));
+        waiting.push_back(static_cast<double>(sample.num_requests_waiting));
+        if (sample.kv_block_bytes > 0) {
+            block_bytes.push_back(static_cast<double>(sample.kv_block_bytes));
+        }
+    }
+    kv_usage = sortedValues(kv_usage);
+    rec.kv_usage_p50 = calculatePercentile(kv_usage, 0.50);
+    rec.kv_usage_p95 = calculatePercentile(kv_usage, 0.95);
+    rec.kv_usage_p99 = calculatePercentile(kv_usage, 0.99);
+    rec.kv_usage_forecast = forecastKVUsage(metrics, config.lookahead_minutes);
+    rec.requests_running_p95 = calculatePercentile(sortedValues(running), 0.95);
+    double waiting_p95 = calculatePercentile(sortedValues(waiting), 0.95);
+
+    // Preemption counter resets when the container restarts; treat that window as unknown
+    double elapsed_minutes = (latest.timestamp - first.timestamp) / 60.0;
+    if (elapsed_minutes > 0.0 && latest.num_preemptions_total >= first.num_preemptions_total) {
+        rec.preemptions_per_minute = (latest.num_preemptions_total - first.num_preemptions_total) / elapsed_minutes;
+    }
+
+    unsigned long long total = latest.total_vram_bytes;
+    rec.num_gpu_blocks = latest.num_gpu_blocks;
+    rec.target_gpu_blocks = latest.num_gpu_blocks;
+    rec.kv_block_bytes = block_bytes.empty() ? 0 : static_cast<unsigned long long>(calculatePercentile(sortedValues(block_bytes), 0.5));
+    if (total == 0 || rec.current_utilization <= 0.0) {
+        return rec;
+    }
+
+    // Each tensor parallel worker holds num_gpu_blocks blocks of kv_block_bytes, while
+    // total and footprint cover every device the model spans
+    double footprint = rec.current_utilization * total;
+    double block_bytes_all_devices = static_cast<double>(rec.kv_block_bytes) * std::max(1u, latest.gpu_count);
+    double kv_bytes = rec.num_gpu_blocks * block_bytes_all_devices;
+    double target_bytes = 0.0;
+
+    if (rec.kv_block_bytes > 0 && rec.num_gpu_blocks > 0 && kv_bytes < footprint) {
+        // Footprint = weights/activations (fixed) + KV blocks (sized to demand)
+        rec.basis = "kv_percentile";
+        double fixed_bytes = footprint - kv_bytes;
+        double needed_usage = std::max(calculatePercentile(kv_usage, config.kv_percentile), rec.kv_usage_forecast);
+        double needed_blocks = needed_usage * rec.num_gpu_blocks;
+
+        // Preemptions or a queue with a full cache mean the cache is already too small
+        bool under_pressure = rec.preemptions_per_minute > 0.0 || (waiting_p95 > 0.0 && rec.kv_usage_p95 > 0.9);
+        if (under_pressure) {
+            needed_blocks = std::max(needed_blocks, static_cast<double>(rec.num_gpu_blocks)) * (1.0 + config.pressure_growth);
+        }
+
+        double target_blocks = std::ceil(std::max(needed_blocks, 1.0) * (1.0 + config.safety_margin));
+        target_bytes = fixed_bytes + target_blocks * block_bytes_all_devices;
+    } else {
+        // No block size from vLLM: fall back to the observed peak footprint plus margin
+        if (metrics.peak_usage <= 0.0) {
+            return rec;
+        }
+        rec.basis = "peak_usage";
+        target_bytes = metrics.peak_usage / 100.0 * total * (1.0 + config.safety_margin);
+    }
+
+    rec.target_utilization = std::clamp(target_bytes / total, 0.1, 0.95);
+    if (rec.basis == "kv_percentile") {
+        double fixed_bytes = footprint - kv_bytes;
+        double blocks = (rec.target_utilization * total - fixed_bytes) / block_bytes_all_devices;
+        rec.target_gpu_blocks = blocks > 0.0 ? static_cast<unsigned int>(blocks) : 0;
+    }
+
+    double change = rec.target_utilization - rec.current_utilization;
+    if (std::fabs(change) < config.min_change) {
+        rec.target_utilization = rec.current_utilization;
+        rec.target_gpu_blocks = rec.num_gpu_blocks;
+        return rec;
+    }
+    rec.action = change < 0.0 ? "shrink" : "grow";
+    rec.projected_savings_bytes = static_cast<long long>(footprint) - static_cast<long long>(rec.target_utilization * total);
+    return rec;
+}
@@ -1,13 +1,14 @@
 #include "services/spindown_service.h"
 #include "services/model_manager.h"
 #include "utils/json_parser.h"
+#include "utils/http_io.h"
 #include <nlohmann/json.hpp>
 #include <boost/beast/core.hpp>
 #include <boost/beast/http.hpp>
 #include <sstream>
 #include <string>
 
-void handleSpindownRequest(http::request<http::string_body>& req, tcp::socket& socket) {
+void handleSpindownRequest(http::request<http::string_body>& req, ClientSocket& socket) {
     std::string body = req.body();
     std::string model_id = parseJSONField(body, "model_id");
     std::string container_id = parseJSONField(body, "container_id");
@@ -22,7 +23,7 @@ void handleSpindownRequest(http::request<http::string_body>& req, tcp::socket& s
         res.result(http::status::bad_request);
         res.body() = R"({"success":false,"message":"model_id or container_id is required"})";
         res.prepare_payload();
-        http::write(socket, res);
+        writeHttpMessage(socket, res);
         return;
     }
     
@@ -43,7 +44,7 @@ void handleSpindownRequest(http::request<http::string_body>& req, tcp::socket& s
     
     res.prepare_payload();
     try {
-        http::write(socket, res);
+        writeHttpMessage(socket, res);
     } catch (const boost::system::system_error& e) {
         auto ec = e.code();
         if (ec == boost::asio::error::broken_pipe || 
@@ -55,7 +56,7 @@ void handleSpindownRequest(http::request<http::string_body>& req, tcp::socket& s
     }
 }
 
-void handleListModelsRequest(http::request<http::string_body>& req, tcp::socket& socket) {
+void handleListModelsRequest(http::request<http::string_body>& req, ClientSocket& socket) {
     std::vector<DeployedModel> models = listDeployedModels();
     int max_allowed = getMaxConcurrentModels();
     int running = 0;
@@ -90,7 +91,7 @@ void handleListModelsRequest(http::request<http::string_body>& req, tcp::socket&
     res.prepare_payload();
     
     try {
-        http::write(socket, res);
+        writeHttpMessage(socket, res);
     } catch (const boost::system::system_error& e) {
         auto ec = e.code();
         if (ec == boost::asio::error::broken_pipe || 
@@ -2,6 +2,7 @@
 #include "services/model_manager.h"
 #include "utils/env_utils.h"
 #include "utils/logger.h"
+#include "utils/stage_timer.h"
 #include <cstdio>
 #include <cstdlib>
 #include <cctype>
@@ -9,6 +10,17 @@
 #include <string>
 #include <sstream>
 
+// Value of a label inside a Prometheus line, e.g. num_gpu_blocks="1234" ("" if absent)
+static std::string extractLabelValue(const std::string& line, const std::string& label) {
+    std::string needle = label + "=\"";
+    size_t start = line.find(needle);
+    if (start == std::string::npos) return "";
+    start += needle.length();
+    size_t end = line.find('"', start);
+    if (end == std::string::npos) return "";
+    return line.substr(start, end - start);
+}
+
 VLLMBlockData fetchVLLMBlockData() {
     VLLMBlockData data{0, 0, 0.0, 0.0, false};
     
@@ -208,6 +220,7 @@ VLLMBlockData fetchVLLMBlockData() {
 }
 
 std::vector<ModelBlockData> fetchPerModelBlockData() {
+    ScopedStageTimer timer("vllm_scrape");
     std::vector<ModelBlockData> models_data;
     
     // Get all deployed models and filter to only running ones
@@ -232,6 +245,10 @@ std::vector<ModelBlockData> fetchPerModelBlockData() {
         model_data.prefix_cache_hit_rate = 0.0;
         model_data.num_requests_running = 0;
         model_data.num_requests_waiting = 0;
+        model_data.num_preemptions_total = 0;
+        model_data.num_cpu_blocks = 0;
+        model_data.swap_space_gib = 0.0;
+        model_data.gpu_memory_utilization = 0.0;
         model_data.available = false;
         
         // Use timeout wrapper to ensure curl doesn't hang
@@ -258,6 +275,7 @@ std::vector<ModelBlockData> fetchPerModelBlockData() {
         unsigned long long cache_query_hit = 0;
         unsigned int requests_running = 0;
         unsigned int requests_waiting = 0;
+        unsigned long long preemptions_total = 0;
         bool found_cache_config = false;
         
         while (fgets(line, sizeof(line), curl)) {
@@ -282,6 +300,21 @@ std::vector<ModelBlockData> fetchPerModelBlockData() {
                         }
                     }
                 }
+                // Swap space and CPU block count give the real bytes per KV block
+                try {
+                    std::string cpu_blocks = extractLabelValue(line_str, "num_cpu_blocks");
+                    if (!cpu_blocks.empty() && cpu_blocks != "None") {
+                        model_data.num_cpu_blocks = static_cast<unsigned int>(std::stoul(cpu_blocks));
+                    }
+                    std::string swap_space = extractLabelValue(line_str, "swap_space");
+                    if (!swap_space.empty() && swap_space != "None") {
+                        model_data.swap_space_gib = std::stod(swap_space);
+                    }
+                    std::string gpu_util = extractLabelValue(line_str, "gpu_memory_utilization");
+                    if (!gpu_util.empty()) {
+                        model_data.gpu_memory_utilization = std::stod(gpu_util);
+                    }
+                } catch (...) {}
             }
             
             // Parse kv_cache_usage_perc - format: vllm:kv_cache_usage_perc{...} value
@@ -366,6 +399,18 @@ std::vector<ModelBlockData> fetchPerModelBlockData() {
                 }
             }
             
+            // Parse num_preemptions_total - format: vllm:num_preemptions_total{...} value
+            if (line_str.find("vllm:num_preemptions_total") != std::string::npos && line_str[0] != '#') {
+                size_t brace = line_str.find_last_of('}');
+                if (brace != std::string::npos && brace + 1 < line_str.length()) {
+                    try {
+                        preemptions_total = static_cast<unsigned long long>(std::stod(line_str.substr(brace + 1)));
+                    } catch (...) {
+                        preemptions_total = 0;
+                    }
+                }
+            }
+            
             // Parse num_requests_waiting - format: vllm:num_requests_waiting{...} value
             if (line_str.find("vllm:num_requests_waiting") != std::string::npos && line_str[0] != '#') {
                 size_t brace = line_str.find_last_of('}');
@@ -408,6 +453,7 @@ std::vector<ModelBlockData> fetchPerModelBlockData() {
             model_data.prefix_cache_hit_rate = model_prefix_hit_rate;
             model_data.num_requests_running = requests_running;
             model_data.num_requests_waiting = requests_waiting;
+            model_data.num_preemptions_total = preemptions_total;
             model_data.available = true;
             LOG_DEBUG("Model " + model.model_id + " metrics: blocks=" + std::to_string(model_blocks) +
                      ", kv_usage=" + std::to_string(model_kv_usage) +
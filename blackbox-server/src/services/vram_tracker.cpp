@@ -1,48 +1,380 @@
 #include "services/vram_tracker.h"
 #include "services/nvml_utils.h"
+#include "utils/json_serializer.h"
+#include "utils/binary_serializer.h"
+#include "utils/env_utils.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <iomanip>
+#include <sstream>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <string>
-#include <cstdio>
-#include <cstdlib>
+#include <type_traits>
+#include <unordered_map>
 #include <absl/strings/str_cat.h>
 
-std::map<std::string, ProcessVRAM> getProcessVRAMUsage() {
-    std::map<std::string, ProcessVRAM> usage;
-    DetailedVRAMInfo info = getDetailedVRAMUsage();
+struct VRAMIndex {
+    std::unordered_map<unsigned int, ProcessVRAM> by_pid;
+    std::unordered_map<std::string, double> by_container;  // "vllm-<model_id>" -> usage percent
+    std::map<std::string, ProcessVRAM> by_key;             // "pid_<pid>" and process names
+    std::shared_ptr<const PublishedSnapshot> snapshot;
+};
+
+// A collection with optional sections is kept per section mask; its core part is published
+// as the latest snapshot, which carries the version every index lookup reads
+struct SectionSnapshot {
+    std::shared_ptr<const PublishedSnapshot> snapshot;
+    std::chrono::steady_clock::time_point published_at;
+};
+
+static std::shared_ptr<const VRAMIndex> latest_index;
+static std::chrono::steady_clock::time_point latest_published_at;
+static unsigned long long latest_version = 0;
+static std::map<unsigned int, SectionSnapshot> section_snapshots;
+static std::mutex latest_index_mutex;  // Guards the four above
+static std::condition_variable snapshot_published;
+
+// FNV-1a over the snapshot's fields, one value at a time (never raw struct bytes, which include padding)
+class SnapshotHasher {
+public:
+    void add(const void* data, size_t size) {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; ++i) {
+            hash = (hash ^ bytes[i]) * 1099511628211ULL;
+        }
+    }
+    template <typename T>
+    void add(T value) {
+        static_assert(std::is_arithmetic_v<T>, "hash fields one by one");
+        add(&value, sizeof(value));
+    }
+    void add(const std::string& value) {
+        add(value.size());
+        add(value.data(), value.size());
+    }
+    unsigned long long value() const { return hash; }
+
+private:
+    unsigned long long hash = 14695981039346656037ULL;
+};
+
+// Every field that reaches a serialized body must be hashed here, or a change to it
+// would be served from the previous snapshot's cached body. The section mask is not part
+// of the content; snapshots with different masks never share an instance or an ETag.
+static unsigned long long fingerprintSnapshot(const DetailedVRAMInfo& info) {
+    SnapshotHasher h;
+    h.add(info.total);
+    h.add(info.used);
+    h.add(info.free);
+    h.add(info.reserved);
+    h.add(info.allocated_blocks);
+    h.add(info.utilized_blocks);
+    h.add(info.free_blocks);
+    h.add(info.atomic_allocations);
+    h.add(info.fragmentation_ratio);
+    h.add(info.used_kv_cache_bytes);
+    h.add(info.prefix_cache_hit_rate);
+    h.add(info.gpus.size());
+    for (const auto& gpu : info.gpus) {
+        h.add(gpu.index);
+        h.add(gpu.name);
+        h.add(gpu.uuid);
+        h.add(gpu.total);
+        h.add(gpu.used);
+        h.add(gpu.free);
+        h.add(gpu.process_count);
+    }
+    h.add(info.models.size());
+    for (const auto& model : info.models) {
+        h.add(model.model_id);
+        h.add(model.port);
+        h.add(model.allocated_vram_bytes);
+        h.add(model.used_kv_cache_bytes);
+        h.add(model.num_gpu_blocks);
+        h.add(model.kv_cache_usage_perc);
+        h.add(model.prefix_cache_hit_rate);
+        h.add(model.num_requests_running);
+        h.add(model.num_requests_waiting);
+        h.add(model.num_preemptions_total);
+        h.add(model.kv_block_bytes);
+        h.add(model.gpu_memory_utilization);
+        h.add(model.gpu_indices.size());
+        for (unsigned int gpu_index : model.gpu_indices) {
+            h.add(gpu_index);
+        }
+        h.add(model.gpu_total_bytes);
+    }
+    h.add(info.processes.size());
+    for (const auto& proc : info.processes) {
+        h.add(proc.pid);
+        h.add(proc.name);
+        h.add(proc.used_bytes);
+        h.add(proc.reserved_bytes);
+        h.add(proc.gpu_index);
+    }
+    h.add(info.block_maps.size());
+    for (const auto& map : info.block_maps) {
+        h.add(map.model_id);
+        h.add(map.port);
+        h.add(map.block_size);
+        h.add(map.num_blocks);
+        h.add(map.utilized_blocks);
+        h.add(map.runs.size());
+        for (const auto& run : map.runs) {
+            h.add(run.first_block);
+            h.add(run.count);
+            h.add(run.utilized);
+        }
+    }
+    h.add(info.nsight_metrics.size());
+    for (const auto& [pid, metrics] : info.nsight_metrics) {
+        h.add(pid);
+        h.add(metrics.atomic_operations);
+        h.add(metrics.threads_per_block);
+        h.add(metrics.occupancy);
+        h.add(metrics.active_blocks);
+        h.add(metrics.memory_throughput);
+        h.add(metrics.dram_read_bytes);
+        h.add(metrics.dram_write_bytes);
+        h.add(metrics.available);
+        h.add(metrics.collected_at);
+    }
+    h.add(info.threads.size());
+    for (const auto& thread : info.threads) {
+        h.add(thread.thread_id);
+        h.add(thread.allocated_bytes);
+        h.add(thread.state);
+    }
+    return h.value();
+}
+
+static std::shared_ptr<const VRAMIndex> getLatestIndex() {
+    std::lock_guard<std::mutex> lock(latest_index_mutex);
+    return latest_index;
+}
+
+// The snapshot without its optional sections, as a core collection would have published it
+static DetailedVRAMInfo coreSnapshot(const DetailedVRAMInfo& info) {
+    DetailedVRAMInfo core = info;
+    core.block_maps.clear();
+    core.nsight_metrics.clear();
+    core.threads.clear();
+    core.sections = SNAPSHOT_CORE;
+    return core;
+}
+
+static std::shared_ptr<const PublishedSnapshot> publishSectionSnapshot(DetailedVRAMInfo info) {
+    unsigned long long fingerprint = fingerprintSnapshot(info);
+    unsigned int sections = info.sections;
+    std::lock_guard<std::mutex> lock(latest_index_mutex);
+    SectionSnapshot& latest = section_snapshots[sections];
+    latest.published_at = std::chrono::steady_clock::now();
+    if (!latest.snapshot || latest.snapshot->fingerprint != fingerprint) {
+        auto snapshot = std::make_shared<PublishedSnapshot>();
+        snapshot->info = std::move(info);
+        snapshot->fingerprint = fingerprint;
+        snapshot->version = latest.snapshot ? latest.snapshot->version + 1 : 1;
+        latest.snapshot = std::move(snapshot);
+        snapshot_published.notify_all();
+    }
+    return latest.snapshot;
+}
+
+std::shared_ptr<const PublishedSnapshot> publishVRAMSnapshot(DetailedVRAMInfo info) {
+    if (info.sections != SNAPSHOT_CORE) {
+        // Callers asking for different sections must not replace each other's latest snapshot
+        publishVRAMSnapshot(coreSnapshot(info));
+        return publishSectionSnapshot(std::move(info));
+    }
+    unsigned long long fingerprint = fingerprintSnapshot(info);
+    {
+        // Unchanged content keeps the published instance, its index and its cached bodies
+        std::lock_guard<std::mutex> lock(latest_index_mutex);
+        if (latest_index && latest_index->snapshot->fingerprint == fingerprint) {
+            latest_published_at = std::chrono::steady_clock::now();
+            return latest_index->snapshot;
+        }
+    }
+    
+    auto index = std::make_shared<VRAMIndex>();
+    
+    std::unordered_map<unsigned int, unsigned long long> device_totals;
+    for (const auto& gpu : info.gpus) {
+        device_totals[gpu.index] = gpu.total;
+    }
+    
+    // A process can hold memory on several devices; its share is measured against those devices only
+    for (const auto& proc : info.processes) {
+        auto inserted = index->by_pid.emplace(proc.pid, ProcessVRAM{proc.pid, 0, 0, 0.0});
+        ProcessVRAM& pvram = inserted.first->second;
+        pvram.used_bytes += proc.used_bytes;
+        auto device_total = device_totals.find(proc.gpu_index);
+        pvram.total_bytes += device_total != device_totals.end() ? device_total->second : info.total;
+        pvram.usage_percent = pvram.total_bytes > 0 ? (100.0 * pvram.used_bytes / pvram.total_bytes) : 0.0;
+    }
     
     for (const auto& proc : info.processes) {
-        ProcessVRAM pvram;
-        pvram.pid = proc.pid;
-        pvram.used_bytes = proc.used_bytes;
-        pvram.total_bytes = info.total;
-        pvram.usage_percent = info.total > 0 ? (100.0 * proc.used_bytes / info.total) : 0.0;
-        
-        std::string key = absl::StrCat("pid_", proc.pid);
-        usage[key] = pvram;
-        
+        const ProcessVRAM& pvram = index->by_pid[proc.pid];
+        index->by_key[absl::StrCat("pid_", proc.pid)] = pvram;
         if (proc.name.find("python") != std::string::npos || 
             proc.name.find("vllm") != std::string::npos) {
-            usage[proc.name] = pvram;
+            index->by_key[proc.name] = pvram;
         }
     }
     
-    return usage;
+    for (const auto& model : info.models) {
+        unsigned long long total = model.gpu_total_bytes > 0 ? model.gpu_total_bytes : info.total;
+        index->by_container["vllm-" + model.model_id] = total > 0 ? 100.0 * model.allocated_vram_bytes / total : 0.0;
+    }
+    
+    auto snapshot = std::make_shared<PublishedSnapshot>();
+    snapshot->info = std::move(info);
+    snapshot->fingerprint = fingerprint;
+    
+    std::lock_guard<std::mutex> lock(latest_index_mutex);
+    snapshot->version = ++latest_version;
+    index->snapshot = snapshot;
+    latest_index = std::move(index);
+    latest_published_at = std::chrono::steady_clock::now();
+    snapshot_published.notify_all();
+    return snapshot;
+}
+
+bool parseSnapshotFormat(const std::string& name, SnapshotFormat& format) {
+    if (name.empty() || name == "json") {
+        format = SNAPSHOT_FORMAT_JSON;
+    } else if (name == "bin" || name == "binary") {
+        format = SNAPSHOT_FORMAT_BINARY;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* snapshotContentType(SnapshotFormat format) {
+    return format == SNAPSHOT_FORMAT_BINARY ? "application/octet-stream" : "application/json";
+}
+
+std::shared_ptr<const std::string> getSnapshotBody(const PublishedSnapshot& snapshot, SnapshotFormat format,
+                                                   ContentEncoding encoding) {
+    if (encoding != CONTENT_ENCODING_IDENTITY) {
+        std::shared_ptr<const std::string> identity = getSnapshotBody(snapshot, format);
+        std::call_once(snapshot.body_once[format][encoding], [&]() {
+            auto body = std::make_shared<std::string>();
+            if (compressBody(*identity, encoding, *body)) {
+                snapshot.bodies[format][encoding] = std::move(body);
+            }
+        });
+        return snapshot.bodies[format][encoding];
+    }
+    std::call_once(snapshot.body_once[format][CONTENT_ENCODING_IDENTITY], [&]() {
+        auto body = std::make_shared<std::string>();
+        switch (format) {
+            case SNAPSHOT_FORMAT_BINARY:
+                writeBinarySnapshot(snapshot.info, snapshot.version, *body);
+                break;
+            case SNAPSHOT_FORMAT_JSON:
+            default:
+                writeDetailedResponse(snapshot.info, *body);
+                break;
+        }
+        snapshot.bodies[format][CONTENT_ENCODING_IDENTITY] = std::move(body);
+    });
+    return snapshot.bodies[format][CONTENT_ENCODING_IDENTITY];
+}
+
+std::string getSnapshotETag(const PublishedSnapshot& snapshot, SnapshotFormat format, ContentEncoding encoding,
+                            const std::string& variant) {
+    static const char* FORMAT_SUFFIXES[SNAPSHOT_FORMAT_COUNT] = {"json", "bin"};
+    std::ostringstream etag;
+    etag << '"' << std::hex << std::setw(16) << std::setfill('0') << snapshot.fingerprint
+         << '-' << FORMAT_SUFFIXES[format];
+    if (snapshot.info.sections != SNAPSHOT_CORE) {
+        etag << "-s" << snapshot.info.sections;
+    }
+    if (!variant.empty()) {
+        etag << '-' << variant;
+    }
+    if (encoding != CONTENT_ENCODING_IDENTITY) {
+        etag << '-' << contentEncodingName(encoding);
+    }
+    etag << '"';
+    return etag.str();
+}
+
+std::shared_ptr<const DetailedVRAMInfo> getLatestVRAMSnapshot(double& age_seconds) {
+    std::lock_guard<std::mutex> lock(latest_index_mutex);
+    if (!latest_index) {
+        age_seconds = 0.0;
+        return nullptr;
+    }
+    age_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - latest_published_at).count();
+    // Shares ownership with the published snapshot
+    const PublishedSnapshot& published = *latest_index->snapshot;
+    return std::shared_ptr<const DetailedVRAMInfo>(latest_index->snapshot, &published.info);
+}
+
+std::chrono::milliseconds snapshotMaxAge() {
+    static const std::chrono::milliseconds max_age(std::max(0, getEnvInt("SNAPSHOT_MAX_AGE_MS", 1000)));
+    return max_age;
+}
+
+std::shared_ptr<const PublishedSnapshot> getPublishedSnapshot(unsigned int sections, double& age_seconds) {
+    std::lock_guard<std::mutex> lock(latest_index_mutex);
+    std::shared_ptr<const PublishedSnapshot> snapshot;
+    std::chrono::steady_clock::time_point published_at;
+    if (sections == SNAPSHOT_CORE) {
+        if (latest_index) {
+            snapshot = latest_index->snapshot;
+            published_at = latest_published_at;
+        }
+    } else {
+        auto found = section_snapshots.find(sections);
+        if (found != section_snapshots.end()) {
+            snapshot = found->second.snapshot;
+            published_at = found->second.published_at;
+        }
+    }
+    age_seconds = snapshot ? std::chrono::duration<double>(std::chrono::steady_clock::now() - published_at).count() : 0.0;
+    return snapshot;
+}
+
+bool waitForSnapshotPublish(unsigned int sections, unsigned long long after_version, std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(latest_index_mutex);
+    return snapshot_published.wait_for(lock, timeout, [&]() {
+        if (sections == SNAPSHOT_CORE) {
+            return latest_index && latest_index->snapshot->version > after_version;
+        }
+        auto found = section_snapshots.find(sections);
+        return found != section_snapshots.end() && found->second.snapshot->version > after_version;
+    });
+}
+
+std::map<std::string, ProcessVRAM> getProcessVRAMUsage() {
+    auto index = getLatestIndex();
+    if (!index) {
+        getDetailedVRAMUsage();
+        index = getLatestIndex();
+    }
+    return index ? index->by_key : std::map<std::string, ProcessVRAM>{};
 }
 
 double getModelVRAMUsagePercent(const std::string& container_name, unsigned int pid) {
-    auto usage = getProcessVRAMUsage();
+    auto index = getLatestIndex();
+    if (!index) return 0.0;
     
-    std::string pid_key = absl::StrCat("pid_", pid);
-    if (usage.find(pid_key) != usage.end()) {
-        return usage[pid_key].usage_percent;
+    auto by_pid = index->by_pid.find(pid);
+    if (by_pid != index->by_pid.end()) {
+        return by_pid->second.usage_percent;
     }
     
-    for (const auto& [key, pvram] : usage) {
-        if (pvram.pid == pid) {
-            return pvram.usage_percent;
-        }
+    auto by_container = index->by_container.find(container_name);
+    if (by_container != index->by_container.end()) {
+        return by_container->second;
     }
     
     return 0.0;
 }
-
@@ -0,0 +1,60 @@
+#include "utils/admission.h"
+
+static std::vector<const AdmissionGate*> admission_gates;
+static std::mutex admission_gates_mutex;
+
+AdmissionGate::AdmissionGate(std::string name, unsigned int max_active, unsigned int max_queued,
+                             std::chrono::milliseconds queue_timeout)
+    : name(std::move(name)), max_active(max_active), max_queued(max_queued), queue_timeout(queue_timeout) {
+    std::lock_guard<std::mutex> lock(admission_gates_mutex);
+    admission_gates.push_back(this);
+}
+
+bool AdmissionGate::enter() {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (counters.active < max_active) {
+        counters.active++;
+        counters.admitted++;
+        return true;
+    }
+    if (counters.queued >= max_queued) {
+        counters.shed_queue_full++;
+        return false;
+    }
+
+    counters.queued++;
+    bool got_slot = slot_freed.wait_for(lock, queue_timeout, [this] { return counters.active < max_active; });
+    counters.queued--;
+    if (!got_slot) {
+        counters.shed_timeout++;
+        return false;
+    }
+    counters.active++;
+    counters.admitted++;
+    counters.waited++;
+    return true;
+}
+
+void AdmissionGate::leave() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        counters.active--;
+    }
+    slot_freed.notify_one();
+}
+
+AdmissionStats AdmissionGate::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    AdmissionStats stats = counters;
+    stats.gate = name;
+    return stats;
+}
+
+std::vector<AdmissionStats> getAdmissionStats() {
+    std::vector<AdmissionStats> stats;
+    std::lock_guard<std::mutex> lock(admission_gates_mutex);
+    for (const AdmissionGate* gate : admission_gates) {
+        stats.push_back(gate->stats());
+    }
+    return stats;
+}
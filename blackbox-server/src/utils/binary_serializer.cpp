@@ -0,0 +1,233 @@
+#include "utils/binary_serializer.h"
+#include "utils/binary_snapshot.h"
+#include "services/nvml_utils.h"
+#include "utils/stage_timer.h"
+#include <cstring>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Little-endian stores, matching the decoder's loads on any host
+static void appendLE16(std::string& out, uint16_t v) {
+    char bytes[2] = {static_cast<char>(v), static_cast<char>(v >> 8)};
+    out.append(bytes, sizeof(bytes));
+}
+
+static void appendLE32(std::string& out, uint32_t v) {
+    char bytes[4];
+    for (int i = 0; i < 4; ++i) bytes[i] = static_cast<char>(v >> (8 * i));
+    out.append(bytes, sizeof(bytes));
+}
+
+static void appendLE64(std::string& out, uint64_t v) {
+    char bytes[8];
+    for (int i = 0; i < 8; ++i) bytes[i] = static_cast<char>(v >> (8 * i));
+    out.append(bytes, sizeof(bytes));
+}
+
+static void appendLEDouble(std::string& out, double d) {
+    uint64_t bits;
+    std::memcpy(&bits, &d, sizeof(bits));
+    appendLE64(out, bits);
+}
+
+// Each distinct string is stored once; model ids repeat across models and block maps
+class StringTable {
+public:
+    uint32_t intern(const std::string& s) {
+        auto found = refs.find(s);
+        if (found != refs.end()) return found->second;
+        uint32_t ref = static_cast<uint32_t>(bytes.size());
+        appendLE32(bytes, static_cast<uint32_t>(s.size()));
+        bytes.append(s);
+        refs.emplace(s, ref);
+        return ref;
+    }
+    const std::string& data() const { return bytes; }
+
+private:
+    std::string bytes;
+    std::unordered_map<std::string_view, uint32_t> refs;  // Views into the snapshot's own strings
+};
+
+struct SectionEntry {
+    uint16_t id;
+    uint16_t record_bytes;
+    uint32_t record_count;
+};
+
+void writeBinarySnapshot(const DetailedVRAMInfo& info, unsigned long long version, std::string& out) {
+    ScopedStageTimer timer("serialize_binary");
+
+    StringTable strings;
+    std::vector<uint32_t> gpu_refs;
+    for (const auto& gpu : info.gpus) {
+        gpu_refs.push_back(strings.intern(gpu.name));
+        gpu_refs.push_back(strings.intern(gpu.uuid));
+    }
+    std::vector<uint32_t> model_refs;
+    for (const auto& model : info.models) {
+        model_refs.push_back(strings.intern(model.model_id));
+    }
+
+    std::vector<SectionEntry> entries;
+    entries.push_back({BINARY_SECTION_TOTALS, BINARY_TOTALS_BYTES, 1});
+    entries.push_back({BINARY_SECTION_GPUS, BINARY_GPU_BYTES, static_cast<uint32_t>(info.gpus.size())});
+    entries.push_back({BINARY_SECTION_MODELS, BINARY_MODEL_BYTES, static_cast<uint32_t>(info.models.size())});
+    // Optional sections follow the same ?include= rules as the JSON body
+    std::vector<uint32_t> process_refs;
+    if (info.sections & SNAPSHOT_PROCESSES) {
+        for (const auto& proc : info.processes) {
+            process_refs.push_back(strings.intern(proc.name));
+        }
+        entries.push_back({BINARY_SECTION_PROCESSES, BINARY_PROCESS_BYTES, static_cast<uint32_t>(info.processes.size())});
+    }
+    std::vector<uint32_t> block_map_refs;
+    uint32_t total_runs = 0;
+    if (info.sections & SNAPSHOT_BLOCKS) {
+        for (const auto& map : info.block_maps) {
+            block_map_refs.push_back(strings.intern(map.model_id));
+            total_runs += static_cast<uint32_t>(map.runs.size());
+        }
+        entries.push_back({BINARY_SECTION_BLOCK_MAPS, BINARY_BLOCK_MAP_BYTES, static_cast<uint32_t>(info.block_maps.size())});
+        entries.push_back({BINARY_SECTION_BLOCK_RUNS, BINARY_BLOCK_RUN_BYTES, total_runs});
+    }
+    if (info.sections & SNAPSHOT_NSIGHT) {
+        entries.push_back({BINARY_SECTION_NSIGHT, BINARY_NSIGHT_BYTES, static_cast<uint32_t>(info.nsight_metrics.size())});
+    }
+    std::vector<uint32_t> thread_refs;
+    if (info.sections & SNAPSHOT_THREADS) {
+        for (const auto& thread : info.threads) {
+            thread_refs.push_back(strings.intern(thread.state));
+        }
+        entries.push_back({BINARY_SECTION_THREADS, BINARY_THREAD_BYTES, static_cast<uint32_t>(info.threads.size())});
+    }
+    entries.push_back({BINARY_SECTION_STRINGS, 1, static_cast<uint32_t>(strings.data().size())});
+
+    // Fixed-width records: every offset is known before anything is written
+    size_t start = out.size();
+    size_t offset = BINARY_SNAPSHOT_HEADER_BYTES + entries.size() * BINARY_SNAPSHOT_DIRECTORY_ENTRY_BYTES;
+    size_t total_bytes = offset;
+    for (const auto& entry : entries) {
+        total_bytes += static_cast<size_t>(entry.record_bytes) * entry.record_count;
+    }
+    out.reserve(start + total_bytes);
+
+    out.append(BINARY_SNAPSHOT_MAGIC, sizeof(BINARY_SNAPSHOT_MAGIC));
+    appendLE16(out, BINARY_SNAPSHOT_VERSION);
+    appendLE16(out, BINARY_SNAPSHOT_HEADER_BYTES);
+    appendLE64(out, version);
+    appendLE32(out, info.sections);
+    appendLE16(out, static_cast<uint16_t>(entries.size()));
+    appendLE16(out, BINARY_SNAPSHOT_DIRECTORY_ENTRY_BYTES);
+    for (const auto& entry : entries) {
+        appendLE16(out, entry.id);
+        appendLE16(out, entry.record_bytes);
+        appendLE32(out, entry.record_count);
+        appendLE32(out, static_cast<uint32_t>(offset));
+        offset += static_cast<size_t>(entry.record_bytes) * entry.record_count;
+    }
+
+    // Sections in directory order
+    appendLE64(out, info.total);
+    appendLE64(out, info.used);
+    appendLE64(out, info.free);
+    appendLE64(out, info.used_kv_cache_bytes);
+    appendLEDouble(out, info.prefix_cache_hit_rate);
+    bool has_blocks = info.sections & SNAPSHOT_BLOCKS;
+    appendLE32(out, has_blocks ? info.allocated_blocks : 0);
+    appendLE32(out, has_blocks ? info.utilized_blocks : 0);
+    appendLE32(out, has_blocks ? info.free_blocks : 0);
+    appendLE32(out, 0);
+
+    for (size_t i = 0; i < info.gpus.size(); ++i) {
+        const GPUDeviceInfo& gpu = info.gpus[i];
+        appendLE32(out, gpu.index);
+        appendLE32(out, gpu.process_count);
+        appendLE64(out, gpu.total);
+        appendLE64(out, gpu.used);
+        appendLE64(out, gpu.free);
+        appendLE32(out, gpu_refs[2 * i]);
+        appendLE32(out, gpu_refs[2 * i + 1]);
+    }
+
+    for (size_t i = 0; i < info.models.size(); ++i) {
+        const ModelVRAMInfo& model = info.models[i];
+        uint32_t gpu_mask = 0;
+        for (unsigned int gpu_index : model.gpu_indices) {
+            if (gpu_index < 32) gpu_mask |= 1u << gpu_index;
+        }
+        appendLE32(out, model_refs[i]);
+        appendLE32(out, static_cast<uint32_t>(model.port));
+        appendLE64(out, model.allocated_vram_bytes);
+        appendLE64(out, model.used_kv_cache_bytes);
+        appendLE64(out, model.num_preemptions_total);
+        appendLE64(out, model.kv_block_bytes);
+        appendLEDouble(out, model.kv_cache_usage_perc);
+        appendLEDouble(out, model.prefix_cache_hit_rate);
+        appendLEDouble(out, model.gpu_memory_utilization);
+        appendLE32(out, model.num_gpu_blocks);
+        appendLE32(out, model.num_requests_running);
+        appendLE32(out, model.num_requests_waiting);
+        appendLE32(out, gpu_mask);
+    }
+
+    if (info.sections & SNAPSHOT_PROCESSES) {
+        for (size_t i = 0; i < info.processes.size(); ++i) {
+            const ProcessMemory& proc = info.processes[i];
+            appendLE32(out, proc.pid);
+            appendLE32(out, proc.gpu_index);
+            appendLE64(out, proc.used_bytes);
+            appendLE64(out, proc.reserved_bytes);
+            appendLE32(out, process_refs[i]);
+            appendLE32(out, 0);
+        }
+    }
+
+    if (has_blocks) {
+        uint32_t first_run = 0;
+        for (size_t i = 0; i < info.block_maps.size(); ++i) {
+            const ModelBlockMap& map = info.block_maps[i];
+            appendLE32(out, block_map_refs[i]);
+            appendLE32(out, static_cast<uint32_t>(map.port));
+            appendLE64(out, map.block_size);
+            appendLE32(out, map.num_blocks);
+            appendLE32(out, map.utilized_blocks);
+            appendLE32(out, first_run);
+            appendLE32(out, static_cast<uint32_t>(map.runs.size()));
+            first_run += static_cast<uint32_t>(map.runs.size());
+        }
+        for (const auto& map : info.block_maps) {
+            for (const auto& run : map.runs) {
+                appendLE32(out, run.first_block);
+                appendLE32(out, (run.count << 1) | (run.utilized ? 1u : 0u));
+            }
+        }
+    }
+
+    if (info.sections & SNAPSHOT_NSIGHT) {
+        for (const auto& [pid, metrics] : info.nsight_metrics) {
+            appendLE32(out, pid);
+            appendLE32(out, metrics.available ? 1 : 0);
+            appendLE64(out, metrics.atomic_operations);
+            appendLE64(out, metrics.threads_per_block);
+            appendLEDouble(out, metrics.occupancy);
+            appendLE64(out, metrics.active_blocks);
+            appendLE64(out, metrics.memory_throughput);
+            appendLE64(out, metrics.dram_read_bytes);
+            appendLE64(out, metrics.dram_write_bytes);
+            appendLE64(out, static_cast<uint64_t>(metrics.collected_at));
+        }
+    }
+
+    if (info.sections & SNAPSHOT_THREADS) {
+        for (size_t i = 0; i < info.threads.size(); ++i) {
+            const ThreadInfo& thread = info.threads[i];
+            appendLE32(out, static_cast<uint32_t>(thread.thread_id));
+            appendLE32(out, thread_refs[i]);
+            appendLE64(out, thread.allocated_bytes);
+        }
+    }
+
+    out.append(strings.data());
+}
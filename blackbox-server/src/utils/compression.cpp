@@ -0,0 +1,221 @@
+#include "utils/compression.h"
+#include "utils/env_utils.h"
+#include "utils/logger.h"
+#include "utils/stage_timer.h"
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <chrono>
+#include <mutex>
+#ifdef ZLIB_AVAILABLE
+#include <zlib.h>
+#endif
+#ifdef ZSTD_AVAILABLE
+#include <zstd.h>
+#endif
+
+// Levels chosen for latency over ratio: snapshots are compressed on the request path
+static const int GZIP_LEVEL = 6;
+static const int ZSTD_LEVEL = 3;
+
+static const char* ENCODING_NAMES[CONTENT_ENCODING_COUNT] = {"identity", "gzip", "zstd"};
+
+struct EncodingCounters {
+    unsigned long long responses = 0;
+    unsigned long long bytes_in = 0;
+    unsigned long long bytes_out = 0;
+    std::chrono::steady_clock::duration time{};
+};
+
+static EncodingCounters encoding_counters[CONTENT_ENCODING_COUNT];
+static std::mutex encoding_counters_mutex;
+
+static bool isBuiltIn(ContentEncoding encoding) {
+    switch (encoding) {
+        case CONTENT_ENCODING_IDENTITY:
+            return true;
+#ifdef ZLIB_AVAILABLE
+        case CONTENT_ENCODING_GZIP:
+            return true;
+#endif
+#ifdef ZSTD_AVAILABLE
+        case CONTENT_ENCODING_ZSTD:
+            return true;
+#endif
+        default:
+            return false;
+    }
+}
+
+static size_t minCompressBytes() {
+    static const size_t min_bytes = static_cast<size_t>(std::max(0, getEnvInt("COMPRESSION_MIN_BYTES", 1024)));
+    return min_bytes;
+}
+
+const char* contentEncodingName(ContentEncoding encoding) {
+    return encoding < CONTENT_ENCODING_COUNT ? ENCODING_NAMES[encoding] : "identity";
+}
+
+static std::string_view trim(std::string_view s) {
+    while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) s.remove_prefix(1);
+    while (!s.empty() && (s.back() == ' ' || s.back() == '\t')) s.remove_suffix(1);
+    return s;
+}
+
+static bool equalsIgnoreCase(std::string_view a, std::string_view b) {
+    return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+        return std::tolower(static_cast<unsigned char>(x)) == std::tolower(static_cast<unsigned char>(y));
+    });
+}
+
+// "gzip;q=0.8, zstd, *;q=0" -> q value per coding; codings not listed take the "*" value (or 0)
+ContentEncoding negotiateContentEncoding(std::string_view accept_encoding, size_t body_size) {
+    if (accept_encoding.empty() || body_size < minCompressBytes()) return CONTENT_ENCODING_IDENTITY;
+
+    double quality[CONTENT_ENCODING_COUNT] = {};
+    bool listed[CONTENT_ENCODING_COUNT] = {};
+    double wildcard = 0.0;
+    bool has_wildcard = false;
+
+    size_t pos = 0;
+    while (pos < accept_encoding.size()) {
+        size_t end = accept_encoding.find(',', pos);
+        if (end == std::string_view::npos) end = accept_encoding.size();
+        std::string_view item = accept_encoding.substr(pos, end - pos);
+        pos = end + 1;
+
+        std::string_view coding = item;
+        double q = 1.0;
+        size_t semicolon = item.find(';');
+        if (semicolon != std::string_view::npos) {
+            coding = item.substr(0, semicolon);
+            std::string_view param = trim(item.substr(semicolon + 1));
+            if (param.size() > 2 && (param[0] == 'q' || param[0] == 'Q') && param[1] == '=') {
+                std::from_chars(param.data() + 2, param.data() + param.size(), q);
+            }
+        }
+        coding = trim(coding);
+        if (coding == "*") {
+            wildcard = q;
+            has_wildcard = true;
+            continue;
+        }
+        for (unsigned int e = 0; e < CONTENT_ENCODING_COUNT; ++e) {
+            if (equalsIgnoreCase(coding, ENCODING_NAMES[e])) {
+                quality[e] = q;
+                listed[e] = true;
+            }
+        }
+    }
+
+    // Highest q wins; on a tie the later (better compressing) coding is preferred
+    ContentEncoding best = CONTENT_ENCODING_IDENTITY;
+    double best_quality = 0.0;
+    for (unsigned int e = CONTENT_ENCODING_GZIP; e < CONTENT_ENCODING_COUNT; ++e) {
+        ContentEncoding encoding = static_cast<ContentEncoding>(e);
+        double q = listed[e] ? quality[e] : (has_wildcard ? wildcard : 0.0);
+        if (q > 0.0 && q >= best_quality && isBuiltIn(encoding)) {
+            best = encoding;
+            best_quality = q;
+        }
+    }
+    return best;
+}
+
+#ifdef ZLIB_AVAILABLE
+static bool gzipCompress(std::string_view input, std::string& out) {
+    // One deflate state per thread, reset between bodies instead of reallocated
+    struct Deflater {
+        z_stream stream{};
+        bool ready = false;
+        Deflater() { ready = deflateInit2(&stream, GZIP_LEVEL, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK; }
+        ~Deflater() { if (ready) deflateEnd(&stream); }
+    };
+    static thread_local Deflater deflater;
+    if (!deflater.ready || deflateReset(&deflater.stream) != Z_OK) return false;
+
+    z_stream& stream = deflater.stream;
+    out.resize(deflateBound(&stream, static_cast<uLong>(input.size())));
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+    stream.avail_in = static_cast<uInt>(input.size());
+    stream.next_out = reinterpret_cast<Bytef*>(out.data());
+    stream.avail_out = static_cast<uInt>(out.size());
+    if (deflate(&stream, Z_FINISH) != Z_STREAM_END) return false;
+    out.resize(stream.total_out);
+    return true;
+}
+#endif
+
+#ifdef ZSTD_AVAILABLE
+static bool zstdCompress(std::string_view input, std::string& out) {
+    struct Compressor {
+        ZSTD_CCtx* context = ZSTD_createCCtx();
+        ~Compressor() { ZSTD_freeCCtx(context); }
+    };
+    static thread_local Compressor compressor;
+    if (!compressor.context) return false;
+
+    out.resize(ZSTD_compressBound(input.size()));
+    size_t written = ZSTD_compressCCtx(compressor.context, out.data(), out.size(), input.data(), input.size(), ZSTD_LEVEL);
+    if (ZSTD_isError(written)) {
+        LOG_WARN(std::string("zstd compression failed: ") + ZSTD_getErrorName(written));
+        return false;
+    }
+    out.resize(written);
+    return true;
+}
+#endif
+
+bool compressBody(std::string_view input, ContentEncoding encoding, std::string& out) {
+    ScopedStageTimer timer("compress");
+    auto start = std::chrono::steady_clock::now();
+    bool compressed = false;
+    switch (encoding) {
+#ifdef ZLIB_AVAILABLE
+        case CONTENT_ENCODING_GZIP:
+            compressed = gzipCompress(input, out);
+            break;
+#endif
+#ifdef ZSTD_AVAILABLE
+        case CONTENT_ENCODING_ZSTD:
+            compressed = zstdCompress(input, out);
+            break;
+#endif
+        default:
+            return false;
+    }
+    if (!compressed || out.size() >= input.size()) {
+        out.clear();
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(encoding_counters_mutex);
+    EncodingCounters& counters = encoding_counters[encoding];
+    counters.responses++;
+    counters.bytes_in += input.size();
+    counters.bytes_out += out.size();
+    counters.time += std::chrono::steady_clock::now() - start;
+    return true;
+}
+
+ContentEncoding compressForClient(std::string_view accept_encoding, std::string& body) {
+    ContentEncoding encoding = negotiateContentEncoding(accept_encoding, body.size());
+    if (encoding == CONTENT_ENCODING_IDENTITY) return encoding;
+    static thread_local std::string compressed;
+    if (!compressBody(body, encoding, compressed)) return CONTENT_ENCODING_IDENTITY;
+    // Swap so both buffers keep their capacity for the next response
+    body.swap(compressed);
+    return encoding;
+}
+
+std::vector<CompressionStats> getCompressionStats() {
+    std::vector<CompressionStats> stats;
+    std::lock_guard<std::mutex> lock(encoding_counters_mutex);
+    for (unsigned int e = CONTENT_ENCODING_GZIP; e < CONTENT_ENCODING_COUNT; ++e) {
+        if (!isBuiltIn(static_cast<ContentEncoding>(e))) continue;
+        const EncodingCounters& counters = encoding_counters[e];
+        stats.push_back({ENCODING_NAMES[e], counters.responses, counters.bytes_in, counters.bytes_out,
+                         std::chrono::duration<double>(counters.time).count()});
+    }
+    return stats;
+}
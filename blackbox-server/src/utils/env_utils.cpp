@@ -6,9 +6,11 @@
 #include <algorithm>
 #include <string>
 #include <map>
+#include <mutex>
 
 static std::map<std::string, std::string> env_cache;
 static bool env_loaded = false;
+static std::once_flag env_load_once;
 
 std::map<std::string, std::string> loadEnvFile(const std::string& path) {
     std::map<std::string, std::string> env;
@@ -67,7 +69,8 @@ std::map<std::string, std::string> loadEnvFile(const std::string& path) {
 }
 
 std::string getEnvValue(const std::string& key, const std::string& default_val) {
-    if (!env_loaded) {
+    // Loaded once; getEnvValue is called from several threads
+    std::call_once(env_load_once, []() {
         // Try project root .env first (if BLACKBOX_ROOT is set)
         const char* project_root = std::getenv("BLACKBOX_ROOT");
         if (project_root) {
@@ -86,7 +89,7 @@ std::string getEnvValue(const std::string& key, const std::string& default_val)
             env_cache.insert(home_cache.begin(), home_cache.end());
         }
         env_loaded = true;
-    }
+    });
     
     const char* env_val = std::getenv(key.c_str());
     if (env_val) {
@@ -101,6 +104,26 @@ std::string getEnvValue(const std::string& key, const std::string& default_val)
     return default_val;
 }
 
+int getEnvInt(const std::string& key, int default_val) {
+    std::string value = getEnvValue(key, "");
+    if (value.empty()) return default_val;
+    try {
+        return std::stoi(value);
+    } catch (...) {
+        return default_val;
+    }
+}
+
+double getEnvDouble(const std::string& key, double default_val) {
+    std::string value = getEnvValue(key, "");
+    if (value.empty()) return default_val;
+    try {
+        return std::stod(value);
+    } catch (...) {
+        return default_val;
+    }
+}
+
 bool hasEnvKey(const std::string& key) {
     if (!env_loaded) {
         getEnvValue(key);
@@ -0,0 +1,8 @@
+#include "utils/http_io.h"
+#include "utils/env_utils.h"
+#include <algorithm>
+
+std::chrono::milliseconds httpWriteTimeout() {
+    static const std::chrono::milliseconds timeout(std::max(1, getEnvInt("HTTP_WRITE_TIMEOUT", 10)) * 1000);
+    return timeout;
+}
@@ -1,80 +1,160 @@
 #include "utils/json_serializer.h"
-#include <sstream>
-#include <iomanip>
+#include "utils/json_writer.h"
+#include "services/nvml_utils.h"
+#include "utils/stage_timer.h"
+#include <atomic>
 
-std::string createDetailedResponse(const DetailedVRAMInfo& info) {
-    std::ostringstream oss;
-    // Simplified response: total VRAM, allocated VRAM, used KV cache bytes, prefix cache hit rate, and per-model breakdown
-    oss << R"({"total_vram_bytes":)" << info.total
-        << R"(,"allocated_vram_bytes":)" << info.used
-        << R"(,"used_kv_cache_bytes":)" << info.used_kv_cache_bytes
-        << R"(,"prefix_cache_hit_rate":)" << std::fixed << std::setprecision(2) << info.prefix_cache_hit_rate
-        << R"(,"models":[)";
-    
-    for (size_t i = 0; i < info.models.size(); ++i) {
-        if (i > 0) oss << ",";
-        const auto& model = info.models[i];
-        oss << R"({"model_id":")" << model.model_id << R"(")"
-            << R"(,"port":)" << model.port
-            << R"(,"allocated_vram_bytes":)" << model.allocated_vram_bytes
-            << R"(,"used_kv_cache_bytes":)" << model.used_kv_cache_bytes
-            << "}";
+// Buffers are reserved from the previous response's size so a steady poll appends without regrowing
+static std::atomic<size_t> last_detailed_size{4096};
+static std::atomic<size_t> last_aggregated_size{2048};
+
+// Optional sections, present only when the snapshot computed them (?include=...)
+static bool hasProcesses(const DetailedVRAMInfo& info) { return info.sections & SNAPSHOT_PROCESSES; }
+static bool hasBlocks(const DetailedVRAMInfo& info) { return info.sections & SNAPSHOT_BLOCKS; }
+static bool hasNsight(const DetailedVRAMInfo& info) { return info.sections & SNAPSHOT_NSIGHT; }
+static bool hasThreads(const DetailedVRAMInfo& info) { return info.sections & SNAPSHOT_THREADS; }
+
+static const auto GPU_FIELDS = std::make_tuple(
+    jsonField("index", &GPUDeviceInfo::index),
+    jsonField("name", &GPUDeviceInfo::name),
+    jsonField("uuid", &GPUDeviceInfo::uuid),
+    jsonField("total_vram_bytes", &GPUDeviceInfo::total),
+    jsonField("allocated_vram_bytes", &GPUDeviceInfo::used),
+    jsonField("free_vram_bytes", &GPUDeviceInfo::free),
+    jsonField("process_count", &GPUDeviceInfo::process_count)
+);
+
+static const auto MODEL_FIELDS = std::make_tuple(
+    jsonField("model_id", &ModelVRAMInfo::model_id),
+    jsonField("port", &ModelVRAMInfo::port),
+    jsonField("allocated_vram_bytes", &ModelVRAMInfo::allocated_vram_bytes),
+    jsonField("used_kv_cache_bytes", &ModelVRAMInfo::used_kv_cache_bytes),
+    jsonField("gpus", &ModelVRAMInfo::gpu_indices)
+);
+
+static const auto PROCESS_FIELDS = std::make_tuple(
+    jsonField("pid", &ProcessMemory::pid),
+    jsonField("name", &ProcessMemory::name),
+    jsonField("gpu_index", &ProcessMemory::gpu_index),
+    jsonField("used_bytes", &ProcessMemory::used_bytes),
+    jsonField("reserved_bytes", &ProcessMemory::reserved_bytes)
+);
+
+static const auto BLOCK_MAP_FIELDS = std::make_tuple(
+    jsonField("model_id", &ModelBlockMap::model_id),
+    jsonField("block_size", &ModelBlockMap::block_size),
+    jsonField("total_blocks", &ModelBlockMap::num_blocks),
+    jsonField("utilized_blocks", &ModelBlockMap::utilized_blocks),
+    jsonNested("runs", &ModelBlockMap::runs, BLOCK_RUN_FIELDS)
+);
+
+static const auto NSIGHT_FIELDS = std::make_tuple(
+    jsonField("atomic_operations", &NsightMetrics::atomic_operations),
+    jsonField("threads_per_block", &NsightMetrics::threads_per_block),
+    jsonField("occupancy", &NsightMetrics::occupancy, 2),
+    jsonField("active_blocks", &NsightMetrics::active_blocks),
+    jsonField("memory_throughput", &NsightMetrics::memory_throughput),
+    jsonField("dram_read_bytes", &NsightMetrics::dram_read_bytes),
+    jsonField("dram_write_bytes", &NsightMetrics::dram_write_bytes),
+    jsonField("available", &NsightMetrics::available),
+    jsonField("collected_at", &NsightMetrics::collected_at)
+);
+
+static const auto THREAD_FIELDS = std::make_tuple(
+    jsonField("thread_id", &ThreadInfo::thread_id),
+    jsonField("allocated_bytes", &ThreadInfo::allocated_bytes),
+    jsonField("state", &ThreadInfo::state)
+);
+
+// Simplified response: total VRAM, allocated VRAM, used KV cache bytes, prefix cache hit rate,
+// per-device and per-model breakdown, then whichever optional sections were computed
+static const auto DETAILED_FIELDS = std::make_tuple(
+    jsonField("total_vram_bytes", &DetailedVRAMInfo::total),
+    jsonField("allocated_vram_bytes", &DetailedVRAMInfo::used),
+    jsonField("used_kv_cache_bytes", &DetailedVRAMInfo::used_kv_cache_bytes),
+    jsonField("prefix_cache_hit_rate", &DetailedVRAMInfo::prefix_cache_hit_rate, 2),
+    jsonNested("gpus", &DetailedVRAMInfo::gpus, GPU_FIELDS),
+    jsonNested("models", &DetailedVRAMInfo::models, MODEL_FIELDS),
+    jsonNested("processes", &DetailedVRAMInfo::processes, PROCESS_FIELDS, hasProcesses),
+    jsonField("allocated_blocks", &DetailedVRAMInfo::allocated_blocks, -1, hasBlocks),
+    jsonField("utilized_blocks", &DetailedVRAMInfo::utilized_blocks, -1, hasBlocks),
+    jsonField("free_blocks", &DetailedVRAMInfo::free_blocks, -1, hasBlocks),
+    jsonNested("blocks", &DetailedVRAMInfo::block_maps, BLOCK_MAP_FIELDS, hasBlocks),
+    jsonNested("nsight_metrics", &DetailedVRAMInfo::nsight_metrics, NSIGHT_FIELDS, hasNsight),
+    jsonNested("threads", &DetailedVRAMInfo::threads, THREAD_FIELDS, hasThreads)
+);
+
+static const auto AGGREGATED_STATS_FIELDS = std::make_tuple(
+    jsonField("min", &AggregatedStats::min, 2),
+    jsonField("max", &AggregatedStats::max, 2),
+    jsonField("avg", &AggregatedStats::avg, 2),
+    jsonField("p95", &AggregatedStats::p95, 2),
+    jsonField("p99", &AggregatedStats::p99, 2),
+    jsonField("count", &AggregatedStats::count)
+);
+
+static const auto AGGREGATED_MODEL_FIELDS = std::make_tuple(
+    jsonField("model_id", &ModelVRAMInfo::model_id),
+    jsonField("port", &ModelVRAMInfo::port),
+    jsonField("allocated_vram_bytes", &ModelVRAMInfo::allocated_vram_bytes),
+    jsonField("used_kv_cache_bytes", &ModelVRAMInfo::used_kv_cache_bytes)
+);
+
+static const auto AGGREGATED_FIELDS = std::make_tuple(
+    jsonField("total_vram_bytes", &AggregatedVRAMInfo::total_vram_bytes),
+    jsonField("window_seconds", &AggregatedVRAMInfo::window_seconds),
+    jsonField("sample_count", &AggregatedVRAMInfo::sample_count),
+    jsonNested("allocated_vram_bytes", &AggregatedVRAMInfo::allocated_vram_bytes, AGGREGATED_STATS_FIELDS),
+    jsonNested("used_kv_cache_bytes", &AggregatedVRAMInfo::used_kv_cache_bytes, AGGREGATED_STATS_FIELDS),
+    jsonNested("prefix_cache_hit_rate", &AggregatedVRAMInfo::prefix_cache_hit_rate, AGGREGATED_STATS_FIELDS),
+    jsonNested("num_requests_running", &AggregatedVRAMInfo::num_requests_running, AGGREGATED_STATS_FIELDS),
+    jsonNested("num_requests_waiting", &AggregatedVRAMInfo::num_requests_waiting, AGGREGATED_STATS_FIELDS),
+    jsonNested("models", &AggregatedVRAMInfo::models, AGGREGATED_MODEL_FIELDS)
+);
+
+void writeDetailedResponse(const DetailedVRAMInfo& info, std::string& out, const JsonSelection* selection) {
+    ScopedStageTimer timer("serialize");
+    size_t start = out.size();
+    out.reserve(start + last_detailed_size.load() + last_detailed_size.load() / 4);
+    JsonWriter writer(out);
+    writeJsonObject(writer, info, DETAILED_FIELDS, selection ? selection->scope() : JsonScope());
+    // Projected bodies are smaller; only full ones size the next reservation
+    if (!selection || selection->empty()) {
+        last_detailed_size = out.size() - start;
     }
-    
-    oss << "]}";
-    return oss.str();
 }
 
-std::string createAggregatedResponse(const AggregatedVRAMInfo& info) {
-    std::ostringstream oss;
-    oss << std::fixed << std::setprecision(2);
-    
-    oss << R"({"total_vram_bytes":)" << info.total_vram_bytes
-        << R"(,"window_seconds":)" << info.window_seconds
-        << R"(,"sample_count":)" << info.sample_count
-        << R"(,"allocated_vram_bytes":{"min":)" << info.allocated_vram_bytes.min
-        << R"(,"max":)" << info.allocated_vram_bytes.max
-        << R"(,"avg":)" << info.allocated_vram_bytes.avg
-        << R"(,"p95":)" << info.allocated_vram_bytes.p95
-        << R"(,"p99":)" << info.allocated_vram_bytes.p99
-        << R"(,"count":)" << info.allocated_vram_bytes.count << "}"
-        << R"(,"used_kv_cache_bytes":{"min":)" << info.used_kv_cache_bytes.min
-        << R"(,"max":)" << info.used_kv_cache_bytes.max
-        << R"(,"avg":)" << info.used_kv_cache_bytes.avg
-        << R"(,"p95":)" << info.used_kv_cache_bytes.p95
-        << R"(,"p99":)" << info.used_kv_cache_bytes.p99
-        << R"(,"count":)" << info.used_kv_cache_bytes.count << "}"
-        << R"(,"prefix_cache_hit_rate":{"min":)" << info.prefix_cache_hit_rate.min
-        << R"(,"max":)" << info.prefix_cache_hit_rate.max
-        << R"(,"avg":)" << info.prefix_cache_hit_rate.avg
-        << R"(,"p95":)" << info.prefix_cache_hit_rate.p95
-        << R"(,"p99":)" << info.prefix_cache_hit_rate.p99
-        << R"(,"count":)" << info.prefix_cache_hit_rate.count << "}"
-        << R"(,"num_requests_running":{"min":)" << info.num_requests_running.min
-        << R"(,"max":)" << info.num_requests_running.max
-        << R"(,"avg":)" << info.num_requests_running.avg
-        << R"(,"p95":)" << info.num_requests_running.p95
-        << R"(,"p99":)" << info.num_requests_running.p99
-        << R"(,"count":)" << info.num_requests_running.count << "}"
-        << R"(,"num_requests_waiting":{"min":)" << info.num_requests_waiting.min
-        << R"(,"max":)" << info.num_requests_waiting.max
-        << R"(,"avg":)" << info.num_requests_waiting.avg
-        << R"(,"p95":)" << info.num_requests_waiting.p95
-        << R"(,"p99":)" << info.num_requests_waiting.p99
-        << R"(,"count":)" << info.num_requests_waiting.count << "}"
-        << R"(,"models":[)";
-    
-    for (size_t i = 0; i < info.models.size(); ++i) {
-        if (i > 0) oss << ",";
-        const auto& model = info.models[i];
-        oss << R"({"model_id":")" << model.model_id << R"(")"
-            << R"(,"port":)" << model.port
-            << R"(,"allocated_vram_bytes":)" << model.allocated_vram_bytes
-            << R"(,"used_kv_cache_bytes":)" << model.used_kv_cache_bytes
-            << "}";
+void writeAggregatedResponse(const AggregatedVRAMInfo& info, std::string& out, const JsonSelection* selection) {
+    ScopedStageTimer timer("serialize_aggregated");
+    size_t start = out.size();
+    out.reserve(start + last_aggregated_size.load() + last_aggregated_size.load() / 4);
+    JsonWriter writer(out);
+    writeJsonObject(writer, info, AGGREGATED_FIELDS, selection ? selection->scope() : JsonScope());
+    if (!selection || selection->empty()) {
+        last_aggregated_size = out.size() - start;
     }
-    
-    oss << "]}";
-    return oss.str();
 }
 
+bool compileDetailedSelection(const std::string& fields, const std::string& model_id,
+                              JsonSelection& selection, std::string& error) {
+    selection.model_id = model_id;
+    return compileJsonProjection(DETAILED_FIELDS, fields, selection.projection, error);
+}
+
+bool compileAggregatedSelection(const std::string& fields, const std::string& model_id,
+                                JsonSelection& selection, std::string& error) {
+    selection.model_id = model_id;
+    return compileJsonProjection(AGGREGATED_FIELDS, fields, selection.projection, error);
+}
+
+std::string createDetailedResponse(const DetailedVRAMInfo& info) {
+    std::string json;
+    writeDetailedResponse(info, json);
+    return json;
+}
+
+std::string createAggregatedResponse(const AggregatedVRAMInfo& info) {
+    std::string json;
+    writeAggregatedResponse(info, json);
+    return json;
+}
@@ -0,0 +1,70 @@
+#include "utils/json_writer.h"
+#include <cmath>
+
+static const char HEX_DIGITS[] = "0123456789abcdef";
+
+// Quote and escape: ", \ and control characters. Other bytes (UTF-8) pass through.
+static void appendEscaped(std::string& out, std::string_view s) {
+    out += '"';
+    size_t run_start = 0;
+    for (size_t i = 0; i < s.size(); ++i) {
+        unsigned char c = static_cast<unsigned char>(s[i]);
+        if (c >= 0x20 && c != '"' && c != '\\') continue;
+        out.append(s.data() + run_start, i - run_start);
+        run_start = i + 1;
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                out += "\\u00";
+                out += HEX_DIGITS[c >> 4];
+                out += HEX_DIGITS[c & 0xf];
+        }
+    }
+    out.append(s.data() + run_start, s.size() - run_start);
+    out += '"';
+}
+
+void JsonWriter::prefix() {
+    if (after_key) {
+        after_key = false;
+        return;
+    }
+    unsigned long long bit = 1ULL << depth;
+    if (has_elements & bit) out += ',';
+    has_elements |= bit;
+}
+
+void JsonWriter::key(std::string_view name) {
+    prefix();
+    appendEscaped(out, name);
+    out += ':';
+    after_key = true;
+}
+
+void JsonWriter::value(std::string_view s) {
+    prefix();
+    appendEscaped(out, s);
+}
+
+void JsonWriter::value(double d, int precision) {
+    // JSON has no NaN or infinity
+    if (!std::isfinite(d)) {
+        null();
+        return;
+    }
+    prefix();
+    char buffer[64];
+    std::to_chars_result result{};
+    if (precision >= 0) {
+        result = std::to_chars(buffer, buffer + sizeof(buffer), d, std::chars_format::fixed, precision);
+    }
+    // Shortest form also covers values too large for fixed notation in the buffer
+    if (precision < 0 || result.ec != std::errc()) {
+        result = std::to_chars(buffer, buffer + sizeof(buffer), d);
+    }
+    out.append(buffer, result.ptr);
+}
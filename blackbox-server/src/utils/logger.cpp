@@ -29,8 +29,11 @@ std::string Logger::getTimestamp() {
     auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
         now.time_since_epoch()) % 1000;
     
+    // std::localtime returns a buffer shared by every thread
+    std::tm local_time{};
+    localtime_r(&time, &local_time);
     std::stringstream ss;
-    ss << std::put_time(std::localtime(&time), "%Y-%m-%d %H:%M:%S");
+    ss << std::put_time(&local_time, "%Y-%m-%d %H:%M:%S");
     ss << "." << std::setfill('0') << std::setw(3) << ms.count();
     return ss.str();
 }
@@ -82,7 +85,12 @@ void Logger::log(LogLevel level, const std::string& message) {
     std::string level_str = levelToString(level);
     std::string colored_level = colorize(level, level_str);
     
-    std::cerr << "[" << timestamp << "] [" << colored_level << "] " << message << std::endl;
+    // One write per line, so lines from concurrent threads never interleave
+    std::string line;
+    line.reserve(timestamp.size() + colored_level.size() + message.size() + 8);
+    line.append("[").append(timestamp).append("] [").append(colored_level).append("] ").append(message).append("\n");
+    std::cerr.write(line.data(), static_cast<std::streamsize>(line.size()));
+    std::cerr.flush();
 }
 
 void Logger::debug(const std::string& message) {
@@ -0,0 +1,81 @@
+#include "utils/query_utils.h"
+#include <cctype>
+#include <charconv>
+#include <string>
+
+static int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    return std::tolower(static_cast<unsigned char>(c)) - 'a' + 10;
+}
+
+std::string urlDecode(std::string_view value) {
+    std::string decoded;
+    decoded.reserve(value.size());
+    for (size_t i = 0; i < value.size(); ++i) {
+        if (value[i] == '+') {
+            decoded += ' ';
+        } else if (value[i] == '%' && i + 2 < value.size() &&
+                   std::isxdigit(static_cast<unsigned char>(value[i + 1])) &&
+                   std::isxdigit(static_cast<unsigned char>(value[i + 2]))) {
+            decoded += static_cast<char>(hexValue(value[i + 1]) * 16 + hexValue(value[i + 2]));
+            i += 2;
+        } else {
+            decoded += value[i];
+        }
+    }
+    return decoded;
+}
+
+QueryParams::QueryParams(std::string_view target) {
+    size_t query_pos = target.find('?');
+    if (query_pos != std::string_view::npos) {
+        query = target.substr(query_pos + 1);
+    }
+}
+
+bool QueryParams::find(std::string_view key, std::string_view& value) const {
+    size_t pos = 0;
+    while (pos < query.size()) {
+        size_t end = query.find('&', pos);
+        if (end == std::string_view::npos) end = query.size();
+        std::string_view pair = query.substr(pos, end - pos);
+        size_t eq = pair.find('=');
+        if (pair.substr(0, eq) == key) {
+            value = eq == std::string_view::npos ? std::string_view() : pair.substr(eq + 1);
+            return true;
+        }
+        pos = end + 1;
+    }
+    return false;
+}
+
+std::string_view QueryParams::raw(std::string_view key) const {
+    std::string_view value;
+    find(key, value);
+    return value;
+}
+
+bool QueryParams::has(std::string_view key) const {
+    std::string_view value;
+    return find(key, value);
+}
+
+std::string QueryParams::get(std::string_view key) const {
+    std::string_view value = raw(key);
+    if (value.find_first_of("%+") == std::string_view::npos) return std::string(value);
+    return urlDecode(value);
+}
+
+bool QueryParams::getUnsigned(std::string_view key, unsigned long long& value) const {
+    std::string_view text = raw(key);
+    if (text.empty()) return false;
+    unsigned long long parsed = 0;
+    auto result = std::from_chars(text.data(), text.data() + text.size(), parsed);
+    if (result.ec != std::errc() || result.ptr != text.data() + text.size()) return false;
+    value = parsed;
+    return true;
+}
+
+std::string getQueryParam(const std::string& target, const std::string& key) {
+    return QueryParams(target).get(key);
+}
@@ -0,0 +1,160 @@
+#include "utils/stage_timer.h"
+#include <algorithm>
+#include <array>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+
+// Log-linear (HDR style) histogram of microseconds: exact below 64us, then 32
+// sub-buckets per power of two, so any recorded value is within ~3% of its bucket.
+static constexpr unsigned int SUB_BUCKET_BITS = 5;
+static constexpr unsigned long long SUB_BUCKETS = 1ULL << SUB_BUCKET_BITS;
+static constexpr size_t HISTOGRAM_BUCKETS = 64 * SUB_BUCKETS;
+
+struct StageHistogram {
+    std::array<unsigned long long, HISTOGRAM_BUCKETS> counts{};
+    unsigned long long count = 0;
+    unsigned long long total_us = 0;
+    unsigned long long min_us = 0;
+    unsigned long long max_us = 0;
+};
+
+static std::map<std::string, std::unique_ptr<StageHistogram>> stage_histograms;
+static std::mutex stage_histograms_mutex;
+
+static thread_local bool request_timing_active = false;
+static thread_local std::vector<StageDuration> request_timings;
+
+static size_t bucketIndex(unsigned long long us) {
+    if (us < 2 * SUB_BUCKETS) return static_cast<size_t>(us);
+    unsigned int msb = 63 - __builtin_clzll(us);
+    unsigned int shift = msb - SUB_BUCKET_BITS;
+    size_t index = (shift + 1) * SUB_BUCKETS + ((us >> shift) - SUB_BUCKETS);
+    return std::min(index, HISTOGRAM_BUCKETS - 1);
+}
+
+// Midpoint of the values that land in a bucket
+static double bucketValue(size_t index) {
+    if (index < 2 * SUB_BUCKETS) return static_cast<double>(index);
+    unsigned int shift = static_cast<unsigned int>(index / SUB_BUCKETS) - 1;
+    unsigned long long lower = (SUB_BUCKETS + index % SUB_BUCKETS) << shift;
+    return lower + ((1ULL << shift) - 1) / 2.0;
+}
+
+static double percentile(const StageHistogram& histogram, double q) {
+    unsigned long long rank = static_cast<unsigned long long>(q * histogram.count + 0.5);
+    if (rank < 1) rank = 1;
+    unsigned long long seen = 0;
+    for (size_t i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+        seen += histogram.counts[i];
+        if (seen >= rank) {
+            return std::min(std::max(bucketValue(i), static_cast<double>(histogram.min_us)),
+                            static_cast<double>(histogram.max_us));
+        }
+    }
+    return static_cast<double>(histogram.max_us);
+}
+
+ScopedStageTimer::ScopedStageTimer(const char* stage)
+    : stage(stage), start(std::chrono::steady_clock::now()) {}
+
+ScopedStageTimer::~ScopedStageTimer() {
+    if (stage) recordStageTiming(stage, std::chrono::steady_clock::now() - start);
+}
+
+void recordStageTiming(const std::string& stage, std::chrono::steady_clock::duration duration) {
+    unsigned long long us = static_cast<unsigned long long>(
+        std::chrono::duration_cast<std::chrono::microseconds>(duration).count());
+
+    if (request_timing_active) {
+        double ms = std::chrono::duration<double, std::milli>(duration).count();
+        bool found = false;
+        for (auto& entry : request_timings) {
+            if (entry.stage == stage) {
+                entry.ms += ms;
+                found = true;
+                break;
+            }
+        }
+        if (!found) request_timings.push_back(StageDuration{stage, ms});
+    }
+
+    std::lock_guard<std::mutex> lock(stage_histograms_mutex);
+    auto& histogram = stage_histograms[stage];
+    if (!histogram) histogram = std::make_unique<StageHistogram>();
+    histogram->counts[bucketIndex(us)]++;
+    histogram->min_us = histogram->count == 0 ? us : std::min(histogram->min_us, us);
+    histogram->max_us = std::max(histogram->max_us, us);
+    histogram->count++;
+    histogram->total_us += us;
+}
+
+std::vector<StageTimingStats> getStageTimings() {
+    std::vector<StageTimingStats> stats;
+    std::lock_guard<std::mutex> lock(stage_histograms_mutex);
+    for (const auto& [stage, histogram] : stage_histograms) {
+        StageTimingStats entry;
+        entry.stage = stage;
+        entry.count = histogram->count;
+        entry.total_ms = histogram->total_us / 1000.0;
+        entry.min_ms = histogram->min_us / 1000.0;
+        entry.max_ms = histogram->max_us / 1000.0;
+        entry.p50_ms = percentile(*histogram, 0.50) / 1000.0;
+        entry.p90_ms = percentile(*histogram, 0.90) / 1000.0;
+        entry.p99_ms = percentile(*histogram, 0.99) / 1000.0;
+        stats.push_back(entry);
+    }
+    return stats;
+}
+
+// Upper end of the values that land in a bucket
+static unsigned long long bucketUpperBound(size_t index) {
+    if (index < 2 * SUB_BUCKETS) return index;
+    unsigned int shift = static_cast<unsigned int>(index / SUB_BUCKETS) - 1;
+    return ((SUB_BUCKETS + index % SUB_BUCKETS + 1) << shift) - 1;
+}
+
+std::vector<StageHistogramBuckets> getStageHistograms(const std::vector<double>& bounds_seconds) {
+    std::vector<StageHistogramBuckets> histograms;
+    std::lock_guard<std::mutex> lock(stage_histograms_mutex);
+    for (const auto& [stage, histogram] : stage_histograms) {
+        StageHistogramBuckets entry;
+        entry.stage = stage;
+        entry.count = histogram->count;
+        entry.sum_seconds = histogram->total_us / 1e6;
+        entry.cumulative_counts.assign(bounds_seconds.size(), 0);
+        for (size_t i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+            if (histogram->counts[i] == 0) continue;
+            double upper_seconds = bucketUpperBound(i) / 1e6;
+            for (size_t b = 0; b < bounds_seconds.size(); ++b) {
+                if (upper_seconds <= bounds_seconds[b]) entry.cumulative_counts[b] += histogram->counts[i];
+            }
+        }
+        histograms.push_back(entry);
+    }
+    return histograms;
+}
+
+void beginRequestTiming() {
+    request_timings.clear();
+    request_timing_active = true;
+}
+
+std::vector<StageDuration> endRequestTiming() {
+    request_timing_active = false;
+    std::vector<StageDuration> timings;
+    timings.swap(request_timings);
+    return timings;
+}
+
+std::string formatServerTiming(const std::vector<StageDuration>& durations) {
+    std::ostringstream oss;
+    oss << std::fixed << std::setprecision(2);
+    for (size_t i = 0; i < durations.size(); ++i) {
+        if (i > 0) oss << ", ";
+        oss << durations[i].stage << ";dur=" << durations[i].ms;
+    }
+    return oss.str();
+}
@@ -0,0 +1,246 @@
+#include "utils/subprocess.h"
+#include "utils/logger.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <map>
+#include <mutex>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <absl/strings/str_cat.h>
+
+extern char** environ;
+
+// Time between SIGTERM and SIGKILL once a deadline passes, so tools like ncu can flush
+static const std::chrono::milliseconds KILL_GRACE_PERIOD(1000);
+// Poll interval for reaping when pidfd_open is unavailable (kernels before 5.3)
+static const int WAITPID_POLL_MS = 20;
+static const size_t READ_CHUNK_BYTES = 64 * 1024;
+
+struct ProgramCounters {
+    unsigned long long spawns = 0;
+    unsigned long long spawn_failures = 0;
+    unsigned long long timeouts = 0;
+    std::chrono::steady_clock::duration spawn_time{};
+    std::chrono::steady_clock::duration run_time{};
+};
+
+static std::map<std::string, ProgramCounters> program_counters;
+static std::mutex program_counters_mutex;
+
+static std::string programName(const std::vector<std::string>& argv) {
+    size_t index = (argv.size() > 1 && argv[0] == "sudo") ? 1 : 0;
+    const std::string& path = argv[index];
+    size_t slash = path.rfind('/');
+    return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+static int openPidfd(pid_t pid) {
+#ifdef SYS_pidfd_open
+    return static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+#else
+    (void)pid;
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+static pid_t spawnChild(const std::vector<std::string>& argv, const SubprocessOptions& options, int stdout_fd, int& spawn_error) {
+    std::vector<char*> args;
+    args.reserve(argv.size() + 1);
+    for (const auto& arg : argv) {
+        args.push_back(const_cast<char*>(arg.c_str()));
+    }
+    args.push_back(nullptr);
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+    posix_spawn_file_actions_adddup2(&actions, stdout_fd, STDOUT_FILENO);
+    if (options.merge_stderr) {
+        posix_spawn_file_actions_adddup2(&actions, stdout_fd, STDERR_FILENO);
+    } else {
+        posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+    }
+
+    // Own process group (so a deadline can kill sudo/docker and whatever they started),
+    // default SIGPIPE handling and an empty signal mask regardless of the server's
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    sigset_t default_signals;
+    sigemptyset(&default_signals);
+    sigaddset(&default_signals, SIGPIPE);
+    sigset_t empty_mask;
+    sigemptyset(&empty_mask);
+    posix_spawnattr_setpgroup(&attr, 0);
+    posix_spawnattr_setsigdefault(&attr, &default_signals);
+    posix_spawnattr_setsigmask(&attr, &empty_mask);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETSIGMASK);
+
+    pid_t pid = -1;
+    spawn_error = posix_spawnp(&pid, args[0], &actions, &attr, args.data(), environ);
+    posix_spawnattr_destroy(&attr);
+    posix_spawn_file_actions_destroy(&actions);
+    return spawn_error == 0 ? pid : -1;
+}
+
+void runSubprocess(const std::vector<std::string>& argv, const SubprocessOptions& options, SubprocessResult& result) {
+    result.started = false;
+    result.timed_out = false;
+    result.exit_code = -1;
+    result.output.clear();
+    if (argv.empty()) return;
+
+    std::string program = programName(argv);
+    auto spawn_start = std::chrono::steady_clock::now();
+
+    int pipe_fds[2];
+    if (pipe2(pipe_fds, O_CLOEXEC) != 0) {
+        LOG_ERROR(std::string("Failed to create pipe for ") + program + ": " + std::strerror(errno));
+        std::lock_guard<std::mutex> lock(program_counters_mutex);
+        program_counters[program].spawn_failures++;
+        return;
+    }
+
+    int spawn_error = 0;
+    pid_t pid = spawnChild(argv, options, pipe_fds[1], spawn_error);
+    close(pipe_fds[1]);
+    auto spawned_at = std::chrono::steady_clock::now();
+    if (pid < 0) {
+        close(pipe_fds[0]);
+        LOG_DEBUG(std::string("Failed to run ") + argv[0] + ": " + std::strerror(spawn_error));
+        std::lock_guard<std::mutex> lock(program_counters_mutex);
+        ProgramCounters& counters = program_counters[program];
+        counters.spawn_failures++;
+        counters.spawn_time += spawned_at - spawn_start;
+        return;
+    }
+    result.started = true;
+
+    int output_fd = pipe_fds[0];
+    int pidfd = openPidfd(pid);
+    bool has_deadline = options.timeout_seconds > 0;
+    auto deadline = spawned_at + std::chrono::seconds(options.timeout_seconds);
+    bool term_sent = false;
+    bool exited = false;
+    int wait_status = 0;
+    static thread_local std::vector<char> read_buffer(READ_CHUNK_BYTES);
+
+    while (!exited || output_fd >= 0) {
+        int timeout_ms = -1;
+        if (has_deadline) {
+            auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+            timeout_ms = static_cast<int>(std::max<long long>(0, remaining.count()));
+        }
+        // Once the child is gone, only drain what is already buffered; a grandchild
+        // holding the pipe open must not keep us waiting
+        if (exited) {
+            timeout_ms = 0;
+        } else if (pidfd < 0) {
+            timeout_ms = timeout_ms < 0 ? WAITPID_POLL_MS : std::min(timeout_ms, WAITPID_POLL_MS);
+        }
+
+        pollfd fds[2];
+        nfds_t nfds = 0;
+        if (output_fd >= 0) fds[nfds++] = pollfd{output_fd, POLLIN, 0};
+        if (!exited && pidfd >= 0) fds[nfds++] = pollfd{pidfd, POLLIN, 0};
+        int ready = poll(fds, nfds, timeout_ms);
+        if (ready < 0 && errno != EINTR) break;
+
+        if (ready > 0) {
+            for (nfds_t i = 0; i < nfds; ++i) {
+                if (fds[i].revents == 0) continue;
+                if (fds[i].fd == output_fd) {
+                    ssize_t n = read(output_fd, read_buffer.data(), read_buffer.size());
+                    if (n > 0) {
+                        size_t room = options.max_output_bytes - std::min(options.max_output_bytes, result.output.size());
+                        result.output.append(read_buffer.data(), std::min(static_cast<size_t>(n), room));
+                    } else if (n == 0 || errno != EINTR) {
+                        close(output_fd);
+                        output_fd = -1;
+                    }
+                } else if (waitpid(pid, &wait_status, 0) == pid) {
+                    exited = true;
+                }
+            }
+        } else if (exited && ready == 0) {
+            break;
+        }
+
+        if (!exited && pidfd < 0 && waitpid(pid, &wait_status, WNOHANG) == pid) {
+            exited = true;
+        }
+
+        if (!exited && has_deadline && std::chrono::steady_clock::now() >= deadline) {
+            if (!term_sent) {
+                kill(-pid, SIGTERM);
+                term_sent = true;
+                result.timed_out = true;
+                deadline = std::chrono::steady_clock::now() + KILL_GRACE_PERIOD;
+            } else {
+                kill(-pid, SIGKILL);
+                waitpid(pid, &wait_status, 0);
+                exited = true;
+            }
+        }
+    }
+
+    if (output_fd >= 0) close(output_fd);
+    if (pidfd >= 0) close(pidfd);
+    if (!exited) {
+        kill(-pid, SIGKILL);
+        waitpid(pid, &wait_status, 0);
+    }
+    if (WIFEXITED(wait_status)) {
+        result.exit_code = WEXITSTATUS(wait_status);
+    }
+    if (result.timed_out) {
+        LOG_WARN(absl::StrCat(program, " killed after ", options.timeout_seconds, "s timeout"));
+    }
+
+    auto finished_at = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(program_counters_mutex);
+    ProgramCounters& counters = program_counters[program];
+    counters.spawns++;
+    if (result.timed_out) counters.timeouts++;
+    counters.spawn_time += spawned_at - spawn_start;
+    counters.run_time += finished_at - spawn_start;
+}
+
+SubprocessResult runSubprocess(const std::vector<std::string>& argv, const SubprocessOptions& options) {
+    SubprocessResult result;
+    runSubprocess(argv, options, result);
+    return result;
+}
+
+std::string firstOutputLine(const SubprocessResult& result) {
+    const std::string& output = result.output;
+    size_t start = output.find_first_not_of(" \t\n\r");
+    if (start == std::string::npos) return "";
+    size_t end = output.find('\n', start);
+    std::string line = output.substr(start, end == std::string::npos ? std::string::npos : end - start);
+    line.erase(line.find_last_not_of(" \t\r") + 1);
+    return line;
+}
+
+std::vector<SubprocessStats> getSubprocessStats() {
+    std::vector<SubprocessStats> stats;
+    std::lock_guard<std::mutex> lock(program_counters_mutex);
+    for (const auto& [program, counters] : program_counters) {
+        SubprocessStats entry;
+        entry.program = program;
+        entry.spawns = counters.spawns;
+        entry.spawn_failures = counters.spawn_failures;
+        entry.timeouts = counters.timeouts;
+        entry.spawn_seconds = std::chrono::duration<double>(counters.spawn_time).count();
+        entry.run_seconds = std::chrono::duration<double>(counters.run_time).count();
+        stats.push_back(entry);
+    }
+    return stats;
+}
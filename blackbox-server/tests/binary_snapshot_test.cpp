@@ -0,0 +1,206 @@
+#include "utils/binary_serializer.h"
+#include "utils/binary_snapshot.h"
+#include "services/nvml_utils.h"
+#include "test_helpers.h"
+#include <string>
+
+static const unsigned long long GIB = 1024ull * 1024ull * 1024ull;
+
+// Two devices, a TP=2 model and a single-device one sharing a name with a block map,
+// and one entry in each optional section
+static DetailedVRAMInfo testSnapshot(unsigned int sections) {
+    DetailedVRAMInfo info{};
+    info.sections = sections;
+    info.total = 160 * GIB;
+    info.used = 90 * GIB;
+    info.free = 70 * GIB;
+    info.used_kv_cache_bytes = 12 * GIB;
+    info.prefix_cache_hit_rate = 42.5;
+    info.allocated_blocks = 15000;
+    info.utilized_blocks = 5500;
+    info.free_blocks = 9500;
+    info.gpus = {{0, "Sim A", "GPU-aaaa", 80 * GIB, 40 * GIB, 40 * GIB, 2},
+                 {1, "Sim B", "GPU-bbbb", 80 * GIB, 50 * GIB, 30 * GIB, 2}};
+    info.models = {{"tp/model", 8000, 60 * GIB, 9 * GIB, 10000, 0.3, 12.5, 3, 1, 7, 2 * 1024 * 1024, 0.375, {0, 1}, 160 * GIB},
+                   {"single/model", 8001, 20 * GIB, 3 * GIB, 5000, 0.5, 0.0, 1, 0, 0, 0, 0.25, {1}, 80 * GIB}};
+    info.processes = {{4000, "python3", 30 * GIB, 31 * GIB, 0}, {4100, "trainer", 2 * GIB, 2 * GIB, 1}};
+    info.block_maps = {{"tp/model", 8000, 2 * 1024 * 1024, 10000, 3000, {{0, 3000, true}, {3000, 7000, false}}},
+                       {"single/model", 8001, 1024 * 1024, 5000, 2500, {{0, 2500, true}, {2500, 2500, false}}}};
+    info.nsight_metrics[4000] = NsightMetrics{123, 256, 0.75, 64, 900, 1000, 2000, true, 1700000000};
+    info.threads = {{7, 4096, "running"}};
+    return info;
+}
+
+static void testRoundTrip() {
+    unsigned int sections = SNAPSHOT_PROCESSES | SNAPSHOT_BLOCKS | SNAPSHOT_NSIGHT | SNAPSHOT_THREADS;
+    DetailedVRAMInfo info = testSnapshot(sections);
+    std::string body;
+    writeBinarySnapshot(info, 42, body);
+
+    BinarySnapshotReader reader;
+    CHECK(reader.parse(body.data(), body.size()));
+    CHECK(reader.version() == 42);
+    CHECK(reader.sectionMask() == sections);
+
+    BinaryTotals totals = reader.totals();
+    CHECK(totals.total_vram_bytes == info.total);
+    CHECK(totals.allocated_vram_bytes == info.used);
+    CHECK(totals.free_vram_bytes == info.free);
+    CHECK(totals.used_kv_cache_bytes == info.used_kv_cache_bytes);
+    CHECK(totals.prefix_cache_hit_rate == 42.5);
+    CHECK(totals.allocated_blocks == 15000);
+    CHECK(totals.utilized_blocks == 5500);
+    CHECK(totals.free_blocks == 9500);
+
+    CHECK(reader.gpuCount() == 2);
+    for (size_t i = 0; i < reader.gpuCount() && i < info.gpus.size(); ++i) {
+        BinaryGpu gpu = reader.gpu(i);
+        CHECK(gpu.index == info.gpus[i].index);
+        CHECK(gpu.process_count == info.gpus[i].process_count);
+        CHECK(gpu.total_vram_bytes == info.gpus[i].total);
+        CHECK(gpu.allocated_vram_bytes == info.gpus[i].used);
+        CHECK(gpu.free_vram_bytes == info.gpus[i].free);
+        CHECK(gpu.name == info.gpus[i].name);
+        CHECK(gpu.uuid == info.gpus[i].uuid);
+    }
+
+    CHECK(reader.modelCount() == 2);
+    for (size_t i = 0; i < reader.modelCount() && i < info.models.size(); ++i) {
+        BinaryModel model = reader.model(i);
+        const ModelVRAMInfo& expected = info.models[i];
+        CHECK(model.model_id == expected.model_id);
+        CHECK(model.port == expected.port);
+        CHECK(model.allocated_vram_bytes == expected.allocated_vram_bytes);
+        CHECK(model.used_kv_cache_bytes == expected.used_kv_cache_bytes);
+        CHECK(model.num_preemptions_total == expected.num_preemptions_total);
+        CHECK(model.kv_block_bytes == expected.kv_block_bytes);
+        CHECK(model.kv_cache_usage_perc == expected.kv_cache_usage_perc);
+        CHECK(model.prefix_cache_hit_rate == expected.prefix_cache_hit_rate);
+        CHECK(model.gpu_memory_utilization == expected.gpu_memory_utilization);
+        CHECK(model.num_gpu_blocks == expected.num_gpu_blocks);
+        CHECK(model.num_requests_running == expected.num_requests_running);
+        CHECK(model.num_requests_waiting == expected.num_requests_waiting);
+    }
+    CHECK(reader.model(0).gpu_mask == 0x3);
+    CHECK(reader.model(1).gpu_mask == 0x2);
+
+    CHECK(reader.hasSection(BINARY_SECTION_PROCESSES));
+    CHECK(reader.processCount() == 2);
+    for (size_t i = 0; i < reader.processCount() && i < info.processes.size(); ++i) {
+        BinaryProcess proc = reader.process(i);
+        CHECK(proc.pid == info.processes[i].pid);
+        CHECK(proc.gpu_index == info.processes[i].gpu_index);
+        CHECK(proc.used_bytes == info.processes[i].used_bytes);
+        CHECK(proc.reserved_bytes == info.processes[i].reserved_bytes);
+        CHECK(proc.name == info.processes[i].name);
+    }
+
+    CHECK(reader.blockMapCount() == 2);
+    for (size_t i = 0; i < reader.blockMapCount() && i < info.block_maps.size(); ++i) {
+        BinaryBlockMap map = reader.blockMap(i);
+        const ModelBlockMap& expected = info.block_maps[i];
+        CHECK(map.model_id == expected.model_id);
+        CHECK(map.port == expected.port);
+        CHECK(map.block_size == expected.block_size);
+        CHECK(map.num_blocks == expected.num_blocks);
+        CHECK(map.utilized_blocks == expected.utilized_blocks);
+        CHECK(map.first_run == 2 * i);
+        CHECK(map.run_count == expected.runs.size());
+        for (size_t r = 0; r < map.run_count && r < expected.runs.size(); ++r) {
+            BinaryBlockRun run = reader.blockRun(map.first_run + r);
+            CHECK(run.first_block == expected.runs[r].first_block);
+            CHECK(run.count == expected.runs[r].count);
+            CHECK(run.utilized == expected.runs[r].utilized);
+        }
+    }
+    // Model ids are stored once and shared by the model and block map records
+    CHECK(reader.model(0).model_id.data() == reader.blockMap(0).model_id.data());
+
+    CHECK(reader.nsightCount() == 1);
+    BinaryNsight nsight = reader.nsight(0);
+    CHECK(nsight.pid == 4000);
+    CHECK(nsight.available);
+    CHECK(nsight.atomic_operations == 123);
+    CHECK(nsight.threads_per_block == 256);
+    CHECK(nsight.occupancy == 0.75);
+    CHECK(nsight.active_blocks == 64);
+    CHECK(nsight.memory_throughput == 900);
+    CHECK(nsight.dram_read_bytes == 1000);
+    CHECK(nsight.dram_write_bytes == 2000);
+    CHECK(nsight.collected_at == 1700000000);
+
+    CHECK(reader.threadCount() == 1);
+    BinaryThread thread = reader.thread(0);
+    CHECK(thread.thread_id == 7);
+    CHECK(thread.allocated_bytes == 4096);
+    CHECK(thread.state == "running");
+
+    // A reference outside the string table decodes as empty
+    CHECK(reader.string(0xfffffff0u).empty());
+}
+
+// Optional sections are absent unless the snapshot computed them
+static void testCoreOnly() {
+    std::string body;
+    writeBinarySnapshot(testSnapshot(SNAPSHOT_CORE), 7, body);
+    BinarySnapshotReader reader;
+    CHECK(reader.parse(body.data(), body.size()));
+    CHECK(reader.version() == 7);
+    CHECK(reader.sectionMask() == SNAPSHOT_CORE);
+    CHECK(!reader.hasSection(BINARY_SECTION_PROCESSES));
+    CHECK(!reader.hasSection(BINARY_SECTION_BLOCK_MAPS));
+    CHECK(!reader.hasSection(BINARY_SECTION_NSIGHT));
+    CHECK(!reader.hasSection(BINARY_SECTION_THREADS));
+    CHECK(reader.processCount() == 0);
+    CHECK(reader.totals().allocated_blocks == 0);
+    CHECK(reader.modelCount() == 2);
+    CHECK(reader.model(1).model_id == "single/model");
+}
+
+static void storeLE32(std::string& body, size_t offset, uint32_t value) {
+    for (int i = 0; i < 4; ++i) body[offset + i] = static_cast<char>(value >> (8 * i));
+}
+
+static void testRejectsMalformed() {
+    std::string body;
+    writeBinarySnapshot(testSnapshot(SNAPSHOT_PROCESSES | SNAPSHOT_BLOCKS), 1, body);
+    BinarySnapshotReader reader;
+
+    // Every truncation cuts into the header, the directory or a section
+    bool any_truncation_parsed = false;
+    for (size_t size = 0; size < body.size(); ++size) {
+        any_truncation_parsed |= reader.parse(body.data(), size);
+    }
+    CHECK(!any_truncation_parsed);
+
+    std::string bad_magic = body;
+    bad_magic[0] = 'X';
+    CHECK(!reader.parse(bad_magic.data(), bad_magic.size()));
+
+    std::string wrong_version = body;
+    wrong_version[4] = static_cast<char>(BINARY_SNAPSHOT_VERSION + 1);
+    CHECK(!reader.parse(wrong_version.data(), wrong_version.size()));
+
+    // The first directory entry is the totals section: offset past the end, then a range that overflows it
+    size_t entry = BINARY_SNAPSHOT_HEADER_BYTES;
+    std::string past_end = body;
+    storeLE32(past_end, entry + 8, static_cast<uint32_t>(body.size() + 1));
+    CHECK(!reader.parse(past_end.data(), past_end.size()));
+
+    std::string overlong = body;
+    storeLE32(overlong, entry + 8, static_cast<uint32_t>(body.size() - 1));
+    CHECK(!reader.parse(overlong.data(), overlong.size()));
+
+    std::string huge_count = body;
+    storeLE32(huge_count, entry + 4, 0xffffffffu);
+    CHECK(!reader.parse(huge_count.data(), huge_count.size()));
+
+    CHECK(reader.parse(body.data(), body.size()));
+}
+
+int main() {
+    testRoundTrip();
+    testCoreOnly();
+    testRejectsMalformed();
+    return testResult();
+}
@@ -0,0 +1,95 @@
+#include "utils/http_io.h"
+#include "test_helpers.h"
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/read.hpp>
+#include <chrono>
+#include <cstdlib>
+#include <thread>
+
+namespace net = boost::asio;
+namespace http = boost::beast::http;
+using tcp = net::ip::tcp;
+
+// Far more than the loopback socket buffers hold, so the write can only finish if the client reads
+static const size_t LARGE_BODY_BYTES = 64 * 1024 * 1024;
+
+// A server-side socket on its own io_context (like a client connection) and a peer connected to it
+struct ConnectedPair {
+    net::io_context server_ioc{1};
+    net::io_context client_ioc{1};
+    tcp::socket server{server_ioc};
+    tcp::socket client{client_ioc};
+
+    ConnectedPair() {
+        tcp::acceptor acceptor(server_ioc, tcp::endpoint(net::ip::address_v4::loopback(), 0));
+        client.connect(acceptor.local_endpoint());
+        acceptor.accept(server);
+    }
+};
+
+static http::response<http::string_body> largeResponse() {
+    http::response<http::string_body> res;
+    res.result(http::status::ok);
+    res.body().assign(LARGE_BODY_BYTES, 'x');
+    res.prepare_payload();
+    return res;
+}
+
+// A client that never reads must not hold the writer past HTTP_WRITE_TIMEOUT
+static void testStalledClientTimesOut() {
+    ConnectedPair pair;
+    auto res = largeResponse();
+    auto started = std::chrono::steady_clock::now();
+    bool timed_out = false;
+    try {
+        writeHttpMessage(pair.server, res);
+    } catch (const boost::system::system_error& e) {
+        timed_out = e.code() == net::error::timed_out;
+    }
+    auto elapsed = std::chrono::steady_clock::now() - started;
+    CHECK(timed_out);
+    CHECK(elapsed >= std::chrono::milliseconds(900));
+    CHECK(elapsed < std::chrono::seconds(5));
+    // Closed, so the connection is not served any further
+    CHECK(!pair.server.is_open());
+}
+
+static void testReadingClientGetsWholeResponse() {
+    ConnectedPair pair;
+    auto res = largeResponse();
+    size_t received = 0;
+    std::thread reader([&]() {
+        boost::beast::error_code ec;
+        char chunk[64 * 1024];
+        while (!ec) {
+            received += pair.client.read_some(net::buffer(chunk), ec);
+        }
+    });
+    bool threw = false;
+    try {
+        writeHttpMessage(pair.server, res);
+    } catch (const boost::system::system_error&) {
+        threw = true;
+    }
+    pair.server.close();
+    reader.join();
+    CHECK(!threw);
+    CHECK(received > LARGE_BODY_BYTES);
+}
+
+static void testWriteWithDeadline() {
+    ConnectedPair pair;
+    std::string data(LARGE_BODY_BYTES, 'y');
+    CHECK(!writeWithDeadline(pair.server, data, std::chrono::milliseconds(200)));
+
+    ConnectedPair small;
+    CHECK(writeWithDeadline(small.server, "ping", std::chrono::milliseconds(200)));
+}
+
+int main() {
+    setenv("HTTP_WRITE_TIMEOUT", "1", 1);
+    testStalledClientTimesOut();
+    testReadingClientGetsWholeResponse();
+    testWriteWithDeadline();
+    return testResult();
+}
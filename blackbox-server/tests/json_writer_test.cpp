@@ -0,0 +1,127 @@
+#include "utils/json_writer.h"
+#include "test_helpers.h"
+#include <cmath>
+#include <limits>
+#include <string>
+#include <vector>
+
+struct TestModel {
+    std::string model_id;
+    int port;
+    double usage;
+};
+
+struct TestSnapshot {
+    unsigned long long total;
+    std::string name;
+    std::vector<TestModel> models;
+};
+
+static const auto MODEL_FIELDS = std::make_tuple(
+    jsonField("model_id", &TestModel::model_id),
+    jsonField("port", &TestModel::port),
+    jsonField("usage", &TestModel::usage, 2));
+
+static const auto SNAPSHOT_FIELDS = std::make_tuple(
+    jsonField("total", &TestSnapshot::total),
+    jsonField("name", &TestSnapshot::name),
+    jsonNested("models", &TestSnapshot::models, MODEL_FIELDS));
+
+static TestSnapshot testSnapshot() {
+    return TestSnapshot{100, "node", {{"a/model", 8000, 0.25}, {"b/model", 8001, 0.5}}};
+}
+
+static std::string writeString(std::string_view s) {
+    std::string out;
+    JsonWriter writer(out);
+    writer.value(s);
+    return out;
+}
+
+static void testEscaping() {
+    CHECK(writeString("plain") == "\"plain\"");
+    CHECK(writeString("say \"hi\"") == "\"say \\\"hi\\\"\"");
+    CHECK(writeString("C:\\path") == "\"C:\\\\path\"");
+    CHECK(writeString("a\nb\rc\td") == "\"a\\nb\\rc\\td\"");
+    CHECK(writeString(std::string_view("\x01\x1f\0", 3)) == "\"\\u0001\\u001f\\u0000\"");
+    // UTF-8 and DEL pass through unchanged
+    CHECK(writeString("caf\xc3\xa9\x7f") == "\"caf\xc3\xa9\x7f\"");
+
+    // Keys are escaped the same way
+    std::string out;
+    JsonWriter writer(out);
+    writer.beginObject();
+    writer.key("a\"b");
+    writer.value(1);
+    writer.endObject();
+    CHECK(out == "{\"a\\\"b\":1}");
+}
+
+static void testNumbers() {
+    std::string out;
+    JsonWriter writer(out);
+    writer.beginArray();
+    writer.value(std::numeric_limits<double>::quiet_NaN());
+    writer.value(std::numeric_limits<double>::infinity());
+    writer.value(-std::numeric_limits<double>::infinity());
+    writer.value(0.1);
+    writer.value(2.0 / 3.0, 3);
+    writer.value(-42);
+    writer.value(18446744073709551615ULL);
+    writer.value(true);
+    writer.endArray();
+    CHECK(out == "[null,null,null,0.1,0.667,-42,18446744073709551615,true]");
+}
+
+static std::string writeProjected(const std::string& fields, const std::string& model_id = "") {
+    JsonSelection selection;
+    std::string error;
+    CHECK(compileJsonProjection(SNAPSHOT_FIELDS, fields, selection.projection, error));
+    selection.model_id = model_id;
+    std::string out;
+    JsonWriter writer(out);
+    writeJsonObject(writer, testSnapshot(), SNAPSHOT_FIELDS, selection.scope());
+    return out;
+}
+
+static void testProjection() {
+    const std::string everything =
+        "{\"total\":100,\"name\":\"node\",\"models\":[{\"model_id\":\"a/model\",\"port\":8000,\"usage\":0.25},"
+        "{\"model_id\":\"b/model\",\"port\":8001,\"usage\":0.50}]}";
+    CHECK(writeProjected("") == everything);
+    CHECK(writeProjected("total") == "{\"total\":100}");
+    // Fields come out in declaration order, whatever order they were asked for
+    CHECK(writeProjected("models.port,total") == "{\"total\":100,\"models\":[{\"port\":8000},{\"port\":8001}]}");
+    CHECK(writeProjected("models.port,models.model_id") ==
+          "{\"models\":[{\"model_id\":\"a/model\",\"port\":8000},{\"model_id\":\"b/model\",\"port\":8001}]}");
+    // A whole subtree wins over a path inside it, in either order
+    const std::string models =
+        "{\"models\":[{\"model_id\":\"a/model\",\"port\":8000,\"usage\":0.25},"
+        "{\"model_id\":\"b/model\",\"port\":8001,\"usage\":0.50}]}";
+    CHECK(writeProjected("models,models.port") == models);
+    CHECK(writeProjected("models.port,models") == models);
+    // Empty entries are ignored
+    CHECK(writeProjected(",total,") == "{\"total\":100}");
+    // ?model= filters array elements by model_id
+    CHECK(writeProjected("models.usage", "b/model") == "{\"models\":[{\"usage\":0.50}]}");
+}
+
+static void testUnknownFields() {
+    JsonProjection projection;
+    std::string error;
+    CHECK(!compileJsonProjection(SNAPSHOT_FIELDS, "total,bogus", projection, error));
+    CHECK(error == "bogus");
+    CHECK(!compileJsonProjection(SNAPSHOT_FIELDS, "models.bogus", projection, error));
+    CHECK(error == "models.bogus");
+    // Scalars have nothing below them
+    CHECK(!compileJsonProjection(SNAPSHOT_FIELDS, "total.x", projection, error));
+    CHECK(error == "total.x");
+}
+
+int main() {
+    testEscaping();
+    testNumbers();
+    testProjection();
+    testUnknownFields();
+    return testResult();
+}
@@ -0,0 +1,146 @@
+#include "services/nsight_utils.h"
+#include "test_helpers.h"
+#include <cmath>
+#include <string>
+
+static bool near(double a, double b) {
+    return std::fabs(a - b) < 1e-9;
+}
+
+static const char* FLASH_KERNEL =
+    "void flash_fwd_kernel<Flash_fwd_kernel_traits<128, 64, 64, 4, false, false, cutlass::half_t>>(Flash_fwd_params)";
+
+// ncu --print-gpu-trace --csv with the details layout: one row per launch and metric
+static const std::string DETAILS_CSV =
+    "==PROF== Connected to process 4000 (/usr/bin/python3)\n"
+    "==PROF== Profiling \"flash_fwd_kernel\": 0%....50%....100% - 9 passes\n"
+    "\"ID\",\"Process ID\",\"Process Name\",\"Host Name\",\"Kernel Name\",\"Context\",\"Stream\",\"Block Size\","
+    "\"Grid Size\",\"Device\",\"CC\",\"Section Name\",\"Metric Name\",\"Metric Unit\",\"Metric Value\"\n"
+    "\"0\",\"4000\",\"python3\",\"host\",\"" + std::string(FLASH_KERNEL) + "\",\"1\",\"7\",\"(128, 1, 1)\",\"(16, 32, 4)\",\"0\",\"8.0\",\"Command line profiler metrics\",\"dram__bytes_read.sum\",\"byte\",\"1,048,576\"\n"
+    "\"0\",\"4000\",\"python3\",\"host\",\"" + std::string(FLASH_KERNEL) + "\",\"1\",\"7\",\"(128, 1, 1)\",\"(16, 32, 4)\",\"0\",\"8.0\",\"Command line profiler metrics\",\"dram__bytes_write.sum\",\"byte\",\"524,288\"\n"
+    "\"0\",\"4000\",\"python3\",\"host\",\"" + std::string(FLASH_KERNEL) + "\",\"1\",\"7\",\"(128, 1, 1)\",\"(16, 32, 4)\",\"0\",\"8.0\",\"Command line profiler metrics\",\"gpu__time_duration.sum\",\"nsecond\",\"1,000\"\n"
+    "\"0\",\"4000\",\"python3\",\"host\",\"" + std::string(FLASH_KERNEL) + "\",\"1\",\"7\",\"(128, 1, 1)\",\"(16, 32, 4)\",\"0\",\"8.0\",\"Command line profiler metrics\",\"sm__warps_active.avg.pct_of_peak_sustained_active\",\"%\",\"50\"\n"
+    "\"0\",\"4000\",\"python3\",\"host\",\"" + std::string(FLASH_KERNEL) + "\",\"1\",\"7\",\"(128, 1, 1)\",\"(16, 32, 4)\",\"0\",\"8.0\",\"Command line profiler metrics\",\"dram__throughput.avg.pct_of_peak_sustained_elapsed\",\"%\",\"80\"\n"
+    "\"0\",\"4000\",\"python3\",\"host\",\"" + std::string(FLASH_KERNEL) + "\",\"1\",\"7\",\"(128, 1, 1)\",\"(16, 32, 4)\",\"0\",\"8.0\",\"Command line profiler metrics\",\"sm__throughput.avg.pct_of_peak_sustained_elapsed\",\"%\",\"30\"\n"
+    "\"0\",\"4000\",\"python3\",\"host\",\"" + std::string(FLASH_KERNEL) + "\",\"1\",\"7\",\"(128, 1, 1)\",\"(16, 32, 4)\",\"0\",\"8.0\",\"Command line profiler metrics\",\"sm__sass_thread_inst_executed_op_atom_pred_on.sum\",\"inst\",\"12\"\n"
+    "\"0\",\"4000\",\"python3\",\"host\",\"" + std::string(FLASH_KERNEL) + "\",\"1\",\"7\",\"(128, 1, 1)\",\"(16, 32, 4)\",\"0\",\"8.0\",\"Command line profiler metrics\",\"l1tex__t_bytes.sum\",\"byte\",\"999\"\n"
+    "\"1\",\"4000\",\"python3\",\"host\",\"my \"\"quoted\"\" kernel\",\"1\",\"7\",\"256\",\"(1024, 1, 1)\",\"0\",\"8.0\",\"Command line profiler metrics\",\"gpu__time_duration.sum\",\"nsecond\",\"500\"\n"
+    "\"1\",\"4000\",\"python3\",\"host\",\"my \"\"quoted\"\" kernel\",\"1\",\"7\",\"256\",\"(1024, 1, 1)\",\"0\",\"8.0\",\"Command line profiler metrics\",\"sm__warps_active.avg.pct_of_peak_sustained_active\",\"%\",\"25.5\"\n"
+    "\"1\",\"4000\",\"python3\",\"host\",\"my \"\"quoted\"\" kernel\",\"1\",\"7\",\"256\",\"(1024, 1, 1)\",\"0\",\"8.0\",\"Command line profiler metrics\",\"dram__throughput.avg.pct_of_peak_sustained_elapsed\",\"%\",\"10\"\n"
+    "\"1\",\"4000\",\"python3\",\"host\",\"my \"\"quoted\"\" kernel\",\"1\",\"7\",\"256\",\"(1024, 1, 1)\",\"0\",\"8.0\",\"Command line profiler metrics\",\"sm__throughput.avg.pct_of_peak_sustained_elapsed\",\"%\",\"90\"\n"
+    "\"2\",\"4000\",\"python3\",\"host\",\"" + std::string(FLASH_KERNEL) + "\",\"1\",\"7\",\"(128, 1, 1)\",\"(16, 32, 4)\",\"0\",\"8.0\",\"Command line profiler metrics\",\"dram__bytes_read.sum\",\"byte\",\"2,097,152\"\n"
+    "\"2\",\"4000\",\"python3\",\"host\",\"" + std::string(FLASH_KERNEL) + "\",\"1\",\"7\",\"(128, 1, 1)\",\"(16, 32, 4)\",\"0\",\"8.0\",\"Command line profiler metrics\",\"gpu__time_duration.sum\",\"nsecond\",\"3,000\"\n"
+    "\"2\",\"4000\",\"python3\",\"host\",\"" + std::string(FLASH_KERNEL) + "\",\"1\",\"7\",\"(128, 1, 1)\",\"(16, 32, 4)\",\"0\",\"8.0\",\"Command line profiler metrics\",\"sm__warps_active.avg.pct_of_peak_sustained_active\",\"%\",\"70\"\n"
+    "\"2\",\"4000\",\"python3\",\"host\",\"" + std::string(FLASH_KERNEL) + "\",\"1\",\"7\",\"(128, 1, 1)\",\"(16, 32, 4)\",\"0\",\"8.0\",\"Command line profiler metrics\",\"dram__throughput.avg.pct_of_peak_sustained_elapsed\",\"%\",\"40\"\n"
+    "\"2\",\"4000\",\"python3\",\"host\",\"" + std::string(FLASH_KERNEL) + "\",\"1\",\"7\",\"(128, 1, 1)\",\"(16, 32, 4)\",\"0\",\"8.0\",\"Command line profiler metrics\",\"sm__throughput.avg.pct_of_peak_sustained_elapsed\",\"%\",\"30\"\n"
+    "==PROF== Disconnected from process 4000\n";
+
+// The raw layout: one column per metric, with a units row under the header (CRLF line ends)
+static const std::string RAW_CSV =
+    "==PROF== Connected to process 4001 (/usr/bin/python3)\r\n"
+    "\"ID\",\"Process ID\",\"Process Name\",\"Host Name\",\"Kernel Name\",\"Context\",\"Stream\",\"Block Size\","
+    "\"Grid Size\",\"Device\",\"CC\",\"dram__bytes_read.sum\",\"dram__bytes_write.sum\",\"dram__throughput.avg.pct_of_peak_sustained_elapsed\","
+    "\"gpu__time_duration.sum\",\"sm__sass_thread_inst_executed_op_atom_pred_on.sum\","
+    "\"sm__throughput.avg.pct_of_peak_sustained_elapsed\",\"sm__warps_active.avg.pct_of_peak_sustained_active\"\r\n"
+    "\"\",\"\",\"\",\"\",\"\",\"\",\"\",\"\",\"\",\"\",\"\",\"byte\",\"byte\",\"%\",\"nsecond\",\"inst\",\"%\",\"%\"\r\n"
+    "\"0\",\"4001\",\"python3\",\"host\",\"ampere_sgemm_128x64_nn\",\"1\",\"7\",\"(256, 1, 1)\",\"(40, 2, 1)\",\"0\",\"8.0\","
+    "\"3,145,728\",\"1,048,576\",\"60.25\",\"2,500\",\"0\",\"20\",\"45.5\"\r\n"
+    "\"1\",\"4001\",\"python3\",\"host\",\"ampere_sgemm_128x64_nn\",\"1\",\"7\",\"(256, 1, 1)\",\"(40, 2, 1)\",\"0\",\"8.0\","
+    "\"1,048,576\",\"0\",\"20\",\"1,500\",\"4\",\"80\",\"35.5\"\r\n";
+
+static void testDetailsLayout() {
+    std::vector<KernelProfile> kernels = parseNcuCsv(DETAILS_CSV);
+    CHECK(kernels.size() == 3);
+    if (kernels.size() != 3) return;
+
+    // Commas inside the quoted name stay in the name
+    CHECK(kernels[0].kernel_name == FLASH_KERNEL);
+    CHECK(kernels[0].block_size == 128);
+    CHECK(kernels[0].grid_size == 16 * 32 * 4);
+    CHECK(kernels[0].dram_read_bytes == 1048576);
+    CHECK(kernels[0].dram_write_bytes == 524288);
+    CHECK(kernels[0].duration_ns == 1000);
+    CHECK(near(kernels[0].occupancy, 50.0));
+    CHECK(near(kernels[0].dram_throughput_pct, 80.0));
+    CHECK(near(kernels[0].sm_throughput_pct, 30.0));
+    CHECK(kernels[0].atomic_operations == 12);
+
+    CHECK(kernels[1].kernel_name == "my \"quoted\" kernel");
+    CHECK(kernels[1].block_size == 256);
+    CHECK(kernels[1].grid_size == 1024);
+    CHECK(kernels[1].duration_ns == 500);
+    CHECK(near(kernels[1].occupancy, 25.5));
+    CHECK(kernels[1].dram_read_bytes == 0);
+
+    CHECK(kernels[2].kernel_name == FLASH_KERNEL);
+    CHECK(kernels[2].dram_read_bytes == 2097152);
+    CHECK(kernels[2].duration_ns == 3000);
+
+    std::vector<KernelSummary> summaries = summarizeKernels(kernels);
+    CHECK(summaries.size() == 2);
+    if (summaries.size() != 2) return;
+    // Longest total duration first
+    const KernelSummary& flash = summaries[0];
+    CHECK(flash.kernel_name == FLASH_KERNEL);
+    CHECK(flash.launches == 2);
+    CHECK(flash.total_duration_ns == 4000);
+    CHECK(flash.dram_read_bytes == 1048576 + 2097152);
+    CHECK(flash.dram_write_bytes == 524288);
+    CHECK(flash.atomic_operations == 12);
+    CHECK(near(flash.avg_occupancy, (50.0 * 1000 + 70.0 * 3000) / 4000));
+    CHECK(near(flash.avg_dram_throughput_pct, (80.0 * 1000 + 40.0 * 3000) / 4000));
+    CHECK(near(flash.avg_sm_throughput_pct, 30.0));
+    CHECK(flash.memory_bound);
+
+    const KernelSummary& quoted = summaries[1];
+    CHECK(quoted.launches == 1);
+    CHECK(quoted.total_duration_ns == 500);
+    CHECK(!quoted.memory_bound);
+}
+
+static void testRawLayout() {
+    std::vector<KernelProfile> kernels = parseNcuCsv(RAW_CSV);
+    // The units row is not a launch
+    CHECK(kernels.size() == 2);
+    if (kernels.size() != 2) return;
+
+    CHECK(kernels[0].kernel_name == "ampere_sgemm_128x64_nn");
+    CHECK(kernels[0].block_size == 256);
+    CHECK(kernels[0].grid_size == 80);
+    CHECK(kernels[0].dram_read_bytes == 3145728);
+    CHECK(kernels[0].dram_write_bytes == 1048576);
+    CHECK(near(kernels[0].dram_throughput_pct, 60.25));
+    CHECK(kernels[0].duration_ns == 2500);
+    CHECK(kernels[0].atomic_operations == 0);
+    CHECK(near(kernels[0].sm_throughput_pct, 20.0));
+    CHECK(near(kernels[0].occupancy, 45.5));
+
+    CHECK(kernels[1].duration_ns == 1500);
+    CHECK(kernels[1].atomic_operations == 4);
+
+    std::vector<KernelSummary> summaries = summarizeKernels(kernels);
+    CHECK(summaries.size() == 1);
+    if (summaries.empty()) return;
+    CHECK(summaries[0].launches == 2);
+    CHECK(summaries[0].total_duration_ns == 4000);
+    CHECK(summaries[0].dram_read_bytes == 4194304);
+    CHECK(summaries[0].atomic_operations == 4);
+    CHECK(near(summaries[0].avg_occupancy, (45.5 * 2500 + 35.5 * 1500) / 4000));
+    CHECK(near(summaries[0].avg_dram_throughput_pct, (60.25 * 2500 + 20.0 * 1500) / 4000));
+    CHECK(near(summaries[0].avg_sm_throughput_pct, (20.0 * 2500 + 80.0 * 1500) / 4000));
+    CHECK(summaries[0].memory_bound);
+}
+
+// Only ==PROF== lines: ncu found nothing to profile
+static void testNoKernels() {
+    CHECK(parseNcuCsv("==PROF== Connected to process 4000\n==PROF== Disconnected from process 4000\n").empty());
+    CHECK(parseNcuCsv("").empty());
+    CHECK(summarizeKernels({}).empty());
+}
+
+int main() {
+    testDetailsLayout();
+    testRawLayout();
+    testNoKernels();
+    return testResult();
+}
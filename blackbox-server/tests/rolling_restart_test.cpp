@@ -0,0 +1,85 @@
+#include "services/rolling_restart.h"
+#include "test_helpers.h"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+static void testClaimIsExclusive() {
+    CHECK(claimRestart("model-a"));
+    CHECK(isRestartInProgress("model-a"));
+    CHECK(!claimRestart("model-a"));
+    CHECK(claimRestart("model-b"));
+    releaseRestart("model-a");
+    CHECK(!isRestartInProgress("model-a"));
+    CHECK(claimRestart("model-a"));
+    releaseRestart("model-a");
+    releaseRestart("model-b");
+}
+
+// Many "plans" racing for one container: never more than one holds it
+static void testConcurrentClaims() {
+    std::atomic<int> holders{0};
+    std::atomic<int> max_holders{0};
+    std::atomic<int> acquired{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; ++t) {
+        threads.emplace_back([&]() {
+            for (int i = 0; i < 200; ++i) {
+                if (!claimRestart("shared-model")) continue;
+                int now = ++holders;
+                int seen = max_holders.load();
+                while (now > seen && !max_holders.compare_exchange_weak(seen, now)) {}
+                acquired++;
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+                holders--;
+                releaseRestart("shared-model");
+            }
+        });
+    }
+    for (auto& thread : threads) thread.join();
+    CHECK(max_holders.load() == 1);
+    CHECK(acquired.load() > 0);
+    CHECK(!isRestartInProgress("shared-model"));
+}
+
+// A second plan for a container another plan is restarting is rejected without touching it
+static void testPlanSkipsContainerInFlight() {
+    OptimizationTarget target{"vllm-busy", "org/model", 8000, "A100", 0.9, 0.6};
+    CHECK(claimRestart(target.container_name));
+
+    auto started = std::chrono::steady_clock::now();
+    std::vector<RestartOutcome> outcomes = executeOptimizationPlan({target}, RestartStrategy::ROLLING);
+    auto elapsed = std::chrono::steady_clock::now() - started;
+
+    CHECK(outcomes.size() == 1);
+    CHECK(!outcomes[0].success);
+    CHECK(outcomes[0].message == "Restart already in progress");
+    CHECK(elapsed < std::chrono::seconds(5));
+    // The rejected plan must not release the claim it never held
+    CHECK(isRestartInProgress(target.container_name));
+    releaseRestart(target.container_name);
+}
+
+// Growing to the whole device never fits the budget, even with nothing else restarting
+static void testPlanOverBudgetIsSkipped() {
+    OptimizationTarget target{"vllm-grow", "org/model", 8000, "A100", 0.0, 1.0};
+    std::vector<RestartOutcome> outcomes = executeOptimizationPlan({target}, RestartStrategy::IN_PLACE);
+
+    CHECK(outcomes.size() == 1);
+    CHECK(!outcomes[0].success);
+    CHECK(outcomes[0].skipped);
+    CHECK(outcomes[0].message == "Exceeds VRAM budget");
+    CHECK(!isRestartInProgress(target.container_name));
+}
+
+int main() {
+    // The budget needs a known device total
+    setenv("GPU_BACKEND", "simulated", 1);
+    testClaimIsExclusive();
+    testConcurrentClaims();
+    testPlanSkipsContainerInFlight();
+    testPlanOverBudgetIsSkipped();
+    return testResult();
+}
@@ -0,0 +1,113 @@
+#include "services/simulated_gpu_backend.h"
+#include "services/nvml_utils.h"
+#include "services/model_manager.h"
+#include "services/sizing_engine.h"
+#include "test_helpers.h"
+#include <algorithm>
+#include <cmath>
+
+static const unsigned long long MIB = 1024ull * 1024ull;
+static const unsigned long long GIB = 1024ull * MIB;
+
+// Two 80 GiB devices: a TP=2 model on both, a single-device model on GPU 1 and a host job on GPU 0
+static SimulatedGpuConfig testConfig() {
+    SimulatedGpuConfig config{};
+    config.seed = 1;
+    config.time_step_seconds = 30.0;
+    config.devices = {
+        {"Sim A", 80 * GIB, {{4000, "python3", "constant", 30 * GIB, 0, 300.0, "tp/model"},
+                             {4100, "trainer", "constant", 2 * GIB, 0, 300.0, ""}}},
+        {"Sim B", 80 * GIB, {{4001, "python3", "constant", 30 * GIB, 0, 300.0, "tp/model"},
+                             {4002, "python3", "constant", 20 * GIB, 0, 300.0, "single/model"}}},
+    };
+    config.models = {
+        {"tp/model", 8000, 10000, 2 * MIB, "constant", 0.3, 0.0, 300.0, 0.375},
+        {"single/model", 8001, 5000, 2 * MIB, "constant", 0.5, 0.0, 300.0, 0.25},
+    };
+    return config;
+}
+
+static const ModelVRAMInfo* findModel(const DetailedVRAMInfo& info, const std::string& model_id) {
+    auto found = std::find_if(info.models.begin(), info.models.end(), [&](const ModelVRAMInfo& model) {
+        return model.model_id == model_id;
+    });
+    return found == info.models.end() ? nullptr : &*found;
+}
+
+static void testAttribution() {
+    DetailedVRAMInfo info = getDetailedVRAMUsage();
+    CHECK(info.processes.size() == 4);
+    CHECK(info.models.size() == 2);
+
+    const ModelVRAMInfo* tp = findModel(info, "tp/model");
+    CHECK(tp != nullptr);
+    if (tp) {
+        CHECK((tp->gpu_indices == std::vector<unsigned int>{0, 1}));
+        CHECK(tp->gpu_total_bytes == 160 * GIB);
+        CHECK(tp->allocated_vram_bytes == 60 * GIB);
+        CHECK(tp->kv_block_bytes == 2 * MIB);
+        CHECK(tp->gpu_memory_utilization == 0.375);
+    }
+    const ModelVRAMInfo* single = findModel(info, "single/model");
+    CHECK(single != nullptr);
+    if (single) {
+        CHECK((single->gpu_indices == std::vector<unsigned int>{1}));
+        CHECK(single->gpu_total_bytes == 80 * GIB);
+        CHECK(single->allocated_vram_bytes == 20 * GIB);
+    }
+    auto trainer = std::find_if(info.processes.begin(), info.processes.end(), [](const ProcessMemory& pm) {
+        return pm.pid == 4100;
+    });
+    CHECK(trainer != info.processes.end() && trainer->name == "trainer");
+}
+
+static void testKVBlocks() {
+    DetailedVRAMInfo info = getDetailedVRAMUsage(SNAPSHOT_BLOCKS);
+    CHECK(info.block_maps.size() == 2);
+    for (const auto& map : info.block_maps) {
+        if (map.model_id == "tp/model") {
+            CHECK(map.num_blocks == 10000);
+            CHECK(map.utilized_blocks == 3000);
+        } else {
+            CHECK(map.num_blocks == 5000);
+            CHECK(map.utilized_blocks == 2500);
+        }
+    }
+    CHECK(info.allocated_blocks == 15000);
+    CHECK(info.utilized_blocks == 5500);
+}
+
+// Samples recorded from simulated snapshots size the TP model like any other
+static void testSizing() {
+    ModelMetrics metrics{};
+    metrics.model_id = "tp/model";
+    for (int i = 0; i < 12; ++i) {
+        DetailedVRAMInfo info = getDetailedVRAMUsage();
+        const ModelVRAMInfo* tp = findModel(info, "tp/model");
+        CHECK(tp != nullptr);
+        if (!tp) return;
+        metrics.configured_max_utilization = tp->gpu_memory_utilization;
+        metrics.usage_samples.push_back(makeUsageSample(*tp, info.total, 30.0 * i));
+    }
+    CHECK(metrics.usage_samples.back().gpu_count == 2);
+
+    SizingConfig config = loadSizingConfig();
+    config.lookahead_minutes = 0;
+    SizingRecommendation rec = sizeModelAllocation("vllm-tp-model", metrics, config);
+    CHECK(rec.basis == "kv_percentile");
+    CHECK(rec.action == "shrink");
+    CHECK(rec.target_gpu_blocks >= 3449 && rec.target_gpu_blocks <= 3450);
+    // Weights: 0.375 * 160 GiB minus 10000 blocks on each worker; KV: 3450 blocks on each worker
+    double fixed_bytes = 0.375 * 160 * GIB - 2.0 * 10000 * 2 * MIB;
+    double expected = (fixed_bytes + 2.0 * 3450 * 2 * MIB) / (160.0 * GIB);
+    CHECK(std::fabs(rec.target_utilization - expected) < 1e-6);
+}
+
+int main() {
+    setGpuTelemetryBackend(createSimulatedBackend(testConfig()));
+    CHECK(initNVML());
+    testAttribution();
+    testKVBlocks();
+    testSizing();
+    return testResult();
+}
@@ -0,0 +1,77 @@
+#include "services/sizing_engine.h"
+#include "services/model_manager.h"
+#include "test_helpers.h"
+#include <cmath>
+
+static const unsigned long long MIB = 1024ull * 1024ull;
+static const unsigned long long GIB = 1024ull * MIB;
+
+static SizingConfig testConfig() {
+    SizingConfig config{};
+    config.kv_percentile = 0.99;
+    config.safety_margin = 0.15;
+    config.min_change = 0.05;
+    config.pressure_growth = 0.25;
+    config.min_samples = 10;
+    config.lookahead_minutes = 0;
+    return config;
+}
+
+// A model at 0.9 utilization holding num_gpu_blocks per device, using 30% of its KV cache
+static ModelMetrics steadyModel(unsigned int gpu_count) {
+    ModelMetrics metrics{};
+    metrics.model_id = "test/model";
+    metrics.configured_max_utilization = 0.9;
+    for (int i = 0; i < 20; ++i) {
+        ModelUsageSample sample{};
+        sample.timestamp = 1000.0 + 5.0 * i;
+        sample.total_vram_bytes = 80 * GIB * gpu_count;
+        sample.gpu_count = gpu_count;
+        sample.allocated_vram_bytes = sample.total_vram_bytes * 9 / 10;
+        sample.kv_cache_usage_perc = 0.3;
+        sample.num_gpu_blocks = 29000;
+        sample.kv_block_bytes = 2 * MIB;
+        sample.num_requests_running = 4;
+        metrics.usage_samples.push_back(sample);
+    }
+    return metrics;
+}
+
+static void testTooFewSamples() {
+    ModelMetrics metrics = steadyModel(1);
+    metrics.usage_samples.resize(5);
+    SizingRecommendation rec = sizeModelAllocation("vllm-test", metrics, testConfig());
+    CHECK(rec.basis == "insufficient_data");
+    CHECK(rec.action == "keep");
+    CHECK(rec.target_utilization == 0.9);
+}
+
+static void testSingleDeviceShrink() {
+    SizingRecommendation rec = sizeModelAllocation("vllm-test", steadyModel(1), testConfig());
+    CHECK(rec.basis == "kv_percentile");
+    CHECK(rec.action == "shrink");
+    // 0.3 * 29000 blocks with 15% margin
+    CHECK(rec.target_gpu_blocks >= 10004 && rec.target_gpu_blocks <= 10005);
+    // Fixed 72 GiB - 29000 * 2 MiB, plus 10005 * 2 MiB, over 80 GiB
+    double expected = (72.0 * GIB - 29000.0 * 2 * MIB + 10005.0 * 2 * MIB) / (80.0 * GIB);
+    CHECK(std::fabs(rec.target_utilization - expected) < 1e-6);
+}
+
+// Under TP=2 both workers hold num_gpu_blocks, so the KV share of the footprint doubles
+// with the capacity and the utilization matches the single-device case
+static void testTensorParallelShrink() {
+    SizingRecommendation single = sizeModelAllocation("vllm-test", steadyModel(1), testConfig());
+    SizingRecommendation rec = sizeModelAllocation("vllm-test", steadyModel(2), testConfig());
+    CHECK(rec.basis == "kv_percentile");
+    CHECK(rec.action == "shrink");
+    CHECK(std::fabs(rec.target_utilization - single.target_utilization) < 1e-6);
+    CHECK(rec.target_gpu_blocks == single.target_gpu_blocks);
+    CHECK(rec.projected_savings_bytes == 2 * single.projected_savings_bytes);
+}
+
+int main() {
+    testTooFewSamples();
+    testSingleDeviceShrink();
+    testTensorParallelShrink();
+    return testResult();
+}
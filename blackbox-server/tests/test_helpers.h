@@ -0,0 +1,20 @@
+#pragma once
+
+#include <iostream>
+
+// Minimal checks for the test executables: a failed CHECK is reported and the test
+// keeps running; main() returns testResult() so ctest sees the failure.
+static int test_failures = 0;
+
+#define CHECK(condition)                                                                        \
+    do {                                                                                        \
+        if (!(condition)) {                                                                     \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK failed: " #condition << std::endl; \
+            ++test_failures;                                                                    \
+        }                                                                                       \
+    } while (0)
+
+static int testResult() {
+    if (test_failures == 0) std::cout << "OK" << std::endl;
+    return test_failures == 0 ? 0 : 1;
+}